@@ -0,0 +1,63 @@
+#ifndef LITEHTML_BENCH_H
+#define LITEHTML_BENCH_H
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Minimal benchmark runner: every benchmark registers itself with BENCHMARK(name),
+// litehtml_benchmarks [filter] runs those whose name contains filter.
+namespace bench
+{
+	struct benchmark
+	{
+		const char*				name;
+		std::function<void()>	run;
+	};
+
+	inline std::vector<benchmark>& registry()
+	{
+		static std::vector<benchmark> list;
+		return list;
+	}
+
+	struct registrar
+	{
+		registrar(const char* name, std::function<void()> run) { registry().push_back({name, std::move(run)}); }
+	};
+
+	// Best wall time of iterations runs of fn, in milliseconds
+	template<class Fn>
+	double measure(int iterations, Fn&& fn)
+	{
+		double best = 0;
+		for (int i = 0; i < iterations; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			fn();
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			if (i == 0 || ms < best) best = ms;
+		}
+		return best;
+	}
+
+	inline void report(const char* what, double ms)
+	{
+		printf("  %-48s %10.3f ms\n", what, ms);
+	}
+
+	// Throughput of processing bytes in ms
+	inline void report_throughput(const char* what, size_t bytes, double ms)
+	{
+		printf("  %-48s %10.3f ms %10.1f MB/s\n", what, ms, ms > 0 ? bytes / (ms * 1000.0) : 0.0);
+	}
+}
+
+#define BENCHMARK(name) \
+	static void bench_##name(); \
+	static bench::registrar registrar_##name(#name, bench_##name); \
+	static void bench_##name()
+
+#endif // LITEHTML_BENCH_H
@@ -0,0 +1,41 @@
+#include "bench.h"
+#include "test_utils.h"
+#include <litehtml/css_tokenizer.h>
+
+using namespace litehtml;
+
+// Framework-style stylesheet: many small rules, shorthands, media queries and custom properties
+static string css_test_stylesheet(size_t size)
+{
+	string css = ":root { --primary: #0d6efd; --gap: 0.5rem; --font: system-ui, -apple-system, \"Segoe UI\", sans-serif }\n";
+	for (int i = 0; css.size() < size; i++)
+	{
+		string n = std::to_string(i);
+		css += ".btn-" + n + ", .btn-" + n + ":hover > .icon { color: var(--primary); margin: 0 auto; padding: 0.375rem 0.75rem;"
+			   " border: 1px solid transparent; border-radius: 0.25rem; font: 400 1rem/1.5 var(--font) }\n";
+		css += "div.col-" + n + " + p[data-x=\"" + n + "\"] { width: calc(100% - 2 * var(--gap)); background: url(img/" + n +
+			   ".png) no-repeat left top / cover, linear-gradient(to right, #fff 0%, rgba(0, 0, 0, .5) 100%) }\n";
+		if (i % 10 == 0)
+		{
+			css += "@media (min-width: " + std::to_string(576 + i) + "px) { .container-" + n + " { max-width: 540px; display: flex } }\n";
+		}
+	}
+	return css;
+}
+
+// Tokenizing and parsing a 1 MB stylesheet
+BENCHMARK(css_parse)
+{
+	test_doc_container container;
+	string css = css_test_stylesheet(1024 * 1024);
+
+	size_t tokens = 0;
+	bench::report_throughput("tokenize", css.size(), bench::measure(5, [&] {
+		tokens = tokenize(css).size();
+	}));
+
+	bench::report_throughput("compiled_css::create (parse + selectors)", css.size(), bench::measure(5, [&] {
+		compiled_css::create(css, &container);
+	}));
+	printf("  %zu top level tokens\n", tokens);
+}
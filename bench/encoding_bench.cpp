@@ -0,0 +1,44 @@
+#include "bench.h"
+#include <litehtml.h>
+#include <litehtml/encodings.h>
+#include <random>
+
+using namespace litehtml;
+
+// Mostly ASCII markup with a share of non-ASCII bytes, like a real page
+static string encoding_test_input(size_t size, const string& non_ascii)
+{
+	string text;
+	std::mt19937 rng(1);
+	while (text.size() < size)
+	{
+		text += "<p class=\"text\">Some text ";
+		for (int i = 0; i < 8; i++)
+		{
+			text += (rng() % 4) ? "word " : non_ascii;
+		}
+		text += "</p>\n";
+	}
+	return text;
+}
+
+static void decode_throughput(const char* what, const string& input, encoding enc)
+{
+	string output;
+	double ms = bench::measure(5, [&] {
+		output.clear();
+		decode(input, enc, output);
+	});
+	bench::report_throughput(what, input.size(), ms);
+}
+
+// decode() throughput of 32 MB inputs
+BENCHMARK(decoding)
+{
+	const size_t size = 32 * 1024 * 1024;
+	decode_throughput("utf-8, ASCII", encoding_test_input(size, "word "), encoding::utf_8);
+	decode_throughput("utf-8, valid", encoding_test_input(size, "\xD1\x81\xD0\xBB\xD0\xBE\xD0\xB2\xD0\xBE "), encoding::utf_8);
+	decode_throughput("utf-8, invalid bytes", encoding_test_input(size, "\xD1\x81\xFF\xB2\xD0 "), encoding::utf_8);
+	decode_throughput("windows-1251", encoding_test_input(size, "\xF1\xEB\xEE\xE2\xEE "), encoding::windows_1251);
+	decode_throughput("gb18030", encoding_test_input(size, "\xD6\xD0\xCE\xC4 "), encoding::gb18030);
+}
@@ -0,0 +1,63 @@
+#include "bench.h"
+#include "test_utils.h"
+#include <litehtml/render_item.h>
+#include <random>
+
+using namespace litehtml;
+
+// Long article with tables and floats, about 20k elements
+static string hit_test_document()
+{
+	string html = "<style>td { padding: 2px } .side { float: right; width: 100px }</style><body>";
+	for (int i = 0; i < 1000; i++)
+	{
+		string n = std::to_string(i);
+		html += "<div class='side'>note " + n + "</div><h3>Header " + n + "</h3>";
+		html += "<p>Paragraph with <a href='#'>a link</a> and <b>bold</b> text that wraps across several lines of the page.</p>";
+		html += "<table><tr><td>a</td><td>b</td><td>c</td></tr><tr><td>d</td><td>e</td><td>f</td></tr></table>";
+	}
+	return html + "</body>";
+}
+
+// get_element_by_point on random points, with and without the hit testing index
+BENCHMARK(hit_test)
+{
+	test_doc_container container;
+	auto doc = document::createFromString(hit_test_document(), &container);
+	doc->render(800);
+	pixel_t height = doc->height();
+
+	const int queries = 1000;
+	std::mt19937 rng(1);
+	std::vector<std::pair<pixel_t, pixel_t>> points;
+	for (int i = 0; i < queries; i++)
+	{
+		points.emplace_back((pixel_t) (rng() % 800), (pixel_t) (rng() % (int) height));
+	}
+
+	// The index is built by the first document::get_element_by_point call after render(),
+	// until then the render tree is walked without it
+	std::vector<element*> expected;
+	bench::report("1000 queries, no index", bench::measure(1, [&] {
+		expected.clear();
+		for (auto& pt : points)
+		{
+			expected.push_back(doc->root_render()->get_element_by_point(pt.first, pt.second, pt.first, 0).get());
+		}
+	}));
+
+	bench::report("build index", bench::measure(1, [&] {
+		doc->get_element_by_point(0, 0, 0, 0);
+	}));
+
+	size_t mismatches = 0;
+	bench::report("1000 queries, indexed", bench::measure(3, [&] {
+		mismatches = 0;
+		for (size_t i = 0; i < points.size(); i++)
+		{
+			auto& pt = points[i];
+			if (doc->get_element_by_point(pt.first, pt.second, pt.first, 0).get() != expected[i]) mismatches++;
+		}
+	}));
+	if (mismatches) printf("  %zu results differ\n", mismatches);
+}
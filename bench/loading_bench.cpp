@@ -0,0 +1,57 @@
+#include "bench.h"
+#include "test_utils.h"
+
+using namespace litehtml;
+
+static string loading_test_document(size_t size)
+{
+	string html = "<!DOCTYPE html><html><head><style>.note { color: #333; margin: 4px } td { padding: 2px }</style></head><body>";
+	for (int i = 0; html.size() < size; i++)
+	{
+		string n = std::to_string(i);
+		html += "<h2>Section " + n + "</h2><p class='note'>Paragraph <b>" + n + "</b> with <a href='#'>a link</a> and text that wraps.</p>";
+		html += "<ul><li>one</li><li>two</li></ul><table><tr><td>a" + n + "</td><td>b</td></tr></table>";
+	}
+	html += "</body></html>";
+	return html;
+}
+
+// Progressive loading of a 584 KB page in 16 KB chunks, compared with createFromString
+BENCHMARK(progressive_loading)
+{
+	test_doc_container container;
+	string html = loading_test_document(584 * 1024);
+	const size_t chunk = 16 * 1024;
+
+	bench::report_throughput("createFromString + render", html.size(), bench::measure(3, [&] {
+		auto doc = document::createFromString(html, &container);
+		doc->render(800);
+	}));
+
+	int updates = 0;
+	bench::report_throughput("append_bytes + finish + render", html.size(), bench::measure(3, [&] {
+		auto doc = document::begin(&container);
+		for (size_t pos = 0; pos < html.size(); pos += chunk)
+		{
+			doc->append_bytes(html.data() + pos, std::min(chunk, html.size() - pos));
+		}
+		doc->finish();
+		doc->render(800);
+	}));
+
+	bench::report_throughput("append_bytes + render on every update", html.size(), bench::measure(3, [&] {
+		auto doc = document::begin(&container);
+		updates = 0;
+		for (size_t pos = 0; pos < html.size(); pos += chunk)
+		{
+			if (doc->append_bytes(html.data() + pos, std::min(chunk, html.size() - pos)))
+			{
+				doc->render(800);
+				updates++;
+			}
+		}
+		doc->finish();
+		doc->render(800);
+	}));
+	printf("  %d updates\n", updates);
+}
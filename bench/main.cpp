@@ -0,0 +1,14 @@
+#include "bench.h"
+#include <cstring>
+
+int main(int argc, char* argv[])
+{
+	const char* filter = argc > 1 ? argv[1] : "";
+	for (const auto& item : bench::registry())
+	{
+		if (!strstr(item.name, filter)) continue;
+		printf("%s\n", item.name);
+		item.run();
+	}
+	return 0;
+}
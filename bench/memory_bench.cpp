@@ -0,0 +1,127 @@
+#include "bench.h"
+#include "test_utils.h"
+#include <litehtml/render_item.h>
+#include <cstdlib>
+#include <new>
+
+using namespace litehtml;
+
+// Counting operator new for the whole benchmark executable. Every block has a header with its size.
+namespace
+{
+	struct heap_counters
+	{
+		size_t	blocks = 0;		// live blocks
+		size_t	bytes = 0;		// live bytes
+		size_t	allocations = 0;
+	};
+	heap_counters g_heap;
+
+	constexpr size_t header_size = alignof(std::max_align_t);
+}
+
+void* operator new(size_t size)
+{
+	char* ptr = static_cast<char*>(std::malloc(size + header_size));
+	if (!ptr) throw std::bad_alloc();
+	*reinterpret_cast<size_t*>(ptr) = size;
+	g_heap.blocks++;
+	g_heap.bytes += size;
+	g_heap.allocations++;
+	return ptr + header_size;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	if (!ptr) return;
+	char* block = static_cast<char*>(ptr) - header_size;
+	g_heap.blocks--;
+	g_heap.bytes -= *reinterpret_cast<size_t*>(block);
+	std::free(block);
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete[](void* ptr) noexcept { operator delete(ptr); }
+void operator delete(void* ptr, size_t) noexcept { operator delete(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { operator delete(ptr); }
+
+static size_t count_elements(const element::ptr& el)
+{
+	size_t count = 1;
+	for (const auto& child : el->children())
+	{
+		count += count_elements(child);
+	}
+	return count;
+}
+
+static size_t count_render_items(const std::shared_ptr<render_item>& ri)
+{
+	size_t count = 1;
+	for (const auto& child : ri->children())
+	{
+		count += count_render_items(child);
+	}
+	return count;
+}
+
+static string memory_test_document()
+{
+	string html = "<style>.row td { padding: 2px } .note { color: gray }</style><body>";
+	for (int i = 0; i < 2000; i++)
+	{
+		string n = std::to_string(i);
+		html += "<div class='note' id='n" + n + "'><p>Paragraph <b>" + n + "</b> with <a href='#x'>a link</a>.</p>"
+				"<table><tr class='row'><td>a</td><td>b</td><td>c</td></tr></table></div>";
+	}
+	return html + "</body>";
+}
+
+static void report_heap(const char* what, const heap_counters& before, const heap_counters& after, size_t nodes)
+{
+	printf("  %-40s %8.2f allocations %8.2f live blocks %8.0f live bytes\n", what,
+		(double) (after.allocations - before.allocations) / nodes,
+		((double) after.blocks - (double) before.blocks) / nodes,
+		((double) after.bytes - (double) before.bytes) / nodes);
+}
+
+// Heap use of a parsed document (elements and render tree) per element, and of the render tree per render item
+BENCHMARK(memory)
+{
+	printf("  sizeof element %zu, html_tag %zu, css_properties %zu, render_item %zu\n",
+		sizeof(element), sizeof(html_tag), sizeof(css_properties), sizeof(render_item));
+
+	test_doc_container container;
+	string html = memory_test_document();
+	auto master = compiled_css::create(litehtml::master_css, &container);
+
+	heap_counters before = g_heap;
+	auto doc = document::createFromString(html, &container, master);
+	heap_counters after = g_heap;
+	size_t elements = count_elements(doc->root());
+	size_t items = count_render_items(doc->root_render());
+	printf("  %zu elements, %zu render items\n", elements, items);
+	report_heap("createFromString, per element", before, after, elements);
+
+	// Progressive loading allocates every element separately, without the arena
+	before = g_heap;
+	auto loaded = document::begin(&container, master);
+	loaded->append_bytes(html.data(), html.size());
+	loaded->finish();
+	after = g_heap;
+	report_heap("begin + append_bytes + finish, per element", before, after, count_elements(loaded->root()));
+	loaded.reset();
+
+	// The previous tree is released by the rebuild, so the live counts don't change
+	before = g_heap;
+	doc->rebuild_render_tree();
+	after = g_heap;
+	report_heap("rebuild_render_tree, per render item", before, after, items);
+	bench::report("rebuild_render_tree", bench::measure(3, [&] { doc->rebuild_render_tree(); }));
+
+	before = g_heap;
+	doc.reset();
+	after = g_heap;
+	printf("  %-40s %8.2f blocks %8.0f bytes\n", "freed with the document, per element",
+		(double) (before.blocks - after.blocks) / elements, (double) (before.bytes - after.bytes) / elements);
+}
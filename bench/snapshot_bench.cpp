@@ -0,0 +1,56 @@
+#include "bench.h"
+#include "test_utils.h"
+
+using namespace litehtml;
+
+// Styled page of about 10k elements
+static string snapshot_test_document()
+{
+	string html =
+		"<style>.card { margin: 4px; padding: 8px; border: 1px solid #ccc } .card h3 { font-size: 18px }"
+		" ul li:nth-child(2n) { color: gray } td + td { padding-left: 4px } a:hover { color: red }</style><body>";
+	for (int i = 0; i < 500; i++)
+	{
+		string n = std::to_string(i);
+		html += "<div class='card'><h3>Card " + n + "</h3><p>Text with <a href='#'>a link</a> and <b>bold</b> words.</p>"
+				"<ul><li>one</li><li>two</li><li>three</li></ul><table><tr><td>a</td><td>b</td></tr></table></div>";
+	}
+	return html + "</body>";
+}
+
+// Cloning a snapshot compared with parsing the page again. The documents are kept until the
+// measurement ends, so their destruction is not measured.
+BENCHMARK(snapshot)
+{
+	test_doc_container container;
+	string html = snapshot_test_document();
+	std::vector<document::ptr> docs;
+
+	bench::report("createFromString", bench::measure(3, [&] {
+		docs.push_back(document::createFromString(html, &container));
+	}));
+	size_t next = 0;
+	bench::report("render", bench::measure(3, [&] {
+		docs[next++]->render(800);
+	}));
+	docs.clear();
+
+	auto doc = document::createFromString(html, &container);
+	std::vector<document_snapshot::ptr> snaps;
+	bench::report("snapshot", bench::measure(3, [&] {
+		snaps.push_back(doc->snapshot());
+	}));
+	bench::report("clone_from_snapshot", bench::measure(3, [&] {
+		docs.push_back(document::clone_from_snapshot(snaps.back()));
+	}));
+	next = 0;
+	bench::report("render the clone", bench::measure(3, [&] {
+		docs[next++]->render(800);
+	}));
+	docs.clear();
+	bench::report("destroy a document", bench::measure(3, [&] {
+		document::clone_from_snapshot(snaps.back()).reset();
+	}) - bench::measure(3, [&] {
+		docs.push_back(document::clone_from_snapshot(snaps.back()));
+	}));
+}
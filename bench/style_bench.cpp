@@ -0,0 +1,67 @@
+#include "bench.h"
+#include "test_utils.h"
+
+using namespace litehtml;
+
+static string style_test_document(int elements)
+{
+	string html =
+		"<style>"
+		".a { color: red; margin: 1px 2px; padding: 3px } "
+		".b { font-weight: bold; border: 1px solid blue } "
+		"div > span { text-decoration: underline } "
+		".c:first-child { background-color: #eee } "
+		"#x1 .a { line-height: 1.5 }"
+		"</style><div id='x1'>";
+	// Sections of 50 rows, every row is a div with a span
+	for (int i = 0; i < elements / 2; i++)
+	{
+		if (i % 50 == 0) html += i ? "</section><section>" : "<section>";
+		html += (i % 3 == 0) ? "<div class='a c'>" : (i % 3 == 1) ? "<div class='b'>" : "<div class='a b' style='width: 10px'>";
+		html += "<span>t</span></div>";
+	}
+	html += "</section></div>";
+	return html;
+}
+
+// Style resolution of a 50k element document: matching, cascade and computed values
+BENCHMARK(style_50k_elements)
+{
+	test_doc_container container;
+	string html = style_test_document(50000);
+
+	document::ptr doc;
+	bench::report("createFromString (parse + style)", bench::measure(3, [&] {
+		doc = document::createFromString(html, &container);
+	}));
+
+	element::ptr root = doc->root();
+	bench::report("refresh_styles + compute_styles", bench::measure(3, [&] {
+		root->refresh_styles();
+		root->compute_styles();
+	}));
+}
+
+// Declaration block operations used by the cascade
+BENCHMARK(style_declarations)
+{
+	style a;
+	a.add("color: red; margin: 1px 2px; padding: 3px; font: bold 12px serif; border: 1px solid blue; display: block");
+	style b;
+	b.add("color: blue; width: 10px; height: 20px; background-color: #eee");
+
+	const string_id lookups[] = { _color_, _width_, _display_, _float_, _position_, _z_index_, _opacity_, _margin_top_ };
+	size_t found = 0;
+	bench::report("copy + combine + 8 lookups, 100k times", bench::measure(3, [&] {
+		for (int i = 0; i < 100000; i++)
+		{
+			style s = a;
+			s.combine(b);
+			for (string_id id : lookups)
+			{
+				if (!s.get_property(id).is<invalid>()) found++;
+			}
+		}
+	}));
+	if (!found) printf("  (no properties found)\n");
+}
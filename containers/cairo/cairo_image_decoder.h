@@ -0,0 +1,483 @@
+#ifndef LITEHTML_CAIRO_IMAGE_DECODER_H
+#define LITEHTML_CAIRO_IMAGE_DECODER_H
+
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <string>
+#include <functional>
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <cairo.h>
+
+// Image cache with asynchronous decoding, a replacement of cairo_images_cache for hosts that
+// download images into files.
+// When an image file is added, a worker reads only its header to get the intrinsic size, so
+// the layout can use the size before the pixels exist. The pixels are decoded on the first
+// get_image() call, i.e. when the image is painted, and are kept in a byte-budgeted LRU.
+// Evicted images keep their size and are decoded again from the file when painted.
+// Hosts call begin_frame() before painting: the images painted in the current frame are never
+// evicted, so a visible set larger than the budget stays decoded instead of decoding in a loop.
+class cairo_image_decoder
+{
+public:
+	// Default budget: 128 MiB of decoded pixels
+	static constexpr size_t DefaultMaxBytes = 128 * 1024 * 1024;
+
+	struct stats
+	{
+		size_t hits = 0;		// get_image returned the pixels
+		size_t misses = 0;		// get_image had to wait for a decode
+		size_t decodes = 0;
+		size_t evictions = 0;
+		size_t bytes = 0;		// decoded pixels resident
+		size_t entries = 0;		// decoded images resident
+	};
+
+	// Decodes the image file, returns nullptr on failure. Called by the workers.
+	typedef std::function<cairo_surface_t*(const std::string& path)> decode_function;
+	// The size of the image became known or its pixels are ready, the image should be painted again.
+	// relayout is true if the size is new and the layout depends on it. Called by the workers.
+	typedef std::function<void(const std::string& url, bool relayout)> ready_function;
+
+private:
+	typedef std::list<std::string> lru_list;
+
+	struct image
+	{
+		std::string			path;				// encoded image, empty for the images added decoded
+		bool				owns_file = false;	// path is removed with the decoder
+		bool				affects_layout = false;
+		int					width = -1;			// intrinsic size, -1 until known
+		int					height = -1;
+		cairo_surface_t*	surface = nullptr;
+		size_t				bytes = 0;
+		bool				queued = false;		// decode is queued or running
+		bool				failed = false;
+		unsigned			frame = 0;			// last frame that painted the image
+		lru_list::iterator	lru;				// valid if surface is set and path is not empty
+	};
+
+	struct task
+	{
+		std::string	url;
+		bool		decode;		// false: read the header only
+	};
+
+	std::mutex			m_mutex;
+	std::condition_variable	m_cond;
+	std::unordered_map<std::string, image>	m_images;
+	lru_list			m_lru;		// decoded images that can be decoded again, front is the most recently used
+	std::deque<task>	m_tasks;
+	std::vector<std::thread>	m_threads;
+	decode_function		m_decode;
+	ready_function		m_ready;
+	size_t				m_max_bytes = DefaultMaxBytes;
+	unsigned			m_frame = 0;	// 0 until the host calls begin_frame()
+	stats				m_stats;
+	bool				m_stop = false;
+
+public:
+	cairo_image_decoder(int workers, decode_function decode, ready_function ready) :
+		m_decode(std::move(decode)), m_ready(std::move(ready))
+	{
+		for(int i = 0; i < std::max(workers, 1); i++)
+		{
+			m_threads.emplace_back(&cairo_image_decoder::worker_loop, this);
+		}
+	}
+	cairo_image_decoder(const cairo_image_decoder&) = delete;
+	cairo_image_decoder& operator=(const cairo_image_decoder&) = delete;
+
+	~cairo_image_decoder()
+	{
+		stop();
+		for(auto& item : m_images)
+		{
+			if(item.second.surface)
+			{
+				cairo_surface_destroy(item.second.surface);
+			}
+			if(item.second.owns_file)
+			{
+				std::remove(item.second.path.c_str());
+			}
+		}
+	}
+
+	// Stops the workers, the queued work is dropped. Call it before the objects used by the callbacks are destroyed.
+	void stop()
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_stop = true;
+			m_tasks.clear();
+		}
+		m_cond.notify_all();
+		for(auto& thread : m_threads)
+		{
+			if(thread.joinable())
+			{
+				thread.join();
+			}
+		}
+	}
+
+	// Returns true if the image is new, the caller should download it
+	bool reserve(const std::string& url)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		return m_images.emplace(url, image()).second;
+	}
+
+	bool exists(const std::string& url)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		return m_images.find(url) != m_images.end();
+	}
+
+	/**
+	 * Adds a downloaded image file. Its header is read in the background.
+	 *
+	 * @param owns_file - remove the file with the decoder
+	 * @param affects_layout - the layout depends on the image size
+	 */
+	void add_file(const std::string& url, const std::string& path, bool owns_file, bool affects_layout)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			image& img = m_images[url];
+			drop_surface(img);
+			if(img.owns_file && img.path != path)
+			{
+				std::remove(img.path.c_str());
+			}
+			img.path = path;
+			img.owns_file = owns_file;
+			img.affects_layout = affects_layout;
+			img.width = img.height = -1;
+			img.failed = false;
+			img.queued = false;
+			m_tasks.push_back(task{url, false});
+		}
+		m_cond.notify_one();
+	}
+
+	// Adds a decoded image, it is never evicted. Takes the reference of the surface like cairo_images_cache::add_image.
+	void add_image(const std::string& url, cairo_surface_t* surface)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		image& img = m_images[url];
+		drop_surface(img);
+		img.surface = surface;
+		if(surface)
+		{
+			img.width = cairo_image_surface_get_width(surface);
+			img.height = cairo_image_surface_get_height(surface);
+			img.bytes = surface_bytes(surface);
+			m_stats.bytes += img.bytes;
+			m_stats.entries++;
+		}
+	}
+
+	// Returns referenced surface or nullptr. Images not decoded yet are queued for decoding.
+	cairo_surface_t* get_image(const std::string& url)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		auto iter = m_images.find(url);
+		if(iter == m_images.end())
+		{
+			return nullptr;
+		}
+		image& img = iter->second;
+		img.frame = m_frame;
+		if(img.surface)
+		{
+			m_stats.hits++;
+			if(!img.path.empty())
+			{
+				m_lru.splice(m_lru.begin(), m_lru, img.lru);
+			}
+			return cairo_surface_reference(img.surface);
+		}
+		m_stats.misses++;
+		queue_decode(url, img);
+		return nullptr;
+	}
+
+	// Decodes the image ahead of painting, e.g. when it is about to be scrolled into view
+	void prefetch(const std::string& url)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		auto iter = m_images.find(url);
+		if(iter != m_images.end() && !iter->second.surface)
+		{
+			queue_decode(url, iter->second);
+		}
+	}
+
+	// Starts painting a new frame. The images painted in the previous frame can be evicted again.
+	void begin_frame()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_frame++;
+	}
+
+	// Intrinsic size of the image, false if it isn't known yet
+	bool get_size(const std::string& url, int& width, int& height)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		auto iter = m_images.find(url);
+		if(iter == m_images.end() || iter->second.width < 0)
+		{
+			return false;
+		}
+		width = iter->second.width;
+		height = iter->second.height;
+		return true;
+	}
+
+	void set_max_bytes(size_t max_bytes)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_max_bytes = max_bytes;
+		evict();
+	}
+
+	stats get_stats()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		return m_stats;
+	}
+
+	// Intrinsic size from the header of PNG, GIF, JPEG, BMP and WebP files
+	static bool read_size(const unsigned char* data, size_t len, int& width, int& height)
+	{
+		auto be16 = [data](size_t pos) { return (data[pos] << 8) | data[pos + 1]; };
+		auto le16 = [data](size_t pos) { return data[pos] | (data[pos + 1] << 8); };
+		auto le24 = [data](size_t pos) { return data[pos] | (data[pos + 1] << 8) | (data[pos + 2] << 16); };
+		auto be32 = [data](size_t pos) { return (int) (((unsigned) data[pos] << 24) | (data[pos + 1] << 16) | (data[pos + 2] << 8) | data[pos + 3]); };
+		auto le32 = [data](size_t pos) { return (int) (data[pos] | (data[pos + 1] << 8) | (data[pos + 2] << 16) | ((unsigned) data[pos + 3] << 24)); };
+
+		if(len >= 24 && !memcmp(data, "\x89PNG\r\n\x1a\n", 8) && !memcmp(data + 12, "IHDR", 4))
+		{
+			width = be32(16);
+			height = be32(20);
+		} else if(len >= 10 && (!memcmp(data, "GIF87a", 6) || !memcmp(data, "GIF89a", 6)))
+		{
+			width = le16(6);
+			height = le16(8);
+		} else if(len >= 26 && data[0] == 'B' && data[1] == 'M')
+		{
+			width = le32(18);
+			height = std::abs(le32(22));
+		} else if(len >= 30 && !memcmp(data, "RIFF", 4) && !memcmp(data + 8, "WEBP", 4))
+		{
+			if(!memcmp(data + 12, "VP8 ", 4))
+			{
+				width = le16(26) & 0x3fff;
+				height = le16(28) & 0x3fff;
+			} else if(!memcmp(data + 12, "VP8L", 4))
+			{
+				width = 1 + (((data[22] & 0x3f) << 8) | data[21]);
+				height = 1 + (((data[24] & 0x0f) << 10) | (data[23] << 2) | ((data[22] & 0xc0) >> 6));
+			} else if(!memcmp(data + 12, "VP8X", 4))
+			{
+				width = 1 + le24(24);
+				height = 1 + le24(27);
+			} else
+			{
+				return false;
+			}
+		} else if(len >= 4 && data[0] == 0xff && data[1] == 0xd8)
+		{
+			// Walk the JPEG segments up to the start of frame
+			size_t pos = 2;
+			while(true)
+			{
+				while(pos < len && data[pos] != 0xff) pos++;
+				while(pos < len && data[pos] == 0xff) pos++;
+				if(pos + 8 > len) return false;
+				unsigned char marker = data[pos];
+				if(marker >= 0xd0 && marker <= 0xd9) { pos++; continue; }
+				if(marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc)
+				{
+					height = be16(pos + 4);
+					width = be16(pos + 6);
+					break;
+				}
+				pos += 1 + be16(pos + 1);
+			}
+		} else
+		{
+			return false;
+		}
+		return width > 0 && height > 0;
+	}
+
+private:
+	static size_t surface_bytes(cairo_surface_t* surface)
+	{
+		return (size_t) cairo_image_surface_get_stride(surface) * (size_t) cairo_image_surface_get_height(surface);
+	}
+
+	// Must be called with the mutex locked
+	void queue_decode(const std::string& url, image& img)
+	{
+		if(img.queued || img.failed || img.path.empty() || m_stop)
+		{
+			return;
+		}
+		img.queued = true;
+		// The most recently painted images first
+		m_tasks.push_front(task{url, true});
+		m_cond.notify_one();
+	}
+
+	// Must be called with the mutex locked
+	void drop_surface(image& img)
+	{
+		if(!img.surface) return;
+		if(!img.path.empty())
+		{
+			m_lru.erase(img.lru);
+		}
+		cairo_surface_destroy(img.surface);
+		img.surface = nullptr;
+		m_stats.bytes -= img.bytes;
+		m_stats.entries--;
+		img.bytes = 0;
+	}
+
+	// Painted in the current frame, or decoded for the frame painting it next. Must be called with the mutex locked.
+	bool is_pinned(const image& img) const
+	{
+		return m_frame != 0 && img.frame >= m_frame;
+	}
+
+	// Drops the least recently used images over the budget, except the pinned ones and keep.
+	// The budget is exceeded while the pinned images don't fit. Must be called with the mutex locked.
+	void evict(const image* keep = nullptr)
+	{
+		auto iter = m_lru.end();
+		while(m_stats.bytes > m_max_bytes && iter != m_lru.begin())
+		{
+			auto victim = std::prev(iter);
+			image& img = m_images[*victim];
+			if(&img == keep || is_pinned(img))
+			{
+				iter = victim;
+				continue;
+			}
+			drop_surface(img);
+			m_stats.evictions++;
+		}
+	}
+
+	void worker_loop()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while(true)
+		{
+			m_cond.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+			if(m_stop) return;
+
+			task t = std::move(m_tasks.front());
+			m_tasks.pop_front();
+			auto iter = m_images.find(t.url);
+			if(iter == m_images.end()) continue;
+			std::string path = iter->second.path;
+
+			if(!t.decode)
+			{
+				lock.unlock();
+				int width = 0;
+				int height = 0;
+				bool found = read_file_size(path, width, height);
+				lock.lock();
+
+				iter = m_images.find(t.url);
+				if(iter == m_images.end() || iter->second.path != path) continue;
+				if(!found)
+				{
+					// Unknown format, the size comes with the pixels
+					queue_decode(t.url, iter->second);
+					continue;
+				}
+				iter->second.width = width;
+				iter->second.height = height;
+				bool relayout = iter->second.affects_layout;
+				if(m_ready)
+				{
+					lock.unlock();
+					m_ready(t.url, relayout);
+					lock.lock();
+				}
+				continue;
+			}
+
+			lock.unlock();
+			cairo_surface_t* surface = m_decode ? m_decode(path) : nullptr;
+			lock.lock();
+
+			iter = m_images.find(t.url);
+			if(iter == m_images.end() || iter->second.path != path || m_stop)
+			{
+				if(surface) cairo_surface_destroy(surface);
+				continue;
+			}
+			image& img = iter->second;
+			img.queued = false;
+			m_stats.decodes++;
+			if(!surface)
+			{
+				img.failed = true;
+				continue;
+			}
+			bool size_changed = img.width != cairo_image_surface_get_width(surface) || img.height != cairo_image_surface_get_height(surface);
+			drop_surface(img);
+			img.surface = surface;
+			img.width = cairo_image_surface_get_width(surface);
+			img.height = cairo_image_surface_get_height(surface);
+			img.bytes = surface_bytes(surface);
+			m_lru.push_front(t.url);
+			img.lru = m_lru.begin();
+			m_stats.bytes += img.bytes;
+			m_stats.entries++;
+			// m_ready repaints the image in the next frame, it must survive until then even if it
+			// is larger than the whole budget
+			if(m_frame != 0 && img.frame + 1 >= m_frame)
+			{
+				img.frame = m_frame + 1;
+			}
+			bool relayout = size_changed && img.affects_layout;
+			evict(&img);
+			if(m_ready)
+			{
+				lock.unlock();
+				m_ready(t.url, relayout);
+				lock.lock();
+			}
+		}
+	}
+
+	// Reads the beginning of the file, JPEG files can have large metadata before the frame header
+	static bool read_file_size(const std::string& path, int& width, int& height)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if(!file) return false;
+		std::vector<unsigned char> data(256 * 1024);
+		file.read((char*) data.data(), (std::streamsize) data.size());
+		return read_size(data.data(), (size_t) file.gcount(), width, height);
+	}
+};
+
+#endif //LITEHTML_CAIRO_IMAGE_DECODER_H
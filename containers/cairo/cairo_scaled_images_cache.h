@@ -0,0 +1,298 @@
+#ifndef LITEHTML_CAIRO_SCALED_IMAGES_CACHE_H
+#define LITEHTML_CAIRO_SCALED_IMAGES_CACHE_H
+
+#include <mutex>
+#include <list>
+#include <unordered_map>
+#include <string>
+#include <functional>
+#include <cstddef>
+#include <cairo.h>
+
+// Bounded LRU cache of scaled image variants.
+// cairo_images_cache stores the original bitmaps only, so every repaint of a
+// background-size'd or <img> element used to rescale the original surface.
+// This cache keeps the scaled results keyed by (url, width, height, filter),
+// accounts the pixel memory of each entry and evicts the least recently used
+// entries when the byte budget is exceeded. The entries keep their originals alive, so
+// every referenced original counts toward the budget once too.
+class cairo_scaled_images_cache
+{
+public:
+	// Default budget: 64 MiB of scaled pixels and referenced originals
+	static constexpr size_t DefaultMaxBytes = 64 * 1024 * 1024;
+
+	struct stats
+	{
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t evictions = 0;
+		size_t bytes = 0;			// scaled variants and the originals they keep alive
+		size_t source_bytes = 0;	// the originals part of bytes
+		size_t entries = 0;
+	};
+
+private:
+	struct cache_key
+	{
+		std::string		url;
+		int				width;
+		int				height;
+		cairo_filter_t	filter;
+
+		bool operator==(const cache_key& other) const
+		{
+			return width == other.width && height == other.height && filter == other.filter && url == other.url;
+		}
+	};
+
+	struct cache_key_hash
+	{
+		size_t operator()(const cache_key& key) const
+		{
+			size_t h = std::hash<std::string>{}(key.url);
+			h ^= std::hash<int>{}(key.width) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			h ^= std::hash<int>{}(key.height) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			h ^= std::hash<int>{}((int) key.filter) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			return h;
+		}
+	};
+
+	struct cache_entry
+	{
+		cache_key			key;
+		cairo_surface_t*	source;		// referenced original the entry was produced from
+		cairo_surface_t*	surface;	// referenced scaled surface
+		size_t				bytes;
+	};
+
+	typedef std::list<cache_entry> lru_list;
+
+	std::mutex	m_mutex;
+	lru_list	m_lru;	// front is the most recently used entry
+	std::unordered_map<cache_key, lru_list::iterator, cache_key_hash> m_index;
+	std::unordered_map<cairo_surface_t*, size_t> m_sources;	// referenced originals -> number of entries
+	size_t		m_max_bytes = DefaultMaxBytes;
+	bool		m_mipmaps = false;
+	stats		m_stats;
+
+public:
+	cairo_scaled_images_cache() = default;
+	cairo_scaled_images_cache(const cairo_scaled_images_cache&) = delete;
+	cairo_scaled_images_cache& operator=(const cairo_scaled_images_cache&) = delete;
+
+	~cairo_scaled_images_cache()
+	{
+		clear();
+	}
+
+	void set_max_bytes(size_t max_bytes)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_max_bytes = max_bytes;
+		evict();
+	}
+
+	// Enable mipmap pyramid for downscales by more than 2x.
+	// Each halving level is cached too, so shrinking a large photo to a thumbnail
+	// averages all source pixels instead of sampling 4 of them per target pixel.
+	void set_mipmaps(bool enable)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_mipmaps = enable;
+	}
+
+	/**
+	 * Returns referenced surface with the image scaled to width x height.
+	 * The caller must destroy the returned surface.
+	 *
+	 * @param url - original image url, used as the cache key
+	 * @param source - original image surface
+	 * @param width, height - target size
+	 * @param filter - cairo filter used for scaling
+	 */
+	cairo_surface_t* get_scaled(const std::string& url, cairo_surface_t* source, int width, int height, cairo_filter_t filter = CAIRO_FILTER_BILINEAR)
+	{
+		if(!source || width <= 0 || height <= 0)
+		{
+			return nullptr;
+		}
+		int s_width = cairo_image_surface_get_width(source);
+		int s_height = cairo_image_surface_get_height(source);
+		if(s_width == width && s_height == height)
+		{
+			return cairo_surface_reference(source);
+		}
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		cairo_surface_t* ret = find(url, source, width, height, filter);
+		if(ret)
+		{
+			m_stats.hits++;
+			return ret;
+		}
+		m_stats.misses++;
+
+		cairo_surface_t* src = cairo_surface_reference(source);
+		if(m_mipmaps)
+		{
+			// Walk down the pyramid while the next level is still larger than the target
+			int level_width = s_width;
+			int level_height = s_height;
+			while(level_width / 2 >= width && level_height / 2 >= height && level_width > 1 && level_height > 1)
+			{
+				level_width /= 2;
+				level_height /= 2;
+				cairo_surface_t* level = find(url, source, level_width, level_height, CAIRO_FILTER_GOOD);
+				if(!level)
+				{
+					level = scale_surface(src, level_width, level_height, CAIRO_FILTER_GOOD);
+					insert(url, source, level_width, level_height, CAIRO_FILTER_GOOD, level);
+				}
+				cairo_surface_destroy(src);
+				src = level;
+			}
+		}
+
+		if(cairo_image_surface_get_width(src) == width && cairo_image_surface_get_height(src) == height)
+		{
+			return src;
+		}
+
+		ret = scale_surface(src, width, height, filter);
+		cairo_surface_destroy(src);
+		insert(url, source, width, height, filter, ret);
+		return ret;
+	}
+
+	// Remove all scaled variants of the image
+	void remove(const std::string& url)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		for(auto iter = m_lru.begin(); iter != m_lru.end();)
+		{
+			if(iter->key.url == url)
+			{
+				iter = erase(iter);
+			} else
+			{
+				++iter;
+			}
+		}
+	}
+
+	void clear()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		for(auto& entry : m_lru)
+		{
+			cairo_surface_destroy(entry.source);
+			cairo_surface_destroy(entry.surface);
+		}
+		m_lru.clear();
+		m_index.clear();
+		m_sources.clear();
+		m_stats.bytes = 0;
+		m_stats.source_bytes = 0;
+		m_stats.entries = 0;
+	}
+
+	stats get_stats()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		return m_stats;
+	}
+
+	static cairo_surface_t* scale_surface(cairo_surface_t* surface, int width, int height, cairo_filter_t filter = CAIRO_FILTER_BILINEAR)
+	{
+		int s_width = cairo_image_surface_get_width(surface);
+		int s_height = cairo_image_surface_get_height(surface);
+		cairo_surface_t *result = cairo_surface_create_similar(surface, cairo_surface_get_content(surface), width, height);
+		cairo_pattern_t *pattern = cairo_pattern_create_for_surface(surface);
+		cairo_t *cr = cairo_create(result);
+		cairo_pattern_set_filter(pattern, filter);
+		cairo_pattern_set_extend(pattern, CAIRO_EXTEND_PAD);
+		cairo_scale(cr, (double) width / (double) s_width, (double) height / (double) s_height);
+		cairo_set_source(cr, pattern);
+		cairo_rectangle(cr, 0, 0, s_width, s_height);
+		cairo_fill(cr);
+		cairo_destroy(cr);
+		cairo_pattern_destroy(pattern);
+		return result;
+	}
+
+private:
+	// Must be called with the mutex locked. Returns referenced surface or nullptr.
+	cairo_surface_t* find(const std::string& url, cairo_surface_t* source, int width, int height, cairo_filter_t filter)
+	{
+		auto iter = m_index.find(cache_key{url, width, height, filter});
+		if(iter == m_index.end())
+		{
+			return nullptr;
+		}
+		if(iter->second->source != source)
+		{
+			// The original image was reloaded, drop the stale variant
+			erase(iter->second);
+			return nullptr;
+		}
+		m_lru.splice(m_lru.begin(), m_lru, iter->second);
+		return cairo_surface_reference(iter->second->surface);
+	}
+
+	static size_t surface_bytes(cairo_surface_t* surface)
+	{
+		return (size_t) cairo_image_surface_get_stride(surface) * (size_t) cairo_image_surface_get_height(surface);
+	}
+
+	// Must be called with the mutex locked. Takes a new reference to surface.
+	void insert(const std::string& url, cairo_surface_t* source, int width, int height, cairo_filter_t filter, cairo_surface_t* surface)
+	{
+		size_t bytes = surface_bytes(surface);
+		size_t source_bytes = m_sources.count(source) ? 0 : surface_bytes(source);
+		if(bytes + source_bytes > m_max_bytes)
+		{
+			return;
+		}
+		// Keep the original alive while the variant is cached, so a reloaded image can't
+		// be allocated at the same address and be mistaken for the original.
+		m_lru.push_front(cache_entry{cache_key{url, width, height, filter}, cairo_surface_reference(source), cairo_surface_reference(surface), bytes});
+		m_index[m_lru.front().key] = m_lru.begin();
+		m_sources[source]++;
+		m_stats.bytes += bytes + source_bytes;
+		m_stats.source_bytes += source_bytes;
+		m_stats.entries++;
+		evict();
+	}
+
+	lru_list::iterator erase(lru_list::iterator iter)
+	{
+		m_index.erase(iter->key);
+		m_stats.bytes -= iter->bytes;
+		m_stats.entries--;
+		// The last entry of an original releases it
+		auto source = m_sources.find(iter->source);
+		if(--source->second == 0)
+		{
+			size_t source_bytes = surface_bytes(iter->source);
+			m_stats.bytes -= source_bytes;
+			m_stats.source_bytes -= source_bytes;
+			m_sources.erase(source);
+		}
+		cairo_surface_destroy(iter->source);
+		cairo_surface_destroy(iter->surface);
+		return m_lru.erase(iter);
+	}
+
+	void evict()
+	{
+		while(m_stats.bytes > m_max_bytes && !m_lru.empty())
+		{
+			erase(std::prev(m_lru.end()));
+			m_stats.evictions++;
+		}
+	}
+};
+
+#endif //LITEHTML_CAIRO_SCALED_IMAGES_CACHE_H
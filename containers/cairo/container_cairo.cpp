@@ -31,7 +31,7 @@ void container_cairo::draw_list_marker(litehtml::uint_ptr hdc, const litehtml::l
 		auto img = get_image(url);
 		if(img)
 		{
-			draw_pixbuf((cairo_t*) hdc, img, marker.pos.x, marker.pos.y, cairo_image_surface_get_width(img),
+			draw_pixbuf((cairo_t*) hdc, url, img, marker.pos.x, marker.pos.y, cairo_image_surface_get_width(img),
 						cairo_image_surface_get_height(img));
 			cairo_surface_destroy(img);
 		}
@@ -75,6 +75,10 @@ void container_cairo::get_image_size(const char* src, const char* baseurl, liteh
 	litehtml::string url;
 	make_url(src, baseurl, url);
 
+	if(get_image_size_hint(url, sz))
+	{
+		return;
+	}
 	auto img = get_image(url);
 	if(img)
 	{
@@ -122,10 +126,15 @@ void container_cairo::draw_image(litehtml::uint_ptr hdc, const litehtml::backgro
 		if (image_width != cairo_image_surface_get_width(bgbmp) ||
 				image_height != cairo_image_surface_get_height(bgbmp))
 		{
-			auto new_img = scale_surface(bgbmp, image_width, image_height);
+			auto new_img = m_scaled_images.get_scaled(img_url, bgbmp, image_width, image_height);
 			cairo_surface_destroy(bgbmp);
 			bgbmp = new_img;
 		}
+		if (!bgbmp)
+		{
+			cairo_restore(cr);
+			return;
+		}
 
 		cairo_pattern_t *pattern = cairo_pattern_create_for_surface(bgbmp);
 		cairo_matrix_t flib_m;
@@ -137,7 +146,7 @@ void container_cairo::draw_image(litehtml::uint_ptr hdc, const litehtml::backgro
 		switch (layer.repeat)
 		{
 			case litehtml::background_repeat_no_repeat:
-				draw_pixbuf(cr, bgbmp, layer.origin_box.x, layer.origin_box.y, cairo_image_surface_get_width(bgbmp),
+				draw_pixbuf(cr, img_url, bgbmp, layer.origin_box.x, layer.origin_box.y, cairo_image_surface_get_width(bgbmp),
 							cairo_image_surface_get_height(bgbmp));
 				break;
 
@@ -478,6 +487,68 @@ void container_cairo::del_clip()
 	}
 }
 
+// Layer handle is the cairo context of an image surface.
+// The surface has the device scale of the target, so layers stay sharp on HiDPI screens.
+litehtml::uint_ptr container_cairo::create_layer(litehtml::uint_ptr hdc, int width, int height)
+{
+	double scale_x = 1;
+	double scale_y = 1;
+	if(hdc)
+	{
+		cairo_surface_get_device_scale(cairo_get_target((cairo_t*) hdc), &scale_x, &scale_y);
+	}
+	cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+														  (int) std::ceil(width * scale_x), (int) std::ceil(height * scale_y));
+	cairo_surface_set_device_scale(surface, scale_x, scale_y);
+	cairo_t* cr = cairo_create(surface);
+	cairo_surface_destroy(surface);
+	if(cairo_status(cr) != CAIRO_STATUS_SUCCESS)
+	{
+		cairo_destroy(cr);
+		return 0;
+	}
+	// Clips of the outer content are applied when the layer is composited
+	m_layer_clips.push_back(std::move(m_clips));
+	m_clips.clear();
+	return (litehtml::uint_ptr) cr;
+}
+
+void container_cairo::finish_layer(litehtml::uint_ptr layer)
+{
+	cairo_surface_flush(cairo_get_target((cairo_t*) layer));
+	if(!m_layer_clips.empty())
+	{
+		m_clips = std::move(m_layer_clips.back());
+		m_layer_clips.pop_back();
+	}
+}
+
+void container_cairo::delete_layer(litehtml::uint_ptr layer)
+{
+	cairo_destroy((cairo_t*) layer);
+}
+
+void container_cairo::composite_layer(litehtml::uint_ptr hdc, litehtml::uint_ptr layer, const litehtml::TransformMatrix& transform, float opacity)
+{
+	auto* cr = (cairo_t*) hdc;
+	if(!cr || !layer || opacity <= 0) return;
+	cairo_save(cr);
+	apply_clip(cr);
+
+	cairo_matrix_t matrix;
+	cairo_matrix_init(&matrix, transform.a, transform.b, transform.c, transform.d, transform.e, transform.f);
+	cairo_transform(cr, &matrix);
+	cairo_set_source_surface(cr, cairo_get_target((cairo_t*) layer), 0, 0);
+	if(opacity < 1)
+	{
+		cairo_paint_with_alpha(cr, opacity);
+	} else
+	{
+		cairo_paint(cr);
+	}
+	cairo_restore(cr);
+}
+
 void container_cairo::apply_clip(cairo_t* cr )
 {
 	for(const auto& clip_box : m_clips)
@@ -528,15 +599,7 @@ void container_cairo::fill_ellipse(cairo_t* cr, litehtml::pixel_t x, litehtml::p
 
 void container_cairo::clear_images()
 {
-/*	for(images_map::iterator i = m_images.begin(); i != m_images.end(); i++)
-	{
-		if(i->second)
-		{
-			delete i->second;
-		}
-	}
-	m_images.clear();
-*/
+	m_scaled_images.clear();
 }
 
 const char* container_cairo::get_default_font_name() const
@@ -610,23 +673,10 @@ void container_cairo::rounded_rectangle(cairo_t* cr, const litehtml::position &p
 
 cairo_surface_t* container_cairo::scale_surface(cairo_surface_t* surface, int width, int height)
 {
-	int s_width = cairo_image_surface_get_width(surface);
-	int s_height = cairo_image_surface_get_height(surface);
-	cairo_surface_t *result = cairo_surface_create_similar(surface, cairo_surface_get_content(surface), width, height);
-	cairo_pattern_t *pattern = cairo_pattern_create_for_surface(surface);
-	cairo_t *cr = cairo_create(result);
-	cairo_pattern_set_filter(pattern, CAIRO_FILTER_BILINEAR);
-	cairo_pattern_set_extend(pattern, CAIRO_EXTEND_PAD);
-	cairo_scale(cr, (double) width / (double) s_width, (double) height / (double) s_height);
-	cairo_set_source(cr, pattern);
-	cairo_rectangle(cr, 0, 0, s_width, s_height);
-	cairo_fill(cr);
-	cairo_destroy(cr);
-	cairo_pattern_destroy(pattern);
-	return result;
+	return cairo_scaled_images_cache::scale_surface(surface, width, height);
 }
 
-void container_cairo::draw_pixbuf(cairo_t* cr, cairo_surface_t* bmp, litehtml::pixel_t x, litehtml::pixel_t y, int cx, int cy)
+void container_cairo::draw_pixbuf(cairo_t* cr, const litehtml::string& url, cairo_surface_t* bmp, litehtml::pixel_t x, litehtml::pixel_t y, int cx, int cy)
 {
 	cairo_save(cr);
 
@@ -636,10 +686,13 @@ void container_cairo::draw_pixbuf(cairo_t* cr, cairo_surface_t* bmp, litehtml::p
 
 		if(cx != cairo_image_surface_get_width(bmp) || cy != cairo_image_surface_get_height(bmp))
 		{
-			auto bmp_scaled = scale_surface(bmp, cx, cy);
-			cairo_set_source_surface(cr, bmp_scaled, x, y);
-			cairo_paint(cr);
-			cairo_surface_destroy(bmp_scaled);
+			auto bmp_scaled = m_scaled_images.get_scaled(url, bmp, cx, cy);
+			if(bmp_scaled)
+			{
+				cairo_set_source_surface(cr, bmp_scaled, x, y);
+				cairo_paint(cr);
+				cairo_surface_destroy(bmp_scaled);
+			}
 		} else
 		{
 			cairo_set_source_surface(cr, bmp, x, y);
@@ -751,8 +804,24 @@ void container_cairo::draw_conic_gradient(litehtml::uint_ptr hdc, const litehtml
 
 	clip_background_layer(cr, layer);
 
-	cairo_pattern_t* pattern = create_conic_gradient_pattern(gradient.angle * M_PI / 180.0 - M_PI / 2.0, gradient.radius, gradient.color_points);
-	if(!pattern) return;
+	// The mesh doesn't depend on the gradient position, so it is kept with the cached gradient layer
+	cairo_pattern_t* pattern;
+	if(gradient.backend_data)
+	{
+		pattern = cairo_pattern_reference((cairo_pattern_t*) gradient.backend_data.get());
+	} else
+	{
+		pattern = create_conic_gradient_pattern(gradient.angle * M_PI / 180.0 - M_PI / 2.0, gradient.radius, gradient.color_points);
+		if(!pattern)
+		{
+			cairo_restore(cr);
+			return;
+		}
+		gradient.backend_data = std::shared_ptr<void>(cairo_pattern_reference(pattern), [](void* ptr)
+			{
+				cairo_pattern_destroy((cairo_pattern_t*) ptr);
+			});
+	}
 
 	// Translate a pattern to the (layer.origin_box.x, layer.origin_box.y) point
 	litehtml::pointF position = gradient.position;
@@ -5,6 +5,7 @@
 #include <litehtml.h>
 #include <cairo.h>
 #include <vector>
+#include "cairo_scaled_images_cache.h"
 
 struct cairo_clip_box
 {
@@ -35,6 +36,8 @@ class container_cairo : public litehtml::document_container
 {
 protected:
     cairo_clip_box::vector		m_clips;
+	std::vector<cairo_clip_box::vector>	m_layer_clips;	// clips saved while a layer is painted
+	cairo_scaled_images_cache	m_scaled_images;
 public:
 	container_cairo() = default;
 	virtual ~container_cairo() = default;
@@ -62,13 +65,22 @@ public:
 	void set_clip(const litehtml::position& pos, const litehtml::border_radiuses& bdr_radius) override;
 	void del_clip() override;
 
+	litehtml::uint_ptr create_layer(litehtml::uint_ptr hdc, int width, int height) override;
+	void finish_layer(litehtml::uint_ptr layer) override;
+	void delete_layer(litehtml::uint_ptr layer) override;
+	void composite_layer(litehtml::uint_ptr hdc, litehtml::uint_ptr layer, const litehtml::TransformMatrix& transform, float opacity) override;
+
 	virtual void make_url( const char* url, const char* basepath, litehtml::string& out );
 	virtual cairo_surface_t* get_image(const std::string& url) = 0;
+	// Intrinsic size of the image if it is known without the pixels, see cairo_image_decoder
+	virtual bool get_image_size_hint(const std::string& /*url*/, litehtml::size& /*sz*/) { return false; }
 	virtual double get_screen_dpi() const = 0;
 	virtual int get_screen_width() const = 0;
 	virtual int get_screen_height() const = 0;
 
 	void clear_images();
+	// Cache of the scaled image variants used by draw_image. Use it to set the memory budget or enable mipmaps.
+	cairo_scaled_images_cache& scaled_images() { return m_scaled_images; }
 
 protected:
 	virtual void draw_ellipse(cairo_t* cr, litehtml::pixel_t x, litehtml::pixel_t y, litehtml::pixel_t width, litehtml::pixel_t height, const litehtml::web_color& color, litehtml::pixel_t line_width);
@@ -88,7 +100,7 @@ protected:
 private:
 
 	static void add_path_arc(cairo_t* cr, double x, double y, double rx, double ry, double a1, double a2, bool neg);
-    static void draw_pixbuf(cairo_t* cr, cairo_surface_t* bmp, litehtml::pixel_t x, litehtml::pixel_t y, int cx, int cy);
+    void draw_pixbuf(cairo_t* cr, const litehtml::string& url, cairo_surface_t* bmp, litehtml::pixel_t x, litehtml::pixel_t y, int cx, int cy);
 	static cairo_surface_t* scale_surface(cairo_surface_t* surface, int width, int height);
 };
 
@@ -1,6 +1,9 @@
 #include "Bitmap.h"
 #include "lodepng.h"
 #include "canvas_ity.hpp"
+#include "pixel_kernels.h"
+#include <cstring>
+#include <cmath>
 using namespace canvas_ity;
 
 Bitmap::Bitmap(canvas& canvas) : Bitmap(canvas.width(), canvas.height())
@@ -52,9 +55,19 @@ void Bitmap::draw_rect(int x, int y, int _width, int _height, color color)
 
 void Bitmap::fill_rect(rect rect, color color)
 {
-	for (int y = (int) rect.top(); y < rect.bottom(); y++)
-		for (int x = (int) rect.left(); x < rect.right(); x++)
-			set_pixel(x, y, color);
+	if (color.a == 0) return;
+	int x0 = max((int) rect.left(), 0);
+	int x1 = min((int) std::ceil(rect.right()), width);
+	int y0 = max((int) rect.top(), 0);
+	int y1 = min((int) std::ceil(rect.bottom()), height);
+	if (x0 >= x1) return;
+
+	uint32_t pixel;
+	static_assert(sizeof(pixel) == sizeof(color), "color must be 4 bytes");
+	memcpy(&pixel, &color, sizeof(pixel));
+	auto fill_span = pixel_kernels::get_pixel_kernels().fill_span;
+	for (int y = y0; y < y1; y++)
+		fill_span((uint32_t*) &data[x0 + y * width], pixel, x1 - x0);
 }
 
 void Bitmap::replace_color(color original, color replacement)
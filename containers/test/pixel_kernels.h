@@ -0,0 +1,587 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+// Pixel kernels for the software raster path of the test container.
+// All kernels are integer only, so every implementation (scalar, SSE2, AVX2, NEON)
+// produces bit-exact identical results. The implementation is selected at runtime
+// by get_pixel_kernels(); get_scalar_pixel_kernels() is the reference.
+//
+// Pixels are 32-bit RGBA8 in memory order (the layout of Bitmap::data), read as
+// little-endian words: alpha is the high byte.
+//
+// The kernels are header only, so the container sources list doesn't change for
+// the projects that build the test container.
+
+// The SSE2 kernels need SSE2 at compile time: always there on x86-64, opt-in on 32-bit x86
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__)) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PIXEL_KERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+#define PIXEL_KERNELS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PIXEL_KERNELS_TARGET_AVX2
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PIXEL_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace pixel_kernels
+{
+	// Fill n pixels with the color
+	using fill_span_fn = void (*)(uint32_t* dst, uint32_t color, size_t n);
+
+	// dst = src + dst * (255 - src.a) / 255 for premultiplied pixels
+	using blend_src_over_fn = void (*)(uint32_t* dst, const uint32_t* src, size_t n);
+
+	/**
+	 * Evaluate gradient span from a color lookup table.
+	 * The LUT position of pixel i is (pos + i * step) / 65536, clamped to [0, lut_size - 1].
+	 */
+	using gradient_span_fn = void (*)(uint32_t* dst, const uint32_t* lut, int lut_size, int32_t pos, int32_t step, size_t n);
+
+	/**
+	 * One box blur pass over an 8-bit mask (e.g. shadow coverage) in place.
+	 * Pixels outside the mask are treated as 0. radius is clamped to 127.
+	 */
+	using box_blur_fn = void (*)(uint8_t* mask, int width, int height, int stride, int radius);
+
+	struct kernels
+	{
+		const char*			name;
+		fill_span_fn		fill_span;
+		blend_src_over_fn	blend_src_over;
+		gradient_span_fn	gradient_span;
+		box_blur_fn			box_blur_h;
+		box_blur_fn			box_blur_v;
+	};
+
+	//
+	//  Scalar reference implementation
+	//
+
+	inline void fill_span_scalar(uint32_t* dst, uint32_t color, size_t n)
+	{
+		for (size_t i = 0; i < n; i++)
+			dst[i] = color;
+	}
+
+	// d * inv / 255 with exact rounding
+	inline uint32_t mul_div255(uint32_t d, uint32_t inv)
+	{
+		uint32_t t = d * inv + 128;
+		return (t + (t >> 8)) >> 8;
+	}
+
+	inline void blend_src_over_scalar(uint32_t* dst, const uint32_t* src, size_t n)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			uint32_t s = src[i];
+			uint32_t d = dst[i];
+			uint32_t inv = 255 - (s >> 24);
+			uint32_t res = 0;
+			for (int shift = 0; shift < 32; shift += 8)
+			{
+				uint32_t c = ((s >> shift) & 0xFF) + mul_div255((d >> shift) & 0xFF, inv);
+				res |= std::min(c, 255u) << shift;
+			}
+			dst[i] = res;
+		}
+	}
+
+	inline int32_t lut_index(int32_t pos, int lut_size)
+	{
+		int32_t idx = pos >> 16;
+		if (idx < 0) idx = 0;
+		if (idx > lut_size - 1) idx = lut_size - 1;
+		return idx;
+	}
+
+	inline void gradient_span_scalar(uint32_t* dst, const uint32_t* lut, int lut_size, int32_t pos, int32_t step, size_t n)
+	{
+		uint32_t p = (uint32_t) pos;
+		for (size_t i = 0; i < n; i++, p += (uint32_t) step)
+			dst[i] = lut[lut_index((int32_t) p, lut_size)];
+	}
+
+	// Box blur divisor: (sum * mul) >> 16 == sum / (2 * radius + 1) rounded, exact in 16-bit lanes
+	inline uint16_t box_blur_mul(int radius)
+	{
+		int d = 2 * radius + 1;
+		return (uint16_t) ((65536 + d - 1) / d);
+	}
+
+	// Blur one line of n samples read with the given step; src is the unmodified copy of the line
+	inline void box_blur_line(const uint8_t* src, uint8_t* dst, int n, int step, int radius, uint16_t mul)
+	{
+		uint32_t sum = 0;
+		for (int j = 0; j <= radius && j < n; j++)
+			sum += src[j];
+		for (int i = 0; i < n; i++)
+		{
+			dst[i * step] = (uint8_t) ((sum * mul) >> 16);
+			if (i + radius + 1 < n) sum += src[i + radius + 1];
+			if (i - radius >= 0) sum -= src[i - radius];
+		}
+	}
+
+	inline void box_blur_h_scalar(uint8_t* mask, int width, int height, int stride, int radius)
+	{
+		radius = std::min(radius, 127);
+		if (radius <= 0 || width <= 0) return;
+		uint16_t mul = box_blur_mul(radius);
+		std::vector<uint8_t> line(width);
+		for (int y = 0; y < height; y++)
+		{
+			uint8_t* row = mask + (size_t) y * stride;
+			std::copy(row, row + width, line.begin());
+			box_blur_line(line.data(), row, width, 1, radius, mul);
+		}
+	}
+
+	inline void box_blur_v_scalar(uint8_t* mask, int width, int height, int stride, int radius)
+	{
+		radius = std::min(radius, 127);
+		if (radius <= 0 || height <= 0) return;
+		uint16_t mul = box_blur_mul(radius);
+		std::vector<uint8_t> line(height);
+		for (int x = 0; x < width; x++)
+		{
+			for (int y = 0; y < height; y++)
+				line[y] = mask[(size_t) y * stride + x];
+			box_blur_line(line.data(), mask + x, height, stride, radius, mul);
+		}
+	}
+
+	inline const kernels& get_scalar_pixel_kernels()
+	{
+		static const kernels k =
+		{
+			"scalar",
+			fill_span_scalar,
+			blend_src_over_scalar,
+			gradient_span_scalar,
+			box_blur_h_scalar,
+			box_blur_v_scalar,
+		};
+		return k;
+	}
+
+	//
+	//  Box blur over lanes of 16-bit samples.
+	//  Lines are transposed into tmp[n][Lanes], so both directions run the same vector loop.
+	//
+
+	typedef void (*box_blur_lanes_fn)(uint16_t* tmp, int n, int radius, uint16_t mul, uint16_t* out);
+
+	template<int Lanes, class Vec>
+	void box_blur_lanes(uint16_t* tmp, int n, int radius, uint16_t mul, uint16_t* out)
+	{
+		Vec sum = Vec::zero();
+		for (int j = 0; j <= radius && j < n; j++)
+			sum = sum + Vec::load(tmp + j * Lanes);
+		Vec vmul = Vec::set(mul);
+		for (int i = 0; i < n; i++)
+		{
+			sum.mulhi(vmul).store(out + i * Lanes);
+			if (i + radius + 1 < n) sum = sum + Vec::load(tmp + (i + radius + 1) * Lanes);
+			if (i - radius >= 0) sum = sum - Vec::load(tmp + (i - radius) * Lanes);
+		}
+	}
+
+	template<int Lanes, box_blur_lanes_fn BlurLanes>
+	void box_blur_h_simd(uint8_t* mask, int width, int height, int stride, int radius)
+	{
+		radius = std::min(radius, 127);
+		if (radius <= 0 || width <= 0) return;
+		uint16_t mul = box_blur_mul(radius);
+		std::vector<uint16_t> tmp((size_t) width * Lanes);
+		std::vector<uint16_t> out((size_t) width * Lanes);
+		int y = 0;
+		for (; y + Lanes <= height; y += Lanes)
+		{
+			for (int k = 0; k < Lanes; k++)
+			{
+				const uint8_t* row = mask + (size_t) (y + k) * stride;
+				for (int x = 0; x < width; x++)
+					tmp[x * Lanes + k] = row[x];
+			}
+			BlurLanes(tmp.data(), width, radius, mul, out.data());
+			for (int k = 0; k < Lanes; k++)
+			{
+				uint8_t* row = mask + (size_t) (y + k) * stride;
+				for (int x = 0; x < width; x++)
+					row[x] = (uint8_t) out[x * Lanes + k];
+			}
+		}
+		if (y < height)
+			box_blur_h_scalar(mask + (size_t) y * stride, width, height - y, stride, radius);
+	}
+
+	template<int Lanes, box_blur_lanes_fn BlurLanes>
+	void box_blur_v_simd(uint8_t* mask, int width, int height, int stride, int radius)
+	{
+		radius = std::min(radius, 127);
+		if (radius <= 0 || height <= 0) return;
+		uint16_t mul = box_blur_mul(radius);
+		std::vector<uint16_t> tmp((size_t) height * Lanes);
+		std::vector<uint16_t> out((size_t) height * Lanes);
+		int x = 0;
+		for (; x + Lanes <= width; x += Lanes)
+		{
+			for (int y = 0; y < height; y++)
+			{
+				const uint8_t* src = mask + (size_t) y * stride + x;
+				for (int k = 0; k < Lanes; k++)
+					tmp[y * Lanes + k] = src[k];
+			}
+			BlurLanes(tmp.data(), height, radius, mul, out.data());
+			for (int y = 0; y < height; y++)
+			{
+				uint8_t* dst = mask + (size_t) y * stride + x;
+				for (int k = 0; k < Lanes; k++)
+					dst[k] = (uint8_t) out[y * Lanes + k];
+			}
+		}
+		if (x < width)
+			box_blur_v_scalar(mask + x, width - x, height, stride, radius);
+	}
+
+#ifdef PIXEL_KERNELS_X86
+
+	//
+	//  SSE2 (always available on x86-64, 32-bit builds need -msse2 or /arch:SSE2)
+	//
+
+	struct vec_sse2
+	{
+		__m128i v;
+		static vec_sse2 zero() { return {_mm_setzero_si128()}; }
+		static vec_sse2 set(uint16_t x) { return {_mm_set1_epi16((short) x)}; }
+		static vec_sse2 load(const uint16_t* p) { return {_mm_loadu_si128((const __m128i*) p)}; }
+		void store(uint16_t* p) const { _mm_storeu_si128((__m128i*) p, v); }
+		vec_sse2 operator+(vec_sse2 b) const { return {_mm_add_epi16(v, b.v)}; }
+		vec_sse2 operator-(vec_sse2 b) const { return {_mm_sub_epi16(v, b.v)}; }
+		vec_sse2 mulhi(vec_sse2 b) const { return {_mm_mulhi_epu16(v, b.v)}; }
+	};
+
+	inline void fill_span_sse2(uint32_t* dst, uint32_t color, size_t n)
+	{
+		__m128i c = _mm_set1_epi32((int) color);
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+			_mm_storeu_si128((__m128i*) (dst + i), c);
+		fill_span_scalar(dst + i, color, n - i);
+	}
+
+	inline __m128i blend_sse2(__m128i s, __m128i d)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i c255 = _mm_set1_epi16(255);
+		const __m128i c128 = _mm_set1_epi16(128);
+
+		__m128i s_lo = _mm_unpacklo_epi8(s, zero);
+		__m128i s_hi = _mm_unpackhi_epi8(s, zero);
+		__m128i inv_lo = _mm_sub_epi16(c255, _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_lo, 0xFF), 0xFF));
+		__m128i inv_hi = _mm_sub_epi16(c255, _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_hi, 0xFF), 0xFF));
+
+		__m128i t_lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), inv_lo), c128);
+		__m128i t_hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), inv_hi), c128);
+		t_lo = _mm_srli_epi16(_mm_add_epi16(t_lo, _mm_srli_epi16(t_lo, 8)), 8);
+		t_hi = _mm_srli_epi16(_mm_add_epi16(t_hi, _mm_srli_epi16(t_hi, 8)), 8);
+
+		return _mm_adds_epu8(s, _mm_packus_epi16(t_lo, t_hi));
+	}
+
+	inline void blend_src_over_sse2(uint32_t* dst, const uint32_t* src, size_t n)
+	{
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128i s = _mm_loadu_si128((const __m128i*) (src + i));
+			__m128i d = _mm_loadu_si128((const __m128i*) (dst + i));
+			_mm_storeu_si128((__m128i*) (dst + i), blend_sse2(s, d));
+		}
+		blend_src_over_scalar(dst + i, src + i, n - i);
+	}
+
+	inline void gradient_span_sse2(uint32_t* dst, const uint32_t* lut, int lut_size, int32_t pos, int32_t step, size_t n)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i max_idx = _mm_set1_epi32(lut_size - 1);
+		__m128i p = _mm_add_epi32(_mm_set1_epi32(pos), _mm_set_epi32((int) (3u * (uint32_t) step), (int) (2u * (uint32_t) step), step, 0));
+		const __m128i step4 = _mm_set1_epi32((int) (4u * (uint32_t) step));
+		alignas(16) int32_t idx[4];
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128i v = _mm_srai_epi32(p, 16);
+			v = _mm_andnot_si128(_mm_cmplt_epi32(v, zero), v);
+			__m128i gt = _mm_cmpgt_epi32(v, max_idx);
+			v = _mm_or_si128(_mm_and_si128(gt, max_idx), _mm_andnot_si128(gt, v));
+			_mm_store_si128((__m128i*) idx, v);
+			dst[i + 0] = lut[idx[0]];
+			dst[i + 1] = lut[idx[1]];
+			dst[i + 2] = lut[idx[2]];
+			dst[i + 3] = lut[idx[3]];
+			p = _mm_add_epi32(p, step4);
+		}
+		gradient_span_scalar(dst + i, lut, lut_size, (int32_t) ((uint32_t) pos + (uint32_t) i * (uint32_t) step), step, n - i);
+	}
+
+	inline const kernels& get_sse2_pixel_kernels()
+	{
+		static const kernels k =
+		{
+			"sse2",
+			fill_span_sse2,
+			blend_src_over_sse2,
+			gradient_span_sse2,
+			box_blur_h_simd<8, box_blur_lanes<8, vec_sse2>>,
+			box_blur_v_simd<8, box_blur_lanes<8, vec_sse2>>,
+		};
+		return k;
+	}
+
+	//
+	//  AVX2 (selected at runtime)
+	//
+
+	// Vector arguments can't cross into functions compiled without AVX2, so the lane loop is written out
+	PIXEL_KERNELS_TARGET_AVX2 inline void box_blur_lanes_avx2(uint16_t* tmp, int n, int radius, uint16_t mul, uint16_t* out)
+	{
+		__m256i sum = _mm256_setzero_si256();
+		for (int j = 0; j <= radius && j < n; j++)
+			sum = _mm256_add_epi16(sum, _mm256_loadu_si256((const __m256i*) (tmp + j * 16)));
+		const __m256i vmul = _mm256_set1_epi16((short) mul);
+		for (int i = 0; i < n; i++)
+		{
+			_mm256_storeu_si256((__m256i*) (out + i * 16), _mm256_mulhi_epu16(sum, vmul));
+			if (i + radius + 1 < n) sum = _mm256_add_epi16(sum, _mm256_loadu_si256((const __m256i*) (tmp + (i + radius + 1) * 16)));
+			if (i - radius >= 0) sum = _mm256_sub_epi16(sum, _mm256_loadu_si256((const __m256i*) (tmp + (i - radius) * 16)));
+		}
+	}
+
+	PIXEL_KERNELS_TARGET_AVX2 inline void fill_span_avx2(uint32_t* dst, uint32_t color, size_t n)
+	{
+		__m256i c = _mm256_set1_epi32((int) color);
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8)
+			_mm256_storeu_si256((__m256i*) (dst + i), c);
+		fill_span_scalar(dst + i, color, n - i);
+	}
+
+	PIXEL_KERNELS_TARGET_AVX2 inline void blend_src_over_avx2(uint32_t* dst, const uint32_t* src, size_t n)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i c255 = _mm256_set1_epi16(255);
+		const __m256i c128 = _mm256_set1_epi16(128);
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256i s = _mm256_loadu_si256((const __m256i*) (src + i));
+			__m256i d = _mm256_loadu_si256((const __m256i*) (dst + i));
+
+			__m256i s_lo = _mm256_unpacklo_epi8(s, zero);
+			__m256i s_hi = _mm256_unpackhi_epi8(s, zero);
+			__m256i inv_lo = _mm256_sub_epi16(c255, _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s_lo, 0xFF), 0xFF));
+			__m256i inv_hi = _mm256_sub_epi16(c255, _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s_hi, 0xFF), 0xFF));
+
+			__m256i t_lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), inv_lo), c128);
+			__m256i t_hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), inv_hi), c128);
+			t_lo = _mm256_srli_epi16(_mm256_add_epi16(t_lo, _mm256_srli_epi16(t_lo, 8)), 8);
+			t_hi = _mm256_srli_epi16(_mm256_add_epi16(t_hi, _mm256_srli_epi16(t_hi, 8)), 8);
+
+			_mm256_storeu_si256((__m256i*) (dst + i), _mm256_adds_epu8(s, _mm256_packus_epi16(t_lo, t_hi)));
+		}
+		blend_src_over_sse2(dst + i, src + i, n - i);
+	}
+
+	PIXEL_KERNELS_TARGET_AVX2 inline void gradient_span_avx2(uint32_t* dst, const uint32_t* lut, int lut_size, int32_t pos, int32_t step, size_t n)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i max_idx = _mm256_set1_epi32(lut_size - 1);
+		__m256i p = _mm256_add_epi32(_mm256_set1_epi32(pos), _mm256_mullo_epi32(_mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0), _mm256_set1_epi32(step)));
+		const __m256i step8 = _mm256_set1_epi32((int) (8u * (uint32_t) step));
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256i v = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(p, 16), zero), max_idx);
+			_mm256_storeu_si256((__m256i*) (dst + i), _mm256_i32gather_epi32((const int*) lut, v, 4));
+			p = _mm256_add_epi32(p, step8);
+		}
+		gradient_span_scalar(dst + i, lut, lut_size, (int32_t) ((uint32_t) pos + (uint32_t) i * (uint32_t) step), step, n - i);
+	}
+
+	inline const kernels& get_avx2_pixel_kernels()
+	{
+		static const kernels k =
+		{
+			"avx2",
+			fill_span_avx2,
+			blend_src_over_avx2,
+			gradient_span_avx2,
+			box_blur_h_simd<16, box_blur_lanes_avx2>,
+			box_blur_v_simd<16, box_blur_lanes_avx2>,
+		};
+		return k;
+	}
+
+	inline bool cpu_has_avx2()
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return false;
+#endif
+	}
+
+#endif // PIXEL_KERNELS_X86
+
+#ifdef PIXEL_KERNELS_NEON
+
+	//
+	//  NEON
+	//
+
+	struct vec_neon
+	{
+		uint16x8_t v;
+		static vec_neon zero() { return {vdupq_n_u16(0)}; }
+		static vec_neon set(uint16_t x) { return {vdupq_n_u16(x)}; }
+		static vec_neon load(const uint16_t* p) { return {vld1q_u16(p)}; }
+		void store(uint16_t* p) const { vst1q_u16(p, v); }
+		vec_neon operator+(vec_neon b) const { return {vaddq_u16(v, b.v)}; }
+		vec_neon operator-(vec_neon b) const { return {vsubq_u16(v, b.v)}; }
+		vec_neon mulhi(vec_neon b) const
+		{
+			uint32x4_t lo = vmull_u16(vget_low_u16(v), vget_low_u16(b.v));
+			uint32x4_t hi = vmull_u16(vget_high_u16(v), vget_high_u16(b.v));
+			return {vcombine_u16(vshrn_n_u32(lo, 16), vshrn_n_u32(hi, 16))};
+		}
+	};
+
+	inline void fill_span_neon(uint32_t* dst, uint32_t color, size_t n)
+	{
+		uint32x4_t c = vdupq_n_u32(color);
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+			vst1q_u32(dst + i, c);
+		fill_span_scalar(dst + i, color, n - i);
+	}
+
+	inline void blend_src_over_neon(uint32_t* dst, const uint32_t* src, size_t n)
+	{
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			uint8x16_t s = vreinterpretq_u8_u32(vld1q_u32(src + i));
+			uint8x16_t d = vreinterpretq_u8_u32(vld1q_u32(dst + i));
+			// broadcast alpha of every pixel to all its channels
+			uint32x4_t a32 = vshrq_n_u32(vreinterpretq_u32_u8(s), 24);
+			uint8x16_t inv = vmvnq_u8(vreinterpretq_u8_u32(vmulq_n_u32(a32, 0x01010101)));
+
+			// (t + ((t + 128) >> 8) + 128) >> 8 is the same as the scalar mul_div255
+			uint16x8_t t_lo = vmull_u8(vget_low_u8(d), vget_low_u8(inv));
+			uint16x8_t t_hi = vmull_u8(vget_high_u8(d), vget_high_u8(inv));
+			uint8x8_t r_lo = vrshrn_n_u16(vrsraq_n_u16(t_lo, t_lo, 8), 8);
+			uint8x8_t r_hi = vrshrn_n_u16(vrsraq_n_u16(t_hi, t_hi, 8), 8);
+
+			vst1q_u32(dst + i, vreinterpretq_u32_u8(vqaddq_u8(s, vcombine_u8(r_lo, r_hi))));
+		}
+		blend_src_over_scalar(dst + i, src + i, n - i);
+	}
+
+	inline void gradient_span_neon(uint32_t* dst, const uint32_t* lut, int lut_size, int32_t pos, int32_t step, size_t n)
+	{
+		const int32x4_t zero = vdupq_n_s32(0);
+		const int32x4_t max_idx = vdupq_n_s32(lut_size - 1);
+		const int32_t offsets[4] = {0, 1, 2, 3};
+		int32x4_t p = vreinterpretq_s32_u32(vmlaq_n_u32(vdupq_n_u32((uint32_t) pos), vreinterpretq_u32_s32(vld1q_s32(offsets)), (uint32_t) step));
+		const int32x4_t step4 = vdupq_n_s32((int32_t) (4u * (uint32_t) step));
+		int32_t idx[4];
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			vst1q_s32(idx, vminq_s32(vmaxq_s32(vshrq_n_s32(p, 16), zero), max_idx));
+			dst[i + 0] = lut[idx[0]];
+			dst[i + 1] = lut[idx[1]];
+			dst[i + 2] = lut[idx[2]];
+			dst[i + 3] = lut[idx[3]];
+			p = vaddq_s32(p, step4);
+		}
+		gradient_span_scalar(dst + i, lut, lut_size, (int32_t) ((uint32_t) pos + (uint32_t) i * (uint32_t) step), step, n - i);
+	}
+
+	inline const kernels& get_neon_pixel_kernels()
+	{
+		static const kernels k =
+		{
+			"neon",
+			fill_span_neon,
+			blend_src_over_neon,
+			gradient_span_neon,
+			box_blur_h_simd<8, box_blur_lanes<8, vec_neon>>,
+			box_blur_v_simd<8, box_blur_lanes<8, vec_neon>>,
+		};
+		return k;
+	}
+
+#endif // PIXEL_KERNELS_NEON
+
+	inline const kernels& get_pixel_kernels()
+	{
+#if defined(PIXEL_KERNELS_X86)
+		static const kernels& selected = cpu_has_avx2() ? get_avx2_pixel_kernels() : get_sse2_pixel_kernels();
+		return selected;
+#elif defined(PIXEL_KERNELS_NEON)
+		return get_neon_pixel_kernels();
+#else
+		return get_scalar_pixel_kernels();
+#endif
+	}
+
+	// Every implementation that runs on this CPU, the scalar reference first
+	inline std::vector<const kernels*> available_pixel_kernels()
+	{
+		std::vector<const kernels*> ret = { &get_scalar_pixel_kernels() };
+#if defined(PIXEL_KERNELS_X86)
+		ret.push_back(&get_sse2_pixel_kernels());
+		if (cpu_has_avx2())
+			ret.push_back(&get_avx2_pixel_kernels());
+#elif defined(PIXEL_KERNELS_NEON)
+		ret.push_back(&get_neon_pixel_kernels());
+#endif
+		return ret;
+	}
+
+	// Three box blur passes in each direction approximating gaussian blur with the given standard deviation
+	inline void gaussian_blur(uint8_t* mask, int width, int height, int stride, float sigma)
+	{
+		if (sigma <= 0) return;
+		// https://www.w3.org/TR/filter-effects-1/#feGaussianBlurElement
+		// three successive box blurs of size d approximate the gaussian
+		int d = (int) std::floor(sigma * 3 * std::sqrt(2 * 3.14159265f) / 4 + 0.5f);
+		int radius = d / 2;
+		if (radius <= 0) return;
+		const kernels& k = get_pixel_kernels();
+		for (int pass = 0; pass < 3; pass++)
+			k.box_blur_h(mask, width, height, stride, radius);
+		for (int pass = 0; pass < 3; pass++)
+			k.box_blur_v(mask, width, height, stride, radius);
+	}
+}
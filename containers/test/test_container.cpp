@@ -1,6 +1,9 @@
 #include "test_container.h"
 #include "Font.h"
+#include "pixel_kernels.h"
 #include "litehtml/types.h"
+#include <cmath>
+#include <cstdint>
 #include <fstream>
 #include <sstream>
 #define CANVAS_ITY_IMPLEMENTATION
@@ -27,8 +30,11 @@ void fill_rect(canvas& cvs, rect r)
 	cvs.fill_rectangle((float)r.x, (float)r.y, (float)r.width, (float)r.height);
 }
 
+static bool fill_opaque_rect(canvas& cvs, rect r, color c);
+
 void fill_rect(canvas& cvs, rect r, color color)
 {
+	if (fill_opaque_rect(cvs, r, color)) return;
 	set_color(cvs, fill_style, color);
 	fill_rect(cvs, r);
 }
@@ -92,6 +98,85 @@ void fill_polygon(canvas& cvs, vector<xy> points, color color)
 	cvs.fill();
 }
 
+//
+//  Software raster paths through the pixel kernels
+//  canvas_ity keeps float pixels, these paths read and write its pixels as 8-bit image data.
+//  The test container doesn't clip or transform the canvas outside draw_image_pattern, so
+//  writing the pixels gives the same result as drawing them.
+//
+
+// Straight alpha color to a premultiplied pixel
+static uint32_t premultiplied(color c)
+{
+	using pixel_kernels::mul_div255;
+	return (uint32_t) c.a << 24 | mul_div255(c.b, c.a) << 16 | mul_div255(c.g, c.a) << 8 | mul_div255(c.r, c.a);
+}
+
+static void premultiply(uint32_t* pixels, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		uint32_t px = pixels[i];
+		pixels[i] = premultiplied(color((byte) px, (byte) (px >> 8), (byte) (px >> 16), (byte) (px >> 24)));
+	}
+}
+
+static void unpremultiply(uint32_t* pixels, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		uint32_t& px = pixels[i];
+		uint32_t a = px >> 24;
+		if (a == 0 || a == 255) continue;
+		uint32_t res = a << 24;
+		for (int shift = 0; shift < 24; shift += 8)
+			res |= min((((px >> shift) & 0xFF) * 255 + a / 2) / a, 255u) << shift;
+		px = res;
+	}
+}
+
+// Blend premultiplied pixels (width x height) over the canvas at x, y
+static void composite(canvas& cvs, int x, int y, int width, int height, const vector<uint32_t>& layer)
+{
+	int x0 = max(x, 0);
+	int y0 = max(y, 0);
+	int x1 = min(x + width, cvs.width());
+	int y1 = min(y + height, cvs.height());
+	if (x0 >= x1 || y0 >= y1) return;
+
+	int w = x1 - x0;
+	int h = y1 - y0;
+	vector<uint32_t> pixels((size_t) w * h);
+	cvs.get_image_data((byte*) pixels.data(), w, h, w * 4, x0, y0);
+	premultiply(pixels.data(), pixels.size());
+	auto blend_src_over = pixel_kernels::get_pixel_kernels().blend_src_over;
+	for (int row = 0; row < h; row++)
+		blend_src_over(&pixels[(size_t) row * w], &layer[(size_t) (y0 - y + row) * width + (x0 - x)], w);
+	unpremultiply(pixels.data(), pixels.size());
+	cvs.put_image_data((byte*) pixels.data(), w, h, w * 4, x0, y0);
+}
+
+// Fill opaque pixel aligned rect with the span kernel, the pixels replace the canvas ones.
+// Returns false for other rects: canvas_ity antialiases the edges and blends translucent
+// colors in float in one pass, faster than reading the pixels back for blend_src_over.
+static bool fill_opaque_rect(canvas& cvs, rect r, color c)
+{
+	if (c.a != 255 || cvs.global_composite_operation != source_over) return false;
+	if (r.x != std::floor(r.x) || r.y != std::floor(r.y) || r.width != std::floor(r.width) || r.height != std::floor(r.height))
+		return false;
+
+	int x0 = max((int) r.x, 0);
+	int y0 = max((int) r.y, 0);
+	int width = min((int) r.right(), cvs.width()) - x0;
+	int height = min((int) r.bottom(), cvs.height()) - y0;
+	if (width <= 0 || height <= 0) return true;
+
+	vector<uint32_t> pixels((size_t) width * height);
+	pixel_kernels::get_pixel_kernels().fill_span(pixels.data(), premultiplied(c), pixels.size());
+	cvs.put_image_data((byte*) pixels.data(), width, height, width * 4, x0, y0);
+	return true;
+}
+
 //
 //  test_container implementation
 //
@@ -125,6 +210,59 @@ void test_container::draw_text(uint_ptr hdc, const char* text, uint_ptr hFont, w
 	font->draw_text(*(canvas*)hdc, text, color, (int) pos.x, (int) pos.y);
 }
 
+// Colorize 8-bit coverage mask with the color and blend it over the canvas at x, y
+static void draw_mask(canvas& cvs, int x, int y, const vector<byte>& mask, int width, int height, web_color c)
+{
+	vector<uint32_t> layer(mask.size());
+	for (size_t i = 0; i < mask.size(); i++)
+	{
+		if (mask[i] == 0) continue;
+		layer[i] = premultiplied(color(c.red, c.green, c.blue, (byte) pixel_kernels::mul_div255(mask[i], c.alpha)));
+	}
+	composite(cvs, x, y, width, height, layer);
+}
+
+// blur_radius is twice the standard deviation of the gaussian blur
+// https://drafts.csswg.org/css-backgrounds/#shadow-blur
+static int blur_padding(pixel_t blur_radius)
+{
+	return blur_radius > 0 ? (int) std::ceil(blur_radius * 1.5f) + 1 : 0;
+}
+
+void test_container::draw_text_with_shadows(uint_ptr hdc, const char* text, uint_ptr hFont, web_color color, const position& pos,
+											const std::vector<text_shadow>& shadows, pixel_t /*letter_spacing*/, pixel_t /*word_spacing*/)
+{
+	Font* font = (Font*)hFont;
+	auto& cvs = *(canvas*)hdc;
+	// First shadow is on top, so draw them in reverse order
+	for (auto shadow = shadows.rbegin(); shadow != shadows.rend(); ++shadow)
+	{
+		int x = (int) (pos.x + shadow->offset_x);
+		int y = (int) (pos.y + shadow->offset_y);
+		if (shadow->blur_radius <= 0)
+		{
+			font->draw_text(cvs, text, shadow->color, x, y);
+			continue;
+		}
+
+		int pad = blur_padding(shadow->blur_radius);
+		int width = (int) std::ceil(font->text_width(text)) + pad * 2;
+		int height = (int) std::ceil(font->height) + pad * 2;
+		if (width <= pad * 2 || height <= pad * 2) continue;
+
+		canvas text_canvas(width, height);
+		font->draw_text(text_canvas, text, black, pad, pad);
+		Bitmap text_bmp(text_canvas);
+
+		vector<byte> mask(width * height);
+		for (int i = 0; i < width * height; i++)
+			mask[i] = text_bmp.data[i].a;
+		pixel_kernels::gaussian_blur(mask.data(), width, height, width, shadow->blur_radius / 2);
+		draw_mask(cvs, x - pad, y - pad, mask, width, height, shadow->color);
+	}
+	font->draw_text(cvs, text, color, (int) pos.x, (int) pos.y);
+}
+
 pixel_t test_container::pt_to_px(float pt) const { return pt * 96 / 72; }
 pixel_t test_container::get_default_font_size() const { return 16; }
 const char* test_container::get_default_font_name() const { return "Terminus"; }
@@ -180,6 +318,67 @@ void test_container::draw_borders(uint_ptr hdc, const borders& borders, const po
 	::draw_image(*(canvas*)hdc, pos.x, pos.y, img);
 }
 
+void test_container::draw_box_shadow(uint_ptr hdc, const std::vector<box_shadow>& shadows, const position& pos)
+{
+	auto& cvs = *(canvas*)hdc;
+	int box_left = (int) pos.left();
+	int box_top = (int) pos.top();
+	int box_right = (int) std::ceil(pos.right());
+	int box_bottom = (int) std::ceil(pos.bottom());
+
+	// First shadow is on top, so draw them in reverse order
+	for (auto shadow = shadows.rbegin(); shadow != shadows.rend(); ++shadow)
+	{
+		if (shadow->color.alpha == 0) continue;
+		int pad = blur_padding(shadow->blur_radius);
+
+		// Shadow shape: the border box moved by the offset and grown (outer) or shrunk (inset) by the spread
+		pixel_t spread = shadow->inset ? -shadow->spread_radius : shadow->spread_radius;
+		int left = (int) std::floor(pos.left() + shadow->offset_x - spread);
+		int top = (int) std::floor(pos.top() + shadow->offset_y - spread);
+		int right = (int) std::ceil(pos.right() + shadow->offset_x + spread);
+		int bottom = (int) std::ceil(pos.bottom() + shadow->offset_y + spread);
+
+		// Mask area
+		int mx, my, width, height;
+		if (shadow->inset)
+		{
+			mx = box_left - pad;
+			my = box_top - pad;
+			width = box_right - box_left + pad * 2;
+			height = box_bottom - box_top + pad * 2;
+		} else
+		{
+			mx = left - pad;
+			my = top - pad;
+			width = right - left + pad * 2;
+			height = bottom - top + pad * 2;
+		}
+		if (width <= 0 || height <= 0) continue;
+
+		// Inset shadow covers everything outside the shape, outer shadow covers the shape
+		vector<byte> mask(width * height, shadow->inset ? 255 : 0);
+		byte shape = shadow->inset ? 0 : 255;
+		for (int y = max(top, my); y < min(bottom, my + height); y++)
+			for (int x = max(left, mx); x < min(right, mx + width); x++)
+				mask[(x - mx) + (y - my) * width] = shape;
+
+		pixel_kernels::gaussian_blur(mask.data(), width, height, width, shadow->blur_radius / 2);
+
+		// Outer shadows are clipped by the border box, inset shadows are drawn only inside it
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				bool inside = mx + x >= box_left && mx + x < box_right && my + y >= box_top && my + y < box_bottom;
+				if (inside != shadow->inset)
+					mask[x + y * width] = 0;
+			}
+		}
+		draw_mask(cvs, mx, my, mask, width, height, shadow->color);
+	}
+}
+
 void test_container::draw_list_marker(uint_ptr hdc, const list_marker& marker)
 {
 	auto& cvs = *(canvas*)hdc;
@@ -356,9 +555,40 @@ void draw_gradient(uint_ptr hdc, const background_layer& bg, const Gradient& gra
 	draw_image_pattern(*(canvas*)hdc, bg, img);
 }
 
+// Linear gradients are filled from the color LUT, one gradient span per row
 void test_container::draw_linear_gradient(uint_ptr hdc, const background_layer& layer, const background_layer::linear_gradient& gradient)
 {
-	draw_gradient(hdc, layer, gradient);
+	const int lut_size = 1024;
+	const vector<uint32_t>& lut = gradient.get_color_lut(lut_size);
+	int width = (int) layer.origin_box.width;
+	int height = (int) layer.origin_box.height;
+	float dx = gradient.end.x - gradient.start.x;
+	float dy = gradient.end.y - gradient.start.y;
+	float len2 = dx * dx + dy * dy;
+	if (lut.empty() || len2 == 0 || width <= 0 || height <= 0)
+	{
+		draw_gradient(hdc, layer, gradient);
+		return;
+	}
+
+	// LUT position of a pixel center in 16.16 fixed point, +0.5 rounds to the nearest entry
+	float scale = (lut_size - 1) * 65536.f / len2;
+	float start_x = gradient.start.x - layer.origin_box.x;
+	float start_y = gradient.start.y - layer.origin_box.y;
+	auto step = (int32_t) std::lround(dx * scale);
+
+	Bitmap img(width, height);
+	auto gradient_span = pixel_kernels::get_pixel_kernels().gradient_span;
+	for (int y = 0; y < height; y++)
+	{
+		float pos = ((0.5f - start_x) * dx + (y + 0.5f - start_y) * dy) * scale + 32768.f;
+		pos = std::max(std::min(pos, (float) INT32_MAX / 2), (float) INT32_MIN / 2);
+		auto row = (uint32_t*) &img.data[(size_t) y * width];
+		gradient_span(row, lut.data(), lut_size, (int32_t) pos, step, width);
+		// canvas_ity draws unpremultiplied images
+		unpremultiply(row, width);
+	}
+	draw_image_pattern(*(canvas*)hdc, layer, img);
 }
 
 void test_container::draw_radial_gradient(uint_ptr hdc, const background_layer& layer, const background_layer::radial_gradient& gradient)
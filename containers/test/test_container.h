@@ -21,6 +21,8 @@ public:
 	void			delete_font(uint_ptr /*hFont*/) override {}
 	pixel_t			text_width(const char* text, uint_ptr hFont) override;
 	void			draw_text(uint_ptr hdc, const char* text, uint_ptr hFont, web_color color, const position& pos) override;
+	void			draw_text_with_shadows(uint_ptr hdc, const char* text, uint_ptr hFont, web_color color, const position& pos,
+										   const std::vector<text_shadow>& shadows, pixel_t letter_spacing, pixel_t word_spacing) override;
 	pixel_t			pt_to_px(float pt) const override;
 	pixel_t			get_default_font_size() const override;
 	const char*		get_default_font_name() const override;
@@ -32,6 +34,7 @@ public:
 	void			draw_radial_gradient(uint_ptr hdc, const background_layer& layer, const background_layer::radial_gradient& gradient) override;
 	void 			draw_conic_gradient(uint_ptr hdc, const background_layer& layer, const background_layer::conic_gradient& gradient) override;
 	void			draw_borders(uint_ptr hdc, const borders& borders, const position& draw_pos, bool root) override;
+	void			draw_box_shadow(uint_ptr hdc, const std::vector<box_shadow>& shadows, const position& draw_pos) override;
 	void 			draw_list_marker(uint_ptr hdc, const list_marker& marker) override;
 	element::ptr	create_element(const char* /*tag_name*/,
 								   const string_map& /*attributes*/,
@@ -3,7 +3,8 @@
 
 #include "types.h"
 #include "css_interpolation.h"
-#include <map>
+#include "css_transform.h"
+#include <memory>
 #include <vector>
 #include <functional>
 
@@ -16,6 +17,9 @@ namespace litehtml
 	// Note: animation_play_state, animation_fill_mode, and animation_direction
 	// are already defined in types.h
 
+	// Matrices are interpolated component-wise (exact for translations and scales)
+	TransformMatrix interpolate_transform(const TransformMatrix& from, const TransformMatrix& to, float progress);
+
 	// Transition state for a single property
 	struct transition_state
 	{
@@ -35,8 +39,25 @@ namespace litehtml
 		web_color to_color;
 		bool is_color = false;
 
+		// For transform transitions
+		TransformMatrix from_transform;
+		TransformMatrix to_transform;
+		bool is_transform = false;
+
 		bool is_complete() const;
 		float get_progress(double current_time) const;
+		// Current value of a color or transform transition
+		TransformMatrix get_transform(float progress) const;
+	};
+
+	// Paint-only property value of a keyframe, resolved from the keyframe strings on the first frame
+	struct keyframe_value
+	{
+		string_id property;
+		float offset = 0;			// 0 to 1
+		float number = 0;			// opacity
+		web_color color;			// color, background-color
+		TransformMatrix transform;	// transform
 	};
 
 	// Animation state for a single animation
@@ -55,23 +76,37 @@ namespace litehtml
 		int current_iteration = 0;
 		double paused_time = 0;  // Time when paused
 
+		// Filled by document::advance_animations on the first frame
+		bool resolved = false;
+		std::vector<keyframe_value> values;			// sorted by property and offset
+		std::vector<keyframe_value> base_values;	// values without the animation, restored when it ends without fill
+
 		bool is_complete() const;
 		float get_progress(double current_time) const;
 		float get_direction_adjusted_progress(float progress) const;
 	};
 
-	// Animation controller - manages all animations and transitions for a document
+	// Animation controller - manages all animations and transitions for a document.
+	// Transitions and animations are kept in dense parallel arrays and advanced in one linear pass.
 	class animation_controller
 	{
 	public:
 		using animation_frame_callback = std::function<void()>;
+		// Receives every running transition with its eased progress, 1 for the last time
+		using transition_callback = std::function<void(element* el, const transition_state& state, float progress)>;
+		// Receives every animation with its direction adjusted progress, -1 if it doesn't apply now
+		using animation_callback = std::function<void(element* el, animation_state& state, float progress)>;
 
 	private:
-		// Active transitions per element (element -> property -> state)
-		std::map<element*, std::map<string_id, transition_state>> m_transitions;
+		// Active transitions, one entry per element and property
+		std::vector<element*>					m_transition_elements;
+		std::vector<std::weak_ptr<element>>		m_transition_refs;		// detects removed elements
+		std::vector<transition_state>			m_transitions;
 
-		// Active animations per element (element -> animation states)
-		std::map<element*, std::vector<animation_state>> m_animations;
+		// Active animations
+		std::vector<element*>					m_animation_elements;
+		std::vector<std::weak_ptr<element>>		m_animation_refs;		// detects removed elements
+		std::vector<animation_state>			m_animations;
 
 		// Callback to request animation frame
 		animation_frame_callback m_frame_callback;
@@ -79,6 +114,10 @@ namespace litehtml
 		// Whether we have any active animations
 		bool m_has_active_animations = false;
 
+		size_t find_transition(element* el, string_id property) const;
+		void remove_transition(size_t i);
+		void remove_animation(size_t i);
+
 	public:
 		animation_controller() = default;
 
@@ -103,9 +142,9 @@ namespace litehtml
 		// Remove all animations/transitions for element (called on element destruction)
 		void remove_element(element* el);
 
-		// Advance all animations/transitions
+		// Advance all animations/transitions, apply and apply_animation receive the current progress.
 		// Returns true if any animation is still active
-		bool advance(double current_time_ms);
+		bool advance(double current_time_ms, const transition_callback& apply = nullptr, const animation_callback& apply_animation = nullptr);
 
 		// Check if there are any active animations/transitions
 		bool has_active_animations() const { return m_has_active_animations; }
@@ -113,6 +152,8 @@ namespace litehtml
 		// Get interpolated value for a transitioning property
 		bool get_transition_value(element* el, string_id property, double current_time, float& value);
 		bool get_transition_color(element* el, string_id property, double current_time, web_color& color);
+		// Matrices are interpolated component-wise (exact for translations and scales)
+		bool get_transition_transform(element* el, double current_time, TransformMatrix& transform);
 
 		// Request an animation frame (calls the frame callback if set)
 		void request_frame();
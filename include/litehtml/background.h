@@ -60,9 +60,28 @@ namespace litehtml
 			vector<color_point>  color_points;
 			color_space_t        color_space       = color_space_none;
 			hue_interpolation_t  hue_interpolation = hue_interpolation_none;
+			// Container specific data attached to the gradient (e.g. prebuilt pattern).
+			// It lives as long as the gradient layer stays in the render item's cache.
+			mutable std::shared_ptr<void> backend_data;
+
+			virtual ~gradient_base() = default;
 
 			void color_points_transparent_fix();
 			bool prepare_color_points(float len, string_id grad_type, const vector<gradient::color_stop>& colors);
+			/**
+			 * Shift gradient geometry from the position the layer was resolved at, used when cached layer
+			 * is drawn at another position. Offsets don't add up: set_offset(0, 0) restores the resolved geometry.
+			 */
+			virtual void set_offset(float /*dx*/, float /*dy*/) {}
+			/**
+			 * Returns lookup table with lut_size colors evenly sampled from offset 0 to offset 1.
+			 * Colors are premultiplied RGBA8 in memory order (bytes R, G, B, A), the pixel layout of
+			 * canvas_ity and the test container's pixel kernels. Cairo's ARGB32 needs a byte swap.
+			 * The table is built once and kept with the gradient layer.
+			 */
+			const vector<uint32_t>& get_color_lut(int lut_size = 256) const;
+		private:
+			mutable vector<uint32_t> m_lut;
 		};
 
 		class linear_gradient : public gradient_base
@@ -70,6 +89,23 @@ namespace litehtml
 		public:
 			pointF start;
 			pointF end;
+
+			void set_offset(float dx, float dy) override
+			{
+				if(!m_resolved)
+				{
+					m_resolved = geometry{start, end};
+				}
+				start = pointF(m_resolved->start.x + dx, m_resolved->start.y + dy);
+				end = pointF(m_resolved->end.x + dx, m_resolved->end.y + dy);
+			}
+		private:
+			struct geometry
+			{
+				pointF start;
+				pointF end;
+			};
+			optional<geometry> m_resolved;
 		};
 
 		class radial_gradient : public gradient_base
@@ -77,6 +113,17 @@ namespace litehtml
 		public:
 			pointF position;
 			pointF radius;
+
+			void set_offset(float dx, float dy) override
+			{
+				if(!m_resolved)
+				{
+					m_resolved = position;
+				}
+				position = pointF(m_resolved->x + dx, m_resolved->y + dy);
+			}
+		private:
+			optional<pointF> m_resolved;
 		};
 
 		class conic_gradient : public gradient_base
@@ -85,9 +132,22 @@ namespace litehtml
 			pointF position; // position is the center of the conic gradient
 			float angle = 0; // angle is the angle of the gradient in degrees, starting from 0 at the top and going clockwise
 			float radius = 0; // radius is the distance from the center to the farthest corner of the background box
+
+			void set_offset(float dx, float dy) override
+			{
+				if(!m_resolved)
+				{
+					m_resolved = position;
+				}
+				position = pointF(m_resolved->x + dx, m_resolved->y + dy);
+			}
+		private:
+			optional<pointF> m_resolved;
 		};
 	};
 
+	class background_layer_cache;
+
 	class background
 	{
 	public:
@@ -139,7 +199,41 @@ namespace litehtml
 		std::unique_ptr<background_layer::linear_gradient> get_linear_gradient_layer(int idx, const background_layer& layer) const;
 		std::unique_ptr<background_layer::radial_gradient> get_radial_gradient_layer(int idx, const background_layer& layer) const;
 		std::unique_ptr<background_layer::conic_gradient> get_conic_gradient_layer(int idx, const background_layer& layer) const;
-		void draw_layer(uint_ptr hdc, int idx, const background_layer& layer, document_container* container) const;
+		void draw_layer(uint_ptr hdc, int idx, const background_layer& layer, document_container* container, background_layer_cache* cache = nullptr) const;
+	};
+
+	// Resolved gradient layers of one render item.
+	// Gradient layers depend on the gradient definition and the origin box size only, so
+	// they are reused between draws and just shifted when the element moves.
+	class background_layer_cache
+	{
+	public:
+		// Elements rarely have more gradient layers (inline boxes get one entry per line box)
+		static constexpr size_t MaxEntries = 8;
+
+		/**
+		 * Find the cached gradient layer. Returned layer is translated to the origin_box position.
+		 * The fingerprint is only a quick reject, a hit requires the whole gradient definition to match.
+		 * @return nullptr if the layer is not cached or the gradient/box size has changed
+		 */
+		const background_layer::gradient_base* find(const background* bg, int idx, size_t fingerprint, const gradient& grad, const position& origin_box);
+		const background_layer::gradient_base* store(const background* bg, int idx, size_t fingerprint, const gradient& grad, const position& origin_box,
+													 std::unique_ptr<background_layer::gradient_base> layer);
+		void clear() { m_entries.clear(); m_next = 0; }
+		size_t size() const { return m_entries.size(); }
+
+	private:
+		struct entry
+		{
+			const background*	bg = nullptr;
+			int					idx = -1;
+			size_t				fingerprint = 0;
+			gradient			grad;
+			position			origin_box;		// where the layer was resolved
+			std::unique_ptr<background_layer::gradient_base> layer;
+		};
+		vector<entry>	m_entries;
+		size_t			m_next = 0;
 	};
 }
 
@@ -12,13 +12,17 @@ class css_parser
 {
 	css_token_vector m_tokens;
 	int m_index = 0;
+	css_token_vector m_values;	// stack of the values of the blocks being consumed, see pop_values
 
-	css_token next_token();
-	css_token peek_token();
+	const css_token& next_token();
+	const css_token& peek_token();
+	css_token take_token(const css_token& token);
+	css_token_vector pop_values(size_t start);
 
 public:
 	css_parser() {}
 	css_parser(const css_token_vector& tokens) : m_tokens(tokens) {}
+	css_parser(css_token_vector&& tokens) : m_tokens(std::move(tokens)) {}
 
 	static raw_rule::vector parse_stylesheet(const string& input,           bool top_level);
 	static raw_rule::vector parse_stylesheet(const css_token_vector& input, bool top_level);
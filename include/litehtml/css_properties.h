@@ -156,6 +156,7 @@ namespace litehtml
 		TransformMatrix			m_transform_matrix;
 		css_length				m_transform_origin_x;
 		css_length				m_transform_origin_y;
+		bool					m_will_change_layer = false;	// will-change lists transform, opacity or filter
 
 		// CSS Transitions
 		transition_spec_vector	m_transitions;
@@ -309,6 +310,7 @@ namespace litehtml
 
 		const background &get_bg() const;
 		void set_bg(const background &mBg);
+		void set_bg_color(web_color color);
 
 		pixel_t get_font_size() const;
 		void set_font_size(pixel_t mFontSize);
@@ -397,10 +399,14 @@ namespace litehtml
 
 		// CSS Transform
 		const TransformMatrix& get_transform_matrix() const;
+		void set_transform_matrix(const TransformMatrix& transform);
 		bool has_transform() const;
 		css_length get_transform_origin_x() const;
 		css_length get_transform_origin_y() const;
 
+		// Element is painted through a compositing layer (transform, filter, opacity < 1 or will-change)
+		bool needs_compositing_layer() const;
+
 		// CSS Transitions
 		const transition_spec_vector& get_transitions() const;
 		void set_transitions(const transition_spec_vector& transitions);
@@ -695,6 +701,11 @@ namespace litehtml
 		m_bg = mBg;
 	}
 
+	inline void css_properties::set_bg_color(web_color color)
+	{
+		m_bg.m_color = color;
+	}
+
 	inline pixel_t css_properties::get_font_size() const
 	{
 		return (pixel_t)m_font_size.val();
@@ -1002,10 +1013,16 @@ namespace litehtml
 
 	// CSS Transform inline implementations
 	inline const TransformMatrix& css_properties::get_transform_matrix() const { return m_transform_matrix; }
+	inline void css_properties::set_transform_matrix(const TransformMatrix& transform) { m_transform_matrix = transform; }
 	inline bool css_properties::has_transform() const { return !m_transform_matrix.isIdentity(); }
 	inline css_length css_properties::get_transform_origin_x() const { return m_transform_origin_x; }
 	inline css_length css_properties::get_transform_origin_y() const { return m_transform_origin_y; }
 
+	inline bool css_properties::needs_compositing_layer() const
+	{
+		return m_will_change_layer || m_opacity < 1.0f || has_transform() || (!m_filter.empty() && m_filter != "none");
+	}
+
 	// Grid alignment inline implementations
 	inline flex_align_items css_properties::get_justify_items() const { return m_justify_items; }
 	inline flex_align_items css_properties::get_justify_self() const { return m_justify_self; }
@@ -210,19 +210,10 @@ namespace litehtml
 	public:
 		bool parse(const string& text, document_mode mode);
 		void calc_specificity();
-		bool is_media_valid() const;
+		bool is_media_valid(const document* doc) const;
 		void add_media_to_doc(document* doc) const;
 	};
 
-	inline bool css_selector::is_media_valid() const
-	{
-		if(!m_media_query)
-		{
-			return true;
-		}
-		return m_media_query->is_used();
-	}
-
 
 	//////////////////////////////////////////////////////////////////////////
 
@@ -72,13 +72,13 @@ struct css_token
 {
 	css_token(css_token_type type = css_token_type(),
 		float number = 0, css_number_type number_type = css_number_integer, string str = "")
-		: type(type), str(str), n{number, number_type}
+		: type(type), str(std::move(str)), n{number, number_type}
 	{
 		if (is_component_value()) new(&value) vector<css_token>;
 	}
 
-	css_token(css_token_type type, const string& str)
-		: type(type), str(str), n()
+	css_token(css_token_type type, string str)
+		: type(type), str(std::move(str)), n()
 	{
 		if (is_component_value()) new(&value) vector<css_token>;
 	}
@@ -108,13 +108,48 @@ struct css_token
 		}
 	}
 
+	// Component values own nested token vectors, moving them avoids deep copies
+	css_token(css_token&& token) noexcept : type(token.type), str(std::move(token.str)), repr(std::move(token.repr))
+	{
+		switch (type)
+		{
+		case HASH:
+			hash_type = token.hash_type;
+			break;
+
+		case NUMBER:
+		case PERCENTAGE:
+		case DIMENSION:
+			n = token.n;
+			break;
+
+		case CV_FUNCTION:
+		case CURLY_BLOCK:
+		case ROUND_BLOCK:
+		case SQUARE_BLOCK:
+			new(&value) vector(std::move(token.value));
+			break;
+
+		default:;
+		}
+	}
+
 	css_token& operator=(const css_token& token)
 	{
+		if (this == &token) return *this;
 		this->~css_token();
 		new(this) css_token(token);
 		return *this;
 	}
 
+	css_token& operator=(css_token&& token) noexcept
+	{
+		if (this == &token) return *this;
+		this->~css_token();
+		new(this) css_token(std::move(token));
+		return *this;
+	}
+
 	~css_token()
 	{
 		str.~string();
@@ -157,13 +192,18 @@ string get_repr(const css_token_vector& tokens, int index = 0, int count = -1, b
 class css_tokenizer
 {
 public:
+	// input is referenced, not copied: it must outlive the tokenizer. Tokens own their strings,
+	// so they can be used after the input is gone. Use tokenize(str) unless you need more.
 	css_tokenizer(const string& input) : str(input), index(0), current_char(0) {}
+	css_tokenizer(string&&) = delete;	// would reference a temporary
+	css_tokenizer(const css_tokenizer&) = delete;
+	css_tokenizer& operator=(const css_tokenizer&) = delete;
 
 	css_token_vector tokenize();
 
 private:
 	// Input stream. Valid UTF-8; no NUL bytes. https://www.w3.org/TR/css-syntax-3/#input-stream
-	string	str;
+	const string&	str;
 
 	// Index of the next input char.  https://www.w3.org/TR/css-syntax-3/#next-input-code-point
 	int		index;
@@ -6,9 +6,16 @@
 #include "master_css.h"
 #include "encodings.h"
 #include "font_description.h"
+#include "font_cache.h"
 #include "selector_filter.h"
 #include "style_cache.h"
+#include "rule_tree.h"
 #include "animation_state.h"
+#include "element_index.h"
+#include "node_arena.h"
+#include "preload_scanner.h"
+#include "virtual_list.h"
+#include <unordered_set>
 
 typedef struct GumboInternalOutput GumboOutput;
 
@@ -44,7 +51,9 @@ namespace litehtml
 	};
 
 	class html_tag;
+	class el_image;
 	class render_item;
+	class document_snapshot;
 
 	class document : public std::enable_shared_from_this<document>
 	{
@@ -56,11 +65,12 @@ namespace litehtml
 		std::shared_ptr<render_item>		m_root_render;
 		document_container*					m_container;
 		fonts_map							m_fonts;
+		std::shared_ptr<font_cache>			m_font_cache;		// Fonts shared with other documents, see document_container::get_font_cache
 		css_text::vector					m_css;
 		litehtml::css						m_styles;
 		litehtml::web_color					m_def_color;
-		litehtml::css						m_master_css;
-		litehtml::css						m_user_css;
+		compiled_css::ptr					m_master_css;
+		compiled_css::ptr					m_user_css;
 		litehtml::size						m_size;
 		litehtml::size						m_content_size;
 		position::vector					m_fixed_boxes;
@@ -68,17 +78,43 @@ namespace litehtml
 		std::shared_ptr<element>			m_active_element;
 		std::list<shared_ptr<render_item>>	m_tabular_elements;
 		media_query_list_list::vector		m_media_lists;
+		std::unordered_set<const media_query_list_list*> m_used_media_lists; // lists of m_media_lists matching m_media
+		media_breakpoints					m_media_breakpoints; // Changes of m_media that don't change m_used_media_lists
 		media_features						m_media;
 		string								m_lang;
 		string								m_culture;
-		string								m_text;
+		string								m_text;             // decoded input of non UTF-8 documents while parsing
 		document_mode						m_mode = no_quirks_mode;
 		selector_filter						m_selector_filter;  // Bloom filter for fast ancestor matching
+		rule_tree							m_rule_tree;        // Interned matched rule lists and style identities
 		style_cache							m_style_cache;      // Style sharing cache for similar elements
+		element_index						m_element_index;    // Lookup tables for select_all/select_one
 		pixel_t								m_scroll_x = 0;     // Scroll position for sticky elements
 		pixel_t								m_scroll_y = 0;
 		keyframes_map						m_keyframes;        // CSS @keyframes rules
 		animation_controller				m_animation_controller; // Animation/transition manager
+		double								m_animation_time = 0;   // Time of the last advance_animations
+		uint32_t							m_paint_generation = 1; // Content version of compositing layers
+		uint32_t							m_layout_generation = 1; // Version of the layout, changed by render()
+		uint32_t							m_hit_generation = 0;   // m_layout_generation of the hit testing index
+		struct loading_state;
+		std::unique_ptr<loading_state>		m_loading;          // Progressive loading state, set between begin() and finish()
+		node_arena*							m_arena = nullptr;  // Allocates the elements while createFromString parses
+		node_arena*							m_render_arena = nullptr; // Allocates the render items while build_render_tree runs
+		elements_list						m_removed_elements; // Removed from the tree but still rendered, see retain_removed
+		preload_scanner						m_preload;          // Resources requested by document_container::preload
+		struct lazy_image
+		{
+			std::weak_ptr<el_image>	el;
+			position				box;
+		};
+		lazy_images_policy					m_lazy_images_policy; // See document_container::get_lazy_images_policy
+		std::vector<lazy_image>				m_lazy_images;      // Images waiting for the viewport, sorted by box top
+		uint32_t							m_lazy_generation = 0; // m_layout_generation of the m_lazy_images boxes
+		std::vector<std::unique_ptr<virtual_list>> m_virtual_lists;
+
+		friend class compiled_css;
+		friend class virtual_list;
 	public:
 		document(document_container* objContainer);
 		virtual ~document();
@@ -86,7 +122,16 @@ namespace litehtml
 		document_container*				container()	{ return m_container; }
 		document_mode					mode() const { return m_mode; }
 		selector_filter&				get_selector_filter() { return m_selector_filter; }
+		// Pushes the ancestors of el to the selector filter before restyling el, returns the count for pop_ancestors
+		size_t							push_ancestors(const element& el);
+		void							pop_ancestors(size_t count);
+		rule_tree&						get_rule_tree() { return m_rule_tree; }
 		style_cache&					get_style_cache() { return m_style_cache; }
+		element_index&					get_element_index() { return m_element_index; }
+		node_arena*						render_arena() const { return m_render_arena; }
+		// Keeps an element removed from the tree alive until the render tree is built again,
+		// the render items refer to their elements without owning them
+		void							retain_removed(const std::shared_ptr<element>& el);
 		uint_ptr						get_font(const font_description& descr, font_metrics* fm);
 		pixel_t							render(pixel_t max_width, render_type rt = render_all);
 		pixel_t							render(pixel_t max_width, render_type rt, bool incremental_layout);
@@ -113,11 +158,17 @@ namespace litehtml
 		void							get_fixed_boxes(position::vector& fixed_boxes);
 		void							add_fixed_box(const position& pos);
 		void							add_media_list(media_query_list_list::ptr list);
+		bool							is_media_list_used(const media_query_list_list* list) const { return m_used_media_lists.count(list) != 0; }
+		// Call when the media features changed, true if the styles changed and the document must be rendered again
 		bool							media_changed();
 		bool							lang_changed();
 		bool							match_lang(const string& lang);
 		void							add_tabular(const std::shared_ptr<render_item>& el);
 		std::shared_ptr<const element>	get_over_element() const { return m_over_element; }
+		// Element at the point, x and y are document coordinates. Builds the hit testing index on the first call after render().
+		std::shared_ptr<element>		get_element_by_point(pixel_t x, pixel_t y, pixel_t client_x, pixel_t client_y);
+		// Generation of the render item hit areas, 0 if the index is out of date
+		uint32_t						hit_generation() const { return m_hit_generation == m_layout_generation ? m_hit_generation : 0; }
 
 		// Scroll position for sticky element positioning
 		void							set_scroll_position(pixel_t x, pixel_t y) { m_scroll_x = x; m_scroll_y = y; }
@@ -132,12 +183,21 @@ namespace litehtml
 		animation_controller&			get_animation_controller() { return m_animation_controller; }
 		const animation_controller&		get_animation_controller() const { return m_animation_controller; }
 
-		// Advance all animations and transitions
+		// Advance all animations and transitions and apply the transition values to the computed styles
 		// Returns true if any animation is still active
 		bool							advance_animations(double current_time_ms);
+		// Same as above. Changes of opacity, transform and colors need only a repaint of redraw_boxes,
+		// relayout is set if another property changed and render() must be called before draw().
+		bool							advance_animations(double current_time_ms, position::vector& redraw_boxes, bool& relayout);
 
 		// Check if there are any active animations
 		bool							has_active_animations() const { return m_animation_controller.has_active_animations(); }
+		double							animation_time() const { return m_animation_time; }
+
+		// Compositing layers are repainted only after render() or invalidate_layers().
+		// Call invalidate_layers() when the content changed without relayout (e.g. an image was loaded).
+		void							invalidate_layers() { m_paint_generation++; }
+		uint32_t						paint_generation() const { return m_paint_generation; }
 
 		void							append_children_from_string(element& parent, const char* str);
 		void							dump(dumper& cout);
@@ -149,17 +209,112 @@ namespace litehtml
 			const string&        master_styles = litehtml::master_css,
 			const string&        user_styles = "");
 
+		// Same as above with style sheets compiled once and shared by many documents, see compiled_css
+		static document::ptr  createFromString(
+			const estring&       str,
+			document_container*  container,
+			compiled_css::ptr    master_css,
+			compiled_css::ptr    user_css = nullptr);
+
+		// Progressive loading, see doc/document_createFromString.md
+		// begin() creates an empty document, append_bytes() feeds the input as it arrives and
+		// finish() completes the document. render() and draw() show the content received so far.
+		// Every update reparses all the input received so far, updates are throttled so that the
+		// parsed input grows geometrically.
+		static document::ptr  begin(
+			document_container*  container,
+			const string&        master_styles = litehtml::master_css,
+			const string&        user_styles = "",
+			encoding             enc = encoding::null);
+		static document::ptr  begin(
+			document_container*  container,
+			compiled_css::ptr    master_css,
+			compiled_css::ptr    user_css = nullptr,
+			encoding             enc = encoding::null);
+		bool							append_bytes(const char* data, size_t size);	// true if the element tree was updated
+		bool							finish();										// true if the element tree was updated
+		bool							is_loading() const { return m_loading != nullptr; }
+
+		// A style sheet requested by document_container::preload arrived, its @import rules are preloaded too.
+		// url is the URL of the style sheet, the base of its @import rules. Can be called from any thread.
+		void							stylesheet_preloaded(const string& url, const string& text);
+
+		// Virtual lists, see doc/using.md. The children of el are replaced by the rows of source near the
+		// viewport, a null source stops updating el (the rows in it are kept). Returns false if el belongs
+		// to another document or the row template has no element.
+		bool							set_virtual_list(const std::shared_ptr<element>& el, const std::shared_ptr<virtual_list_source>& source);
+		// Moves the rows of the virtual lists to the viewport, true if render() must be called
+		bool							update_virtual_lists();
+
+		// Lazy images, see document_container::get_lazy_images_policy
+		const lazy_images_policy&		lazy_images() const { return m_lazy_images_policy; }
+		void							add_lazy_image(const std::shared_ptr<el_image>& el);
+		// Loads the lazy images near the viewport, returns true if any image was requested. draw() calls it,
+		// hosts that don't draw the document after scrolling can call it themselves.
+		bool							update_lazy_images();
+
+		// Snapshot of the element tree and the computed styles, without the render tree and the layout.
+		// See doc/document_createFromString.md
+		// Returns nullptr while the document is loading or if it has an element that can't be copied.
+		std::shared_ptr<const document_snapshot> snapshot() const;
+		// New document with copies of the elements and computed styles of the snapshot. Its render tree
+		// is built again from them, and its first render() lays it out in full.
+		static document::ptr  clone_from_snapshot(const std::shared_ptr<const document_snapshot>& snap);
+
 	private:
 		uint_ptr	add_font(const font_description& descr, font_metrics* fm);
+		template<class T, class... Args>
+		std::shared_ptr<T> make_node(Args&&... args)
+		{
+			if (m_arena) return std::allocate_shared<T>(node_allocator<T>(m_arena), std::forward<Args>(args)...);
+			return std::make_shared<T>(std::forward<Args>(args)...);
+		}
+		document::ptr copy() const;
+		void resolve_keyframes(element* el, animation_state& anim);
 
-		GumboOutput* parse_html(estring str);
+		GumboOutput* parse_html(const estring& str);
+		void create_elements_tree(const estring& str);
 		void create_node(void* gnode, elements_list& elements, bool parseTextNode);
-		bool update_media_lists(const media_features& features);
+		std::shared_ptr<element> create_element_node(void* gnode);
+		void parse_default_styles(const string& master_styles, const string& user_styles);
+		void set_default_styles(compiled_css::ptr master_css, compiled_css::ptr user_css);
+		void add_default_styles_state();
+		void init_elements();
+		void build_render_tree();
+		void parse_stylesheets(size_t first);
+		void clear_trees();
+		bool update_loading(bool final);
+		void reset_loading_tree();
+		bool build_loading_tree(GumboOutput* output, bool final);
+		bool advance_loading_tree(void* groot, bool final);
+		void add_loaded_elements(const std::shared_ptr<element>& parent, elements_list& elements);
+		// Evaluates the lists depending on the changed media_dep_* features, updated gets the lists that changed
+		bool update_media_lists(const media_features& features, uint32_t changed = media_dep_all,
+								std::unordered_set<const media_query_list_list*>* updated = nullptr);
+		void restyle_media_elements(const std::unordered_set<const media_query_list_list*>& lists);
+		// Styles the subtree again from scratch, after its attributes changed
+		void restyle_subtree(const std::shared_ptr<element>& el);
+		// Applies the pseudo class changes, collects the rule tree when it has grown
+		bool find_styles_changes(position::vector& redraw_boxes);
+		// Drops the rule nodes and style identities no element uses
+		void collect_rule_tree();
+		elements_list parse_fragment(const string& html, const element& context);
 		void fix_tables_layout();
 		void fix_table_children(const std::shared_ptr<render_item>& el_ptr, style_display disp, const char* disp_str);
 		void fix_table_parent(const std::shared_ptr<render_item> & el_ptr, style_display disp, const char* disp_str);
 	};
 
+	// Immutable copy of the element tree of a document made by document::snapshot(), with the computed styles,
+	// the style sheets and the media state. document::clone_from_snapshot() only reads it.
+	// It keeps the fonts created by the document container, the container must outlive it.
+	class document_snapshot
+	{
+		friend class document;
+		std::shared_ptr<document>	m_doc;
+	public:
+		typedef std::shared_ptr<const document_snapshot>	ptr;
+	};
+
 	inline std::shared_ptr<element> document::root()
 	{
 		return m_root;
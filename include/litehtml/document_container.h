@@ -16,6 +16,7 @@ namespace litehtml
 {
 	struct box_shadow;  // Forward declaration
 	struct text_shadow; // Forward declaration
+	class font_cache;   // Forward declaration
 
 	// Form control types
 	enum form_control_type
@@ -124,6 +125,9 @@ namespace litehtml
 	public:
 		virtual litehtml::uint_ptr	create_font(const font_description& descr, const document* doc, litehtml::font_metrics* fm) = 0;
 		virtual void				delete_font(litehtml::uint_ptr hFont) = 0;
+		// Fonts shared by all documents of the container, see font_cache.
+		// Default returns nullptr: every document creates and deletes its own fonts.
+		virtual std::shared_ptr<font_cache>	get_font_cache() { return nullptr; }
 		virtual pixel_t				text_width(const char* text, litehtml::uint_ptr hFont) = 0;
 		virtual void				draw_text(litehtml::uint_ptr hdc, const char* text, litehtml::uint_ptr hFont, litehtml::web_color color, const litehtml::position& pos) = 0;
 		// Draw text with shadows - default implementation just calls draw_text
@@ -178,6 +182,21 @@ namespace litehtml
 		virtual void				begin_filter(const litehtml::string& /*filter*/) {}
 		virtual void				end_filter() {}
 
+		// Compositing layers: elements with transform, filter, opacity < 1 or will-change are
+		// painted once into an offscreen surface, and later frames only composite that surface
+		// with the current transform and opacity.
+		// create_layer returns the layer handle, which is also passed as hdc to the draw calls
+		// while the layer content is painted (in layer coordinates, clips set before the layer
+		// was created don't apply). finish_layer is called when the content is complete.
+		// hdc is the target the layer will be composited onto, use it to match its resolution
+		// (e.g. the device scale on HiDPI screens).
+		// Default implementation returns 0: no layer support, elements are drawn directly.
+		virtual litehtml::uint_ptr	create_layer(litehtml::uint_ptr /*hdc*/, int /*width*/, int /*height*/) { return 0; }
+		virtual void				finish_layer(litehtml::uint_ptr /*layer*/) {}
+		virtual void				delete_layer(litehtml::uint_ptr /*layer*/) {}
+		// Draw the layer onto hdc; transform maps layer coordinates to hdc coordinates
+		virtual void				composite_layer(litehtml::uint_ptr /*hdc*/, litehtml::uint_ptr /*layer*/, const TransformMatrix& /*transform*/, float /*opacity*/) {}
+
 		virtual	void				set_caption(const char* caption) = 0;
 		virtual	void				set_base_url(const char* base_url) = 0;
 		virtual void				link(const std::shared_ptr<litehtml::document>& doc, const litehtml::element::ptr& el) = 0;
@@ -187,6 +206,19 @@ namespace litehtml
 		virtual	void				set_cursor(const char* cursor) = 0;
 		virtual	void				transform_text(litehtml::string& text, litehtml::text_transform tt) = 0;
 		virtual void				import_css(litehtml::string& text, const litehtml::string& url, litehtml::string& baseurl) = 0;
+		// Resource preloading: the document finds style sheets, @import rules and images in the raw input before they
+		// are parsed. Start fetching the resource and return, import_css and load_image for the same url come later and
+		// can wait for the fetch. Pass fetched style sheets to document::stylesheet_preloaded to preload their @import
+		// rules. baseurl is empty (the document URL), the href of <base> or the URL of the style sheet.
+		// Default implementation does nothing.
+		virtual void				preload(const std::shared_ptr<litehtml::document>& /*doc*/, const litehtml::string& /*url*/,
+		                                    const litehtml::string& /*baseurl*/, litehtml::resource_type /*type*/) {}
+		// Lazy images: load_image is called when the image box comes within policy.margin of get_viewport(),
+		// which the document checks in draw() and update_lazy_images(). Called once when the document is created.
+		// Default implementation keeps the defaults of lazy_images_policy.
+		virtual void				get_lazy_images_policy(litehtml::lazy_images_policy& /*policy*/) const {}
+		// A lazy image came near the viewport, load_image for its src follows. Default implementation does nothing.
+		virtual void				on_image_near_viewport(const litehtml::element::ptr& /*el*/, const char* /*src*/) {}
 		virtual void				set_clip(const litehtml::position& pos, const litehtml::border_radiuses& bdr_radius) = 0;
 		virtual void				del_clip() = 0;
 		virtual void				get_viewport(litehtml::position& viewport) const = 0;
@@ -9,6 +9,7 @@ namespace litehtml
 	{
 	public:
 		explicit el_anchor(const std::shared_ptr<litehtml::document>& doc);
+		element::ptr copy() const override { return std::make_shared<el_anchor>(*this); }
 
 		void	on_click() override;
 		void	apply_stylesheet(const litehtml::css& stylesheet) override;
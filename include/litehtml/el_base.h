@@ -9,6 +9,7 @@ namespace litehtml
 	{
 	public:
 		explicit el_base(const std::shared_ptr<litehtml::document>& doc);
+		element::ptr copy() const override { return std::make_shared<el_base>(*this); }
 
 		void parse_attributes() override;
 	};
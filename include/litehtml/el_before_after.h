@@ -9,6 +9,7 @@ namespace litehtml
 	{
 	public:
 		el_before_after_base(const std::shared_ptr<document>& doc, bool before);
+		element::ptr copy() const override { return std::make_shared<el_before_after_base>(*this); }
 
 		void add_style(const style& style) override;
 	private:
@@ -24,6 +25,7 @@ namespace litehtml
 		{
 
 		}
+		element::ptr copy() const override { return std::make_shared<el_before>(*this); }
 	};
 
 	class el_after : public el_before_after_base
@@ -33,6 +35,7 @@ namespace litehtml
 		{
 
 		}
+		element::ptr copy() const override { return std::make_shared<el_after>(*this); }
 	};
 }
 
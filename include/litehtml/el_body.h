@@ -9,6 +9,7 @@ namespace litehtml
 	{
 	public:
 		explicit el_body(const std::shared_ptr<litehtml::document>& doc);
+		element::ptr copy() const override { return std::make_shared<el_body>(*this); }
 
 		bool is_body() const override;
 	};
@@ -9,6 +9,7 @@ namespace litehtml
 	{
 	public:
 		explicit el_break(const std::shared_ptr<litehtml::document>& doc);
+		element::ptr copy() const override { return std::make_shared<el_break>(*this); }
 
 		bool is_break() const override;
 	};
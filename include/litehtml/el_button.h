@@ -13,6 +13,7 @@ namespace litehtml
 
 	public:
 		el_button(const document::ptr& doc);
+		element::ptr copy() const override { return std::make_shared<el_button>(*this); }
 
 		bool is_replaced() const override;
 		void parse_attributes() override;
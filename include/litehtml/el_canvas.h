@@ -12,6 +12,7 @@ class el_canvas : public html_tag
 {
 public:
     el_canvas(const document::ptr& doc);
+    element::ptr copy() const override { return std::make_shared<el_canvas>(*this); }
 
     bool    is_replaced() const override;
     void    parse_attributes() override;
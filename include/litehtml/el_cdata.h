@@ -10,6 +10,7 @@ namespace litehtml
 		string	m_text;
 	public:
 		explicit el_cdata(const std::shared_ptr<document>& doc);
+		element::ptr copy() const override { return std::make_shared<el_cdata>(*this); }
 
 		void get_text(string& text) const override;
 		void set_data(const char* data) override;
@@ -10,6 +10,7 @@ namespace litehtml
 		string	m_text;
 	public:
 		explicit el_comment(const std::shared_ptr<document>& doc);
+		element::ptr copy() const override { return std::make_shared<el_comment>(*this); }
 
 		bool is_comment() const override;
 		void get_text(string& text) const override;
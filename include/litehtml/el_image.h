@@ -10,9 +10,18 @@ namespace litehtml
 
 	class el_image : public html_tag
 	{
-		string	m_src;
+		enum lazy_state
+		{
+			lazy_none,		// loaded when the styles are computed
+			lazy_waiting,	// waits for document::update_lazy_images
+			lazy_loaded
+		};
+
+		string		m_src;
+		lazy_state	m_lazy = lazy_none;
 	public:
 		el_image(const document::ptr& doc);
+		element::ptr copy() const override { return std::make_shared<el_image>(*this); }
 
 		bool	is_replaced() const override;
 		void	parse_attributes() override;
@@ -23,7 +32,13 @@ namespace litehtml
 
 		std::shared_ptr<render_item> create_render_item(const std::shared_ptr<render_item>& parent_ri) override;
 
+		bool	is_lazy_waiting() const { return m_lazy == lazy_waiting; }
+		// Called by the document when the image box comes near the viewport
+		void	load_lazy();
+
 	private:
+		bool	is_lazy() const;
+		void	load_image();
 //		pixel_t calc_max_height(pixel_t image_height);
 	};
 }
@@ -23,6 +23,7 @@ namespace litehtml
 
 	public:
 		el_input(const document::ptr& doc);
+		element::ptr copy() const override { return std::make_shared<el_input>(*this); }
 
 		bool is_replaced() const override;
 		void parse_attributes() override;
@@ -10,6 +10,7 @@ namespace litehtml
 		string m_text;
 	public:
 		explicit el_script(const std::shared_ptr<document>& doc);
+		element::ptr copy() const override { return std::make_shared<el_script>(*this); }
 
 		void parse_attributes() override;
 		bool appendChild(const ptr &el) override;
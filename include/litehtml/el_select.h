@@ -15,6 +15,7 @@ namespace litehtml
 
 	public:
 		el_select(const document::ptr& doc);
+		element::ptr copy() const override { return std::make_shared<el_select>(*this); }
 
 		bool is_replaced() const override;
 		void parse_attributes() override;
@@ -9,6 +9,7 @@ namespace litehtml
 	{
 	public:
 		el_space(const char* text, const std::shared_ptr<document>& doc);
+		element::ptr copy() const override { return std::make_shared<el_space>(*this); }
 
 		bool is_white_space() const override;
 		bool is_break() const override;
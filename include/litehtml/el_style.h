@@ -10,6 +10,7 @@ namespace litehtml
 		elements_list		m_children;
 	public:
 		explicit el_style(const std::shared_ptr<document>& doc);
+		element::ptr copy() const override { return std::make_shared<el_style>(*this); }
 
 		void			parse_attributes() override;
 		bool			appendChild(const ptr &el) override;
@@ -20,6 +20,7 @@ namespace litehtml
 
 	public:
 		el_svg(const document::ptr& doc);
+		element::ptr copy() const override { return std::make_shared<el_svg>(*this); }
 		~el_svg();
 
 		bool	is_replaced() const override;
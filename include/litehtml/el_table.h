@@ -9,6 +9,7 @@ namespace litehtml
 	{
 	public:
 		explicit el_table(const std::shared_ptr<litehtml::document>& doc);
+		element::ptr copy() const override { return std::make_shared<el_table>(*this); }
 
 		bool appendChild(const litehtml::element::ptr& el) override;
 		void parse_attributes() override;
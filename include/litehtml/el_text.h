@@ -16,6 +16,7 @@ namespace litehtml
 		bool			m_draw_spaces;
 	public:
 		el_text(const char* text, const document::ptr& doc);
+		element::ptr copy() const override { return std::make_shared<el_text>(*this); }
 
 		void				get_text(string& text) const override;
 		void				compute_styles(bool recursive, bool use_cache = true) override;
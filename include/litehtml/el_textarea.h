@@ -18,6 +18,7 @@ namespace litehtml
 
 	public:
 		el_textarea(const document::ptr& doc);
+		element::ptr copy() const override { return std::make_shared<el_textarea>(*this); }
 
 		bool is_replaced() const override;
 		void parse_attributes() override;
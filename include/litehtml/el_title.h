@@ -9,6 +9,7 @@ namespace litehtml
 	{
 	public:
 		explicit el_title(const std::shared_ptr<litehtml::document>& doc);
+		element::ptr copy() const override { return std::make_shared<el_title>(*this); }
 
 	protected:
 		void parse_attributes() override;
@@ -9,6 +9,7 @@ namespace litehtml
 	{
 	public:
 		explicit el_tr(const std::shared_ptr<litehtml::document>& doc);
+		element::ptr copy() const override { return std::make_shared<el_tr>(*this); }
 
 		void parse_attributes() override;
 	};
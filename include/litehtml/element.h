@@ -8,6 +8,8 @@
 #include "types.h"
 #include "stylesheet.h"
 #include "css_properties.h"
+#include "flat_map.h"
+#include "intrusive_list.h"
 
 namespace litehtml
 {
@@ -38,20 +40,31 @@ namespace litehtml
 		DOCUMENT_POSITION_IMPLEMENTATION_SPECIFIC = 0x20
 	};
 
+	class element;
+
+	// Children of an element, see intrusive_list
+	using child_list = intrusive_list<element>;
+
 	class element : public std::enable_shared_from_this<element>
 	{
 		friend class line_box;
 		friend class html_tag;
 		friend class el_table;
 		friend class document;
+		friend class intrusive_list<element>;
 	public:
 		typedef std::shared_ptr<element>		ptr;
 		typedef std::shared_ptr<const element>	const_ptr;
 		typedef std::weak_ptr<element>			weak_ptr;
+	private:
+		// Intrusive tree links, see child_list
+		element*								m_parent = nullptr;			// cleared when the parent removes the element or is destroyed
+		element*								m_prev_sibling = nullptr;
+		element::ptr							m_next_sibling;				// owning
+		child_list*								m_siblings = nullptr;		// the list the element is in
 	protected:
-		std::weak_ptr<element>					m_parent;
 		std::weak_ptr<document>					m_doc;
-		elements_list							m_children;
+		child_list								m_children;
 		css_properties							m_css;
 		std::list<std::weak_ptr<render_item>>	m_renders;
 		used_selector::vector					m_used_styles;
@@ -60,10 +73,13 @@ namespace litehtml
 		element::ptr _add_before_after(int type, const style& style);
 
 	private:
-		std::map<string_id, int>	m_counter_values;
+		flat_map<string_id, int>	m_counter_values;
 
 	public:
 		explicit element(const std::shared_ptr<document>& doc);
+		// Copies the node with its computed style, but not its parent, children and render items
+		element(const element& src);
+		element& operator=(const element&) = delete;
 		virtual ~element() = default;
 
 		const css_properties&		css() const;
@@ -86,7 +102,7 @@ namespace litehtml
 		bool						is_table_skip() const;
 
 		std::shared_ptr<document>	get_document() const;
-		const std::list<std::shared_ptr<element>>& children() const;
+		const child_list&			children() const;
 
 		virtual elements_list		select_all(const string& selector);
 		virtual elements_list		select_all(const css_selector& selector);
@@ -130,6 +146,9 @@ namespace litehtml
 
 		// Node manipulation
 		virtual element::ptr		cloneNode(bool deep = false) const;
+		// Copy of the same type made with the copy constructor, used by document::snapshot.
+		// Every element class must override it, nullptr means the node cannot be copied.
+		virtual element::ptr		copy() const;
 		bool						containsNode(const element::ptr& other) const;
 		unsigned short				compareDocumentPosition(const element::ptr& other) const;
 
@@ -197,7 +216,7 @@ namespace litehtml
 
 	private:
 		std::vector<element::ptr> get_siblings_before() const;
-		bool				find_counter(const string_id& counter_name_id, std::map<string_id, int>::iterator& map_iterator);
+		bool				find_counter(const string_id& counter_name_id, flat_map<string_id, int>::iterator& map_iterator);
 		void				parse_counter_tokens(const string_vector& tokens, const int default_value, std::function<void(const string_id&, const int)> handler) const;
 	};
 
@@ -218,17 +237,17 @@ namespace litehtml
 
 	inline bool litehtml::element::is_root() const
 	{
-		return m_parent.expired();
+		return m_parent == nullptr;
 	}
 
 	inline element::ptr litehtml::element::parent() const
 	{
-		return m_parent.lock();
+		return m_parent ? m_parent->shared_from_this() : nullptr;
 	}
 
 	inline void litehtml::element::parent(const element::ptr& par)
 	{
-		m_parent = par;
+		m_parent = par.get();
 	}
 
 	inline bool litehtml::element::is_positioned()	const
@@ -268,7 +287,7 @@ namespace litehtml
 		return false;
 	}
 
-	inline const std::list<std::shared_ptr<element>>& element::children() const
+	inline const child_list& element::children() const
 	{
 		return m_children;
 	}
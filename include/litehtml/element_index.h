@@ -0,0 +1,62 @@
+#ifndef LH_ELEMENT_INDEX_H
+#define LH_ELEMENT_INDEX_H
+
+#include "css_selector.h"
+#include <unordered_map>
+#include <vector>
+
+namespace litehtml
+{
+
+// Lookup tables of the element tree for select_all() and select_one(): elements by id,
+// class and tag, in document order. The tables are built by the first query. Id, class and
+// tag changes and elements appended at the end of the document update them in place, other
+// changes of the tree call invalidate() and the first query after it builds them again.
+// Parsed selector strings are cached too.
+class element_index
+{
+public:
+	// Maximum number of cached selector strings
+	static constexpr size_t MaxSelectors = 256;
+
+private:
+	using index_map = std::unordered_map<string_id, std::vector<size_t>>;	// positions in m_elements
+
+	std::vector<element*>	m_elements;		// all elements in document order
+	std::vector<size_t>		m_subtree_end;	// position after the last descendant of each element
+	std::unordered_map<const element*, size_t>	m_positions;	// positions of m_elements
+	index_map				m_ids;
+	index_map				m_classes;
+	index_map				m_tags;
+	const element*			m_root = nullptr;
+	bool					m_valid = false;
+
+	std::unordered_map<string, css_selector::ptr>	m_selectors;
+	document_mode			m_selectors_mode = no_quirks_mode;
+
+public:
+	void invalidate() { m_valid = false; }
+
+	// Updates the tables after the tag, id or classes of el changed from the old values
+	void changed(const html_tag* el, string_id old_tag, string_id old_id, const vector<string_id>& old_classes);
+	// Updates the tables after child was appended to the children of parent
+	void appended(const element* parent, element* child);
+
+	// Parsed selector, nullptr if the text is not a valid selector
+	css_selector::ptr get_selector(const string& text, document_mode mode);
+
+	// Adds the elements of the scope subtree (scope included) matching the selector to res,
+	// in document order. Stops at the first match if first_only.
+	// Returns false if scope is not in the tree of root, res is unchanged then.
+	bool select(element* root, const element* scope, const css_selector& selector, elements_list& res, bool first_only);
+
+private:
+	void update(element* root);
+	void add_subtree(element* el);
+	void add(element* el);
+	void insert_keys(const html_tag* el, size_t pos);
+};
+
+} // namespace litehtml
+
+#endif // LH_ELEMENT_INDEX_H
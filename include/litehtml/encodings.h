@@ -80,12 +80,18 @@ struct estring : string  // string with encoding
 
 encoding bom_sniff(const string& str);
 void encoding_sniffing_algorithm(estring& str);
+// same as above, for input that is not copied into an estring
+void encoding_sniffing_algorithm(const string& str, encoding& _encoding, confidence& _confidence);
 
 encoding get_encoding(string label);
 encoding extract_encoding_from_meta_element(string str);
 
-void decode(string input, encoding coding, string& output);
-string decode(string input, encoding coding);
+// Length of the longest prefix of str that is valid UTF-8
+size_t valid_utf8_length(const char* str, size_t len);
+inline bool is_valid_utf8(const string& str) { return valid_utf8_length(str.data(), str.size()) == str.size(); }
+
+void decode(const string& input, encoding coding, string& output);
+string decode(const string& input, encoding coding);
 
 } // namespace litehtml
 
@@ -0,0 +1,63 @@
+#ifndef LH_FLAT_MAP_H
+#define LH_FLAT_MAP_H
+
+#include <vector>
+#include <utility>
+
+namespace litehtml
+{
+	// Map for a few items stored in one vector and searched linearly.
+	// Used for per-element data like attributes, smaller and faster than std::map at this size.
+	template<class Key, class Value>
+	class flat_map
+	{
+		using item = std::pair<Key, Value>;
+		std::vector<item> m_items;
+	public:
+		using iterator			= typename std::vector<item>::iterator;
+		using const_iterator	= typename std::vector<item>::const_iterator;
+
+		iterator		begin()			{ return m_items.begin(); }
+		iterator		end()			{ return m_items.end(); }
+		const_iterator	begin() const	{ return m_items.begin(); }
+		const_iterator	end() const		{ return m_items.end(); }
+		size_t			size() const	{ return m_items.size(); }
+		bool			empty() const	{ return m_items.empty(); }
+		void			clear()			{ m_items.clear(); }
+
+		template<class K>
+		iterator find(const K& key)
+		{
+			for (auto it = m_items.begin(); it != m_items.end(); ++it)
+			{
+				if (it->first == key) return it;
+			}
+			return m_items.end();
+		}
+
+		template<class K>
+		const_iterator find(const K& key) const
+		{
+			return const_cast<flat_map*>(this)->find(key);
+		}
+
+		Value& operator[](const Key& key)
+		{
+			auto it = find(key);
+			if (it != m_items.end()) return it->second;
+			m_items.emplace_back(key, Value());
+			return m_items.back().second;
+		}
+
+		template<class K>
+		bool erase(const K& key)
+		{
+			auto it = find(key);
+			if (it == m_items.end()) return false;
+			m_items.erase(it);
+			return true;
+		}
+	};
+}
+
+#endif  // LH_FLAT_MAP_H
@@ -47,7 +47,7 @@ namespace litehtml
 
 		flex_align_items align;
 
-		explicit flex_item(std::shared_ptr<render_item> &_el) :
+		explicit flex_item(const std::shared_ptr<render_item> &_el) :
 				el(_el),
 				base_size(0),
 				min_size(0),
@@ -106,7 +106,7 @@ namespace litehtml
 	class flex_item_row_direction : public flex_item
 	{
 	public:
-		explicit flex_item_row_direction(std::shared_ptr<render_item> &_el) : flex_item(_el) {}
+		explicit flex_item_row_direction(const std::shared_ptr<render_item> &_el) : flex_item(_el) {}
 
 		void apply_main_auto_margins() override;
 		bool apply_cross_auto_margins(pixel_t cross_size) override;
@@ -131,7 +131,7 @@ namespace litehtml
 	class flex_item_column_direction : public flex_item
 	{
 	public:
-		explicit flex_item_column_direction(std::shared_ptr<render_item> &_el) : flex_item(_el) {}
+		explicit flex_item_column_direction(const std::shared_ptr<render_item> &_el) : flex_item(_el) {}
 
 		void apply_main_auto_margins() override;
 		bool apply_cross_auto_margins(pixel_t cross_size) override;
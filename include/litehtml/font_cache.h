@@ -0,0 +1,46 @@
+#ifndef LH_FONT_CACHE_H
+#define LH_FONT_CACHE_H
+
+#include "font_description.h"
+#include <memory>
+#include <mutex>
+
+namespace litehtml
+{
+	class document;
+	class document_container;
+
+	// Fonts shared by the documents of a container, see document_container::get_font_cache.
+	// A font is created once with document_container::create_font and counts the documents using it.
+	// Fonts no document uses are kept for the next documents until release_unused() or the
+	// destruction of the cache. Documents on different threads can use the same cache.
+	class font_cache
+	{
+		struct entry
+		{
+			font_item	item;
+			int			refs;
+		};
+
+		document_container*		m_container;
+		std::mutex				m_mutex;
+		std::unordered_map<font_description, entry, font_description::hasher> m_fonts;
+	public:
+		using ptr = std::shared_ptr<font_cache>;
+
+		explicit font_cache(document_container* container) : m_container(container) {}
+		~font_cache();
+		font_cache(const font_cache&) = delete;
+		font_cache& operator=(const font_cache&) = delete;
+
+		// Returns the font for descr, doc is passed to create_font if the font is created
+		uint_ptr	acquire(const font_description& descr, const document* doc, font_metrics* fm);
+		// The document doesn't use the font acquired for descr anymore
+		void		release(const font_description& descr);
+		// Deletes the fonts no document uses
+		void		release_unused();
+		size_t		size();
+	};
+}
+
+#endif  // LH_FONT_CACHE_H
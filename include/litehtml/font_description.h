@@ -2,6 +2,8 @@
 #define LITEHTML_FONT_DESCRIPTION
 
 #include <string>
+#include <cstring>
+#include <unordered_map>
 #include "types.h"
 #include "css_length.h"
 #include "web_color.h"
@@ -43,7 +45,62 @@ namespace litehtml
 
 			return out;
 		}
+
+		// Structural hash for font lookups, no strings are built
+		size_t hash_value() const
+		{
+			uint64_t h = std::hash<std::string>{}(family);
+			auto mix = [&h](uint64_t v) { h = (h ^ v) * 0x100000001b3ULL; };
+			auto mix_float = [&mix](float v) { uint32_t bits; memcpy(&bits, &v, sizeof(bits)); mix(bits); };
+			auto mix_color = [&mix](web_color c) { mix((uint64_t) c.red << 24 | (uint64_t) c.green << 16 | (uint64_t) c.blue << 8 | c.alpha); };
+			mix_float((float) size);
+			mix(style);
+			mix(weight);
+			mix(decoration_line);
+			mix(decoration_thickness.is_predefined() ? decoration_thickness.predef() : decoration_thickness.units());
+			mix_float(decoration_thickness.is_predefined() ? 0 : decoration_thickness.val());
+			mix(decoration_style);
+			mix_color(decoration_color);
+			mix(std::hash<std::string>{}(emphasis_style));
+			mix_color(emphasis_color);
+			mix(emphasis_position);
+			mix_float((float) letter_spacing);
+			mix_float((float) word_spacing);
+			return (size_t) h;
+		}
+
+		bool operator==(const font_description& other) const
+		{
+			return size == other.size && style == other.style && weight == other.weight &&
+				decoration_line == other.decoration_line && decoration_style == other.decoration_style &&
+				decoration_color == other.decoration_color && emphasis_color == other.emphasis_color &&
+				emphasis_position == other.emphasis_position && letter_spacing == other.letter_spacing &&
+				word_spacing == other.word_spacing && family == other.family && emphasis_style == other.emphasis_style &&
+				same_length(decoration_thickness, other.decoration_thickness);
+		}
+		bool operator!=(const font_description& other) const { return !(*this == other); }
+
+		struct hasher
+		{
+			size_t operator()(const font_description& descr) const { return descr.hash_value(); }
+		};
+
+	private:
+		static bool same_length(const css_length& a, const css_length& b)
+		{
+			if (a.is_calc() || b.is_calc()) return a.to_string() == b.to_string();
+			if (a.is_predefined() != b.is_predefined()) return false;
+			return a.is_predefined() ? a.predef() == b.predef() : a.val() == b.val() && a.units() == b.units();
+		}
 	};
+
+	struct font_item
+	{
+		uint_ptr			font;
+		font_metrics		metrics;
+	};
+
+	using fonts_map = std::unordered_map<font_description, font_item, font_description::hasher>;
 }
 
 #endif
\ No newline at end of file
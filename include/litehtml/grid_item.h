@@ -42,7 +42,7 @@ namespace litehtml
 		int order;
 		int src_order;
 
-		explicit grid_item(std::shared_ptr<render_item>& _el) :
+		explicit grid_item(const std::shared_ptr<render_item>& _el) :
 			el(_el),
 			col_start(0),
 			col_end(0),
@@ -0,0 +1,166 @@
+#ifndef LH_HIT_INDEX_H
+#define LH_HIT_INDEX_H
+
+#include "types.h"
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+namespace litehtml
+{
+	class render_item;
+
+	// Area where get_element_by_point can find an element in the subtree of a render item,
+	// in the coordinates of render_item::pos(). Subtrees with fixed elements are unbounded,
+	// fixed elements are hit in client coordinates.
+	struct hit_bounds
+	{
+		pixel_t	left = 0;
+		pixel_t	top = 0;
+		pixel_t	right = 0;
+		pixel_t	bottom = 0;
+		bool	empty = true;
+		bool	unbounded = false;
+
+		void add(pixel_t l, pixel_t t, pixel_t r, pixel_t b)
+		{
+			if (r < l || b < t) return;
+			if (empty)
+			{
+				left = l; top = t; right = r; bottom = b;
+				empty = false;
+			} else
+			{
+				left	= std::min(left, l);
+				top		= std::min(top, t);
+				right	= std::max(right, r);
+				bottom	= std::max(bottom, b);
+			}
+		}
+
+		void add(const position& pos)
+		{
+			add(pos.left(), pos.top(), pos.right(), pos.bottom());
+		}
+
+		// Adds bounds of a child, dx and dy are the offset of the child coordinates
+		void add(const hit_bounds& val, pixel_t dx, pixel_t dy)
+		{
+			unbounded = unbounded || val.unbounded;
+			if (!val.empty)
+			{
+				add(val.left + dx, val.top + dy, val.right + dx, val.bottom + dy);
+			}
+		}
+
+		void clip(const position& pos)
+		{
+			if (empty) return;
+			left	= std::max(left, pos.left());
+			top		= std::max(top, pos.top());
+			right	= std::min(right, pos.right());
+			bottom	= std::min(bottom, pos.bottom());
+			empty	= right < left || bottom < top;
+		}
+
+		bool contains(pixel_t x, pixel_t y) const
+		{
+			// One pixel tolerance for the rounding of translated coordinates
+			return unbounded || (!empty && x >= left - 1 && x <= right + 1 && y >= top - 1 && y <= bottom + 1);
+		}
+	};
+
+	// Children of a render item grouped by horizontal band of equal height. A hit test checks
+	// only the children overlapping the band of the point. Bands keep the order of the children.
+	class hit_bands
+	{
+		std::vector<std::vector<render_item*>>	m_bands;
+		std::vector<render_item*>				m_unbounded;	// children found in every band
+		pixel_t									m_top = 0;
+		pixel_t									m_band_height = 0;
+	public:
+		// Fewer children are checked one by one
+		static constexpr size_t MinChildren = 16;
+
+		// Returns false if the children overlap too much for bands to help
+		bool build(const std::vector<std::pair<render_item*, const hit_bounds*>>& children)
+		{
+			pixel_t top = 0;
+			pixel_t bottom = 0;
+			bool first = true;
+			for (const auto& child : children)
+			{
+				const hit_bounds& b = *child.second;
+				if (b.unbounded || b.empty) continue;
+				top		= first ? b.top : std::min(top, b.top);
+				bottom	= first ? b.bottom : std::max(bottom, b.bottom);
+				first	= false;
+			}
+			if (first || bottom - top < 1) return false;
+
+			// bounds are checked with one pixel tolerance
+			m_top = top - 1;
+			size_t count = std::min(children.size(), (size_t) 65536);
+			m_band_height = (bottom - top + 2) / (pixel_t) count;
+
+			// Every child is added to all bands it overlaps. Stop if that takes too much memory.
+			size_t total = 0;
+			for (const auto& child : children)
+			{
+				const hit_bounds& b = *child.second;
+				if (b.unbounded)
+				{
+					total += count;
+				} else if (!b.empty)
+				{
+					auto range = band_range(b, count);
+					total += range.second - range.first + 1;
+				}
+				if (total > children.size() * 4 + count) return false;
+			}
+
+			m_bands.assign(count, {});
+			for (const auto& child : children)
+			{
+				const hit_bounds& b = *child.second;
+				if (b.unbounded)
+				{
+					m_unbounded.push_back(child.first);
+					for (auto& band : m_bands) band.push_back(child.first);
+				} else if (!b.empty)
+				{
+					auto range = band_range(b, count);
+					for (size_t i = range.first; i <= range.second; i++)
+					{
+						m_bands[i].push_back(child.first);
+					}
+				}
+			}
+			return true;
+		}
+
+		// Children that can contain the point at y, in the order of the children
+		const std::vector<render_item*>& find(pixel_t y) const
+		{
+			pixel_t band = std::floor((y - m_top) / m_band_height);
+			if (band < 0 || band >= (pixel_t) m_bands.size())
+			{
+				return m_unbounded;
+			}
+			return m_bands[(size_t) band];
+		}
+
+	private:
+		std::pair<size_t, size_t> band_range(const hit_bounds& b, size_t count) const
+		{
+			auto index = [this, count](pixel_t y)
+			{
+				pixel_t band = std::floor((y - m_top) / m_band_height);
+				return (size_t) std::max((pixel_t) 0, std::min(band, (pixel_t) (count - 1)));
+			};
+			return {index(b.top - 1), index(b.bottom + 1)};
+		}
+	};
+}
+
+#endif  // LH_HIT_INDEX_H
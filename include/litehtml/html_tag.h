@@ -8,6 +8,7 @@
 #include "stylesheet.h"
 #include "line_box.h"
 #include "table.h"
+#include "rule_tree.h"
 
 namespace litehtml
 {
@@ -18,15 +19,21 @@ namespace litehtml
 		friend class el_table;
 		friend class table_grid;
 		friend class line_box;
+		friend class document;
+		friend class element_index;
 	public:
 		typedef shared_ptr<html_tag>	ptr;
 	protected:
 		string_id				m_tag;
 		string_id				m_id;
-		string_vector			m_str_classes;
 		vector<string_id>		m_classes;
-		style					m_style;
-		string_map				m_attrs;
+		style					m_style;			// valid if m_own_style, otherwise the cascaded style is m_rule_node's
+		const rule_node*		m_rule_node = nullptr;	// matched rules in cascade order, nullptr if none
+		size_t					m_style_id = 0;		// identity of the computed style, see rule_tree::style_id
+		bool					m_own_style = false;	// m_style holds the element's own copy of the cascaded style
+		bool					m_local_style = false;	// element has local declarations, its style is unique
+		size_t					m_local_style_key = 0;	// see rule_tree::local_style_id, 0 if not assigned yet
+		flat_map<string_id, string>	m_attrs;		// attribute values by lower case name
 		vector<string_id>		m_pseudo_classes;
 
 		void			select_all(const css_selector& selector, elements_list& res) override;
@@ -35,6 +42,7 @@ namespace litehtml
 		explicit html_tag(const shared_ptr<document>& doc);
 		// constructor for anonymous wrapper boxes
 		explicit html_tag(const element::ptr& parent, const string& style = "display: block");
+		element::ptr copy() const override { return std::make_shared<html_tag>(*this); }
 
 		bool				appendChild(const element::ptr& el) override;
 		bool				removeChild(const element::ptr& el) override;
@@ -45,11 +53,12 @@ namespace litehtml
 		void				set_tagName(const char* tag) override;
 		void				set_data(const char* data) override;
 		const vector<string_id>& classes() const { return m_classes; }
-		const string_vector& str_classes() const { return m_str_classes; }
+		string_vector		str_classes() const;
 		bool has_pseudo_class(string_id cls) const { return std::find(m_pseudo_classes.begin(), m_pseudo_classes.end(), cls) != m_pseudo_classes.end(); }
 
 		void				set_attr(const char* name, const char* val) override;
 		const char*			get_attr(const char* name, const char* def = nullptr) const override;
+		const char*			get_attr(string_id name, const char* def = nullptr) const;
 		void				apply_stylesheet(const litehtml::css& stylesheet) override;
 		void				refresh_styles() override;
 
@@ -75,7 +84,7 @@ namespace litehtml
 		const Type&			get_property(string_id name, bool inherited, const Type& default_value, uint_ptr css_properties_member_offset) const;
 		bool				get_custom_property(string_id name, css_token_vector& result) const;
 
-		elements_list&	children();
+		child_list&		children();
 
 		int					select(const css_selector::vector& selector_list, bool apply_pseudo = true) override;
 		int					select(const string& selector) override;
@@ -98,6 +107,7 @@ namespace litehtml
 
 		void				get_content_size(size& sz, pixel_t max_width) override;
 		void				add_style(const style& style) override;
+		const style&		cascaded_style() const;
 
 		bool				is_nth_child(const element::ptr& el, int num, int off, bool of_type, const css_selector::vector& selector_list) const override;
 		bool				is_nth_last_child(const element::ptr& el, int num, int off, bool of_type, const css_selector::vector& selector_list) const override;
@@ -112,6 +122,10 @@ namespace litehtml
 		element::ptr		get_element_before(const style& style, bool create);
 		element::ptr		get_element_after(const style& style, bool create);
 
+		style&				own_style();
+		// Style for element specific declarations (presentational hints, style attribute)
+		style&				local_style();
+
 		void map_to_pixel_length_property(string_id prop_name, string attr_value);
 		void map_to_pixel_length_property_with_default_value(string_id prop_name, string attr_value, int default_value);
 		void map_to_dimension_property(string_id prop_name, string attr_value);
@@ -126,15 +140,24 @@ namespace litehtml
 	/*                        Inline Functions                              */
 	/************************************************************************/
 
-	inline elements_list& html_tag::children()
+	inline child_list& html_tag::children()
 	{
 		return m_children;
 	}
 
+	inline const style& html_tag::cascaded_style() const
+	{
+		if (m_own_style || !m_rule_node)
+		{
+			return m_style;
+		}
+		return m_rule_node->cascaded();
+	}
+
 	template<class Type>
 	const Type& html_tag::get_property(string_id name, bool inherited, const Type& default_value, uint_ptr css_properties_member_offset) const
 	{
-		const property_value& value = m_style.get_property(name);
+		const property_value& value = cascaded_style().get_property(name);
 
 		if (value.is<Type>())
 		{
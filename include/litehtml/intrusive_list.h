@@ -0,0 +1,150 @@
+#ifndef LH_INTRUSIVE_LIST_H
+#define LH_INTRUSIVE_LIST_H
+
+#include <memory>
+#include <list>
+
+namespace litehtml
+{
+	// Children of a tree node, linked through the nodes themselves: the list owns the first child
+	// and every child owns its next sibling. Iterators yield these shared_ptrs, so the list is used
+	// like a std::list<std::shared_ptr<T>>. A child is in one list at a time and its parent is the
+	// owner of the list: inserting sets the parent, removing clears it. A list without owner (a
+	// temporary one) leaves the parent as it is.
+	//
+	// T declares intrusive_list<T> a friend and has the members
+	//     T*						m_parent;
+	//     T*						m_prev_sibling;
+	//     std::shared_ptr<T>		m_next_sibling;
+	//     intrusive_list<T>*		m_siblings;		// the list the node is in
+	template<class T>
+	class intrusive_list
+	{
+		T*					m_owner;
+		std::shared_ptr<T>	m_first;
+		T*					m_last = nullptr;
+		size_t				m_size = 0;
+	public:
+		class iterator
+		{
+			friend class intrusive_list;
+			const intrusive_list*	m_list = nullptr;
+			T*						m_node = nullptr;	// nullptr for end()
+			iterator(const intrusive_list* list, T* node) : m_list(list), m_node(node) {}
+		public:
+			using iterator_category	= std::bidirectional_iterator_tag;
+			using value_type		= std::shared_ptr<T>;
+			using difference_type	= std::ptrdiff_t;
+			using pointer			= const std::shared_ptr<T>*;
+			using reference			= const std::shared_ptr<T>&;
+
+			iterator() = default;
+			reference	operator*() const	{ return m_node->m_prev_sibling ? m_node->m_prev_sibling->m_next_sibling : m_list->m_first; }
+			pointer		operator->() const	{ return &**this; }
+			iterator&	operator++()		{ m_node = m_node->m_next_sibling.get(); return *this; }
+			iterator&	operator--()		{ m_node = m_node ? m_node->m_prev_sibling : m_list->m_last; return *this; }
+			iterator	operator++(int)		{ iterator tmp = *this; ++*this; return tmp; }
+			iterator	operator--(int)		{ iterator tmp = *this; --*this; return tmp; }
+			bool		operator==(const iterator& other) const { return m_node == other.m_node; }
+			bool		operator!=(const iterator& other) const { return m_node != other.m_node; }
+		};
+		using const_iterator			= iterator;
+		using reverse_iterator			= std::reverse_iterator<iterator>;
+		using const_reverse_iterator	= reverse_iterator;
+		using value_type				= std::shared_ptr<T>;
+
+		explicit intrusive_list(T* owner = nullptr) : m_owner(owner) {}
+		intrusive_list(const intrusive_list&) = delete;
+		intrusive_list& operator=(const intrusive_list&) = delete;
+		~intrusive_list() { clear(); }
+
+		iterator			begin() const	{ return iterator(this, m_first.get()); }
+		iterator			end() const		{ return iterator(this, nullptr); }
+		reverse_iterator	rbegin() const	{ return reverse_iterator(end()); }
+		reverse_iterator	rend() const	{ return reverse_iterator(begin()); }
+		bool				empty() const	{ return m_first == nullptr; }
+		size_t				size() const	{ return m_size; }
+		const std::shared_ptr<T>& front() const	{ return m_first; }
+		const std::shared_ptr<T>& back() const	{ return *iterator(this, m_last); }
+
+		// Moves node from the list it is in
+		iterator	insert(iterator pos, const std::shared_ptr<T>& node);
+		void		push_back(const std::shared_ptr<T>& node)	{ insert(end(), node); }
+		void		pop_back()									{ erase(iterator(this, m_last)); }
+		// Moves all nodes of other before pos
+		void		splice(iterator pos, intrusive_list& other);
+		iterator	erase(iterator pos);
+		iterator	erase(iterator first, iterator last);
+		// Removes from the back, destroying a long list doesn't recurse through the siblings
+		void		clear();
+		// Position of a child of this list, end() for other nodes
+		iterator	find(const T* node) const	{ return iterator(this, node && node->m_siblings == this ? const_cast<T*>(node) : nullptr); }
+	};
+
+	template<class T>
+	typename intrusive_list<T>::iterator intrusive_list<T>::insert(iterator pos, const std::shared_ptr<T>& node)
+	{
+		std::shared_ptr<T> item = node;	// node can be the link of the list the item is in
+		if (item->m_siblings)
+		{
+			if (pos.m_node == item.get()) ++pos;
+			item->m_siblings->erase(item->m_siblings->find(item.get()));
+		}
+		T* next = pos.m_node;
+		T* prev = next ? next->m_prev_sibling : m_last;
+		if (m_owner) item->m_parent = m_owner;
+		item->m_siblings = this;
+		item->m_prev_sibling = prev;
+		if (next) next->m_prev_sibling = item.get(); else m_last = item.get();
+		std::shared_ptr<T>& link = prev ? prev->m_next_sibling : m_first;
+		item->m_next_sibling = std::move(link);
+		link = std::move(item);
+		m_size++;
+		return iterator(this, link.get());
+	}
+
+	template<class T>
+	void intrusive_list<T>::splice(iterator pos, intrusive_list& other)
+	{
+		while (!other.empty())
+		{
+			insert(pos, other.front());
+		}
+	}
+
+	template<class T>
+	typename intrusive_list<T>::iterator intrusive_list<T>::erase(iterator pos)
+	{
+		T* prev = pos.m_node->m_prev_sibling;
+		std::shared_ptr<T>& link = prev ? prev->m_next_sibling : m_first;
+		std::shared_ptr<T> item = std::move(link);	// the node can be destroyed after it is unlinked
+		link = std::move(item->m_next_sibling);
+		if (link) link->m_prev_sibling = prev; else m_last = prev;
+		item->m_prev_sibling = nullptr;
+		item->m_siblings = nullptr;
+		if (m_owner && item->m_parent == m_owner) item->m_parent = nullptr;
+		m_size--;
+		return iterator(this, link.get());
+	}
+
+	template<class T>
+	typename intrusive_list<T>::iterator intrusive_list<T>::erase(iterator first, iterator last)
+	{
+		while (first != last)
+		{
+			first = erase(first);
+		}
+		return last;
+	}
+
+	template<class T>
+	void intrusive_list<T>::clear()
+	{
+		while (m_last)
+		{
+			erase(iterator(this, m_last));
+		}
+	}
+}
+
+#endif  // LH_INTRUSIVE_LIST_H
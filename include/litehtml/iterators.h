@@ -43,7 +43,7 @@ namespace litehtml
 		elements_iterator(bool return_parents, iterator_selector* go_inside, iterator_selector* select);
 		~elements_iterator() = default;
 
-        void process(const std::shared_ptr<render_item>& container, const std::function<void (std::shared_ptr<render_item>&, iterator_item_type)>& func);
+        void process(const std::shared_ptr<render_item>& container, const std::function<void (const std::shared_ptr<render_item>&, iterator_item_type)>& func);
 
 	private:
 		void next_idx();
@@ -38,6 +38,30 @@ namespace litehtml
 	}
 
 
+	// Continuous media features. A change matters only if it crosses a value used by a media query.
+	enum media_range
+	{
+		media_range_width,
+		media_range_height,
+		media_range_device_width,
+		media_range_device_height,
+		media_range_aspect_ratio,			// width / height, also for orientation
+		media_range_device_aspect_ratio,
+		media_range_resolution,
+		media_range_count
+	};
+
+	// Media features a media query list depends on
+	enum media_dependency
+	{
+		media_dep_type			= 1 << media_range_count,	// bits below are 1 << media_range
+		media_dep_color			= media_dep_type << 1,
+		media_dep_color_index	= media_dep_type << 2,
+		media_dep_monochrome	= media_dep_type << 3,
+		media_dep_color_scheme	= media_dep_type << 4,
+		media_dep_all			= (media_dep_type << 5) - 1
+	};
+
 	struct media_condition;
 
 	// <media-query> = <media-condition> | [ not | only ]? <media-type> [ and <media-condition-without-or> ]?
@@ -76,6 +100,8 @@ namespace litehtml
 		bool compare(int x) const { return compare((float)x); }
 		bool compare(float x) const;
 		bool check(const media_features& features) const;
+		// media_dep_* flags, values compared with continuous features are added to breakpoints
+		uint32_t get_dependencies(std::vector<float> breakpoints[media_range_count]) const;
 	};
 
 	// <media-in-parens> = ( <media-condition> ) | <media-feature> | <general-enclosed>
@@ -104,15 +130,44 @@ namespace litehtml
 		using vector = std::vector<ptr>;
 	private:
 		std::vector<media_query_list>	m_media_query_lists;
-		bool							m_is_used = false;
+		uint32_t						m_dependencies = 0;	// media_dep_* flags
+		std::vector<float>				m_breakpoints[media_range_count];
+
+		void add_dependencies(const media_query_list& mq_list);
+
+		friend class css_binary;
 	public:
 		void add(const media_query_list& mq_list)
 		{
 			m_media_query_lists.push_back(mq_list);
+			add_dependencies(mq_list);
 		}
-		bool is_used() const { return m_is_used; }
 
-		bool apply_media_features(const media_features& features); // returns true if the m_is_used changed
+		uint32_t					dependencies() const { return m_dependencies; }
+		const std::vector<float>&	breakpoints(media_range range) const { return m_breakpoints[range]; }
+
+		// Lists can be shared by documents (see compiled_css), so whether they match is kept by
+		// the document, see document::update_media_lists
+		bool check(const media_features& features) const;
+	};
+
+	// Intervals of the continuous media features where no media query list of a document changes its
+	// result, see document::media_changed. A resize within them needs no evaluation.
+	class media_breakpoints
+	{
+		std::vector<float>	m_values[media_range_count];	// sorted breakpoints of all lists
+		float				m_low[media_range_count] = {};	// current interval, exclusive
+		float				m_high[media_range_count] = {};
+		uint32_t			m_dependencies = 0;
+		media_features		m_features;						// features the intervals were computed for
+		bool				m_valid = false;
+	public:
+		void		clear();
+		void		add(const media_query_list_list& list);
+		// Computes the intervals around features, called after the lists were evaluated
+		void		update(const media_features& features);
+		// media_dep_* flags of the features that changed enough to change the result of a list
+		uint32_t	changed(const media_features& features) const;
 	};
 
 }
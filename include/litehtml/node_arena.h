@@ -0,0 +1,69 @@
+#ifndef LH_NODE_ARENA_H
+#define LH_NODE_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace litehtml
+{
+	// Bump allocator for the elements created by the parser and the items of a render tree.
+	// Nothing is freed before the arena is destroyed, then all memory is freed at once. Every
+	// object allocated in the arena keeps it alive, so objects may outlive their document.
+	class node_arena
+	{
+		static constexpr size_t ChunkSize = 64 * 1024;
+
+		std::vector<std::unique_ptr<char[]>>	m_chunks;
+		char*									m_pos = nullptr;
+		size_t									m_left = 0;
+		size_t									m_used = 0;
+		size_t									m_reserved = 0;
+		std::atomic<size_t>						m_refs{0};
+	public:
+		node_arena() = default;
+		node_arena(const node_arena&) = delete;
+		node_arena& operator=(const node_arena&) = delete;
+
+		void*	allocate(size_t size, size_t align);
+		size_t	bytes_used() const		{ return m_used; }
+		size_t	bytes_reserved() const	{ return m_reserved; }
+
+		static void add_ref(node_arena* arena)	{ arena->m_refs++; }
+		static void release(node_arena* arena)	{ if (--arena->m_refs == 0) delete arena; }
+	};
+
+	// Allocator for std::allocate_shared, the control block keeps a reference to the arena
+	template<class T>
+	class node_allocator
+	{
+		node_arena* m_arena;
+	public:
+		using value_type = T;
+
+		explicit node_allocator(node_arena* arena) : m_arena(arena)		{ node_arena::add_ref(m_arena); }
+		node_allocator(const node_allocator& val) : node_allocator(val.m_arena) {}
+		template<class U>
+		node_allocator(const node_allocator<U>& val) : node_allocator(val.arena()) {}
+		node_allocator& operator=(const node_allocator& val)
+		{
+			node_arena::add_ref(val.m_arena);
+			node_arena::release(m_arena);
+			m_arena = val.m_arena;
+			return *this;
+		}
+		~node_allocator()	{ node_arena::release(m_arena); }
+
+		T*		allocate(size_t n)				{ return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T))); }
+		void	deallocate(T* /*p*/, size_t /*n*/)	{}
+		node_arena* arena() const				{ return m_arena; }
+
+		template<class U>
+		bool operator==(const node_allocator<U>& val) const { return m_arena == val.arena(); }
+		template<class U>
+		bool operator!=(const node_allocator<U>& val) const { return m_arena != val.arena(); }
+	};
+}
+
+#endif  // LH_NODE_ARENA_H
@@ -0,0 +1,338 @@
+#ifndef LH_PAINT_PROFILER_H
+#define LH_PAINT_PROFILER_H
+
+#include "types.h"
+
+namespace litehtml {
+
+// Container draw calls tracked by the paint profiler
+enum paint_op
+{
+    paint_op_draw_text,
+    paint_op_draw_list_marker,
+    paint_op_draw_image,
+    paint_op_draw_solid_fill,
+    paint_op_draw_linear_gradient,
+    paint_op_draw_radial_gradient,
+    paint_op_draw_conic_gradient,
+    paint_op_draw_borders,
+    paint_op_draw_box_shadow,
+    paint_op_draw_form_control,
+    paint_op_composite_layer,
+
+    paint_op_count
+};
+
+inline const char* paint_op_name(paint_op op)
+{
+    static const char* names[paint_op_count] = {
+        "draw_text",
+        "draw_list_marker",
+        "draw_image",
+        "draw_solid_fill",
+        "draw_linear_gradient",
+        "draw_radial_gradient",
+        "draw_conic_gradient",
+        "draw_borders",
+        "draw_box_shadow",
+        "draw_form_control",
+        "composite_layer",
+    };
+    return op >= 0 && op < paint_op_count ? names[op] : "";
+}
+
+} // namespace litehtml
+
+// Paint profiler: draw calls per container virtual, pixels touched, overdraw heatmap
+// and time per stacking context for each document::draw.
+// Enable with LITEHTML_PROFILE_PAINT define. When disabled the PAINT_PROFILE_* macros
+// expand to nothing. When enabled, recording doesn't allocate: the report has fixed
+// capacity and the heatmap grid is reallocated only when the viewport size changes.
+#ifdef LITEHTML_PROFILE_PAINT
+
+#include <chrono>
+#include <ostream>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "document_container.h"
+
+namespace litehtml {
+
+struct paint_context_stats
+{
+    const void* item = nullptr;     // render_item of the stacking context
+    const char* tag = "";           // tag name of the element
+    int         depth = 0;
+    double      ms = 0;             // inclusive time
+    int         draw_calls = 0;     // inclusive number of draw calls
+};
+
+struct paint_profile_report
+{
+    static constexpr int MaxContexts = 256;
+
+    double              frame_ms = 0;
+    int                 calls[paint_op_count] = {};
+    double              pixels[paint_op_count] = {};   // area passed to the draw calls
+    double              pixels_total = 0;
+    double              pixels_covered = 0;     // viewport pixels painted at least once
+    uint32_t            max_overdraw = 0;       // max number of draws over a single pixel
+    paint_context_stats contexts[MaxContexts];
+    int                 context_count = 0;
+    int                 dropped_contexts = 0;   // contexts over MaxContexts
+
+    int total_calls() const
+    {
+        int ret = 0;
+        for (int c : calls) ret += c;
+        return ret;
+    }
+
+    // Average number of draws over a painted pixel
+    double avg_overdraw() const
+    {
+        return pixels_covered > 0 ? pixels_total / pixels_covered : 0;
+    }
+
+    void print(std::ostream& os) const
+    {
+        os << "\n=== Paint Profile ===\n";
+        os << "Frame time: " << frame_ms << "ms, draw calls: " << total_calls() << "\n";
+        for (int i = 0; i < paint_op_count; i++)
+        {
+            if (!calls[i]) continue;
+            os << "  " << paint_op_name((paint_op) i) << ": " << calls[i] << " calls, " << (long long) pixels[i] << " px\n";
+        }
+        os << "Overdraw: avg " << avg_overdraw() << ", max " << max_overdraw << "\n";
+        os << "Stacking contexts:\n";
+        for (int i = 0; i < context_count; i++)
+        {
+            const auto& ctx = contexts[i];
+            os << "  " << std::string(ctx.depth * 2, ' ') << "<" << ctx.tag << "> " << ctx.ms << "ms, " << ctx.draw_calls << " calls\n";
+        }
+        if (dropped_contexts)
+        {
+            os << "  (" << dropped_contexts << " more)\n";
+        }
+        os << "=====================\n" << std::endl;
+    }
+};
+
+class paint_profiler {
+public:
+    // Paint is single threaded: the profiler records the frames of the painting thread
+    static paint_profiler& instance() {
+        static paint_profiler p;
+        return p;
+    }
+
+    // Size of the heatmap cells in pixels, 1 gives exact per-pixel overdraw
+    void set_cell_size(int cell_size) {
+        m_cell = std::max(cell_size, 1);
+        m_grid_width = m_grid_height = 0;
+    }
+    int cell_size() const { return m_cell; }
+
+    void begin_frame(const position& viewport) {
+        m_report = paint_profile_report();
+        m_depth = 0;
+        m_layer_depth = 0;
+
+        int width = std::max((int) ((viewport.width + m_cell - 1) / m_cell), 0);
+        int height = std::max((int) ((viewport.height + m_cell - 1) / m_cell), 0);
+        if (width != m_grid_width || height != m_grid_height)
+        {
+            m_grid_width = width;
+            m_grid_height = height;
+            m_heat.assign((size_t) width * height, 0);
+        } else
+        {
+            std::fill(m_heat.begin(), m_heat.end(), 0);
+        }
+        m_viewport = viewport;
+        m_start = std::chrono::steady_clock::now();
+    }
+
+    void end_frame() {
+        m_report.frame_ms = elapsed_ms(m_start);
+        uint32_t covered = 0;
+        for (uint16_t v : m_heat)
+        {
+            if (v) covered++;
+            m_report.max_overdraw = std::max(m_report.max_overdraw, (uint32_t) v);
+        }
+        m_report.pixels_covered = (double) covered * m_cell * m_cell;
+    }
+
+    // Record a draw call covering rect (hdc coordinates); area is the number of pixels painted
+    void record(paint_op op, const position& rect, double area) {
+        m_report.calls[op]++;
+        m_report.pixels[op] += area;
+        m_report.pixels_total += area;
+        for (int i = 0; i < m_depth && i < paint_profile_report::MaxContexts; i++)
+        {
+            if (m_stack[i] >= 0) m_report.contexts[m_stack[i]].draw_calls++;
+        }
+        // Content of compositing layers is in layer coordinates, it's counted by the composite
+        if (m_layer_depth == 0)
+        {
+            add_heat(rect);
+        }
+    }
+
+    void record(paint_op op, const position& rect) {
+        record(op, rect, std::max((double) rect.width, 0.0) * std::max((double) rect.height, 0.0));
+    }
+
+    // Borders paint only the ring between the border box and the padding box
+    void record_borders(const position& rect, const borders& b) {
+        double inner_w = std::max((double) (rect.width - b.left.width - b.right.width), 0.0);
+        double inner_h = std::max((double) (rect.height - b.top.width - b.bottom.width), 0.0);
+        record(paint_op_draw_borders, rect, std::max((double) rect.width, 0.0) * std::max((double) rect.height, 0.0) - inner_w * inner_h);
+    }
+
+    void begin_layer() { m_layer_depth++; }
+    void end_layer() { m_layer_depth--; }
+
+    int begin_context(const void* item, const char* tag) {
+        int idx = -1;
+        if (m_report.context_count < paint_profile_report::MaxContexts)
+        {
+            idx = m_report.context_count++;
+            auto& ctx = m_report.contexts[idx];
+            ctx.item = item;
+            ctx.tag = tag ? tag : "";
+            ctx.depth = m_depth;
+        } else
+        {
+            m_report.dropped_contexts++;
+        }
+        if (m_depth < paint_profile_report::MaxContexts) m_stack[m_depth] = idx;
+        m_depth++;
+        return idx;
+    }
+
+    void end_context(int idx, std::chrono::steady_clock::time_point start) {
+        m_depth--;
+        if (idx >= 0) m_report.contexts[idx].ms = elapsed_ms(start);
+    }
+
+    const paint_profile_report& report() const { return m_report; }
+
+    // Number of draws over the pixel of the last frame
+    uint32_t overdraw(pixel_t x, pixel_t y) const {
+        int cx = (int) ((x - m_viewport.x) / m_cell);
+        int cy = (int) ((y - m_viewport.y) / m_cell);
+        if (cx < 0 || cy < 0 || cx >= m_grid_width || cy >= m_grid_height) return 0;
+        return m_heat[(size_t) cy * m_grid_width + cx];
+    }
+
+    // Draw the overdraw heatmap of the last frame with draw_solid_fill:
+    // 1 draw - blue, 2 - green, 3 - yellow, 4 and more - red
+    void draw_heatmap(document_container* container, uint_ptr hdc, byte alpha = 96) const {
+        static const web_color colors[] = {
+            web_color(0, 0, 255), web_color(0, 255, 0), web_color(255, 255, 0), web_color(255, 0, 0)
+        };
+        background_layer layer;
+        for (int y = 0; y < m_grid_height; y++)
+        {
+            const uint16_t* row = &m_heat[(size_t) y * m_grid_width];
+            int x = 0;
+            while (x < m_grid_width)
+            {
+                // Merge runs of cells with the same color into one fill
+                int level = std::min((int) row[x], 4);
+                int end = x + 1;
+                while (end < m_grid_width && std::min((int) row[end], 4) == level) end++;
+                if (level > 0)
+                {
+                    web_color color = colors[level - 1];
+                    color.alpha = alpha;
+                    layer.border_box = position(m_viewport.x + x * m_cell, m_viewport.y + y * m_cell, (end - x) * m_cell, m_cell);
+                    layer.clip_box = layer.origin_box = layer.border_box;
+                    container->draw_solid_fill(hdc, layer, color);
+                }
+                x = end;
+            }
+        }
+    }
+
+private:
+    paint_profiler() = default;
+
+    static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void add_heat(const position& rect) {
+        if (m_heat.empty() || rect.width <= 0 || rect.height <= 0) return;
+        int x0 = std::max((int) ((rect.left() - m_viewport.x) / m_cell), 0);
+        int y0 = std::max((int) ((rect.top() - m_viewport.y) / m_cell), 0);
+        int x1 = std::min((int) ((rect.right() - m_viewport.x + m_cell - 1) / m_cell), m_grid_width);
+        int y1 = std::min((int) ((rect.bottom() - m_viewport.y + m_cell - 1) / m_cell), m_grid_height);
+        for (int y = y0; y < y1; y++)
+        {
+            uint16_t* row = &m_heat[(size_t) y * m_grid_width];
+            for (int x = x0; x < x1; x++)
+            {
+                if (row[x] != UINT16_MAX) row[x]++;
+            }
+        }
+    }
+
+    paint_profile_report    m_report;
+    std::vector<uint16_t>   m_heat;
+    int                     m_grid_width = 0;
+    int                     m_grid_height = 0;
+    int                     m_cell = 4;
+    position                m_viewport;
+    int                     m_stack[paint_profile_report::MaxContexts] = {};
+    int                     m_depth = 0;
+    int                     m_layer_depth = 0;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+class paint_context_scope {
+public:
+    paint_context_scope(const void* item, const char* tag) :
+        m_idx(paint_profiler::instance().begin_context(item, tag)),
+        m_start(std::chrono::steady_clock::now()) {}
+
+    ~paint_context_scope() {
+        paint_profiler::instance().end_context(m_idx, m_start);
+    }
+private:
+    int m_idx;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+class paint_layer_scope {
+public:
+    paint_layer_scope() { paint_profiler::instance().begin_layer(); }
+    ~paint_layer_scope() { paint_profiler::instance().end_layer(); }
+};
+
+#define PAINT_PROFILE_CONCAT_(a, b) a##b
+#define PAINT_PROFILE_CONCAT(a, b) PAINT_PROFILE_CONCAT_(a, b)
+
+#define PAINT_PROFILE_BEGIN_FRAME(viewport) litehtml::paint_profiler::instance().begin_frame(viewport)
+#define PAINT_PROFILE_END_FRAME() litehtml::paint_profiler::instance().end_frame()
+#define PAINT_PROFILE_DRAW(op, rect) litehtml::paint_profiler::instance().record(litehtml::paint_op_##op, rect)
+#define PAINT_PROFILE_DRAW_BORDERS(rect, borders) litehtml::paint_profiler::instance().record_borders(rect, borders)
+#define PAINT_PROFILE_CONTEXT(item, tag) litehtml::paint_context_scope PAINT_PROFILE_CONCAT(_paint_ctx_, __LINE__)(item, tag)
+#define PAINT_PROFILE_LAYER() litehtml::paint_layer_scope PAINT_PROFILE_CONCAT(_paint_layer_, __LINE__)
+
+} // namespace litehtml
+
+#else
+// No-op when profiling disabled
+#define PAINT_PROFILE_BEGIN_FRAME(viewport)
+#define PAINT_PROFILE_END_FRAME()
+#define PAINT_PROFILE_DRAW(op, rect)
+#define PAINT_PROFILE_DRAW_BORDERS(rect, borders)
+#define PAINT_PROFILE_CONTEXT(item, tag)
+#define PAINT_PROFILE_LAYER()
+#endif
+
+#endif // LH_PAINT_PROFILER_H
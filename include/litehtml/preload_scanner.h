@@ -0,0 +1,36 @@
+#ifndef LH_PRELOAD_SCANNER_H
+#define LH_PRELOAD_SCANNER_H
+
+#include "types.h"
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+namespace litehtml
+{
+	class document;
+
+	// Finds the style sheets, @import rules and images of a document in the raw HTML before
+	// the parser reaches them and passes them to document_container::preload, so they are
+	// fetched concurrently. The scan is approximate, the parser still requests every resource.
+	class preload_scanner
+	{
+		std::mutex						m_mutex;
+		std::unordered_set<string>		m_requested;	// base url and url of the preloaded resources
+		string							m_base;			// href of <base>
+		size_t							m_pos = 0;		// html scanned so far
+		string							m_raw_tag;		// unterminated raw text element the scan stopped in
+		size_t							m_raw_start = 0;	// offset of its content
+	public:
+		// Scans html from the end of the previous call, html may only grow between the calls
+		void scan_html(const string& html, const std::shared_ptr<document>& doc);
+		// Preloads the @import rules of a style sheet, can be called from any thread
+		void scan_css(const string& text, const string& baseurl, const std::shared_ptr<document>& doc);
+
+	private:
+		bool skip_raw_text(const string& html, size_t& pos, const std::shared_ptr<document>& doc);
+		void request(const string& url, const string& baseurl, resource_type type, const std::shared_ptr<document>& doc);
+	};
+}
+
+#endif  // LH_PRELOAD_SCANNER_H
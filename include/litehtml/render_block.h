@@ -26,12 +26,12 @@ namespace litehtml
 		{}
 
 	public:
-		explicit render_item_block(std::shared_ptr<element>  src_el) : render_item(std::move(src_el))
+		explicit render_item_block(element* src_el) : render_item(src_el)
 		{}
 
 		std::shared_ptr<render_item> clone() override
 		{
-			return std::make_shared<render_item_block>(src_el());
+			return make_render_item<render_item_block>(src_el());
 		}
 		std::shared_ptr<render_item> init() override;
 	};
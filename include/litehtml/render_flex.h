@@ -16,12 +16,12 @@ namespace litehtml
 		pixel_t _render_content(pixel_t x, pixel_t y, bool second_pass, const containing_block_context &self_size, formatting_context* fmt_ctx) override;
 
 	public:
-		explicit render_item_flex(std::shared_ptr<element>  src_el) : render_item_block(std::move(src_el))
+		explicit render_item_flex(element* src_el) : render_item_block(src_el)
 		{}
 
 		std::shared_ptr<render_item> clone() override
 		{
-			return std::make_shared<render_item_flex>(src_el());
+			return make_render_item<render_item_flex>(src_el());
 		}
 		std::shared_ptr<render_item> init() override;
 
@@ -87,13 +87,13 @@ namespace litehtml
 								formatting_context* fmt_ctx) override;
 
 	public:
-		explicit render_item_grid(std::shared_ptr<element> src_el) :
-			render_item_block(std::move(src_el))
+		explicit render_item_grid(element* src_el) :
+			render_item_block(src_el)
 		{}
 
 		std::shared_ptr<render_item> clone() override
 		{
-			return std::make_shared<render_item_grid>(src_el());
+			return make_render_item<render_item_grid>(src_el());
 		}
 
 		std::shared_ptr<render_item> init() override;
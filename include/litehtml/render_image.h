@@ -12,12 +12,12 @@ namespace litehtml
 		pixel_t _render(pixel_t x, pixel_t y, const containing_block_context &containing_block_size, formatting_context* fmt_ctx, bool second_pass) override;
 
 	public:
-		explicit render_item_image(std::shared_ptr<element>  src_el) : render_item(std::move(src_el))
+		explicit render_item_image(element* src_el) : render_item(src_el)
 		{}
 
 		std::shared_ptr<render_item> clone() override
 		{
-			return std::make_shared<render_item_image>(src_el());
+			return make_render_item<render_item_image>(src_el());
 		}
 	};
 }
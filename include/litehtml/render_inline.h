@@ -12,7 +12,7 @@ namespace litehtml
 		position::vector m_boxes;
 
 	public:
-		explicit render_item_inline(std::shared_ptr<element>  src_el) : render_item(std::move(src_el))
+		explicit render_item_inline(element* src_el) : render_item(src_el)
 		{}
 
 		void get_inline_boxes( position::vector& boxes ) const override { boxes = m_boxes; }
@@ -30,7 +30,7 @@ namespace litehtml
 
 		std::shared_ptr<render_item> clone() override
 		{
-			return std::make_shared<render_item_inline>(src_el());
+			return make_render_item<render_item_inline>(src_el());
 		}
 		virtual void y_shift(pixel_t shift) override
 		{
@@ -40,12 +40,12 @@ namespace litehtml
 		pixel_t new_box(const std::unique_ptr<line_box_item>& el, line_context& line_ctx, const containing_block_context &self_size, formatting_context* fmt_ctx);
 		void apply_vertical_align() override;
 	public:
-		explicit render_item_inline_context(std::shared_ptr<element>  src_el) : render_item_block(std::move(src_el)), m_max_line_width(0)
+		explicit render_item_inline_context(element* src_el) : render_item_block(src_el), m_max_line_width(0)
 		{}
 
 		std::shared_ptr<render_item> clone() override
 		{
-			return std::make_shared<render_item_inline_context>(src_el());
+			return make_render_item<render_item_inline_context>(src_el());
 		}
 
 		pixel_t get_first_baseline() override;
@@ -11,44 +11,100 @@
 #include "formatting_context.h"
 #include "element.h"
 #include "layout_cache.h"
+#include "background.h"
+#include "hit_index.h"
+#include "node_arena.h"
 
 namespace litehtml
 {
     class element;
+    class document_container;
+
+    /**
+     * Offscreen surface holding the rasterized subtree of a render item.
+     * See document_container::create_layer
+     */
+    struct compositing_layer
+    {
+        document_container* container = nullptr;   // Owner of the handle
+        uint_ptr            handle = 0;
+        position            bounds;                 // Layer rectangle relative to the draw origin of the item
+        string              filter;                 // Filter rasterized into the layer
+        uint32_t            generation = 0;         // Document paint generation of the content
+        bool                stale = false;          // Content must be repainted, see render_item::invalidate_layers
+    };
+
+    // Arena of the render tree being built by the document of the element, nullptr outside of the build
+    node_arena* render_arena(const element* el);
+
+    // Creates a render item in the arena of the render tree being built, see document::build_render_tree
+    template<class T>
+    std::shared_ptr<T> make_render_item(element* el)
+    {
+        node_arena* arena = render_arena(el);
+        if (arena) return std::allocate_shared<T>(node_allocator<T>(arena), el);
+        return std::make_shared<T>(el);
+    }
+
+    // Creates the render item of an anonymous box, the item owns the element created for the box
+    template<class T>
+    std::shared_ptr<T> make_anonymous_render_item(const std::shared_ptr<element>& el);
 
     class render_item : public std::enable_shared_from_this<render_item>
     {
+        friend class intrusive_list<render_item>;
+        template<class T>
+        friend std::shared_ptr<T> make_anonymous_render_item(const std::shared_ptr<element>& el);
+
+        // Intrusive tree links, see intrusive_list
+        render_item*                                m_parent = nullptr;
+        render_item*                                m_prev_sibling = nullptr;
+        std::shared_ptr<render_item>                m_next_sibling;     // owning
+        intrusive_list<render_item>*                m_siblings = nullptr;
+        std::shared_ptr<element>                    m_anonymous_el;     // element of an anonymous box, nullptr for the others
+        bool                                        m_initialized = false; // init() was called, see init_tree
     protected:
-        std::shared_ptr<element>                    m_element;
-        std::weak_ptr<render_item>                  m_parent;
-        std::list<std::shared_ptr<render_item>>     m_children;
+        // The document owns the elements, the render tree is built again when they change.
+        // Elements removed before that are kept alive, see document::retain_removed
+        element*                                    m_element;
+        intrusive_list<render_item>                 m_children;
         margins						                m_margins;
         margins						                m_padding;
         margins						                m_borders;
         position					                m_pos;
         bool                                        m_skip;
         bool                                        m_needs_layout;  // Deferred layout pending
-        std::vector<std::shared_ptr<render_item>>   m_positioned;
+        std::vector<render_item*>                   m_positioned;       // positioned descendants, sorted by z-index after render_positioned
 
         // Layout caching for performance optimization
         damage_flags                                m_damage;           // What needs recalculation
         block_width_cache                           m_width_cache;      // Cached min/max content widths
         layout_result_cache                         m_layout_cache;     // Cached layout results
         uint32_t                                    m_cache_generation; // Generation for cache validity
+        background_layer_cache                      m_bg_cache;         // Resolved gradient layers reused between draws
+        compositing_layer                           m_layer;            // Cached subtree raster for transform/filter/opacity
+        hit_bounds                                  m_hit_bounds;       // Hit testing area of the subtree, see build_hit_index
+        uint32_t                                    m_hit_generation = 0; // document::hit_generation() of m_hit_bounds
+        std::unique_ptr<hit_bands>                  m_hit_bands;        // Children by band, for items with many children
 
 		containing_block_context calculate_containing_block_context(const containing_block_context& cb_context);
 		void calc_cb_length(const css_length& len, pixel_t percent_base, containing_block_context::typed_pixel& out_value) const;
+		void to_document_coords(position::vector& boxes);
+		// Items get_child_by_point descends to, in the reverse order of the checks. Items of bounds_only are
+		// checked separately. clipped is true if get_child_by_point finds nothing outside of m_pos.
+		virtual void get_hit_children(std::vector<render_item*>& children, std::vector<render_item*>& bounds_only, bool& clipped);
+		void update_hit_bounds(uint32_t generation);
 		virtual pixel_t _render(pixel_t /*x*/, pixel_t /*y*/, const containing_block_context& /*containing_block_size*/, formatting_context* /*fmt_ctx*/, bool /*second_pass = false*/)
 		{
 			return 0;
 		}
 
     public:
-        explicit render_item(std::shared_ptr<element>  src_el);
+        explicit render_item(element* src_el);
 
-        virtual ~render_item() = default;
+        virtual ~render_item();
 
-        std::list<std::shared_ptr<render_item>>& children()
+        intrusive_list<render_item>& children()
         {
             return m_children;
         }
@@ -170,7 +226,7 @@ namespace litehtml
 
         std::shared_ptr<render_item> parent() const
         {
-            return m_parent.lock();
+            return m_parent ? m_parent->shared_from_this() : nullptr;
         }
 
         margins& get_margins()
@@ -335,10 +391,10 @@ namespace litehtml
 
         void parent(const std::shared_ptr<render_item>& par)
         {
-            m_parent = par;
+            m_parent = par.get();
         }
 
-        const std::shared_ptr<element>& src_el() const
+        element* src_el() const
         {
             return m_element;
         }
@@ -351,12 +407,11 @@ namespace litehtml
         void add_child(const std::shared_ptr<render_item>& ri)
         {
             m_children.push_back(ri);
-            ri->parent(shared_from_this());
         }
 
 		bool is_root() const
 		{
-			return m_parent.expired();
+			return m_parent == nullptr;
 		}
 
         bool collapse_top_margin() const
@@ -421,7 +476,7 @@ namespace litehtml
 
         virtual std::shared_ptr<render_item> clone()
         {
-            return std::make_shared<render_item>(src_el());
+            return make_render_item<render_item>(src_el());
         }
         std::tuple<
                 std::shared_ptr<litehtml::render_item>,
@@ -431,7 +486,7 @@ namespace litehtml
         bool fetch_positioned(int depth = 0);
         void render_positioned(render_type rt = render_all);
 		// returns element offset related to the containing block
-		std::tuple<pixel_t, pixel_t> element_static_offset(const std::shared_ptr<litehtml::render_item> &el);
+		std::tuple<pixel_t, pixel_t> element_static_offset(const render_item* el);
         void add_positioned(const std::shared_ptr<litehtml::render_item> &el);
         void get_redraw_box(litehtml::position& pos, pixel_t x = 0, pixel_t y = 0);
         void calc_document_size( litehtml::size& sz, litehtml::size& content_size, pixel_t x = 0, pixel_t y = 0 );
@@ -444,6 +499,13 @@ namespace litehtml
         virtual pixel_t get_draw_vertical_offset() { return 0; }
         virtual std::shared_ptr<element> get_child_by_point(pixel_t x, pixel_t y, pixel_t client_x, pixel_t client_y, draw_flag flag, int zindex, int depth = 0);
         std::shared_ptr<element> get_element_by_point(pixel_t x, pixel_t y, pixel_t client_x, pixel_t client_y, int depth = 0);
+        // Builds the hit testing area of all items of the subtree, called by the document after layout
+        void build_hit_index(uint32_t generation);
+        // false if get_element_by_point can't find anything at the point, generation is document::hit_generation()
+        bool may_hit(pixel_t x, pixel_t y, uint32_t generation) const
+        {
+            return generation == 0 || m_hit_generation != generation || m_hit_bounds.contains(x, y);
+        }
         bool is_point_inside( pixel_t x, pixel_t y );
         void dump(litehtml::dumper& cout);
 		position get_placement() const;
@@ -455,6 +517,8 @@ namespace litehtml
          * @return
          */
         void get_rendering_boxes( position::vector& redraw_boxes);
+        // Area painted by the element with its visible overflow and transform, in document coordinates
+        void get_paint_boxes( position::vector& redraw_boxes);
 
 		// ========== Damage Tracking API ==========
 
@@ -542,7 +606,48 @@ namespace litehtml
 		 */
 		block_width_cache& get_width_cache() { return m_width_cache; }
 		const block_width_cache& get_width_cache() const { return m_width_cache; }
+
+		/**
+		 * Get the cache of resolved background gradient layers
+		 */
+		background_layer_cache& get_background_cache() { return m_bg_cache; }
+
+		/**
+		 * Draw the item and its subtree through the compositing layer.
+		 * The content is repainted only if the layer is missing or stale, otherwise the
+		 * cached surface is composited with the current transform and opacity.
+		 * @return false if the item doesn't need a layer or the container has no layer support
+		 */
+		bool draw_composited(uint_ptr hdc, pixel_t x, pixel_t y, bool with_positioned, int depth);
+
+		/**
+		 * True if the item is currently drawn through a compositing layer
+		 */
+		bool is_composited() const { return m_layer.handle != 0; }
+
+		/**
+		 * Delete the compositing layer surface
+		 */
+		void release_layer();
+
+		/**
+		 * Mark the layers showing this item as stale: the layers of the subtree and of the
+		 * composited ancestors are repainted on the next draw. Used when the item was restyled
+		 * without render().
+		 */
+		void invalidate_layers();
+
+	private:
+		void invalidate_subtree_layers();
 	};
+
+    template<class T>
+    std::shared_ptr<T> make_anonymous_render_item(const std::shared_ptr<element>& el)
+    {
+        auto ret = make_render_item<T>(el.get());
+        ret->m_anonymous_el = el;
+        return ret;
+    }
 }
 
 #endif //LH_RENDER_ITEM_H
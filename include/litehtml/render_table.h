@@ -14,13 +14,14 @@ namespace litehtml
 		pixel_t						m_border_spacing_y;
 
 		pixel_t _render(pixel_t x, pixel_t y, const containing_block_context &containing_block_size, formatting_context* fmt_ctx, bool second_pass) override;
+		void get_hit_children(std::vector<render_item*>& children, std::vector<render_item*>& bounds_only, bool& clipped) override;
 
 	public:
-		explicit render_item_table(std::shared_ptr<element>  src_el);
+		explicit render_item_table(element* src_el);
 
 		std::shared_ptr<render_item> clone() override
 		{
-			return std::make_shared<render_item_table>(src_el());
+			return make_render_item<render_item_table>(src_el());
 		}
 		void draw_children(uint_ptr hdc, pixel_t x, pixel_t y, const position* clip, draw_flag flag, int zindex, int depth = 0) override;
 		std::shared_ptr<element> get_child_by_point(pixel_t x, pixel_t y, pixel_t client_x, pixel_t client_y, draw_flag flag, int zindex, int depth = 0) override;
@@ -31,24 +32,24 @@ namespace litehtml
 	class render_item_table_part : public render_item
 	{
 	public:
-		explicit render_item_table_part(std::shared_ptr<element>  src_el) : render_item(std::move(src_el))
+		explicit render_item_table_part(element* src_el) : render_item(src_el)
 		{}
 
 		std::shared_ptr<render_item> clone() override
 		{
-			return std::make_shared<render_item_table_part>(src_el());
+			return make_render_item<render_item_table_part>(src_el());
 		}
 	};
 
 	class render_item_table_row : public render_item
 	{
 	public:
-		explicit render_item_table_row(std::shared_ptr<element>  src_el) : render_item(std::move(src_el))
+		explicit render_item_table_row(element* src_el) : render_item(src_el)
 		{}
 
 		std::shared_ptr<render_item> clone() override
 		{
-			return std::make_shared<render_item_table_row>(src_el());
+			return make_render_item<render_item_table_row>(src_el());
 		}
 		void get_inline_boxes( position::vector& boxes ) const override;
 	};
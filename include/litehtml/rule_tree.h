@@ -0,0 +1,271 @@
+#ifndef LH_RULE_TREE_H
+#define LH_RULE_TREE_H
+
+#include "string_id.h"
+#include "style.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace litehtml
+{
+
+// Node of the rule tree. The path from the root to the node is a list of matched
+// declaration blocks in cascade order. Elements that matched exactly the same rules
+// in the same order end on the same node and share its cascaded style.
+class rule_node
+{
+	friend class rule_tree;
+
+	const rule_node*	m_parent;
+	const style*		m_declarations;		// nullptr for the root node
+	uint64_t			m_declarations_uid;	// style::uid() of m_declarations, 0 for the root node
+	mutable std::unique_ptr<style>	m_cascaded;	// computed on first use
+	mutable bool		m_has_vars = false;
+public:
+	rule_node(const rule_node* parent, const style* declarations, uint64_t declarations_uid) :
+		m_parent(parent), m_declarations(declarations), m_declarations_uid(declarations_uid) {}
+
+	const rule_node*	parent() const			{ return m_parent; }
+	const style*		declarations() const	{ return m_declarations; }
+
+	// Result of combining all declaration blocks from the root to this node
+	const style& cascaded() const
+	{
+		if (!m_cascaded)
+		{
+			if (m_parent)
+			{
+				m_cascaded = std::make_unique<style>(m_parent->cascaded());
+				m_cascaded->combine(*m_declarations);
+			} else
+			{
+				m_cascaded = std::make_unique<style>();
+			}
+			m_has_vars = m_cascaded->has_vars();
+		}
+		return *m_cascaded;
+	}
+
+	// true if the cascaded style contains var() references that need substitution
+	bool has_vars() const
+	{
+		cascaded();
+		return m_has_vars;
+	}
+};
+
+// Interns matched rule lists (Gecko-style rule tree) and the style identities of elements.
+// Style identity is the tuple (tag, replaced, rule node, parent style identity), so two
+// elements with the same identity have the same cascaded style and the same inherited values
+// and can share their computed style outright.
+// Declaration blocks are keyed by style::uid(), so a block allocated at the address of a freed
+// one never matches its nodes. The elements referencing a node keep its declarations alive
+// through their used selectors. Nodes and identities no element uses any more are dropped
+// by collect().
+class rule_tree
+{
+	struct child_key
+	{
+		const rule_node* parent;
+		uint64_t declarations;
+
+		bool operator==(const child_key& other) const
+		{
+			return parent == other.parent && declarations == other.declarations;
+		}
+	};
+
+	struct style_key
+	{
+		string_id tag;
+		bool replaced;				// css_properties::compute depends on element::is_replaced
+		const rule_node* node;
+		size_t parent_style_id;
+		size_t local_key;			// 0, or the element owning local declarations, see local_style_id
+		string local_style;			// style attribute of that element
+
+		bool operator==(const style_key& other) const
+		{
+			return tag == other.tag && replaced == other.replaced && node == other.node && parent_style_id == other.parent_style_id &&
+				local_key == other.local_key && local_style == other.local_style;
+		}
+	};
+
+	struct key_hash
+	{
+		static size_t mix(size_t h, size_t v)
+		{
+			return h ^ (v + 0x9e3779b9 + (h << 6) + (h >> 2));
+		}
+		size_t operator()(const child_key& key) const
+		{
+			return mix(std::hash<const void*>{}(key.parent), std::hash<uint64_t>{}(key.declarations));
+		}
+		size_t operator()(const style_key& key) const
+		{
+			size_t h = std::hash<int>{}(static_cast<int>(key.tag) * 2 + (key.replaced ? 1 : 0));
+			h = mix(h, std::hash<const void*>{}(key.node));
+			h = mix(h, key.parent_style_id);
+			if (key.local_key)
+			{
+				h = mix(h, key.local_key);
+				h = mix(h, std::hash<string>{}(key.local_style));
+			}
+			return h;
+		}
+	};
+
+	std::vector<std::unique_ptr<rule_node>>					m_nodes;
+	std::unordered_map<child_key, rule_node*, key_hash>		m_children;
+	std::unordered_map<style_key, size_t, key_hash>			m_style_ids;
+	size_t													m_next_style_id = 1;
+	size_t													m_next_local_key = 1;
+	size_t													m_collected_size = 0;	// size() after the last collect()
+
+	size_t intern(style_key&& key)
+	{
+		auto ret = m_style_ids.emplace(std::move(key), m_next_style_id);
+		if (ret.second)
+		{
+			m_next_style_id++;
+		}
+		return ret.first->second;
+	}
+public:
+	rule_tree()
+	{
+		m_nodes.push_back(std::make_unique<rule_node>(nullptr, nullptr, 0));
+	}
+
+	const rule_node* root() const { return m_nodes.front().get(); }
+
+	// Returns the node for the rule list of parent followed by declarations
+	const rule_node* child(const rule_node* parent, const style& declarations)
+	{
+		if (!parent) parent = root();
+
+		child_key key{parent, declarations.uid()};
+		auto it = m_children.find(key);
+		if (it != m_children.end())
+		{
+			return it->second;
+		}
+		m_nodes.push_back(std::make_unique<rule_node>(parent, &declarations, declarations.uid()));
+		rule_node* node = m_nodes.back().get();
+		m_children.emplace(key, node);
+		return node;
+	}
+
+	// Interned style identity, never 0. parent_style_id is 0 for the root element.
+	size_t style_id(string_id tag, bool replaced, const rule_node* node, size_t parent_style_id)
+	{
+		if (!node) node = root();
+		return intern(style_key{tag, replaced, node, parent_style_id, 0, string()});
+	}
+
+	// Key of an element with local declarations, passed to local_style_id
+	size_t new_local_key()
+	{
+		return m_next_local_key++;
+	}
+
+	// Style identity for an element with local declarations, equal to the identity of no other
+	// element. It stays the same while the rules, the parent style and the style attribute do,
+	// so restyling the element doesn't create new identities for its subtree.
+	size_t local_style_id(size_t local_key, string_id tag, bool replaced, const rule_node* node, size_t parent_style_id, const string& style_attr)
+	{
+		if (!node) node = root();
+		return intern(style_key{tag, replaced, node, parent_style_id, local_key, style_attr});
+	}
+
+	size_t size() const { return m_nodes.size() + m_style_ids.size(); }
+
+	// true if the tree has grown enough since the last collect() to make collecting worthwhile
+	bool needs_collect() const
+	{
+		return size() > m_collected_size * 2 + 256;
+	}
+
+	/**
+	 * Drops the nodes and identities no element uses.
+	 * @param live_nodes - rule nodes of all elements of the document
+	 * @param live_ids - style identities of all elements of the document
+	 */
+	template<class NodeSet, class IdSet>
+	void collect(const NodeSet& live_nodes, const IdSet& live_ids)
+	{
+		std::unordered_set<const rule_node*> marked;
+		marked.insert(root());
+		for (const rule_node* node : live_nodes)
+		{
+			for (; node && marked.insert(node).second; node = node->m_parent) {}
+		}
+
+		for (auto it = m_children.begin(); it != m_children.end();)
+		{
+			if (marked.count(it->second)) ++it;
+			else it = m_children.erase(it);
+		}
+		for (auto it = m_style_ids.begin(); it != m_style_ids.end();)
+		{
+			const style_key& key = it->first;
+			bool live = marked.count(key.node) && live_ids.count(it->second) &&
+				(key.parent_style_id == 0 || live_ids.count(key.parent_style_id));
+			if (live) ++it;
+			else it = m_style_ids.erase(it);
+		}
+		// Parents are always created before their children, so the order is kept
+		m_nodes.erase(std::remove_if(m_nodes.begin(), m_nodes.end(),
+						[&](const std::unique_ptr<rule_node>& node) { return !marked.count(node.get()); }),
+					  m_nodes.end());
+		m_collected_size = size();
+	}
+
+	// Makes this tree a copy of other, including the cascaded styles and style identities.
+	// node_map receives the node of this tree for every node of other.
+	void copy_from(const rule_tree& other, std::unordered_map<const rule_node*, const rule_node*>& node_map)
+	{
+		m_nodes.clear();
+		m_children.clear();
+		m_style_ids.clear();
+		node_map.clear();
+		node_map.reserve(other.m_nodes.size());
+
+		// Parents are always created before their children
+		m_nodes.reserve(other.m_nodes.size());
+		for (const auto& src : other.m_nodes)
+		{
+			const rule_node* parent = src->m_parent ? node_map.at(src->m_parent) : nullptr;
+			m_nodes.push_back(std::make_unique<rule_node>(parent, src->m_declarations, src->m_declarations_uid));
+			rule_node* node = m_nodes.back().get();
+			if (src->m_cascaded)
+			{
+				node->m_cascaded = std::make_unique<style>(*src->m_cascaded);
+				node->m_has_vars = src->m_has_vars;
+			}
+			node_map.emplace(src.get(), node);
+			if (parent)
+			{
+				m_children.emplace(child_key{parent, src->m_declarations_uid}, node);
+			}
+		}
+
+		m_style_ids.reserve(other.m_style_ids.size());
+		for (const auto& item : other.m_style_ids)
+		{
+			style_key key = item.first;
+			key.node = node_map.at(key.node);
+			m_style_ids.emplace(std::move(key), item.second);
+		}
+		m_next_style_id = other.m_next_style_id;
+		m_next_local_key = other.m_next_local_key;
+		m_collected_size = other.m_collected_size;
+	}
+};
+
+} // namespace litehtml
+
+#endif // LH_RULE_TREE_H
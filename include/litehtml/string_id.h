@@ -139,6 +139,10 @@ STRING_ID(
 	__tag_before_, // note: real tag cannot start with '-'
 	__tag_after_,
 
+	// HTML attributes that set the element's classes and id
+	_class_,
+	_id_,
+
 	// CSS pseudo-elements
 	_before_,
 	_after_,
@@ -358,6 +362,7 @@ STRING_ID(
 	// CSS Transform
 	_transform_,
 	_transform_origin_,
+	_will_change_,
 
 	// CSS Transitions
 	_transition_,
@@ -434,6 +439,7 @@ extern const string_id empty_id; // _id("")
 extern const string_id star_id; // _id("*")
 
 string_id			   _id(const std::string& str);
+bool				   _find_id(const std::string& str, string_id& id); // unlike _id, doesn't add str
 const std::string&	   _s(string_id id);
 
 } // namespace litehtml
@@ -7,6 +7,8 @@
 #include "css_tokenizer.h"
 #include "gradient.h"
 #include "web_color.h"
+#include <algorithm>
+#include <atomic>
 
 namespace litehtml
 {
@@ -38,7 +40,159 @@ namespace litehtml
 	};
 
 	class html_tag;
-	typedef std::map<string_id, property_value>	props_map;
+	class css_binary;
+
+	// Declarations of a style block: a flat array sorted by property id.
+	// Lookups are binary searches over contiguous memory, and misses (the common case in
+	// css_properties::compute) are answered by a presence bitset without searching.
+	// Values are stored inline in the array, so combining blocks does at most one allocation.
+	class props_map
+	{
+	public:
+		typedef std::pair<string_id, property_value>	value_type;
+		typedef std::vector<value_type>::iterator		iterator;
+		typedef std::vector<value_type>::const_iterator	const_iterator;
+	private:
+		static constexpr int PresenceBits = 512; // ids above it are always searched
+		std::vector<value_type>	m_items;
+		uint64_t				m_present[PresenceBits / 64] = {};
+
+		bool maybe_present(string_id name) const
+		{
+			return (int) name >= PresenceBits || (m_present[name / 64] >> (name % 64)) & 1;
+		}
+		void set_present(string_id name)
+		{
+			if ((int) name < PresenceBits) m_present[name / 64] |= uint64_t(1) << (name % 64);
+		}
+		const_iterator lower_bound(string_id name) const
+		{
+			return std::lower_bound(m_items.begin(), m_items.end(), name,
+				[](const value_type& item, string_id id) { return item.first < id; });
+		}
+	public:
+		const_iterator begin() const	{ return m_items.begin(); }
+		const_iterator end() const		{ return m_items.end(); }
+		iterator begin()				{ return m_items.begin(); }
+		iterator end()					{ return m_items.end(); }
+		size_t size() const				{ return m_items.size(); }
+		bool empty() const				{ return m_items.empty(); }
+		void reserve(size_t n)			{ m_items.reserve(n); }
+
+		const property_value* find(string_id name) const
+		{
+			if (!maybe_present(name)) return nullptr;
+			auto it = lower_bound(name);
+			return it != m_items.end() && it->first == name ? &it->second : nullptr;
+		}
+		property_value* find(string_id name)
+		{
+			return const_cast<property_value*>(static_cast<const props_map*>(this)->find(name));
+		}
+
+		// Inserts or replaces the value of the property
+		void set(string_id name, const property_value& val)
+		{
+			auto it = m_items.begin() + (lower_bound(name) - m_items.cbegin());
+			if (it != m_items.end() && it->first == name)
+			{
+				it->second = val;
+			} else
+			{
+				m_items.emplace(it, name, val);
+				set_present(name);
+			}
+		}
+
+		void erase(string_id name)
+		{
+			if (!maybe_present(name)) return;
+			auto it = lower_bound(name);
+			if (it != m_items.end() && it->first == name)
+			{
+				m_items.erase(it);
+				if ((int) name < PresenceBits) m_present[name / 64] &= ~(uint64_t(1) << (name % 64));
+			}
+		}
+
+		void clear()
+		{
+			m_items.clear();
+			std::fill(std::begin(m_present), std::end(m_present), 0);
+		}
+
+		// Merges src into this map in one linear pass.
+		// replace(current, value) decides if a value already present is overwritten.
+		template<class Replace> void merge(const props_map& src, Replace replace);
+	};
+
+	template<class Replace> void props_map::merge(const props_map& src, Replace replace)
+	{
+		if (m_items.empty())
+		{
+			*this = src;
+			return;
+		}
+
+		size_t added = 0;
+		for (const auto& item : src.m_items)
+		{
+			if (!find(item.first)) added++;
+		}
+
+		if (!added)
+		{
+			// Only overrides, update in place
+			for (const auto& item : src.m_items)
+			{
+				property_value* cur = find(item.first);
+				if (replace(*cur, item.second)) *cur = item.second;
+			}
+			return;
+		}
+
+		std::vector<value_type> merged;
+		merged.reserve(m_items.size() + added);
+		auto dst = m_items.begin();
+		auto it = src.m_items.begin();
+		while (dst != m_items.end() || it != src.m_items.end())
+		{
+			if (it == src.m_items.end() || (dst != m_items.end() && dst->first < it->first))
+			{
+				merged.push_back(std::move(*dst++));
+			} else if (dst == m_items.end() || it->first < dst->first)
+			{
+				merged.push_back(*it);
+				set_present(it->first);
+				++it;
+			} else
+			{
+				merged.push_back(replace(dst->second, it->second) ? *it : std::move(*dst));
+				++dst;
+				++it;
+			}
+		}
+		m_items.swap(merged);
+	}
+
+	// Identity of a declaration block: new for every block, copies included, and never reused.
+	// Unlike the address it can key data that outlives the block, see rule_tree.
+	class style_uid
+	{
+		uint64_t m_value;
+
+		static uint64_t next()
+		{
+			static std::atomic<uint64_t> counter{0};
+			return ++counter;
+		}
+	public:
+		style_uid() : m_value(next()) {}
+		style_uid(const style_uid&) : m_value(next()) {}
+		style_uid& operator=(const style_uid&) { m_value = next(); return *this; }
+
+		uint64_t value() const { return m_value; }
+	};
 
 	// represents a style block, eg. "color: black; display: inline"
 	class style
@@ -48,7 +202,10 @@ namespace litehtml
 		typedef std::vector<style::ptr>		vector;
 	private:
 		props_map							m_properties;
+		style_uid							m_uid;
 		static std::map<string_id, string>	m_valid_values;
+
+		friend class css_binary;
 	public:
 		void add(const css_token_vector& tokens, const string& baseurl = "", document_container* container = nullptr);
 		void add(const string& txt,              const string& baseurl = "", document_container* container = nullptr);
@@ -59,6 +216,7 @@ namespace litehtml
 		const property_value& get_property(string_id name) const;
 
 		void combine(const style& src);
+		uint64_t uid() const { return m_uid.value(); }
 		void clear()
 		{
 			m_properties.clear();
@@ -66,16 +224,14 @@ namespace litehtml
 
 		void subst_vars(const html_tag* el);
 
-		// Compute hash for style sharing cache
-		size_t hash() const
+		// true if any property value contains var() and needs subst_vars
+		bool has_vars() const
 		{
-			size_t h = 0;
 			for (const auto& prop : m_properties)
 			{
-				h ^= std::hash<int>{}(static_cast<int>(prop.first)) + 0x9e3779b9 + (h << 6) + (h >> 2);
-				h ^= prop.second.index() + 0x9e3779b9 + (h << 6) + (h >> 2);
+				if (prop.second.m_has_var) return true;
 			}
-			return h;
+			return false;
 		}
 
 	private:
@@ -1,78 +1,28 @@
 #ifndef LH_STYLE_CACHE_H
 #define LH_STYLE_CACHE_H
 
-#include "string_id.h"
 #include "css_properties.h"
 #include <unordered_map>
-#include <vector>
-#include <algorithm>
 
 namespace litehtml
 {
 
 // Style sharing cache - stores computed styles for reuse between similar elements
-// Based on WebKit's style sharing cache and Quantum CSS's style sharing
+// Based on WebKit's style sharing cache and Quantum CSS's style sharing.
+// Keyed by the exact style identity from rule_tree::style_id: elements with the same
+// identity matched the same rules and have parents with the same computed style,
+// so a hit is always correct (also for cousins, not only siblings).
 class style_cache
 {
 public:
 	// Maximum cache size to prevent unbounded memory growth
 	static constexpr size_t MaxCacheSize = 4096;
 
-	struct cache_key
-	{
-		string_id tag;
-		size_t classes_hash;             // Hash of sorted classes
-		size_t style_hash;               // Hash of matched CSS rules (m_style)
-		size_t parent_style_hash;        // Hash of parent's computed style
-
-		bool operator==(const cache_key& other) const
-		{
-			return tag == other.tag &&
-			       style_hash == other.style_hash &&
-			       parent_style_hash == other.parent_style_hash &&
-			       classes_hash == other.classes_hash;
-		}
-	};
-
-	struct cache_key_hash
-	{
-		size_t operator()(const cache_key& key) const
-		{
-			size_t h = std::hash<int>{}(static_cast<int>(key.tag));
-			h ^= key.style_hash + 0x9e3779b9 + (h << 6) + (h >> 2);
-			h ^= key.parent_style_hash + 0x9e3779b9 + (h << 6) + (h >> 2);
-			h ^= key.classes_hash + 0x9e3779b9 + (h << 6) + (h >> 2);
-			return h;
-		}
-	};
-
-	// Compute hash for a vector of classes
-	static size_t hash_classes(const std::vector<string_id>& classes)
-	{
-		// Sort a copy for consistent hashing
-		std::vector<string_id> sorted = classes;
-		std::sort(sorted.begin(), sorted.end());
-
-		size_t h = 0;
-		for (auto cls : sorted)
-		{
-			h ^= std::hash<int>{}(static_cast<int>(cls)) + 0x9e3779b9 + (h << 6) + (h >> 2);
-		}
-		return h;
-	}
-
 	// Try to find cached style for element
 	// Returns nullptr if not found
-	const css_properties* find(string_id tag, const std::vector<string_id>& classes,
-	                           size_t style_hash, size_t parent_style_hash) const
+	const css_properties* find(size_t style_id) const
 	{
-		cache_key key;
-		key.tag = tag;
-		key.classes_hash = hash_classes(classes);
-		key.style_hash = style_hash;
-		key.parent_style_hash = parent_style_hash;
-
-		auto it = m_cache.find(key);
+		auto it = m_cache.find(style_id);
 		if (it != m_cache.end())
 		{
 			m_hits++;
@@ -83,9 +33,7 @@ public:
 	}
 
 	// Store computed style in cache
-	void store(string_id tag, const std::vector<string_id>& classes,
-	           size_t style_hash, size_t parent_style_hash,
-	           const css_properties& computed_style)
+	void store(size_t style_id, const css_properties& computed_style)
 	{
 		// Evict if cache is full (simple LRU would be better but this is simpler)
 		if (m_cache.size() >= MaxCacheSize)
@@ -98,13 +46,7 @@ public:
 			}
 		}
 
-		cache_key key;
-		key.tag = tag;
-		key.classes_hash = hash_classes(classes);
-		key.style_hash = style_hash;
-		key.parent_style_hash = parent_style_hash;
-
-		m_cache[key] = computed_style;
+		m_cache[style_id] = computed_style;
 	}
 
 	void clear()
@@ -120,7 +62,7 @@ public:
 	float hit_rate() const { return m_hits + m_misses > 0 ? float(m_hits) / (m_hits + m_misses) : 0; }
 
 private:
-	mutable std::unordered_map<cache_key, css_properties, cache_key_hash> m_cache;
+	mutable std::unordered_map<size_t, css_properties> m_cache;
 	mutable size_t m_hits = 0;
 	mutable size_t m_misses = 0;
 };
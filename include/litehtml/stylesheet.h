@@ -52,6 +52,8 @@ class css
 	css_selector::vector m_universal_selectors;  // * selectors (match any element)
 	bool m_index_built = false;
 
+	friend class css_binary;
+
 public:
 
 	const css_selector::vector& selectors() const
@@ -92,6 +94,36 @@ inline void css::add_selector(const css_selector::ptr& selector)
 	m_selectors.push_back(selector);
 }
 
+// Parsed, sorted and indexed style sheet that can be shared by any number of documents,
+// e.g. the master css or a style sheet common to many small documents.
+// It is immutable once created, so documents on different threads can use it at the same time.
+// Which of its media queries match is kept by each document, see document::update_media_lists.
+class compiled_css
+{
+	css								m_css;
+	media_query_list_list::vector	m_media_lists;	// media lists referenced by m_css selectors
+	keyframes_map					m_keyframes;
+
+	friend class css_binary;
+public:
+	using ptr = shared_ptr<const compiled_css>;
+
+	// container is used for @import, urls and the units of media queries.
+	// mode is the document mode the selectors are parsed for.
+	static ptr create(const string& text, document_container* container, const string& baseurl = "", document_mode mode = no_quirks_mode);
+
+	// Compact binary form of the style sheet for fast startup, see doc/document_createFromString.md.
+	// It is valid only for the litehtml version that wrote it.
+	string serialize() const;
+	// Returns nullptr if data is not a style sheet serialized by this litehtml version.
+	// data is not referenced after the call, so it can be a temporary memory-mapped file.
+	static ptr load(const void* data, size_t size);
+
+	const css&								styles() const		{ return m_css; }
+	const media_query_list_list::vector&	media_lists() const	{ return m_media_lists; }
+	const keyframes_map&					keyframes() const	{ return m_keyframes; }
+};
+
 
 } // namespace litehtml
 
@@ -53,6 +53,24 @@ namespace litehtml
 		limited_quirks_mode
 	};
 
+	// Resources found by the preload scanner, see document_container::preload
+	enum resource_type
+	{
+		resource_stylesheet,
+		resource_image
+	};
+
+	// Deferred loading of images, see document_container::get_lazy_images_policy
+	struct lazy_images_policy
+	{
+		bool	enabled		= true;		// Images with loading="lazy" wait until they come near the viewport
+		bool	all_images	= false;	// All images are lazy, except the ones with loading="eager"
+		pixel_t	margin		= 1250;		// Distance from the viewport where the images are loaded
+
+		// loading is the value of the loading attribute or nullptr
+		bool is_lazy(const char* loading) const;
+	};
+
 	#define  style_text_decoration_line_strings		"none;underline;overline;line-through"
 
 	enum text_decoration_line
@@ -276,14 +294,6 @@ namespace litehtml
 		pixel_t base_line() const	{ return descent; }
 	};
 
-	struct font_item
-	{
-		uint_ptr		font;
-		font_metrics	metrics;
-	};
-
-	using fonts_map = std::map<string, font_item>;
-
 	enum draw_flag
 	{
 		draw_root,
@@ -0,0 +1,71 @@
+#ifndef LH_VIRTUAL_LIST_H
+#define LH_VIRTUAL_LIST_H
+
+#include "types.h"
+#include <memory>
+#include <vector>
+
+namespace litehtml
+{
+	class document;
+	class element;
+
+	// Rows of a virtual list, see document::set_virtual_list
+	class virtual_list_source
+	{
+	public:
+		virtual ~virtual_list_source() = default;
+
+		virtual size_t	row_count() const = 0;
+		// HTML of one row, parsed in the context of the list element (use <tbody> for table rows).
+		// Row elements are created from it only for the rows near the viewport and are reused for
+		// other rows when the window moves.
+		virtual string	row_template() const = 0;
+		// Sets the text and the attributes of a row element created from the template for the row index.
+		// The row is styled again after the call.
+		virtual void	fill_row(size_t index, const std::shared_ptr<element>& row) = 0;
+	};
+
+	// Element with only the rows near the viewport in the DOM. The rows before and after the window are
+	// replaced by two spacers sized with the average height of the rows laid out so far, so the height
+	// of the list doesn't change while it is scrolled.
+	class virtual_list
+	{
+		document*								m_doc;
+		std::weak_ptr<element>					m_list;
+		std::shared_ptr<virtual_list_source>	m_source;
+		string									m_template;
+		std::shared_ptr<element>				m_top_spacer;
+		std::shared_ptr<element>				m_bottom_spacer;
+		std::vector<std::shared_ptr<element>>	m_rows;				// Rows m_first, m_first + 1... in the DOM
+		std::vector<std::shared_ptr<element>>	m_free;				// Rows out of the window, reused first
+		size_t									m_first = 0;
+		size_t									m_count = 0;		// row_count() of the last update
+		pixel_t									m_row_height = 0;	// Average height of the measured rows
+		pixel_t									m_spacers_height = 0; // m_row_height the spacers are sized with
+		double									m_measured_height = 0;
+		size_t									m_measured_rows = 0;
+		bool									m_measure = false;	// The rows changed since the last render
+
+		// Rows laid out before the first measurement
+		static constexpr size_t					InitialRows = 32;
+	public:
+		virtual_list(document* doc, const std::shared_ptr<element>& list, const std::shared_ptr<virtual_list_source>& source);
+
+		// Replaces the children of the list with the first rows, false if the template has no element
+		bool						init();
+		std::shared_ptr<element>	list() const { return m_list.lock(); }
+		// Moves the window of rows around the viewport (document coordinates), true if the DOM changed
+		bool						update(const position& viewport);
+		// Measures the rows after the document was rendered
+		void						measure();
+
+	private:
+		void						set_window(size_t first, size_t last);
+		void						set_spacers();
+		static position				row_box(const std::shared_ptr<element>& row);
+		std::shared_ptr<element>	create_element(const string& html) const;
+	};
+}
+
+#endif  // LH_VIRTUAL_LIST_H
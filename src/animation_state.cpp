@@ -1,6 +1,7 @@
 #include "html.h"
 #include "animation_state.h"
 #include "element.h"
+#include <climits>
 
 namespace litehtml
 {
@@ -95,115 +96,168 @@ float animation_state::get_direction_adjusted_progress(float progress) const
 	return is_reverse ? (1.0f - progress) : progress;
 }
 
+TransformMatrix interpolate_transform(const TransformMatrix& from, const TransformMatrix& to, float progress)
+{
+	TransformMatrix transform;
+	transform.a = interpolate::number(from.a, to.a, progress);
+	transform.b = interpolate::number(from.b, to.b, progress);
+	transform.c = interpolate::number(from.c, to.c, progress);
+	transform.d = interpolate::number(from.d, to.d, progress);
+	transform.e = interpolate::number(from.e, to.e, progress);
+	transform.f = interpolate::number(from.f, to.f, progress);
+	return transform;
+}
+
+TransformMatrix transition_state::get_transform(float progress) const
+{
+	return interpolate_transform(from_transform, to_transform, progress);
+}
+
 // animation_controller implementation
+// Index of the transition, or the number of transitions if there is none
+size_t animation_controller::find_transition(element* el, string_id property) const
+{
+	size_t i = 0;
+	for (; i < m_transitions.size(); i++)
+	{
+		if (m_transition_elements[i] == el && m_transitions[i].property == property) break;
+	}
+	return i;
+}
+
+// The order of entries doesn't matter, the last one takes the place of the removed one
+void animation_controller::remove_transition(size_t i)
+{
+	m_transition_elements[i] = m_transition_elements.back();
+	m_transition_refs[i] = std::move(m_transition_refs.back());
+	m_transitions[i] = m_transitions.back();
+	m_transition_elements.pop_back();
+	m_transition_refs.pop_back();
+	m_transitions.pop_back();
+}
+
+void animation_controller::remove_animation(size_t i)
+{
+	m_animation_elements[i] = m_animation_elements.back();
+	m_animation_refs[i] = std::move(m_animation_refs.back());
+	m_animations[i] = std::move(m_animations.back());
+	m_animation_elements.pop_back();
+	m_animation_refs.pop_back();
+	m_animations.pop_back();
+}
+
 void animation_controller::start_transition(element* el, string_id property, const transition_state& state)
 {
-	m_transitions[el][property] = state;
+	size_t i = find_transition(el, property);
+	if (i == m_transitions.size())
+	{
+		m_transition_elements.push_back(el);
+		m_transition_refs.push_back(el->weak_from_this());
+		m_transitions.push_back(state);
+	} else
+	{
+		m_transitions[i] = state;
+	}
+	m_transitions[i].property = property;
 	m_has_active_animations = true;
 	request_frame();
 }
 
 void animation_controller::start_animation(element* el, const animation_state& state)
 {
-	m_animations[el].push_back(state);
+	m_animation_elements.push_back(el);
+	m_animation_refs.push_back(el->weak_from_this());
+	m_animations.push_back(state);
 	m_has_active_animations = true;
 	request_frame();
 }
 
 void animation_controller::stop_transitions(element* el)
 {
-	m_transitions.erase(el);
+	for (size_t i = m_transitions.size(); i-- > 0; )
+	{
+		if (m_transition_elements[i] == el) remove_transition(i);
+	}
 }
 
 void animation_controller::stop_animations(element* el)
 {
-	m_animations.erase(el);
+	for (size_t i = m_animations.size(); i-- > 0; )
+	{
+		if (m_animation_elements[i] == el) remove_animation(i);
+	}
 }
 
 void animation_controller::stop_animation(element* el, const string& name)
 {
-	auto it = m_animations.find(el);
-	if (it != m_animations.end())
+	for (size_t i = m_animations.size(); i-- > 0; )
 	{
-		auto& anims = it->second;
-		anims.erase(
-			std::remove_if(anims.begin(), anims.end(),
-				[&name](const animation_state& a) { return a.name == name; }),
-			anims.end()
-		);
-		if (anims.empty())
-		{
-			m_animations.erase(it);
-		}
+		if (m_animation_elements[i] == el && m_animations[i].name == name) remove_animation(i);
 	}
 }
 
 void animation_controller::remove_element(element* el)
 {
-	m_transitions.erase(el);
-	m_animations.erase(el);
+	stop_transitions(el);
+	stop_animations(el);
 }
 
-bool animation_controller::advance(double current_time_ms)
+bool animation_controller::advance(double current_time_ms, const transition_callback& apply, const animation_callback& apply_animation)
 {
-	bool any_active = false;
-
 	// Process transitions
-	for (auto it = m_transitions.begin(); it != m_transitions.end(); )
+	for (size_t i = 0; i < m_transitions.size(); )
 	{
-		auto& props = it->second;
-		for (auto pit = props.begin(); pit != props.end(); )
+		if (m_transition_refs[i].expired())
 		{
-			float progress = pit->second.get_progress(current_time_ms);
-			if (progress >= 1.0f)
-			{
-				// Transition complete
-				pit = props.erase(pit);
-			}
-			else
-			{
-				any_active = true;
-				++pit;
-			}
+			remove_transition(i);
+			continue;
 		}
-
-		if (props.empty())
+		const transition_state& state = m_transitions[i];
+		bool complete = current_time_ms - state.start_time - state.delay >= state.duration;
+		if (apply)
 		{
-			it = m_transitions.erase(it);
+			apply(m_transition_elements[i], state, complete ? 1.0f : state.get_progress(current_time_ms));
 		}
-		else
+		if (complete)
 		{
-			++it;
+			remove_transition(i);
+		} else
+		{
+			i++;
 		}
 	}
 
 	// Process animations
-	for (auto it = m_animations.begin(); it != m_animations.end(); )
+	for (size_t i = 0; i < m_animations.size(); )
 	{
-		auto& anims = it->second;
-		for (auto ait = anims.begin(); ait != anims.end(); )
+		if (m_animation_refs[i].expired())
 		{
-			if (ait->is_complete())
-			{
-				ait = anims.erase(ait);
-			}
-			else
-			{
-				any_active = true;
-				++ait;
-			}
+			remove_animation(i);
+			continue;
 		}
-
-		if (anims.empty())
+		animation_state& anim = m_animations[i];
+		if (anim.play_state == animation_play_running && anim.duration > 0)
 		{
-			it = m_animations.erase(it);
+			double elapsed = current_time_ms - anim.start_time - anim.delay;
+			anim.current_iteration = elapsed > 0 ? (int) std::min(elapsed / anim.duration, (double) INT_MAX) : 0;
 		}
-		else
+		bool complete = anim.is_complete();
+		if (apply_animation)
 		{
-			++it;
+			// The progress of a finished animation is already the final one
+			float progress = anim.get_progress(current_time_ms);
+			apply_animation(m_animation_elements[i], anim, complete ? progress : anim.get_direction_adjusted_progress(progress));
+		}
+		if (complete)
+		{
+			remove_animation(i);
+		} else
+		{
+			i++;
 		}
 	}
 
+	bool any_active = !m_transitions.empty() || !m_animations.empty();
 	m_has_active_animations = any_active;
 
 	if (any_active)
@@ -216,33 +270,31 @@ bool animation_controller::advance(double current_time_ms)
 
 bool animation_controller::get_transition_value(element* el, string_id property, double current_time, float& value)
 {
-	auto it = m_transitions.find(el);
-	if (it == m_transitions.end()) return false;
-
-	auto pit = it->second.find(property);
-	if (pit == it->second.end()) return false;
-
-	const auto& state = pit->second;
-	float progress = state.get_progress(current_time);
+	size_t i = find_transition(el, property);
+	if (i == m_transitions.size()) return false;
 
-	value = interpolate::number(state.from_value, state.to_value, progress);
+	const transition_state& state = m_transitions[i];
+	value = interpolate::number(state.from_value, state.to_value, state.get_progress(current_time));
 	return true;
 }
 
 bool animation_controller::get_transition_color(element* el, string_id property, double current_time, web_color& color)
 {
-	auto it = m_transitions.find(el);
-	if (it == m_transitions.end()) return false;
+	size_t i = find_transition(el, property);
+	if (i == m_transitions.size() || !m_transitions[i].is_color) return false;
 
-	auto pit = it->second.find(property);
-	if (pit == it->second.end()) return false;
-
-	const auto& state = pit->second;
-	if (!state.is_color) return false;
+	const transition_state& state = m_transitions[i];
+	color = interpolate::color(state.from_color, state.to_color, state.get_progress(current_time));
+	return true;
+}
 
-	float progress = state.get_progress(current_time);
+bool animation_controller::get_transition_transform(element* el, double current_time, TransformMatrix& transform)
+{
+	size_t i = find_transition(el, _transform_);
+	if (i == m_transitions.size() || !m_transitions[i].is_transform) return false;
 
-	color = interpolate::color(state.from_color, state.to_color, progress);
+	const transition_state& state = m_transitions[i];
+	transform = state.get_transform(state.get_progress(current_time));
 	return true;
 }
 
@@ -1,9 +1,11 @@
 #include <cmath>
+#include <cstring>
 
 #include "background.h"
 #include "render_item.h"
 #include "document.h"
 #include "document_container.h"
+#include "paint_profiler.h"
 
 #ifndef M_PI
 #       define M_PI    3.14159265358979323846
@@ -651,64 +653,226 @@ litehtml::background::layer_type litehtml::background::get_layer_type(int idx) c
 	return type_none;
 }
 
-void litehtml::background::draw_layer(uint_ptr hdc, int idx, const background_layer& layer, document_container* container) const
+static inline void hash_combine(size_t& h, size_t v)
 {
-	switch (get_layer_type(idx))
+	h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2);
+}
+
+static void hash_length(size_t& h, const litehtml::css_length& len)
+{
+	if(len.is_predefined())
+	{
+		hash_combine(h, std::hash<int>{}(len.predef()));
+	} else
+	{
+		hash_combine(h, std::hash<float>{}(len.val()));
+		hash_combine(h, std::hash<int>{}(len.units()));
+	}
+	hash_combine(h, std::hash<const void*>{}(len.get_calc().get()));
+}
+
+static bool same_length(const litehtml::css_length& l1, const litehtml::css_length& l2)
+{
+	if(l1.is_predefined() != l2.is_predefined()) return false;
+	if(l1.is_predefined()) return l1.predef() == l2.predef();
+	return l1.val() == l2.val() && l1.units() == l2.units() && l1.get_calc() == l2.get_calc();
+}
+
+// Compares everything that affects the resolved gradient layer except the origin box.
+// Stop lengths are already converted to pixels by css_properties, so em-based stops
+// compare different when the element font size changes.
+static bool same_gradient(const litehtml::gradient& g1, const litehtml::gradient& g2)
+{
+	if(g1.m_type != g2.m_type || g1.m_side != g2.m_side || g1.angle != g2.angle ||
+		!same_length(g1.position_x, g2.position_x) || !same_length(g1.position_y, g2.position_y) ||
+		g1.radial_shape != g2.radial_shape || g1.radial_extent != g2.radial_extent ||
+		!same_length(g1.radial_radius_x, g2.radial_radius_x) || !same_length(g1.radial_radius_y, g2.radial_radius_y) ||
+		g1.conic_from_angle != g2.conic_from_angle || g1.color_space != g2.color_space ||
+		g1.hue_interpolation != g2.hue_interpolation || g1.m_colors.size() != g2.m_colors.size())
+	{
+		return false;
+	}
+	for(size_t i = 0; i < g1.m_colors.size(); i++)
+	{
+		const auto& s1 = g1.m_colors[i];
+		const auto& s2 = g2.m_colors[i];
+		if(s1.is_color_hint != s2.is_color_hint || s1.color != s2.color ||
+			s1.length.has_value() != s2.length.has_value() || s1.angle.has_value() != s2.angle.has_value())
+		{
+			return false;
+		}
+		if(s1.length && !same_length(*s1.length, *s2.length)) return false;
+		if(s1.angle && *s1.angle != *s2.angle) return false;
+	}
+	return true;
+}
+
+// Hash of everything that affects the resolved gradient layer except the origin box
+static size_t gradient_fingerprint(const litehtml::gradient& grad)
+{
+	size_t h = std::hash<int>{}(grad.m_type);
+	hash_combine(h, grad.m_side);
+	hash_combine(h, std::hash<float>{}(grad.angle));
+	hash_length(h, grad.position_x);
+	hash_length(h, grad.position_y);
+	hash_combine(h, grad.radial_shape);
+	hash_combine(h, grad.radial_extent);
+	hash_length(h, grad.radial_radius_x);
+	hash_length(h, grad.radial_radius_y);
+	hash_combine(h, std::hash<float>{}(grad.conic_from_angle));
+	hash_combine(h, grad.color_space);
+	hash_combine(h, grad.hue_interpolation);
+	for(const auto& stop : grad.m_colors)
+	{
+		hash_combine(h, stop.is_color_hint);
+		hash_combine(h, ((size_t) stop.color.red << 24) | ((size_t) stop.color.green << 16) | ((size_t) stop.color.blue << 8) | stop.color.alpha);
+		if(stop.length) hash_length(h, *stop.length);
+		if(stop.angle) hash_combine(h, std::hash<float>{}(*stop.angle));
+	}
+	return h;
+}
+
+void litehtml::background::draw_layer(uint_ptr hdc, int idx, const background_layer& layer, document_container* container, background_layer_cache* cache) const
+{
+	layer_type type = get_layer_type(idx);
+	switch (type)
 	{
 		case background::type_color:
 			{
 				auto color_layer = get_color_layer(idx);
 				if(color_layer)
 				{
+					PAINT_PROFILE_DRAW(draw_solid_fill, layer.border_box);
 					container->draw_solid_fill(hdc, layer, color_layer->color);
 				}
 			}
-			break;
+			return;
 		case background::type_image:
 			if(layer.origin_box.width != 0 && layer.origin_box.height != 0)
 			{
 				auto image_layer = get_image_layer(idx);
 				if(image_layer)
 				{
+					PAINT_PROFILE_DRAW(draw_image, layer.border_box);
 					container->draw_image(hdc, layer, image_layer->url, image_layer->base_url);
 				}
 			}
+			return;
+		case background::type_linear_gradient:
+		case background::type_radial_gradient:
+		case background::type_conic_gradient:
 			break;
+		default:
+			return;
+	}
+
+	if(layer.origin_box.width == 0 || layer.origin_box.height == 0)
+	{
+		return;
+	}
+
+	const background_layer::gradient_base* gradient_layer = nullptr;
+	std::unique_ptr<background_layer::gradient_base> new_layer;
+	size_t fingerprint = 0;
+	if(cache)
+	{
+		fingerprint = gradient_fingerprint(m_image[idx].m_gradient);
+		gradient_layer = cache->find(this, idx, fingerprint, m_image[idx].m_gradient, layer.origin_box);
+	}
+	if(!gradient_layer)
+	{
+		switch (type)
+		{
+			case background::type_linear_gradient:
+				new_layer = get_linear_gradient_layer(idx, layer);
+				break;
+			case background::type_radial_gradient:
+				new_layer = get_radial_gradient_layer(idx, layer);
+				break;
+			default:
+				new_layer = get_conic_gradient_layer(idx, layer);
+				break;
+		}
+		if(!new_layer)
+		{
+			return;
+		}
+		if(cache)
+		{
+			gradient_layer = cache->store(this, idx, fingerprint, m_image[idx].m_gradient, layer.origin_box, std::move(new_layer));
+		} else
+		{
+			gradient_layer = new_layer.get();
+		}
+	}
+
+	switch (type)
+	{
 		case background::type_linear_gradient:
-			if(layer.origin_box.width != 0 && layer.origin_box.height != 0)
-			{
-				auto gradient_layer = get_linear_gradient_layer(idx, layer);
-				if(gradient_layer)
-				{
-					container->draw_linear_gradient(hdc, layer, *gradient_layer);
-				}
-			}
+			PAINT_PROFILE_DRAW(draw_linear_gradient, layer.border_box);
+			container->draw_linear_gradient(hdc, layer, static_cast<const background_layer::linear_gradient&>(*gradient_layer));
 			break;
 		case background::type_radial_gradient:
-			if(layer.origin_box.width != 0 && layer.origin_box.height != 0)
-			{
-				auto gradient_layer = get_radial_gradient_layer(idx, layer);
-				if(gradient_layer)
-				{
-					container->draw_radial_gradient(hdc, layer, *gradient_layer);
-				}
-			}
-			break;
-		case background::type_conic_gradient:
-			if(layer.origin_box.width != 0 && layer.origin_box.height != 0)
-			{
-				auto gradient_layer = get_conic_gradient_layer(idx, layer);
-				if(gradient_layer)
-				{
-					container->draw_conic_gradient(hdc, layer, *gradient_layer);
-				}
-			}
+			PAINT_PROFILE_DRAW(draw_radial_gradient, layer.border_box);
+			container->draw_radial_gradient(hdc, layer, static_cast<const background_layer::radial_gradient&>(*gradient_layer));
 			break;
 		default:
+			PAINT_PROFILE_DRAW(draw_conic_gradient, layer.border_box);
+			container->draw_conic_gradient(hdc, layer, static_cast<const background_layer::conic_gradient&>(*gradient_layer));
 			break;
 	}
 }
 
+const litehtml::background_layer::gradient_base* litehtml::background_layer_cache::find(const background* bg, int idx, size_t fingerprint, const gradient& grad, const position& origin_box)
+{
+	for(auto& item : m_entries)
+	{
+		if(item.bg == bg && item.idx == idx && item.fingerprint == fingerprint &&
+			item.origin_box.width == origin_box.width && item.origin_box.height == origin_box.height &&
+			same_gradient(item.grad, grad))
+		{
+			// The offset is taken from the resolved position every time, so moves don't add up rounding errors
+			item.layer->set_offset((float) (origin_box.x - item.origin_box.x), (float) (origin_box.y - item.origin_box.y));
+			return item.layer.get();
+		}
+	}
+	return nullptr;
+}
+
+const litehtml::background_layer::gradient_base* litehtml::background_layer_cache::store(const background* bg, int idx, size_t fingerprint, const gradient& grad, const position& origin_box,
+																						   std::unique_ptr<background_layer::gradient_base> layer)
+{
+	// Reuse the slot of the same layer if its gradient was changed
+	entry* item = nullptr;
+	for(auto& e : m_entries)
+	{
+		if(e.bg == bg && e.idx == idx && (e.fingerprint != fingerprint || !same_gradient(e.grad, grad)))
+		{
+			item = &e;
+			break;
+		}
+	}
+	if(!item)
+	{
+		if(m_entries.size() < MaxEntries)
+		{
+			m_entries.emplace_back();
+			item = &m_entries.back();
+		} else
+		{
+			item = &m_entries[m_next];
+			m_next = (m_next + 1) % MaxEntries;
+		}
+	}
+	item->bg = bg;
+	item->idx = idx;
+	item->fingerprint = fingerprint;
+	item->grad = grad;
+	item->origin_box = origin_box;
+	item->layer = std::move(layer);
+	return item->layer.get();
+}
+
 static void repeat_color_points(std::vector<litehtml::background_layer::color_point>& color_points)
 {
 	auto old_points = color_points;
@@ -913,4 +1077,65 @@ bool litehtml::background_layer::gradient_base::prepare_color_points(float line_
 	return true;
 }
 
+const std::vector<uint32_t>& litehtml::background_layer::gradient_base::get_color_lut(int lut_size) const
+{
+	if(lut_size < 2) lut_size = 2;
+	if((int) m_lut.size() == lut_size || color_points.empty())
+	{
+		return m_lut;
+	}
+	m_lut.resize(lut_size);
+
+	size_t seg = 0;
+	for(int i = 0; i < lut_size; i++)
+	{
+		float t = (float) i / (float) (lut_size - 1);
+		while(seg + 1 < color_points.size() && color_points[seg + 1].offset < t)
+		{
+			seg++;
+		}
+
+		float r, g, b, a;
+		const color_point& c1 = color_points[seg];
+		if(t <= c1.offset || seg + 1 >= color_points.size())
+		{
+			a = c1.color.alpha;
+			r = c1.color.red * a / 255.0f;
+			g = c1.color.green * a / 255.0f;
+			b = c1.color.blue * a / 255.0f;
+		} else
+		{
+			const color_point& c2 = color_points[seg + 1];
+			float len = c2.offset - c1.offset;
+			float p = len > 0 ? (t - c1.offset) / len : 1.0f;
+			// https://drafts.csswg.org/css-images-4/#coloring-gradient-line
+			if(c1.hint && len > 0)
+			{
+				float h = (*c1.hint - c1.offset) / len;
+				if(h <= 0)
+				{
+					p = 1;
+				} else if(h >= 1)
+				{
+					p = 0;
+				} else
+				{
+					p = std::pow(p, std::log(0.5f) / std::log(h));
+				}
+			}
+			// Interpolate in premultiplied space
+			float a1 = c1.color.alpha;
+			float a2 = c2.color.alpha;
+			a = a1 + (a2 - a1) * p;
+			r = (c1.color.red * a1 + (c2.color.red * a2 - c1.color.red * a1) * p) / 255.0f;
+			g = (c1.color.green * a1 + (c2.color.green * a2 - c1.color.green * a1) * p) / 255.0f;
+			b = (c1.color.blue * a1 + (c2.color.blue * a2 - c1.color.blue * a1) * p) / 255.0f;
+		}
+		// Bytes in memory order, whatever the endianness
+		const uint8_t pixel[4] = { (uint8_t) std::lround(r), (uint8_t) std::lround(g), (uint8_t) std::lround(b), (uint8_t) std::lround(a) };
+		memcpy(&m_lut[i], pixel, sizeof(pixel));
+	}
+	return m_lut;
+}
+
 } // namespace litehtml
\ No newline at end of file
@@ -0,0 +1,860 @@
+#include "html.h"
+#include "stylesheet.h"
+#include "css_calc.h"
+#include "encodings.h"
+#include <cstring>
+#include <unordered_map>
+
+namespace litehtml
+{
+
+// Binary format of compiled_css:
+//
+//   header:   "LHCS", format version, library fingerprint, size of the whole data
+//   strings:  names of all string_ids used below, resolved with _id once on load
+//   media:    media lists referenced by selectors
+//   styles:   declaration blocks, properties in the sorted order of props_map
+//   rules:    selectors in sorted order with their indexes of media lists and styles
+//   keyframes
+//
+// Unsigned integers are LEB128 varints, signed ones are zigzag encoded, floats are 4 bytes
+// little-endian. Data has no alignment requirements, so it can be read directly from a
+// memory-mapped file. Keyword values are stored as enum values, so the data is valid only for
+// the library version that wrote it: the fingerprint covers the format version and the list
+// of predefined string ids and keywords.
+class css_binary
+{
+	static constexpr char		Magic[4] = {'L', 'H', 'C', 'S'};
+	static constexpr uint32_t	Version = 1;
+	static constexpr int		MaxDepth = 256; // nesting of selectors, media conditions and tokens
+
+	// writing
+	string										m_out;
+	std::unordered_map<string_id, uint32_t>		m_string_index;
+	std::vector<string_id>						m_strings;
+
+	// reading
+	const byte*					m_pos = nullptr;
+	const byte*					m_end = nullptr;
+	bool						m_ok = true;
+	int							m_depth = 0;
+	size_t						m_items_left = 0;	// limits allocations for damaged data
+	std::vector<string_id>		m_ids;
+
+	static uint32_t fingerprint();
+
+public:
+	static string			write(const compiled_css& css);
+	static compiled_css::ptr read(const void* data, size_t size);
+
+private:
+	void	write_uint(uint64_t val);
+	void	write_int(int64_t val)			{ write_uint(((uint64_t) val << 1) ^ (uint64_t) (val >> 63)); }
+	void	write_bool(bool val)			{ m_out += char(val ? 1 : 0); }
+	void	write_fixed(uint32_t val);
+	void	write_float(float val);
+	void	write_string(const string& str);
+	void	write_id(string_id id);
+
+	void	write_token(const css_token& token);
+	void	write_tokens(const css_token_vector& tokens);
+	void	write_length(const css_length& len);
+	void	write_color(const web_color& color);
+	void	write_image(const image& img);
+	void	write_value(const property_value& val);
+	void	write_media_condition(const media_condition& cond);
+	void	write_media_lists(const media_query_list_list& lists);
+	void	write_selector(const css_selector& sel, const std::unordered_map<const media_query_list_list*, size_t>& media, const std::unordered_map<const style*, size_t>& styles);
+
+	bool	fail()							{ m_ok = false; m_pos = m_end; return false; }
+	uint64_t read_uint();
+	int64_t	read_int()						{ uint64_t val = read_uint(); return (int64_t) (val >> 1) ^ -(int64_t) (val & 1); }
+	bool	read_bool()						{ return read_uint() != 0; }
+	uint32_t read_fixed();
+	float	read_float();
+	string	read_string();
+	string_id read_id();
+	size_t	read_count();
+
+	css_token			read_token();
+	css_token_vector	read_tokens();
+	css_length			read_length();
+	web_color			read_color();
+	image				read_image();
+	property_value		read_value();
+	media_condition		read_media_condition();
+	media_query_list_list::ptr read_media_lists();
+	css_selector::ptr	read_selector(const media_query_list_list::vector& media, const style::vector& styles);
+};
+
+template<class... Types> constexpr size_t alternatives(const std::variant<Types...>*) { return sizeof...(Types); }
+
+uint32_t css_binary::fingerprint()
+{
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	auto add = [&hash](const char* str) {
+		for (; *str; str++) hash = (hash ^ (byte) *str) * 16777619u;
+	};
+	add(initial_string_ids);
+	add(css_units_strings);
+	add(media_type_strings);
+	add(color_space_strings);
+	add(radial_extent_strings);
+	return hash ^ Version;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Writing
+
+void css_binary::write_uint(uint64_t val)
+{
+	while (val >= 0x80)
+	{
+		m_out += char((val & 0x7F) | 0x80);
+		val >>= 7;
+	}
+	m_out += char(val);
+}
+
+void css_binary::write_fixed(uint32_t val)
+{
+	for (int i = 0; i < 4; i++)
+		m_out += char((val >> (i * 8)) & 0xFF);
+}
+
+void css_binary::write_float(float val)
+{
+	uint32_t bits;
+	memcpy(&bits, &val, 4);
+	write_fixed(bits);
+}
+
+void css_binary::write_string(const string& str)
+{
+	write_uint(str.size());
+	m_out += str;
+}
+
+void css_binary::write_id(string_id id)
+{
+	auto ret = m_string_index.emplace(id, (uint32_t) m_strings.size());
+	if (ret.second) m_strings.push_back(id);
+	write_uint(ret.first->second);
+}
+
+void css_binary::write_token(const css_token& token)
+{
+	write_int(token.type);
+	write_string(token.str);
+	write_string(token.repr);
+	switch (token.type)
+	{
+	case HASH:
+		write_uint(token.hash_type);
+		break;
+	case NUMBER:
+	case PERCENTAGE:
+	case DIMENSION:
+		write_float(token.n.number);
+		write_uint(token.n.number_type);
+		break;
+	case CV_FUNCTION:
+	case CURLY_BLOCK:
+	case ROUND_BLOCK:
+	case SQUARE_BLOCK:
+		write_tokens(token.value);
+		break;
+	default:;
+	}
+}
+
+void css_binary::write_tokens(const css_token_vector& tokens)
+{
+	write_uint(tokens.size());
+	for (const auto& token : tokens)
+		write_token(token);
+}
+
+void css_binary::write_length(const css_length& len)
+{
+	// calc() expressions are stored as their text and parsed again on load
+	bool calc = len.is_calc() && len.get_calc();
+	write_uint((len.is_predefined() ? 1 : 0) | (calc ? 2 : 0));
+	write_uint(len.units());
+	if (calc)
+		write_string(len.get_calc()->to_string());
+	else if (len.is_predefined())
+		write_int(len.predef());
+	else
+		write_float(len.val());
+}
+
+void css_binary::write_color(const web_color& color)
+{
+	m_out += char(color.red);
+	m_out += char(color.green);
+	m_out += char(color.blue);
+	m_out += char(color.alpha);
+	write_bool(color.is_current_color);
+}
+
+void css_binary::write_image(const image& img)
+{
+	write_uint(img.type);
+	write_string(img.url);
+
+	const gradient& grad = img.m_gradient;
+	write_id(grad.m_type);
+	write_uint(grad.m_side);
+	write_float(grad.angle);
+	write_uint(grad.m_colors.size());
+	for (const auto& stop : grad.m_colors)
+	{
+		write_bool(stop.is_color_hint);
+		write_color(stop.color);
+		write_bool(stop.length.has_value());
+		if (stop.length) write_length(*stop.length);
+		write_bool(stop.angle.has_value());
+		if (stop.angle) write_float(*stop.angle);
+	}
+	write_length(grad.position_x);
+	write_length(grad.position_y);
+	write_uint(grad.radial_shape);
+	write_uint(grad.radial_extent);
+	write_length(grad.radial_radius_x);
+	write_length(grad.radial_radius_y);
+	write_float(grad.conic_from_angle);
+	write_uint(grad.color_space);
+	write_uint(grad.hue_interpolation);
+}
+
+void css_binary::write_value(const property_value& val)
+{
+	write_uint(val.index());
+	write_bool(val.m_important);
+	write_bool(val.m_has_var);
+	switch (val.index())
+	{
+	case 2: write_int(val.get<int>()); break;
+	case 3:
+		write_uint(val.get<int_vector>().size());
+		for (int i : val.get<int_vector>()) write_int(i);
+		break;
+	case 4: write_length(val.get<css_length>()); break;
+	case 5:
+		write_uint(val.get<length_vector>().size());
+		for (const auto& len : val.get<length_vector>()) write_length(len);
+		break;
+	case 6: write_float(val.get<float>()); break;
+	case 7: write_color(val.get<web_color>()); break;
+	case 8:
+		write_uint(val.get<vector<image>>().size());
+		for (const auto& img : val.get<vector<image>>()) write_image(img);
+		break;
+	case 9: write_string(val.get<string>()); break;
+	case 10:
+		write_uint(val.get<string_vector>().size());
+		for (const auto& str : val.get<string_vector>()) write_string(str);
+		break;
+	case 11:
+		write_uint(val.get<size_vector>().size());
+		for (const auto& size : val.get<size_vector>())
+		{
+			write_length(size.width);
+			write_length(size.height);
+		}
+		break;
+	case 12: write_tokens(val.get<css_token_vector>()); break;
+	default:; // invalid, inherit
+	}
+	static_assert(alternatives((property_value*) nullptr) == 13, "update css_binary::write_value and read_value");
+}
+
+void css_binary::write_media_condition(const media_condition& cond)
+{
+	write_id(cond.op);
+	write_uint(cond.m_conditions.size());
+	for (const auto& item : cond.m_conditions)
+	{
+		write_uint(item.index());
+		if (item.is<media_condition>())
+		{
+			write_media_condition(item.get<media_condition>());
+		} else if (item.is<media_feature>())
+		{
+			const auto& feature = item.get<media_feature>();
+			write_string(feature.name);
+			write_float(feature.value);
+			write_float(feature.value2);
+			write_int(feature.op);
+			write_int(feature.op2);
+		}
+	}
+}
+
+void css_binary::write_media_lists(const media_query_list_list& lists)
+{
+	write_uint(lists.m_media_query_lists.size());
+	for (const auto& list : lists.m_media_query_lists)
+	{
+		write_uint(list.m_queries.size());
+		for (const auto& query : list.m_queries)
+		{
+			write_bool(query.m_not);
+			write_uint(query.m_media_type);
+			write_uint(query.m_conditions.size());
+			for (const auto& cond : query.m_conditions)
+				write_media_condition(cond);
+		}
+	}
+}
+
+void css_binary::write_selector(const css_selector& sel, const std::unordered_map<const media_query_list_list*, size_t>& media, const std::unordered_map<const style*, size_t>& styles)
+{
+	write_int(sel.m_specificity.a);
+	write_int(sel.m_specificity.b);
+	write_int(sel.m_specificity.c);
+	write_int(sel.m_specificity.d);
+	write_int(sel.m_order);
+	write_uint(sel.m_combinator);
+	// indexes are stored + 1, 0 means none
+	write_uint(sel.m_media_query ? media.at(sel.m_media_query.get()) + 1 : 0);
+	write_uint(sel.m_style ? styles.at(sel.m_style.get()) + 1 : 0);
+
+	write_id(sel.m_right.m_prefix);
+	write_id(sel.m_right.m_tag);
+	write_uint(sel.m_right.m_attrs.size());
+	for (const auto& attr : sel.m_right.m_attrs)
+	{
+		write_uint(attr.type);
+		write_id(attr.prefix);
+		write_id(attr.name);
+		write_string(attr.value);
+		write_uint((byte) attr.matcher);
+		write_bool(attr.caseless_match);
+		write_int(attr.a);
+		write_int(attr.b);
+		write_uint(attr.selector_list.size());
+		for (const auto& item : attr.selector_list)
+			write_selector(*item, media, styles);
+	}
+
+	write_bool(sel.m_left != nullptr);
+	if (sel.m_left)
+		write_selector(*sel.m_left, media, styles);
+}
+
+string css_binary::write(const compiled_css& css)
+{
+	css_binary out;
+
+	// Media lists and styles are shared by selectors, they are stored once and referenced by index
+	media_query_list_list::vector media_lists = css.m_media_lists;
+	std::unordered_map<const media_query_list_list*, size_t> media_index;
+	for (size_t i = 0; i < media_lists.size(); i++)
+		media_index.emplace(media_lists[i].get(), i);
+
+	style::vector styles;
+	std::unordered_map<const style*, size_t> style_index;
+	for (const auto& sel : css.m_css.m_selectors)
+	{
+		if (sel->m_media_query && media_index.emplace(sel->m_media_query.get(), media_lists.size()).second)
+			media_lists.push_back(sel->m_media_query);
+		if (sel->m_style && style_index.emplace(sel->m_style.get(), styles.size()).second)
+			styles.push_back(sel->m_style);
+	}
+
+	out.write_uint(media_lists.size());
+	for (const auto& list : media_lists)
+		out.write_media_lists(*list);
+
+	out.write_uint(styles.size());
+	for (const auto& st : styles)
+	{
+		out.write_uint(st->m_properties.size());
+		for (const auto& prop : st->m_properties)
+		{
+			out.write_id(prop.first);
+			out.write_value(prop.second);
+		}
+	}
+
+	out.write_uint(css.m_css.m_selectors.size());
+	for (const auto& sel : css.m_css.m_selectors)
+		out.write_selector(*sel, media_index, style_index);
+
+	out.write_uint(css.m_keyframes.size());
+	for (const auto& kf : css.m_keyframes)
+	{
+		out.write_string(kf.first);
+		out.write_string(kf.second.name);
+		out.write_uint(kf.second.keyframes.size());
+		for (const auto& frame : kf.second.keyframes)
+		{
+			out.write_float(frame.offset);
+			out.write_uint(frame.timing);
+			out.write_uint(frame.properties.size());
+			for (const auto& prop : frame.properties)
+			{
+				out.write_string(prop.first);
+				out.write_string(prop.second);
+			}
+		}
+	}
+
+	// The string table goes before the body so that ids are resolved before they are referenced
+	string body;
+	body.swap(out.m_out);
+	out.write_uint(out.m_strings.size());
+	for (auto id : out.m_strings)
+		out.write_string(_s(id));
+	out.m_out += body;
+
+	string strings_and_body;
+	strings_and_body.swap(out.m_out);
+	out.m_out.reserve(sizeof(Magic) + 12 + strings_and_body.size());
+	out.m_out.append(Magic, sizeof(Magic));
+	out.write_fixed(Version);
+	out.write_fixed(fingerprint());
+	out.write_fixed((uint32_t) (sizeof(Magic) + 12 + strings_and_body.size()));
+	out.m_out += strings_and_body;
+	return std::move(out.m_out);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Reading
+
+uint64_t css_binary::read_uint()
+{
+	uint64_t val = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		if (m_pos == m_end) break;
+		byte b = *m_pos++;
+		val |= uint64_t(b & 0x7F) << shift;
+		if (!(b & 0x80)) return val;
+	}
+	fail();
+	return 0;
+}
+
+uint32_t css_binary::read_fixed()
+{
+	if (m_end - m_pos < 4)
+	{
+		fail();
+		return 0;
+	}
+	uint32_t val = m_pos[0] | (m_pos[1] << 8) | (m_pos[2] << 16) | ((uint32_t) m_pos[3] << 24);
+	m_pos += 4;
+	return val;
+}
+
+float css_binary::read_float()
+{
+	uint32_t bits = read_fixed();
+	float val;
+	memcpy(&val, &bits, 4);
+	return val;
+}
+
+string css_binary::read_string()
+{
+	uint64_t len = read_uint();
+	if (len > (uint64_t) (m_end - m_pos))
+	{
+		fail();
+		return "";
+	}
+	string ret((const char*) m_pos, (size_t) len);
+	m_pos += len;
+	return ret;
+}
+
+string_id css_binary::read_id()
+{
+	uint64_t index = read_uint();
+	if (index >= m_ids.size())
+	{
+		fail();
+		return empty_id;
+	}
+	return m_ids[index];
+}
+
+// Number of items that follow. Every item, nested ones included, takes at least one byte
+// of its own, so the total number of items is never greater than the size of the data.
+size_t css_binary::read_count()
+{
+	uint64_t count = read_uint();
+	if (count > (uint64_t) (m_end - m_pos) || count > m_items_left)
+	{
+		fail();
+		return 0;
+	}
+	m_items_left -= (size_t) count;
+	return (size_t) count;
+}
+
+css_token css_binary::read_token()
+{
+	auto type = (css_token_type) read_int();
+	// component values own a vector, only the known ones are copied and destroyed correctly
+	if (type <= CV_FUNCTION && !is_one_of(type, CV_FUNCTION, CURLY_BLOCK, ROUND_BLOCK, SQUARE_BLOCK))
+	{
+		fail();
+		type = WHITESPACE;
+	}
+	string str = read_string();
+	css_token token(type, std::move(str));
+	token.repr = read_string();
+	switch (type)
+	{
+	case HASH:
+		token.hash_type = (css_hash_type) read_uint();
+		break;
+	case NUMBER:
+	case PERCENTAGE:
+	case DIMENSION:
+		token.n.number = read_float();
+		token.n.number_type = (css_number_type) read_uint();
+		break;
+	case CV_FUNCTION:
+	case CURLY_BLOCK:
+	case ROUND_BLOCK:
+	case SQUARE_BLOCK:
+		token.value = read_tokens();
+		break;
+	default:;
+	}
+	return token;
+}
+
+css_token_vector css_binary::read_tokens()
+{
+	css_token_vector tokens;
+	if (++m_depth > MaxDepth) fail();
+	size_t count = read_count();
+	tokens.reserve(count);
+	for (size_t i = 0; i < count && m_ok; i++)
+		tokens.push_back(read_token());
+	m_depth--;
+	return tokens;
+}
+
+css_length css_binary::read_length()
+{
+	uint64_t flags = read_uint();
+	auto units = (css_units) read_uint();
+	css_length len;
+	if (flags & 2)
+	{
+		// the tokenizer expects valid UTF-8 without NULs
+		string text = read_string();
+		auto calc = std::make_shared<css_calc_expression>();
+		if (!is_valid_utf8(text) || text.find('\0') != string::npos || !calc->parse_string(text)) fail();
+		len.set_value(0, css_units_none);
+		len.set_calc(calc);
+	} else if (flags & 1)
+	{
+		len.set_value(0, units);
+		len.predef((int) read_int());
+	} else
+	{
+		float val = read_float();
+		len.set_value(val, units);
+	}
+	return len;
+}
+
+web_color css_binary::read_color()
+{
+	if (m_end - m_pos < 4)
+	{
+		fail();
+		return {};
+	}
+	web_color color(m_pos[0], m_pos[1], m_pos[2], m_pos[3]);
+	m_pos += 4;
+	color.is_current_color = read_bool();
+	return color;
+}
+
+image css_binary::read_image()
+{
+	image img;
+	img.type = (decltype(img.type)) read_uint();
+	img.url = read_string();
+
+	gradient& grad = img.m_gradient;
+	grad.m_type = read_id();
+	grad.m_side = (uint32_t) read_uint();
+	grad.angle = read_float();
+	size_t count = read_count();
+	grad.m_colors.reserve(count);
+	for (size_t i = 0; i < count && m_ok; i++)
+	{
+		gradient::color_stop stop;
+		stop.is_color_hint = read_bool();
+		stop.color = read_color();
+		if (read_bool()) stop.length = read_length();
+		if (read_bool()) stop.angle = read_float();
+		grad.m_colors.push_back(stop);
+	}
+	grad.position_x = read_length();
+	grad.position_y = read_length();
+	grad.radial_shape = (radial_shape_t) read_uint();
+	grad.radial_extent = (radial_extent_t) read_uint();
+	grad.radial_radius_x = read_length();
+	grad.radial_radius_y = read_length();
+	grad.conic_from_angle = read_float();
+	grad.color_space = (color_space_t) read_uint();
+	grad.hue_interpolation = (hue_interpolation_t) read_uint();
+	return img;
+}
+
+property_value css_binary::read_value()
+{
+	uint64_t index = read_uint();
+	bool important = read_bool();
+	bool has_var = read_bool();
+	auto make = [&](auto&& val) { return property_value(val, important, has_var); };
+
+	switch (index)
+	{
+	case 1: return make(inherit());
+	case 2: return make((int) read_int());
+	case 3:
+	{
+		int_vector vec(read_count());
+		for (auto& i : vec) i = (int) read_int();
+		return make(vec);
+	}
+	case 4: return make(read_length());
+	case 5:
+	{
+		length_vector vec(read_count());
+		for (auto& len : vec) len = read_length();
+		return make(vec);
+	}
+	case 6: return make(read_float());
+	case 7: return make(read_color());
+	case 8:
+	{
+		vector<image> vec(read_count());
+		for (auto& img : vec) img = read_image();
+		return make(vec);
+	}
+	case 9: return make(read_string());
+	case 10:
+	{
+		string_vector vec(read_count());
+		for (auto& str : vec) str = read_string();
+		return make(vec);
+	}
+	case 11:
+	{
+		size_vector vec(read_count());
+		for (auto& size : vec)
+		{
+			size.width = read_length();
+			size.height = read_length();
+		}
+		return make(vec);
+	}
+	case 12: return make(read_tokens());
+	default:
+		fail();
+		return {};
+	}
+}
+
+media_condition css_binary::read_media_condition()
+{
+	media_condition cond;
+	if (++m_depth > MaxDepth) fail();
+	cond.op = read_id();
+	size_t count = read_count();
+	cond.m_conditions.reserve(count);
+	for (size_t i = 0; i < count && m_ok; i++)
+	{
+		switch (read_uint())
+		{
+		case 0:
+			cond.m_conditions.emplace_back(read_media_condition());
+			break;
+		case 1:
+		{
+			media_feature feature;
+			feature.name = read_string();
+			feature.value = read_float();
+			feature.value2 = read_float();
+			feature.op = (short) read_int();
+			feature.op2 = (short) read_int();
+			cond.m_conditions.emplace_back(feature);
+			break;
+		}
+		case 2:
+			cond.m_conditions.emplace_back(unknown());
+			break;
+		default:
+			fail();
+		}
+	}
+	m_depth--;
+	return cond;
+}
+
+media_query_list_list::ptr css_binary::read_media_lists()
+{
+	auto ret = make_shared<media_query_list_list>();
+	size_t count = read_count();
+	ret->m_media_query_lists.resize(count);
+	for (auto& list : ret->m_media_query_lists)
+	{
+		list.m_queries.resize(read_count());
+		for (auto& query : list.m_queries)
+		{
+			query.m_not = read_bool();
+			query.m_media_type = (media_type) read_uint();
+			size_t conditions = read_count();
+			for (size_t i = 0; i < conditions && m_ok; i++)
+				query.m_conditions.push_back(read_media_condition());
+		}
+		ret->add_dependencies(list);
+	}
+	return ret;
+}
+
+css_selector::ptr css_binary::read_selector(const media_query_list_list::vector& media, const style::vector& styles)
+{
+	auto sel = make_shared<css_selector>();
+	if (++m_depth > MaxDepth) fail();
+
+	sel->m_specificity.a = (int) read_int();
+	sel->m_specificity.b = (int) read_int();
+	sel->m_specificity.c = (int) read_int();
+	sel->m_specificity.d = (int) read_int();
+	sel->m_order = (int) read_int();
+	sel->m_combinator = (css_combinator) read_uint();
+	uint64_t media_index = read_uint();
+	uint64_t style_index = read_uint();
+	if (media_index > media.size() || style_index > styles.size()) fail();
+	else
+	{
+		if (media_index) sel->m_media_query = media[media_index - 1];
+		if (style_index) sel->m_style = styles[style_index - 1];
+	}
+
+	sel->m_right.m_prefix = read_id();
+	sel->m_right.m_tag = read_id();
+	sel->m_right.m_attrs.resize(read_count());
+	for (auto& attr : sel->m_right.m_attrs)
+	{
+		attr.type = (attr_select_type) read_uint();
+		attr.prefix = read_id();
+		attr.name = read_id();
+		attr.value = read_string();
+		attr.matcher = (attr_matcher) read_uint();
+		attr.caseless_match = read_bool();
+		attr.a = (int) read_int();
+		attr.b = (int) read_int();
+		size_t count = read_count();
+		for (size_t i = 0; i < count && m_ok; i++)
+			attr.selector_list.push_back(read_selector(media, styles));
+	}
+
+	if (read_bool() && m_ok)
+		sel->m_left = read_selector(media, styles);
+
+	m_depth--;
+	return sel;
+}
+
+compiled_css::ptr css_binary::read(const void* data, size_t size)
+{
+	css_binary in;
+	in.m_pos = (const byte*) data;
+	in.m_end = in.m_pos + size;
+	in.m_items_left = size;
+
+	if (size < sizeof(Magic) + 12 || memcmp(data, Magic, sizeof(Magic)) != 0)
+		return nullptr;
+	in.m_pos += sizeof(Magic);
+	uint32_t version = in.read_fixed();
+	uint32_t hash = in.read_fixed();
+	uint32_t total_size = in.read_fixed();
+	if (version != Version || hash != fingerprint() || total_size != size)
+		return nullptr;
+
+	size_t count = in.read_count();
+	in.m_ids.reserve(count);
+	for (size_t i = 0; i < count && in.m_ok; i++)
+		in.m_ids.push_back(_id(in.read_string()));
+
+	auto ret = make_shared<compiled_css>();
+
+	media_query_list_list::vector media(in.read_count());
+	for (auto& list : media)
+		list = in.read_media_lists();
+
+	style::vector styles(in.read_count());
+	for (auto& st : styles)
+	{
+		st = make_shared<style>();
+		size_t props = in.read_count();
+		st->m_properties.reserve(props);
+		for (size_t i = 0; i < props && in.m_ok; i++)
+		{
+			string_id name = in.read_id();
+			st->m_properties.set(name, in.read_value());
+		}
+	}
+
+	auto& selectors = ret->m_css.m_selectors;
+	selectors.resize(in.read_count());
+	for (auto& sel : selectors)
+		sel = in.read_selector(media, styles);
+
+	count = in.read_count();
+	for (size_t i = 0; i < count && in.m_ok; i++)
+	{
+		string key = in.read_string();
+		keyframes_rule& rule = ret->m_keyframes[key];
+		rule.name = in.read_string();
+		rule.keyframes.resize(in.read_count());
+		for (auto& frame : rule.keyframes)
+		{
+			frame.offset = in.read_float();
+			frame.timing = (transition_timing_function) in.read_uint();
+			size_t props = in.read_count();
+			for (size_t j = 0; j < props && in.m_ok; j++)
+			{
+				string name = in.read_string();
+				frame.properties[name] = in.read_string();
+			}
+		}
+	}
+
+	if (!in.m_ok || in.m_pos != in.m_end)
+		return nullptr;
+
+	ret->m_media_lists = std::move(media);
+	ret->m_css.build_index();
+	return ret;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+string compiled_css::serialize() const
+{
+	return css_binary::write(*this);
+}
+
+compiled_css::ptr compiled_css::load(const void* data, size_t size)
+{
+	return css_binary::read(data, size);
+}
+
+} // namespace litehtml
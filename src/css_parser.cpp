@@ -1,6 +1,7 @@
 #include "encodings.h"
 #include "html.h"
 #include "css_parser.h"
+#include <cassert>
 
 namespace litehtml
 {
@@ -40,6 +41,7 @@ void filter_code_points(string& input)
 }
 
 static const size_t kLargeSize = 50;
+static const css_token no_token;
 static void remove_whitespace_large(css_token_vector& tokens, keep_whitespace_fn keep_whitespace);
 static void remove_whitespace_small(css_token_vector& tokens, keep_whitespace_fn keep_whitespace);
 
@@ -53,7 +55,7 @@ void remove_whitespace_large(css_token_vector& tokens, keep_whitespace_fn keep_w
 		bool keep = true;
 		if (tok.type == ' ')
 		{
-			const auto &left = i > 0 ? tokens[i - 1] : css_token();
+			const auto &left = i > 0 ? tokens[i - 1] : no_token;
 			const auto &right = at(tokens, i + 1);
 			keep = keep_whitespace && keep_whitespace(left, right);
 		}
@@ -75,23 +77,25 @@ void remove_whitespace_large(css_token_vector& tokens, keep_whitespace_fn keep_w
 		css_token_vector tmp;
 		tmp.reserve(keep_idx.size());
 		for (auto idx : keep_idx)
-			tmp.push_back(tokens[idx]);
+			tmp.push_back(std::move(tokens[idx]));
 		tokens.swap(tmp);
 	}
 }
 
+// Compacts tokens in place, left neighbour of a whitespace is the last kept token
 void remove_whitespace_small(css_token_vector& tokens, keep_whitespace_fn keep_whitespace)
 {
+	int count = 0;
 	for (int i = 0; i < (int)tokens.size(); i++)
 	{
 		auto& tok = tokens[i];
 		if (tok.type == ' ')
 		{
-			const auto& left = i > 0 ? tokens[i - 1] : css_token();
+			const auto& left = count > 0 ? tokens[count - 1] : no_token;
 			const auto& right = at(tokens, i + 1);
 			bool keep = keep_whitespace && keep_whitespace(left, right);
 			if (!keep)
-				remove(tokens, i), i--;
+				continue;
 		}
 		else if (tok.is_component_value())
 		{
@@ -100,7 +104,11 @@ void remove_whitespace_small(css_token_vector& tokens, keep_whitespace_fn keep_w
 			else
 				remove_whitespace_small(tok.value, keep_whitespace);
 		}
+		if (count != i)
+			tokens[count] = std::move(tok);
+		count++;
 	}
+	tokens.erase(tokens.begin() + count, tokens.end());
 }
 
 void remove_whitespace(css_token_vector& tokens, keep_whitespace_fn keep_whitespace)
@@ -113,15 +121,15 @@ void remove_whitespace(css_token_vector& tokens, keep_whitespace_fn keep_whitesp
 
 void componentize(css_token_vector& tokens)
 {
-	css_parser parser(tokens);
+	css_parser parser(std::move(tokens));
 	css_token_vector result;
 	while (true)
 	{
 		css_token tok = parser.consume_component_value();
 		if (tok.type == EOF) break;
-		result.push_back(tok);
+		result.push_back(std::move(tok));
 	}
-	tokens = result;
+	tokens = std::move(result);
 }
 
 // https://www.w3.org/TR/css-syntax-3/#normalize-into-a-token-stream
@@ -137,7 +145,7 @@ css_token_vector normalize(string input, int options, keep_whitespace_fn keep_wh
 {
 	filter_code_points(input);
 	auto tokens = tokenize(input);
-	return normalize(tokens, options, keep_whitespace);
+	return normalize(std::move(tokens), options, keep_whitespace);
 }
 
 // https://www.w3.org/TR/css-syntax-3/#parse-stylesheet
@@ -147,12 +155,12 @@ raw_rule::vector css_parser::parse_stylesheet(const string& input, bool top_leve
 {
 	// 1. If input is a byte stream for stylesheet, decode bytes from input, and set input to the result.
 	// not implemented, utf-8 is always assumed
-	string str = decode(input, encoding::utf_8); // decoding potentially broken UTF-8 into valid UTF-8
+	// decoding potentially broken UTF-8 into valid UTF-8, valid input is only copied
 
 	// 2. Normalize input, and set input to the result.
-	auto tokens = normalize(str);
+	auto tokens = normalize(decode(input, encoding::utf_8));
 
-	return parse_stylesheet(tokens, top_level);
+	return css_parser(std::move(tokens)).consume_list_of_rules(top_level);
 }
 raw_rule::vector css_parser::parse_stylesheet(const css_token_vector& input, bool top_level)
 {
@@ -162,23 +170,44 @@ raw_rule::vector css_parser::parse_stylesheet(const css_token_vector& input, boo
 	return css_parser(input).consume_list_of_rules(top_level);
 }
 
+static const css_token eof_token(css_token_type(EOF));
+
 // https://www.w3.org/TR/css-syntax-3/#consume-the-next-input-token
-css_token css_parser::next_token()
+const css_token& css_parser::next_token()
 {
 	if (m_index == (int)m_tokens.size())
-		return css_token_type(EOF);
+		return eof_token;
 	else
 		return m_tokens[m_index++];
 }
 
-css_token css_parser::peek_token()
+const css_token& css_parser::peek_token()
 {
 	if (m_index == (int)m_tokens.size())
-		return css_token_type(EOF);
+		return eof_token;
 	else
 		return m_tokens[m_index];
 }
 
+// Moves the current input token (the result of the last next_token) out of the parser.
+// It must not be reconsumed after that.
+css_token css_parser::take_token(const css_token& token)
+{
+	if (&token == &eof_token) return eof_token;
+	assert(&token == &m_tokens[m_index - 1]);
+	return std::move(m_tokens[m_index - 1]);
+}
+
+// Component values of blocks and functions are collected on m_values, so that each block
+// gets a vector of the exact size instead of growing its own one value at a time.
+// Returns the values collected since start.
+css_token_vector css_parser::pop_values(size_t start)
+{
+	css_token_vector values(std::make_move_iterator(m_values.begin() + start), std::make_move_iterator(m_values.end()));
+	m_values.erase(m_values.begin() + start, m_values.end());
+	return values;
+}
+
 // https://www.w3.org/TR/css-syntax-3/#consume-list-of-rules
 raw_rule::vector css_parser::consume_list_of_rules(bool top_level)
 {
@@ -188,7 +217,7 @@ raw_rule::vector css_parser::consume_list_of_rules(bool top_level)
 	while (true)
 	{
 		// Repeatedly consume the next input token:
-		css_token token = next_token();
+		const css_token& token = next_token();
 
 		switch (token.type)
 		{
@@ -236,7 +265,7 @@ raw_rule::ptr css_parser::consume_qualified_rule()
 	while (true)
 	{
 		// Repeatedly consume the next input token:
-		css_token token = next_token();
+		const css_token& token = next_token();
 
 		switch (token.type)
 		{
@@ -250,13 +279,12 @@ raw_rule::ptr css_parser::consume_qualified_rule()
 			return rule;
 		case CURLY_BLOCK:
 			// Assign the block to the qualified rule’s block. Return the qualified rule.
-			rule->block = token;
+			rule->block = take_token(token);
 			return rule;
 		default:
 			// Reconsume the current input token. Consume a component value. Append the returned value to the qualified rule’s prelude.
 			m_index--;
-			css_token value = consume_component_value();
-			rule->prelude.push_back(value);
+			rule->prelude.push_back(consume_component_value());
 		}
 	}
 }
@@ -266,13 +294,12 @@ raw_rule::ptr css_parser::consume_at_rule()
 {
 	// Consume the next input token. Create a new at-rule with its name set to the value of the current input token,
 	// its prelude initially set to an empty list, and its value initially set to nothing.
-	css_token token = next_token();
-	raw_rule::ptr rule = make_shared<raw_rule>(raw_rule::at, token.str);
+	raw_rule::ptr rule = make_shared<raw_rule>(raw_rule::at, next_token().str);
 
 	while (true)
 	{
 		// Repeatedly consume the next input token:
-		token = next_token();
+		const css_token& token = next_token();
 
 		switch (token.type)
 		{
@@ -288,13 +315,12 @@ raw_rule::ptr css_parser::consume_at_rule()
 			return rule;
 		case CURLY_BLOCK:
 			// Assign the block to the at-rule’s block. Return the at-rule.
-			rule->block = token;
+			rule->block = take_token(token);
 			return rule;
 		default:
 			// Reconsume the current input token. Consume a component value. Append the returned value to the at-rule’s prelude.
 			m_index--;
-			css_token value = consume_component_value();
-			rule->prelude.push_back(value);
+			rule->prelude.push_back(consume_component_value());
 		}
 	}
 }
@@ -309,27 +335,29 @@ css_token css_parser::consume_simple_block(char opening_bracket)
 	css_token block(block_type);
 
 	char closing_bracket = mirror(opening_bracket);
+	size_t start = m_values.size();
 
 	while (true)
 	{
 		// Repeatedly consume the next input token and process it as follows:
-		css_token token = next_token();
+		const css_token& token = next_token();
 
 		if (token.type == closing_bracket)
 		{
+			block.value = pop_values(start);
 			return block;
 		}
 		else if (token.type == EOF)
 		{
 			css_parse_error("eof in simple block");
+			block.value = pop_values(start);
 			return block;
 		}
 		else
 		{
 			// Reconsume the current input token. Consume a component value and append it to the value of the block.
 			m_index--;
-			css_token val = consume_component_value();
-			block.value.push_back(val);
+			m_values.push_back(consume_component_value());
 		}
 	}
 }
@@ -338,7 +366,7 @@ css_token css_parser::consume_simple_block(char opening_bracket)
 css_token css_parser::consume_component_value()
 {
 	// Consume the next input token.
-	css_token token = next_token();
+	const css_token& token = next_token();
 
 	switch (token.type)
 	{
@@ -352,7 +380,7 @@ css_token css_parser::consume_component_value()
 
 		// Otherwise, return the current input token.
 	default:
-		return token;
+		return take_token(token);
 	}
 }
 
@@ -361,26 +389,28 @@ css_token css_parser::consume_function(const string& name)
 {
 	// Create a function with its name equal to the value of the current input token and with its value initially set to an empty list.
 	css_token function(CV_FUNCTION, name);
+	size_t start = m_values.size();
 
 	while (true)
 	{
 		// Repeatedly consume the next input token and process it as follows:
-		css_token token = next_token();
+		const css_token& token = next_token();
 
 		switch (token.type)
 		{
 		case ')':
+			function.value = pop_values(start);
 			return function;
 
 		case EOF:
 			css_parse_error("eof in function");
+			function.value = pop_values(start);
 			return function;
 
 		default:
 			// Reconsume the current input token. Consume a component value and append the returned value to the function’s value.
 			m_index--;
-			css_token val = consume_component_value();
-			function.value.push_back(val);
+			m_values.push_back(consume_component_value());
 		}
 	}
 }
@@ -401,8 +431,7 @@ raw_declaration css_parser::consume_declaration()
 {
 	// Consume the next input token. Create a new declaration with its name set to the value of
 	// the current input token and its value initially set to an empty list.
-	css_token token = next_token();
-	raw_declaration decl = {token.name};
+	raw_declaration decl = {next_token().name};
 	auto& value = decl.value;
 
 	// 1. While the next input token is a <whitespace-token>, consume the next input token.
@@ -422,6 +451,7 @@ raw_declaration css_parser::consume_declaration()
 
 	// 4. As long as the next input token is anything other than an <EOF-token>,
 	//    consume a component value and append it to the declaration’s value.
+	value.reserve(m_tokens.size() - m_index);
 	while (peek_token().type != EOF)
 		value.push_back(consume_component_value());
 
@@ -450,7 +480,7 @@ void css_parser::consume_style_block_contents(/*out*/ raw_declaration::vector& d
 	while (true)
 	{
 		// Repeatedly consume the next input token:
-		css_token token = next_token();
+		const css_token& token = next_token();
 
 		switch (token.type)
 		{
@@ -472,13 +502,14 @@ void css_parser::consume_style_block_contents(/*out*/ raw_declaration::vector& d
 		}
 		case IDENT: {
 			// Initialize a temporary list initially filled with the current input token.
-			css_token_vector temp = { token };
+			css_token_vector temp;
+			temp.push_back(take_token(token));
 			// As long as the next input token is anything other than a <semicolon-token> or <EOF-token>,
 			// consume a component value and append it to the temporary list.
 			while (!is_one_of(peek_token().type, ';', EOF))
 				temp.push_back(consume_component_value());
 
-			css_parser parser(temp);
+			css_parser parser(std::move(temp));
 			// Consume a declaration from the temporary list.
 			auto decl = parser.consume_declaration();
 			// If anything was returned, append it to decls.
@@ -516,13 +547,13 @@ vector<css_token_vector> parse_comma_separated_list(const css_token_vector& toke
 	{
 		if (tok.type == ',')  // Note: EOF token is not stored in arrays
 		{
-			result.push_back(list);
+			result.push_back(std::move(list));
 			list.clear();
 			continue;
 		}
 		list.push_back(tok);
 	}
-	result.push_back(list);
+	result.push_back(std::move(list));
 
 	return result;
 }
@@ -242,6 +242,19 @@ void litehtml::css_properties::compute(const html_tag* el, const document::ptr&
 	m_transform_origin_y = css_length(50, css_units_percentage);
 	// TODO: Parse transform-origin string if provided
 
+	// will-change: promote to a compositing layer ahead of transform/opacity/filter changes
+	m_will_change_layer = false;
+	string will_change = el->get_property<string>(_will_change_, false, "auto", 0);
+	for (auto& prop : split_string(will_change, ", "))
+	{
+		lcase(prop);
+		if (prop == "transform" || prop == "opacity" || prop == "filter")
+		{
+			m_will_change_layer = true;
+			break;
+		}
+	}
+
 	// Parse box-shadow
 	string box_shadow_str = el->get_property<string>(_box_shadow_, false, "", 0);
 	m_box_shadows.clear();
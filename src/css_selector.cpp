@@ -31,6 +31,15 @@ void css_selector::calc_specificity()
 	}
 }
 
+bool css_selector::is_media_valid(const document* doc) const
+{
+	if(!m_media_query)
+	{
+		return true;
+	}
+	return doc && doc->is_media_list_used(m_media_query.get());
+}
+
 void css_selector::add_media_to_doc( document* doc ) const
 {
 	if(m_media_query && doc)
@@ -245,6 +245,13 @@ string css_tokenizer::consume_ident_sequence()
 
 	while (true)
 	{
+		// Fast path: append a run of ASCII ident code points at once
+		int start = index;
+		while (is_ident_code_point((byte)str[index]) && (byte)str[index] < 0x80)
+			index++;
+		if (index != start)
+			result.append(str, start, index - start);
+
 		// Repeatedly consume the next input code point from the stream:
 		int ch = consume_char();
 
@@ -536,7 +543,7 @@ css_token css_tokenizer::consume_ident_like_token()
 		{
 			// This is not exactly what standard says, but equivalent. The purpose is to preserve a whitespace token.
 			if (is_whitespace(str[index-1])) index--;
-			return {FUNCTION, string};
+			return {FUNCTION, std::move(string)};
 		}
 		else // Otherwise, consume a url token, and return it.
 		{
@@ -549,11 +556,11 @@ css_token css_tokenizer::consume_ident_like_token()
 	else if (str[index] == '(')
 	{
 		index++;
-		return {FUNCTION, string};
+		return {FUNCTION, std::move(string)};
 	}
 
 	// Otherwise, create an <ident-token> with its value set to string and return it.
-	return {IDENT, string};
+	return {IDENT, std::move(string)};
 }
 
 // https://www.w3.org/TR/css-syntax-3/#consume-token
@@ -705,7 +712,7 @@ css_token css_tokenizer::consume_token()
 			token.ch = ch; // NOTE: :;,()[]{} tokens are also handled here
 	}
 
-	token.repr = str.substr(start, index - start);
+	token.repr.assign(str, start, index - start);
 	return token;
 }
 
@@ -716,7 +723,7 @@ css_token_vector css_tokenizer::tokenize()
 	{
 		css_token token = consume_token();
 		if (token.type == EOF) break;
-		tokens.push_back(token);
+		tokens.push_back(std::move(token));
 	}
 	return tokens;
 }
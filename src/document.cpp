@@ -4,6 +4,7 @@
 #include "layout_profiler.h"
 #include "layout_cache.h"
 #include "css_calc.h"
+#include "css_parser.h"
 #include "html_tag.h"
 #include "el_text.h"
 #include "el_para.h"
@@ -36,13 +37,30 @@
 #include "render_block.h"
 #include "document_container.h"
 #include "types.h"
+#include "paint_profiler.h"
+#include <typeinfo>
+#include <limits>
 
 namespace litehtml
 {
 
+// Shared by documents without master or user css
+static const compiled_css::ptr& empty_css()
+{
+	static const compiled_css::ptr empty = compiled_css::create("", nullptr);
+	return empty;
+}
+
 document::document(document_container* container)
 {
 	m_container	= container;
+	m_font_cache = container ? container->get_font_cache() : nullptr;
+	m_master_css = empty_css();
+	m_user_css = empty_css();
+	if (container)
+	{
+		container->get_lazy_images_policy(m_lazy_images_policy);
+	}
 
 	// Set up animation frame callback
 	m_animation_controller.set_frame_callback([this]() {
@@ -54,8 +72,30 @@ document::document(document_container* container)
 }
 
 document::~document()
+{
+	clear_trees();
+
+	if(m_container)
+	{
+		for(auto& font : m_fonts)
+		{
+			if(m_font_cache)
+			{
+				m_font_cache->release(font.first);
+			} else
+			{
+				m_container->delete_font(font.second.font);
+			}
+		}
+	}
+}
+
+// Releases the element and render trees
+void document::clear_trees()
 {
 	m_over_element = m_active_element = nullptr;
+	m_lazy_images.clear();
+	m_virtual_lists.clear();
 
 	// Iteratively destroy render tree to prevent stack overflow from deeply nested structures
 	// (Wikipedia pages can have 190,000+ nested elements)
@@ -84,6 +124,7 @@ document::~document()
 		// Now nodes will be destroyed iteratively as vector goes out of scope
 		m_root_render.reset();
 	}
+	m_removed_elements.clear();
 
 	// Iteratively destroy element tree
 	if (m_root)
@@ -114,13 +155,16 @@ document::~document()
 
 	// Clear tabular elements list
 	m_tabular_elements.clear();
+	m_element_index.invalidate();
+}
 
-	if(m_container)
+static document_mode get_document_mode(GumboOutput* output)
+{
+	switch (output->document->v.document.doc_type_quirks_mode)
 	{
-		for(auto& font : m_fonts)
-		{
-			m_container->delete_font(font.second.font);
-		}
+	case GUMBO_DOCTYPE_QUIRKS:         return quirks_mode;
+	case GUMBO_DOCTYPE_LIMITED_QUIRKS: return limited_quirks_mode;
+	default:                           return no_quirks_mode;
 	}
 }
 
@@ -133,117 +177,208 @@ document::ptr document::createFromString(
 	// Create litehtml::document
 	document::ptr doc = make_shared<document>(container);
 
+	doc->create_elements_tree(str);
+
+	doc->parse_default_styles(master_styles, user_styles);
+
+	// Let's process created elements tree
+	doc->init_elements();
+
+	return doc;
+}
+
+document::ptr document::createFromString(
+	const estring& str,
+	document_container* container,
+	compiled_css::ptr master_css,
+	compiled_css::ptr user_css)
+{
+	document::ptr doc = make_shared<document>(container);
+	doc->create_elements_tree(str);
+	doc->set_default_styles(master_css, user_css);
+	doc->init_elements();
+	return doc;
+}
+
+void document::create_elements_tree(const estring& str)
+{
+	// Start fetching the style sheets and images before the elements ask for them
+	m_preload.scan_html(str, shared_from_this());
+
 	// Parse document into GumboOutput
-	GumboOutput* output = doc->parse_html(str);
+	GumboOutput* output = parse_html(str);
 
-	// mode must be set before doc->create_node because it is used in html_tag::set_attr
-	switch (output->document->v.document.doc_type_quirks_mode)
-	{
-	case GUMBO_DOCTYPE_NO_QUIRKS:      doc->m_mode = no_quirks_mode;      break;
-	case GUMBO_DOCTYPE_QUIRKS:         doc->m_mode = quirks_mode;         break;
-	case GUMBO_DOCTYPE_LIMITED_QUIRKS: doc->m_mode = limited_quirks_mode; break;
-	}
+	// mode must be set before create_node because it is used in html_tag::set_attr
+	m_mode = get_document_mode(output);
 
-	// Create litehtml::elements.
+	// Create litehtml::elements, allocated together in an arena
+	m_arena = new node_arena();
+	node_arena::add_ref(m_arena);
 	elements_list root_elements;
-	doc->create_node(output->root, root_elements, true);
+	create_node(output->root, root_elements, true);
 	if (!root_elements.empty())
 	{
-		doc->m_root = root_elements.back();
+		m_root = root_elements.back();
 	}
+	// The elements keep the arena alive
+	node_arena::release(m_arena);
+	m_arena = nullptr;
 
-	// Destroy GumboOutput
+	// Destroy GumboOutput, converted nodes are already released by create_node
 	gumbo_destroy_output(&kGumboDefaultOptions, output);
+	// Decoded text is only needed while Gumbo nodes exist
+	string().swap(m_text);
+}
 
-	if (master_styles != "")
-	{
-		doc->m_master_css.parse_css_stylesheet(master_styles, "", doc);
-		doc->m_master_css.sort_selectors();
-	}
-	if (user_styles != "")
+void document::parse_default_styles(const string& master_styles, const string& user_styles)
+{
+	set_default_styles(compiled_css::create(master_styles, m_container, "", m_mode),
+					   compiled_css::create(user_styles, m_container, "", m_mode));
+}
+
+void document::set_default_styles(compiled_css::ptr master_css, compiled_css::ptr user_css)
+{
+	m_master_css = master_css ? master_css : empty_css();
+	m_user_css = user_css ? user_css : empty_css();
+	add_default_styles_state();
+}
+
+// Registers the media lists and keyframes of the master and user css in the document
+void document::add_default_styles_state()
+{
+	for (const auto& styles : {m_master_css, m_user_css})
 	{
-		doc->m_user_css.parse_css_stylesheet(user_styles, "", doc);
-		doc->m_user_css.sort_selectors();
+		for (const auto& list : styles->media_lists())
+		{
+			add_media_list(list);
+		}
+		for (const auto& kf : styles->keyframes())
+		{
+			add_keyframes(kf.second);
+		}
 	}
+}
 
-	// Let's process created elements tree
-	if (doc->m_root)
-	{
-		doc->container()->get_media_features(doc->m_media);
+// Styles the element tree created from the parsed document and creates the render tree
+void document::init_elements()
+{
+	if (!m_root) return;
 
-		doc->m_root->set_pseudo_class(_root_, true);
+	m_container->get_media_features(m_media);
 
-		// apply master CSS
-		doc->m_root->apply_stylesheet(doc->m_master_css);
+	m_root->set_pseudo_class(_root_, true);
 
-		// parse elements attributes
-		doc->m_root->parse_attributes();
+	// apply master CSS
+	m_root->apply_stylesheet(m_master_css->styles());
 
-		// parse style sheets linked in document
-		for (const auto& css : doc->m_css)
-		{
-			media_query_list_list::ptr media;
-			if (css.media != "")
-			{
-				auto mq_list = parse_media_query_list(css.media, doc);
-				media = make_shared<media_query_list_list>();
-				media->add(mq_list);
-			}
-			doc->m_styles.parse_css_stylesheet(css.text, css.baseurl, doc, media);
-		}
-		// Sort css selectors using CSS rules.
-		doc->m_styles.sort_selectors();
+	// parse elements attributes
+	m_root->parse_attributes();
 
-		// Apply media features.
-		doc->update_media_lists(doc->m_media);
+	// parse style sheets linked in document
+	parse_stylesheets(0);
 
-		// Apply parsed styles.
-		doc->m_root->apply_stylesheet(doc->m_styles);
+	// Apply media features.
+	update_media_lists(m_media);
 
-		// Apply user styles if any
-		doc->m_root->apply_stylesheet(doc->m_user_css);
+	// Apply parsed styles.
+	m_root->apply_stylesheet(m_styles);
 
-		// Initialize element::m_css
-		doc->m_root->compute_styles();
+	// Apply user styles if any
+	m_root->apply_stylesheet(m_user_css->styles());
 
-		// Create rendering tree
-		doc->m_root_render = doc->m_root->create_render_item(nullptr);
+	// Initialize element::m_css
+	m_root->compute_styles();
 
-		// Now the m_tabular_elements is filled with tabular elements.
-		// We have to check the tabular elements for missing table elements
-		// and create the anonymous boxes in visual table layout
-		doc->fix_tables_layout();
+	// Create rendering tree
+	build_render_tree();
+}
 
-		// Finally initialize elements
-		// init_tree() uses iterative approach to avoid stack overflow on deeply nested DOMs
-		// init() returns pointer to the render_init element because it can change its type
-		if(doc->m_root_render)
+// Creates the render tree of the styled element tree. All render items of the tree are
+// allocated in one arena, the memory of the previous tree is freed at once when its last
+// item is released.
+void document::build_render_tree()
+{
+	// Release the previous tree first, the elements drop their references to it below
+	bool rebuild = m_root_render != nullptr;
+	m_root_render = nullptr;
+	m_tabular_elements.clear();
+	m_removed_elements.clear();
+
+	m_render_arena = new node_arena();
+	node_arena::add_ref(m_render_arena);
+
+	m_root_render = m_root->create_render_item(nullptr);
+
+	// Now the m_tabular_elements is filled with tabular elements.
+	// We have to check the tabular elements for missing table elements
+	// and create the anonymous boxes in visual table layout
+	fix_tables_layout();
+
+	// Finally initialize elements
+	// init_tree() uses iterative approach to avoid stack overflow on deeply nested DOMs
+	// init() returns pointer to the render_init element because it can change its type
+	if(m_root_render)
+	{
+		m_root_render = render_item::init_tree(m_root_render);
+	}
+
+	node_arena::release(m_render_arena);
+	m_render_arena = nullptr;
+
+	// Weak references to the items of the previous tree keep its arena allocated. Elements
+	// rendered again already replaced them, the hidden ones still have them.
+	if (rebuild)
+	{
+		std::vector<element*> stack = {m_root.get()};
+		while (!stack.empty())
 		{
-			doc->m_root_render = render_item::init_tree(doc->m_root_render);
+			element* el = stack.back();
+			stack.pop_back();
+			el->m_renders.remove_if([](const std::weak_ptr<render_item>& item) { return item.expired(); });
+			for (const auto& child : el->m_children)
+			{
+				stack.push_back(child.get());
+			}
 		}
 	}
+}
 
-	return doc;
+void document::retain_removed(const element::ptr& el)
+{
+	if (m_root_render)
+	{
+		m_removed_elements.push_back(el);
+	}
+}
+
+// Parses the style sheets m_css[first...] into m_styles
+void document::parse_stylesheets(size_t first)
+{
+	document::ptr doc = shared_from_this();
+	for (size_t i = first; i < m_css.size(); i++)
+	{
+		const auto& css = m_css[i];
+		media_query_list_list::ptr media;
+		if (css.media != "")
+		{
+			auto mq_list = parse_media_query_list(css.media, doc);
+			media = make_shared<media_query_list_list>();
+			media->add(mq_list);
+		}
+		m_styles.parse_css_stylesheet(css.text, css.baseurl, doc, media);
+	}
+	// Sort css selectors using CSS rules.
+	m_styles.sort_selectors();
 }
 
 void document::rebuild_render_tree()
 {
 	if (!m_root) return;
 
-	// Clear tabular elements for fresh table layout
-	m_tabular_elements.clear();
+	m_layout_generation++;
 
 	// Recreate the render tree from the DOM tree
-	m_root_render = m_root->create_render_item(nullptr);
-
-	// Fix tables layout (creates anonymous boxes for tables)
-	fix_tables_layout();
-
-	// Initialize the render tree
-	if (m_root_render)
-	{
-		m_root_render = render_item::init_tree(m_root_render);
-	}
+	build_render_tree();
 }
 
 void document::apply_stylesheets_to_element(std::shared_ptr<element> el)
@@ -251,7 +386,7 @@ void document::apply_stylesheets_to_element(std::shared_ptr<element> el)
 	if (!el) return;
 
 	// Apply master CSS (browser defaults)
-	el->apply_stylesheet(m_master_css);
+	el->apply_stylesheet(m_master_css->styles());
 
 	// Parse element attributes (for style attribute, etc.)
 	el->parse_attributes();
@@ -260,12 +395,124 @@ void document::apply_stylesheets_to_element(std::shared_ptr<element> el)
 	el->apply_stylesheet(m_styles);
 
 	// Apply user styles if any
-	el->apply_stylesheet(m_user_css);
+	el->apply_stylesheet(m_user_css->styles());
 
 	// Compute the final styles
 	el->compute_styles();
 }
 
+std::shared_ptr<const document_snapshot> document::snapshot() const
+{
+	if (m_loading || !m_root) return nullptr;
+
+	document::ptr doc = copy();
+	if (!doc) return nullptr;
+
+	auto snap = std::make_shared<document_snapshot>();
+	snap->m_doc = doc;
+	return snap;
+}
+
+document::ptr document::clone_from_snapshot(const std::shared_ptr<const document_snapshot>& snap)
+{
+	if (!snap || !snap->m_doc) return nullptr;
+
+	document::ptr doc = snap->m_doc->copy();
+	if (doc)
+	{
+		// Layout is done by the first render()
+		doc->rebuild_render_tree();
+	}
+	return doc;
+}
+
+// Copies the styled element tree with everything it references, without the render tree.
+// Returns nullptr if an element can't be copied.
+document::ptr document::copy() const
+{
+	document::ptr doc = make_shared<document>(m_container);
+	doc->m_css				= m_css;
+	doc->m_styles			= m_styles;
+	doc->m_def_color		= m_def_color;
+	doc->m_master_css		= m_master_css;
+	doc->m_user_css			= m_user_css;
+	doc->m_media_lists		= m_media_lists;
+	doc->m_used_media_lists	= m_used_media_lists;
+	doc->m_media_breakpoints = m_media_breakpoints;
+	doc->m_media			= m_media;
+	doc->m_lang				= m_lang;
+	doc->m_culture			= m_culture;
+	doc->m_mode				= m_mode;
+	doc->m_scroll_x			= m_scroll_x;
+	doc->m_scroll_y			= m_scroll_y;
+	doc->m_keyframes		= m_keyframes;
+
+	// Fonts are owned by the document, so they are created again or taken from the shared cache
+	std::unordered_map<uint_ptr, uint_ptr> fonts;
+	for (const auto& item : m_fonts)
+	{
+		fonts[item.second.font] = doc->add_font(item.first, nullptr);
+	}
+
+	// Cascaded styles are kept, elements are moved to the nodes of the new tree
+	std::unordered_map<const rule_node*, const rule_node*> rule_nodes;
+	doc->m_rule_tree.copy_from(m_rule_tree, rule_nodes);
+
+	auto copy_node = [&](const element& src) -> element::ptr
+	{
+		element::ptr el = src.copy();
+		// A class without its own copy() is copied as its base class
+		if (!el || typeid(*el) != typeid(src)) return nullptr;
+
+		el->m_doc = doc;
+		// The render items belong to the source document
+		el->m_renders.clear();
+		auto font = fonts.find(src.css().get_font());
+		if (font != fonts.end())
+		{
+			el->css_w().set_font(font->second);
+		}
+		if (auto tag = dynamic_cast<html_tag*>(el.get()))
+		{
+			if (tag->m_rule_node)
+			{
+				tag->m_rule_node = rule_nodes.at(tag->m_rule_node);
+			}
+		}
+		if (auto img = dynamic_cast<el_image*>(el.get()))
+		{
+			if (img->is_lazy_waiting()) doc->add_lazy_image(std::static_pointer_cast<el_image>(el));
+		}
+		if (&src == m_over_element.get())	doc->m_over_element = el;
+		if (&src == m_active_element.get())	doc->m_active_element = el;
+		return el;
+	};
+
+	if (m_root)
+	{
+		doc->m_root = copy_node(*m_root);
+		if (!doc->m_root) return nullptr;
+
+		// Iterative to handle deeply nested documents
+		std::vector<std::pair<const element*, element::ptr>> stack;
+		stack.emplace_back(m_root.get(), doc->m_root);
+		while (!stack.empty())
+		{
+			auto item = std::move(stack.back());
+			stack.pop_back();
+			for (const auto& child : item.first->m_children)
+			{
+				element::ptr el = copy_node(*child);
+				if (!el) return nullptr;
+
+				item.second->m_children.push_back(el);
+				stack.emplace_back(child.get(), el);
+			}
+		}
+	}
+	return doc;
+}
+
 // https://html.spec.whatwg.org/multipage/parsing.html#change-the-encoding
 encoding adjust_meta_encoding(encoding meta_encoding, encoding current_encoding)
 {
@@ -331,24 +578,35 @@ encoding get_meta_encoding(GumboNode* root)
 }
 
 // substitute for gumbo_parse that handles encodings
-GumboOutput* document::parse_html(estring str)
+GumboOutput* document::parse_html(const estring& str)
 {
 	// https://html.spec.whatwg.org/multipage/parsing.html#the-input-byte-stream
-	encoding_sniffing_algorithm(str);
-	// cannot store output in local variable because gumbo keeps pointers into it,
-	// which will be accessed later in gumbo_tag_from_original_text
-	if (str.encoding == encoding::utf_8)
-		m_text = str;
-	else
-		decode(str, str.encoding, m_text);
+	encoding str_encoding = str.encoding;
+	confidence str_confidence = str.confidence;
+	encoding_sniffing_algorithm(str, str_encoding, str_confidence);
+
+	// UTF-8 input is parsed in place, without a copy. Other encodings are decoded into m_text.
+	// In both cases the text must outlive the GumboOutput because gumbo keeps pointers into it,
+	// which will be accessed later in gumbo_tag_from_original_text.
+	const string* text = &str;
+	size_t bom_size = 0;
+	if (str_encoding != encoding::utf_8)
+	{
+		decode(str, str_encoding, m_text);
+		text = &m_text;
+	} else if (bom_sniff(str) == encoding::utf_8)
+	{
+		// decode() strips the BOM, do the same when parsing in place
+		bom_size = 3;
+	}
 
 	// Gumbo does not support callbacks on node creation, so we cannot change encoding while parsing.
 	// Instead, we parse entire file and then handle <meta> tags.
 
-	// Using gumbo_parse_with_options to pass string length (m_text may contain NUL chars).
-	GumboOutput* output = gumbo_parse_with_options(&kGumboDefaultOptions, m_text.data(), m_text.size());
+	// Using gumbo_parse_with_options to pass string length (text may contain NUL chars).
+	GumboOutput* output = gumbo_parse_with_options(&kGumboDefaultOptions, text->data() + bom_size, text->size() - bom_size);
 
-	if (str.confidence == confidence::certain)
+	if (str_confidence == confidence::certain)
 		return output;
 
 	// Otherwise: confidence is tentative.
@@ -358,57 +616,689 @@ GumboOutput* document::parse_html(estring str)
 	if (meta_encoding != encoding::null)
 	{
 		// ...and it is different from currently used encoding...
-		encoding new_encoding = adjust_meta_encoding(meta_encoding, str.encoding);
-		if (new_encoding != str.encoding)
+		encoding new_encoding = adjust_meta_encoding(meta_encoding, str_encoding);
+		if (new_encoding != str_encoding)
 		{
 			// ...reparse with the new encoding.
 			gumbo_destroy_output(&kGumboDefaultOptions, output);
-			m_text.clear();
+			string().swap(m_text);
 
-			if (new_encoding == encoding::utf_8)
-				m_text = str;
-			else
+			text = &str;
+			if (new_encoding != encoding::utf_8)
+			{
 				decode(str, new_encoding, m_text);
-			output = gumbo_parse_with_options(&kGumboDefaultOptions, m_text.data(), m_text.size());
+				text = &m_text;
+			}
+			output = gumbo_parse_with_options(&kGumboDefaultOptions, text->data(), text->size());
 		}
 	}
 
 	return output;
 }
 
-void document::create_node(void* gnode, elements_list& elements, bool parseTextNode)
+//////////////////////////////////////////////////////////////////////////
+// Progressive loading
+//
+// Gumbo is not incremental, so the received text is parsed again on every update (geometrically
+// throttled, which keeps the total parsing cost linear). The parse is reconciled with the elements
+// created by the previous updates through the right edge of the tree: an open element keeps its
+// children except the last one, those are complete and are converted, styled and kept for good.
+// The last child is descended into if it is a block container, otherwise it is converted
+// provisionally and replaced on the next update.
+
+// Open element on the right edge of the tree being loaded
+struct loading_level
 {
-	auto* node = (GumboNode*)gnode;
-	switch (node->type)
+	element::ptr	el;
+	size_t			offset = 0;			// start offset of the Gumbo node, identifies the node between parses
+	unsigned int	attributes = 0;		// attributes count of the Gumbo node (<html> and <body> tags can add attributes)
+	size_t			done_nodes = 0;		// Gumbo children converted for good
+	size_t			done_elements = 0;	// el children that are kept for good, including ::before
+	size_t			last_offset = 0;	// start offset of the last child converted for good
+	size_t			last_length = 0;	// text length of that child, foster parenting can append text to it
+};
+
+struct document::loading_state
+{
+	string						raw;					// bytes received so far
+	encoding					enc = encoding::null;
+	confidence					conf = confidence::certain;
+	bool						sniffed = false;
+	size_t						parsed_size = 0;		// raw size at the last update
+	std::vector<loading_level>	levels;					// right edge of the element tree, levels[0] is <html>
+	size_t						css_parsed = 0;			// m_css entries parsed into m_styles
+	bool						late_styles = false;	// style sheets were found after elements were styled
+	bool						render_tree_stale = false;
+};
+
+// Minimum amount of new input that triggers an update, it grows with the document
+static const size_t loading_update_size = 8 * 1024;
+
+static size_t gumbo_node_offset(const GumboNode* node)
+{
+	if (node->type == GUMBO_NODE_ELEMENT || node->type == GUMBO_NODE_TEMPLATE)
 	{
-	case GUMBO_NODE_ELEMENT:
+		return node->v.element.start_pos.offset;
+	}
+	return node->v.text.start_pos.offset;
+}
+
+static size_t gumbo_text_length(const GumboNode* node)
+{
+	if (node->type == GUMBO_NODE_ELEMENT || node->type == GUMBO_NODE_TEMPLATE)
 	{
-		string_map attrs;
-		GumboAttribute* attr;
-		for (unsigned int i = 0; i < node->v.element.attributes.length; i++)
+		return 0;
+	}
+	return node->v.text.original_text.length;
+}
+
+static size_t gumbo_body_index(const GumboNode* root)
+{
+	for (size_t i = 0; i < root->v.element.children.length; i++)
+	{
+		auto node = (const GumboNode*)root->v.element.children.data[i];
+		if (node->type == GUMBO_NODE_ELEMENT && (node->v.element.tag == GUMBO_TAG_BODY || node->v.element.tag == GUMBO_TAG_FRAMESET))
 		{
-			attr = (GumboAttribute*)node->v.element.attributes.data[i];
-			attrs[attr->name] = attr->value;
+			return i;
 		}
+	}
+	return root->v.element.children.length;
+}
+
+// Block containers that are loaded child by child. Formatting elements (<b>, <a>, ...) are never
+// descended into: the adoption agency algorithm can move their content when they are closed.
+static bool is_loading_container(const GumboNode* node)
+{
+	if (node->type != GUMBO_NODE_ELEMENT) return false;
+
+	switch (node->v.element.tag)
+	{
+	case GUMBO_TAG_BODY:
+	case GUMBO_TAG_DIV:
+	case GUMBO_TAG_SECTION:
+	case GUMBO_TAG_ARTICLE:
+	case GUMBO_TAG_MAIN:
+	case GUMBO_TAG_ASIDE:
+	case GUMBO_TAG_NAV:
+	case GUMBO_TAG_HEADER:
+	case GUMBO_TAG_FOOTER:
+	case GUMBO_TAG_UL:
+	case GUMBO_TAG_OL:
+	case GUMBO_TAG_DL:
+	case GUMBO_TAG_DD:
+	case GUMBO_TAG_LI:
+	case GUMBO_TAG_BLOCKQUOTE:
+	case GUMBO_TAG_FORM:
+	case GUMBO_TAG_FIGURE:
+	case GUMBO_TAG_DETAILS:
+	case GUMBO_TAG_CENTER:
+	case GUMBO_TAG_FIELDSET:
+	case GUMBO_TAG_TABLE:
+	case GUMBO_TAG_TBODY:
+	case GUMBO_TAG_THEAD:
+	case GUMBO_TAG_TFOOT:
+	case GUMBO_TAG_TR:
+	case GUMBO_TAG_TD:
+	case GUMBO_TAG_TH:
+		return true;
+	default:
+		return false;
+	}
+}
 
+// Elements that change the document when their attributes are parsed (style sheets, base url, caption)
+// must not be converted provisionally, it would be done twice
+static bool has_document_side_effects(const GumboNode* root)
+{
+	std::vector<const GumboNode*> nodes = {root};
+	while (!nodes.empty())
+	{
+		const GumboNode* node = nodes.back();
+		nodes.pop_back();
+		if (node->type != GUMBO_NODE_ELEMENT) continue;
 
-		element::ptr ret;
-		const char* tag = gumbo_normalized_tagname(node->v.element.tag);
-		if (tag[0])
+		switch (node->v.element.tag)
 		{
-			ret = create_element(tag, attrs);
+		case GUMBO_TAG_STYLE:
+		case GUMBO_TAG_LINK:
+		case GUMBO_TAG_BASE:
+		case GUMBO_TAG_TITLE:
+			return true;
+		default:
+			break;
 		}
-		else
+		for (size_t i = 0; i < node->v.element.children.length; i++)
+		{
+			nodes.push_back((const GumboNode*)node->v.element.children.data[i]);
+		}
+	}
+	return false;
+}
+
+// true if the selector depends on the following siblings of the element, they are not known while loading
+static bool depends_on_following_siblings(const css_selector& selector)
+{
+	for (const auto& attr : selector.m_right.m_attrs)
+	{
+		if (attr.type == select_pseudo_class)
+		{
+			switch (attr.name)
+			{
+			case _last_child_:
+			case _last_of_type_:
+			case _only_child_:
+			case _only_of_type_:
+			case _nth_last_child_:
+			case _nth_last_of_type_:
+				return true;
+			default:
+				break;
+			}
+		}
+		for (const auto& sel : attr.selector_list)
+		{
+			if (depends_on_following_siblings(*sel)) return true;
+		}
+	}
+	return selector.m_left && depends_on_following_siblings(*selector.m_left);
+}
+
+static bool depends_on_following_siblings(const css& stylesheet)
+{
+	for (const auto& sel : stylesheet.selectors())
+	{
+		if (depends_on_following_siblings(*sel)) return true;
+	}
+	return false;
+}
+
+static size_t loaded_children_count(const child_list& children)
+{
+	// ::after stays the last child while loading
+	if (!children.empty() && children.back()->tag() == __tag_after_)
+	{
+		return children.size() - 1;
+	}
+	return children.size();
+}
+
+document::ptr document::begin(
+	document_container* container,
+	const string& master_styles,
+	const string& user_styles,
+	encoding enc)
+{
+	document::ptr doc = make_shared<document>(container);
+	doc->m_loading = std::make_unique<loading_state>();
+	// Same as createFromString: a known (transport) encoding is certain, BOM still takes precedence
+	doc->m_loading->enc = enc;
+	doc->parse_default_styles(master_styles, user_styles);
+	return doc;
+}
+
+document::ptr document::begin(
+	document_container* container,
+	compiled_css::ptr master_css,
+	compiled_css::ptr user_css,
+	encoding enc)
+{
+	document::ptr doc = make_shared<document>(container);
+	doc->m_loading = std::make_unique<loading_state>();
+	doc->m_loading->enc = enc;
+	doc->set_default_styles(master_css, user_css);
+	return doc;
+}
+
+bool document::append_bytes(const char* data, size_t size)
+{
+	if (!m_loading) return false;
+
+	m_loading->raw.append(data, size);
+	// Resources are requested as soon as their tags arrive, the tree is updated less often
+	m_preload.scan_html(m_loading->raw, shared_from_this());
+	return update_loading(false);
+}
+
+void document::stylesheet_preloaded(const string& url, const string& text)
+{
+	m_preload.scan_css(text, url, shared_from_this());
+}
+
+bool document::finish()
+{
+	if (!m_loading) return false;
+
+	bool updated = update_loading(true);
+	if (m_loading->render_tree_stale)
+	{
+		rebuild_render_tree();
+	}
+	m_loading.reset();
+	string().swap(m_text);
+	return updated;
+}
+
+bool document::update_loading(bool final)
+{
+	loading_state& ls = *m_loading;
+
+	if (!ls.sniffed)
+	{
+		// The encoding is settled on the first bytes: the <meta> prescan looks at 1024 bytes
+		if (!final && ls.raw.size() < 1024) return false;
+		encoding_sniffing_algorithm(ls.raw, ls.enc, ls.conf);
+		ls.sniffed = true;
+	}
+	if (!final && ls.raw.size() - ls.parsed_size < std::max(loading_update_size, ls.parsed_size / 4))
+	{
+		return false;
+	}
+	ls.parsed_size = ls.raw.size();
+
+	// At the end the style sheets found late and the selectors depending on the following siblings
+	// are applied by building the whole tree again, the same way createFromString does
+	bool full_build = final && (ls.late_styles || depends_on_following_siblings(m_styles) || depends_on_following_siblings(m_user_css->styles()));
+	while (true)
+	{
+		// UTF-8 input is parsed in place, other encodings are decoded into m_text
+		const string* text = &ls.raw;
+		size_t start = 0;
+		if (ls.enc != encoding::utf_8)
+		{
+			m_text.clear();
+			decode(ls.raw, ls.enc, m_text);
+			text = &m_text;
+		} else if (bom_sniff(ls.raw) == encoding::utf_8)
+		{
+			start = 3;
+		}
+		size_t end = text->size();
+		if (!final)
+		{
+			// Only complete tags are parsed, a tag cut in the middle would be dropped
+			end = text->rfind('>');
+			if (end == string::npos || end < start) return false;
+			end++;
+		}
+		GumboOutput* output = gumbo_parse_with_options(&kGumboDefaultOptions, text->data() + start, end - start);
+
+		if (ls.conf == confidence::tentative)
+		{
+			encoding meta_encoding = get_meta_encoding(output->root);
+			if (meta_encoding != encoding::null)
+			{
+				encoding new_encoding = adjust_meta_encoding(meta_encoding, ls.enc);
+				if (new_encoding != ls.enc)
+				{
+					gumbo_destroy_output(&kGumboDefaultOptions, output);
+					ls.enc = new_encoding;
+					ls.conf = confidence::certain;
+					reset_loading_tree();
+					continue;
+				}
+			}
+			// <head> is complete when <body> is started, the encoding cannot change anymore
+			if (gumbo_body_index(output->root) < output->root->v.element.children.length)
+			{
+				ls.conf = confidence::certain;
+			}
+		}
+
+		if (full_build)
+		{
+			reset_loading_tree();
+			m_mode = get_document_mode(output);
+			elements_list root_elements;
+			create_node(output->root, root_elements, true);
+			if (!root_elements.empty())
+			{
+				m_root = root_elements.back();
+			}
+			gumbo_destroy_output(&kGumboDefaultOptions, output);
+			init_elements();
+			ls.render_tree_stale = false;
+			return true;
+		}
+
+		bool updated = build_loading_tree(output, final);
+		gumbo_destroy_output(&kGumboDefaultOptions, output);
+
+		if (final && (ls.late_styles || depends_on_following_siblings(m_styles)))
+		{
+			// The last update brought such style sheets
+			full_build = true;
+			continue;
+		}
+		// The render tree is created again by the next render() or finish()
+		ls.render_tree_stale = ls.render_tree_stale || updated;
+		return updated;
+	}
+}
+
+// Drops everything created from the input, the next update starts from scratch
+void document::reset_loading_tree()
+{
+	clear_trees();
+	m_fixed_boxes.clear();
+	m_css.clear();
+	m_styles = css();
+	m_media_lists.clear();
+	m_used_media_lists.clear();
+	m_media_breakpoints.clear();
+	m_keyframes.clear();
+	add_default_styles_state();
+	// Rule nodes point to the declarations of the dropped style sheets
+	m_rule_tree = rule_tree();
+	m_style_cache.clear();
+
+	m_loading->levels.clear();
+	m_loading->css_parsed = 0;
+	m_loading->late_styles = false;
+}
+
+bool document::build_loading_tree(GumboOutput* output, bool final)
+{
+	auto& levels = m_loading->levels;
+	GumboNode* root = output->root;
+
+	if (m_root)
+	{
+		if (get_document_mode(output) == m_mode && advance_loading_tree(root, final))
+		{
+			return true;
+		}
+		// The new parse does not extend the elements created so far (misnested markup)
+		reset_loading_tree();
+	}
+
+	// Nothing is created until <head> is complete, so its style sheets apply from the start
+	const GumboVector& children = root->v.element.children;
+	size_t body = gumbo_body_index(root);
+	if (body == children.length && !final)
+	{
+		return false;
+	}
+
+	m_mode = get_document_mode(output);
+	element::ptr el = create_element_node(root);
+	if (!el)
+	{
+		return false;
+	}
+	for (size_t i = 0; i < body; i++)
+	{
+		elements_list elements;
+		create_node(children.data[i], elements, true);
+		for (const auto& child : elements)
+		{
+			el->appendChild(child);
+		}
+	}
+	m_root = el;
+	m_container->get_media_features(m_media);
+	update_media_lists(m_media);
+	m_root->set_pseudo_class(_root_, true);
+	elements_list root_elements = {m_root};
+	add_loaded_elements(nullptr, root_elements);
+
+	loading_level level;
+	level.el = m_root;
+	level.offset = gumbo_node_offset(root);
+	level.attributes = root->v.element.attributes.length;
+	level.done_nodes = body;
+	level.done_elements = loaded_children_count(m_root->m_children);
+	if (body)
+	{
+		auto last = (GumboNode*)children.data[body - 1];
+		level.last_offset = gumbo_node_offset(last);
+		level.last_length = gumbo_text_length(last);
+	}
+	levels.push_back(level);
+
+	advance_loading_tree(root, final);
+	return true;
+}
+
+// Converts the complete Gumbo nodes on the right edge of the tree. Returns false if the new parse
+// does not match the elements kept for good.
+bool document::advance_loading_tree(void* groot, bool final)
+{
+	auto& levels = m_loading->levels;
+
+	// The whole right edge is verified before anything is converted
+	std::vector<GumboNode*> nodes;
+	nodes.reserve(levels.size());
+	auto node = (GumboNode*)groot;
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		const loading_level& lv = levels[i];
+		const GumboVector& children = node->v.element.children;
+		if (node->type != GUMBO_NODE_ELEMENT || gumbo_node_offset(node) != lv.offset ||
+			node->v.element.attributes.length != lv.attributes || children.length < lv.done_nodes)
 		{
-			if (node->v.element.original_tag.data && node->v.element.original_tag.length)
+			return false;
+		}
+		if (lv.done_nodes)
+		{
+			auto last = (GumboNode*)children.data[lv.done_nodes - 1];
+			if (gumbo_node_offset(last) != lv.last_offset || gumbo_text_length(last) != lv.last_length)
+			{
+				return false;
+			}
+		}
+		nodes.push_back(node);
+		if (i + 1 < levels.size())
+		{
+			if (lv.done_nodes >= children.length)
+			{
+				return false;
+			}
+			node = (GumboNode*)children.data[lv.done_nodes];
+		}
+	}
+
+	// The right edge is the ancestors chain of all new elements, it stays in the selector filter
+	auto push_level = [this](const element::ptr& el)
+		{
+			auto tag = dynamic_cast<html_tag*>(el.get());
+			m_selector_filter.push_element(el->tag(), el->id(), tag ? tag->classes() : vector<string_id>());
+		};
+
+	// Levels from the first complete one down are finished by this update
+	size_t complete = levels.size();
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		bool closed = i == 0 ? final : levels[i - 1].done_nodes + 1 < nodes[i - 1]->v.element.children.length;
+		if (closed && complete == levels.size())
+		{
+			complete = i;
+		}
+
+		// Remove the provisional elements of the previous update
+		const loading_level& lv = levels[i];
+		auto& el_children = lv.el->m_children;
+		size_t keep = lv.done_elements + (i + 1 < levels.size() ? 1 : 0);
+		size_t count = loaded_children_count(el_children);
+		if (count > keep)
+		{
+			auto last = el_children.end();
+			if (count != el_children.size()) --last;
+			auto first = std::prev(last, (ptrdiff_t)(count - keep));
+			for (auto it = first; it != last; ++it)
+			{
+				retain_removed(*it);
+				(*it)->parent(nullptr);
+			}
+			el_children.erase(first, last);
+			m_element_index.invalidate();
+		}
+
+		push_level(lv.el);
+	}
+
+	// Converts the children [done_nodes, end) of the level for good
+	auto convert = [&](size_t i, size_t end)
+		{
+			loading_level& lv = levels[i];
+			if (lv.done_nodes >= end) return;
+
+			const GumboVector& children = nodes[i]->v.element.children;
+			elements_list elements;
+			for (size_t n = lv.done_nodes; n < end; n++)
+			{
+				create_node(children.data[n], elements, true);
+			}
+			add_loaded_elements(lv.el, elements);
+
+			auto last = (GumboNode*)children.data[end - 1];
+			lv.done_nodes = end;
+			lv.done_elements += elements.size();
+			lv.last_offset = gumbo_node_offset(last);
+			lv.last_length = gumbo_text_length(last);
+		};
+
+	// Complete levels, from the deepest one: the rest of the children, then the level element is
+	// kept for good by its parent level
+	while (levels.size() > complete)
+	{
+		size_t i = levels.size() - 1;
+		convert(i, nodes[i]->v.element.children.length);
+
+		m_selector_filter.pop_element();
+		levels.pop_back();
+		if (i > 0)
+		{
+			loading_level& parent = levels[i - 1];
+			parent.done_nodes++;
+			parent.done_elements++;
+			parent.last_offset = gumbo_node_offset(nodes[i]);
+			parent.last_length = 0;
+		}
+	}
+
+	// The deepest open level: its children except the last one are complete. The last child is the
+	// next level if it is a block container, otherwise it is converted provisionally.
+	while (!levels.empty())
+	{
+		size_t i = levels.size() - 1;
+		const GumboVector& children = nodes[i]->v.element.children;
+		if (children.length == 0)
+		{
+			break;
+		}
+		convert(i, children.length - 1);
+
+		auto last = (GumboNode*)children.data[children.length - 1];
+		if (is_loading_container(last))
+		{
+			elements_list elements;
+			if (element::ptr el = create_element_node(last))
+			{
+				elements.push_back(el);
+				add_loaded_elements(levels[i].el, elements);
+			}
+			if (!elements.empty())
+			{
+				loading_level child_level;
+				child_level.el = elements.front();
+				child_level.offset = gumbo_node_offset(last);
+				child_level.attributes = last->v.element.attributes.length;
+				child_level.done_elements = loaded_children_count(child_level.el->m_children);
+				levels.push_back(child_level);
+				nodes.push_back(last);
+				push_level(child_level.el);
+				continue;
+			}
+		} else if (!has_document_side_effects(last))
+		{
+			elements_list elements;
+			create_node(last, elements, true);
+			add_loaded_elements(levels[i].el, elements);
+		}
+		break;
+	}
+
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		m_selector_filter.pop_element();
+	}
+	return true;
+}
+
+// Appends the elements to parent and styles them. The steps of createFromString are applied
+// to the new subtrees only, their ancestors are already styled and in the selector filter.
+void document::add_loaded_elements(const element::ptr& parent, elements_list& elements)
+{
+	if (elements.empty()) return;
+
+	if (parent)
+	{
+		// appendChild can reject elements (e.g. el_table), they are removed from the list
+		auto& children = parent->m_children;
+		element::ptr after;
+		if (loaded_children_count(children) != children.size())
+		{
+			after = children.back();
+			children.pop_back();
+			// The new children go before ::after, the index can't append them in place
+			m_element_index.invalidate();
+		}
+		for (auto it = elements.begin(); it != elements.end();)
+		{
+			if (parent->appendChild(*it))
 			{
-				string str;
-				gumbo_tag_from_original_text(&node->v.element.original_tag);
-				str.append(node->v.element.original_tag.data, node->v.element.original_tag.length);
-				ret = create_element(str.c_str(), attrs);
+				++it;
+			} else
+			{
+				it = elements.erase(it);
 			}
 		}
-		if (!strcmp(tag, "script"))
+		if (after)
+		{
+			children.push_back(after);
+		}
+	}
+
+	for (const auto& el : elements)
+	{
+		el->apply_stylesheet(m_master_css->styles());
+	}
+	for (const auto& el : elements)
+	{
+		el->parse_attributes();
+	}
+	if (m_loading->css_parsed < m_css.size())
+	{
+		// Already styled elements miss the new rules, they are applied by finish()
+		if (parent)
+		{
+			m_loading->late_styles = true;
+		}
+		parse_stylesheets(m_loading->css_parsed);
+		m_loading->css_parsed = m_css.size();
+		update_media_lists(m_media);
+	}
+	for (const auto& el : elements)
+	{
+		el->apply_stylesheet(m_styles);
+		el->apply_stylesheet(m_user_css->styles());
+	}
+
+	for (const auto& el : elements)
+	{
+		el->compute_styles();
+	}
+}
+
+void document::create_node(void* gnode, elements_list& elements, bool parseTextNode)
+{
+	auto* node = (GumboNode*)gnode;
+	switch (node->type)
+	{
+	case GUMBO_NODE_ELEMENT:
+	{
+		element::ptr ret = create_element_node(node);
+		if (node->v.element.tag == GUMBO_TAG_SCRIPT)
 		{
 			parseTextNode = false;
 		}
@@ -417,15 +1307,20 @@ void document::create_node(void* gnode, elements_list& elements, bool parseTextN
 			elements_list child;
 			for (unsigned int i = 0; i < node->v.element.children.length; i++)
 			{
+				auto child_node = static_cast<GumboNode*> (node->v.element.children.data[i]);
 				child.clear();
-				create_node(static_cast<GumboNode*> (node->v.element.children.data[i]), child, parseTextNode);
+				create_node(child_node, child, parseTextNode);
 				std::for_each(child.begin(), child.end(),
 					[&ret](element::ptr& el)
 					{
 						ret->appendChild(el);
 					}
 				);
+				// Release every Gumbo subtree as soon as it is converted, so the full Gumbo tree
+				// and the full element tree never exist at the same time
+				gumbo_destroy_node(&kGumboDefaultOptions, child_node);
 			}
+			node->v.element.children.length = 0;
 			elements.push_back(ret);
 		}
 	}
@@ -434,42 +1329,74 @@ void document::create_node(void* gnode, elements_list& elements, bool parseTextN
 	{
 		if (!parseTextNode)
 		{
-			elements.push_back(std::make_shared<el_text>(node->v.text.text, shared_from_this()));
+			elements.push_back(make_node<el_text>(node->v.text.text, shared_from_this()));
 		}
 		else
 		{
 			m_container->split_text(node->v.text.text,
-				[this, &elements](const char* text) { elements.push_back(std::make_shared<el_text>(text, shared_from_this())); },
-				[this, &elements](const char* text) { elements.push_back(std::make_shared<el_space>(text, shared_from_this())); });
+				[this, &elements](const char* text) { elements.push_back(make_node<el_text>(text, shared_from_this())); },
+				[this, &elements](const char* text) { elements.push_back(make_node<el_space>(text, shared_from_this())); });
 		}
 	}
 	break;
 	case GUMBO_NODE_CDATA:
 	{
-		element::ptr ret = std::make_shared<el_cdata>(shared_from_this());
+		element::ptr ret = make_node<el_cdata>(shared_from_this());
 		ret->set_data(node->v.text.text);
 		elements.push_back(ret);
 	}
 	break;
 	case GUMBO_NODE_COMMENT:
 	{
-		element::ptr ret = std::make_shared<el_comment>(shared_from_this());
+		element::ptr ret = make_node<el_comment>(shared_from_this());
 		ret->set_data(node->v.text.text);
 		elements.push_back(ret);
 	}
 	break;
 	case GUMBO_NODE_WHITESPACE:
 	{
-		string str = node->v.text.text;
-		for (size_t i = 0; i < str.length(); i++)
+		string str = node->v.text.text;
+		for (size_t i = 0; i < str.length(); i++)
+		{
+			elements.push_back(make_node<el_space>(str.substr(i, 1).c_str(), shared_from_this()));
+		}
+	}
+	break;
+	default:
+		break;
+	}
+}
+
+// Creates the element of a Gumbo element node, without its children
+element::ptr document::create_element_node(void* gnode)
+{
+	auto* node = (GumboNode*)gnode;
+
+	string_map attrs;
+	GumboAttribute* attr;
+	for (unsigned int i = 0; i < node->v.element.attributes.length; i++)
+	{
+		attr = (GumboAttribute*)node->v.element.attributes.data[i];
+		attrs[attr->name] = attr->value;
+	}
+
+	element::ptr ret;
+	const char* tag = gumbo_normalized_tagname(node->v.element.tag);
+	if (tag[0])
+	{
+		ret = create_element(tag, attrs);
+	}
+	else
+	{
+		if (node->v.element.original_tag.data && node->v.element.original_tag.length)
 		{
-			elements.push_back(std::make_shared<el_space>(str.substr(i, 1).c_str(), shared_from_this()));
+			string str;
+			gumbo_tag_from_original_text(&node->v.element.original_tag);
+			str.append(node->v.element.original_tag.data, node->v.element.original_tag.length);
+			ret = create_element(str.c_str(), attrs);
 		}
 	}
-	break;
-	default:
-		break;
-	}
+	return ret;
 }
 
 element::ptr document::create_element(const char* tag_name, const string_map& attributes)
@@ -484,91 +1411,91 @@ element::ptr document::create_element(const char* tag_name, const string_map& at
 	{
 		if (!strcmp(tag_name, "br"))
 		{
-			newTag = std::make_shared<el_break>(this_doc);
+			newTag = make_node<el_break>(this_doc);
 		}
 		else if (!strcmp(tag_name, "p"))
 		{
-			newTag = std::make_shared<el_para>(this_doc);
+			newTag = make_node<el_para>(this_doc);
 		}
 		else if (!strcmp(tag_name, "img"))
 		{
-			newTag = std::make_shared<el_image>(this_doc);
+			newTag = make_node<el_image>(this_doc);
 		}
 		else if (!strcmp(tag_name, "canvas"))
 		{
-			newTag = std::make_shared<el_canvas>(this_doc);
+			newTag = make_node<el_canvas>(this_doc);
 		}
 		else if (!strcmp(tag_name, "svg"))
 		{
-			newTag = std::make_shared<el_svg>(this_doc);
+			newTag = make_node<el_svg>(this_doc);
 		}
 		else if (!strcmp(tag_name, "table"))
 		{
-			newTag = std::make_shared<el_table>(this_doc);
+			newTag = make_node<el_table>(this_doc);
 		}
 		else if (!strcmp(tag_name, "td") || !strcmp(tag_name, "th"))
 		{
-			newTag = std::make_shared<el_td>(this_doc);
+			newTag = make_node<el_td>(this_doc);
 		}
 		else if (!strcmp(tag_name, "link"))
 		{
-			newTag = std::make_shared<el_link>(this_doc);
+			newTag = make_node<el_link>(this_doc);
 		}
 		else if (!strcmp(tag_name, "title"))
 		{
-			newTag = std::make_shared<el_title>(this_doc);
+			newTag = make_node<el_title>(this_doc);
 		}
 		else if (!strcmp(tag_name, "a"))
 		{
-			newTag = std::make_shared<el_anchor>(this_doc);
+			newTag = make_node<el_anchor>(this_doc);
 		}
 		else if (!strcmp(tag_name, "tr"))
 		{
-			newTag = std::make_shared<el_tr>(this_doc);
+			newTag = make_node<el_tr>(this_doc);
 		}
 		else if (!strcmp(tag_name, "style"))
 		{
-			newTag = std::make_shared<el_style>(this_doc);
+			newTag = make_node<el_style>(this_doc);
 		}
 		else if (!strcmp(tag_name, "base"))
 		{
-			newTag = std::make_shared<el_base>(this_doc);
+			newTag = make_node<el_base>(this_doc);
 		}
 		else if (!strcmp(tag_name, "body"))
 		{
-			newTag = std::make_shared<el_body>(this_doc);
+			newTag = make_node<el_body>(this_doc);
 		}
 		else if (!strcmp(tag_name, "div"))
 		{
-			newTag = std::make_shared<el_div>(this_doc);
+			newTag = make_node<el_div>(this_doc);
 		}
 		else if (!strcmp(tag_name, "script"))
 		{
-			newTag = std::make_shared<el_script>(this_doc);
+			newTag = make_node<el_script>(this_doc);
 		}
 		else if (!strcmp(tag_name, "font"))
 		{
-			newTag = std::make_shared<el_font>(this_doc);
+			newTag = make_node<el_font>(this_doc);
 		}
 		else if (!strcmp(tag_name, "input"))
 		{
-			newTag = std::make_shared<el_input>(this_doc);
+			newTag = make_node<el_input>(this_doc);
 		}
 		else if (!strcmp(tag_name, "textarea"))
 		{
-			newTag = std::make_shared<el_textarea>(this_doc);
+			newTag = make_node<el_textarea>(this_doc);
 		}
 		else if (!strcmp(tag_name, "select"))
 		{
-			newTag = std::make_shared<el_select>(this_doc);
+			newTag = make_node<el_select>(this_doc);
 		}
 		else if (!strcmp(tag_name, "button"))
 		{
-			newTag = std::make_shared<el_button>(this_doc);
+			newTag = make_node<el_button>(this_doc);
 		}
 		else
 		{
-			newTag = std::make_shared<html_tag>(this_doc);
+			newTag = make_node<html_tag>(this_doc);
 		}
 	}
 
@@ -586,23 +1513,20 @@ element::ptr document::create_element(const char* tag_name, const string_map& at
 
 uint_ptr document::add_font( const font_description& descr, font_metrics* fm )
 {
-	uint_ptr ret = 0;
-
-	std::string key = descr.hash();
-
-	if(m_fonts.find(key) == m_fonts.end())
+	font_item fi = {0, {}};
+	if(m_font_cache)
+	{
+		fi.font = m_font_cache->acquire(descr, this, &fi.metrics);
+	} else
 	{
-		font_item fi = {0, {}};
-
 		fi.font = m_container->create_font(descr, this, &fi.metrics);
-		m_fonts[key] = fi;
-		ret = fi.font;
-		if(fm)
-		{
-			*fm = fi.metrics;
-		}
 	}
-	return ret;
+	m_fonts.emplace(descr, fi);
+	if(fm)
+	{
+		*fm = fi.metrics;
+	}
+	return fi.font;
 }
 
 uint_ptr document::get_font( const font_description& descr, font_metrics* fm )
@@ -612,9 +1536,7 @@ uint_ptr document::get_font( const font_description& descr, font_metrics* fm )
 		return 0;
 	}
 
-	auto key = descr.hash();
-
-	auto el = m_fonts.find(key);
+	auto el = m_fonts.find(descr);
 
 	if(el != m_fonts.end())
 	{
@@ -644,11 +1566,19 @@ pixel_t document::render( pixel_t max_width, render_type rt, bool incremental_la
 	PROFILE_RESET();
 	PROFILE_SCOPE("document::render (total)");
 
+	if (m_loading && m_loading->render_tree_stale)
+	{
+		m_loading->render_tree_stale = false;
+		rebuild_render_tree();
+	}
+
 	pixel_t ret = 0;
 	if(m_root && m_root_render)
 	{
 		// Increment layout generation for cache invalidation
 		layout_generation::increment();
+		invalidate_layers();
+		m_layout_generation++;
 
 		position viewport;
 		m_container->get_viewport(viewport);
@@ -690,6 +1620,10 @@ pixel_t document::render( pixel_t max_width, render_type rt, bool incremental_la
 				m_content_size.height = 0;
 				m_root_render->calc_document_size(m_size, m_content_size);
 			}
+			for (const auto& list : m_virtual_lists)
+			{
+				list->measure();
+			}
 		}
 	}
 
@@ -702,12 +1636,132 @@ pixel_t document::render( pixel_t max_width, render_type rt, bool incremental_la
 	return ret;
 }
 
+// https://html.spec.whatwg.org/multipage/urls-and-fetching.html#lazy-loading-attributes
+bool lazy_images_policy::is_lazy(const char* loading) const
+{
+	if(!enabled) return false;
+
+	if(loading)
+	{
+		if(t_strcasecmp(loading, "lazy") == 0) return true;
+		if(t_strcasecmp(loading, "eager") == 0) return false;
+	}
+	return all_images;
+}
+
+void document::add_lazy_image(const std::shared_ptr<el_image>& el)
+{
+	m_lazy_images.push_back({el, position()});
+	m_lazy_generation = 0;
+}
+
+bool document::update_lazy_images()
+{
+	if(m_lazy_images.empty() || !m_root_render) return false;
+
+	// Boxes are updated once per layout, images without render items are moved to the end
+	if(m_lazy_generation != m_layout_generation)
+	{
+		for(auto& item : m_lazy_images)
+		{
+			auto el = item.el.lock();
+			bool rendered = false;
+			if(el && el->css().get_display() != display_none)
+			{
+				for(const auto& ri : el->m_renders)
+				{
+					if(!ri.expired())
+					{
+						rendered = true;
+						break;
+					}
+				}
+			}
+			item.box = rendered ? el->get_placement() : position(0, std::numeric_limits<pixel_t>::max(), 0, 0);
+		}
+		std::stable_sort(m_lazy_images.begin(), m_lazy_images.end(),
+			[](const lazy_image& a, const lazy_image& b) { return a.box.y < b.box.y; });
+		m_lazy_generation = m_layout_generation;
+	}
+
+	position viewport;
+	m_container->get_viewport(viewport);
+	pixel_t margin = m_lazy_images_policy.margin;
+	position range(viewport.x - margin, viewport.y - margin, viewport.width + margin * 2, viewport.height + margin * 2);
+
+	// Images are loaded after the list is updated, the container can add new lazy images
+	std::vector<std::shared_ptr<el_image>> visible;
+	for(auto& item : m_lazy_images)
+	{
+		if(item.box.y > range.bottom()) break;
+		if(item.box.bottom() >= range.y && item.box.right() >= range.x && item.box.x <= range.right())
+		{
+			if(auto el = item.el.lock())
+			{
+				visible.push_back(el);
+			}
+			item.el.reset();
+		}
+	}
+	m_lazy_images.erase(std::remove_if(m_lazy_images.begin(), m_lazy_images.end(),
+		[](const lazy_image& item) { return item.el.expired(); }), m_lazy_images.end());
+
+	for(const auto& el : visible)
+	{
+		el->load_lazy();
+	}
+	return !visible.empty();
+}
+
+bool document::set_virtual_list(const element::ptr& el, const std::shared_ptr<virtual_list_source>& source)
+{
+	if (!el || el->get_document().get() != this) return false;
+
+	m_virtual_lists.erase(std::remove_if(m_virtual_lists.begin(), m_virtual_lists.end(),
+		[&el](const std::unique_ptr<virtual_list>& list) { auto item = list->list(); return !item || item == el; }),
+		m_virtual_lists.end());
+	if (source)
+	{
+		auto list = std::make_unique<virtual_list>(this, el, source);
+		if (!list->init()) return false;
+		m_virtual_lists.push_back(std::move(list));
+	}
+	rebuild_render_tree();
+	return true;
+}
+
+bool document::update_virtual_lists()
+{
+	if (m_virtual_lists.empty()) return false;
+
+	position viewport;
+	m_container->get_viewport(viewport);
+	bool changed = false;
+	for (const auto& list : m_virtual_lists)
+	{
+		if (list->update(viewport)) changed = true;
+	}
+	if (changed)
+	{
+		rebuild_render_tree();
+	}
+	return changed;
+}
+
 void document::draw( uint_ptr hdc, pixel_t x, pixel_t y, const position* clip )
 {
 	if(m_root && m_root_render)
 	{
+		update_lazy_images();
+#ifdef LITEHTML_PROFILE_PAINT
+		position frame_box;
+		m_container->get_viewport(frame_box);
+		frame_box = clip ? *clip : position(0, 0, frame_box.width, frame_box.height);
+		PAINT_PROFILE_BEGIN_FRAME(frame_box);
+#endif
 		m_root->draw(hdc, x, y, clip, m_root_render);
 		m_root_render->draw_stacking_context(hdc, x, y, clip, true);
+		PAINT_PROFILE_END_FRAME();
 	}
 }
 
@@ -826,6 +1880,18 @@ void document::add_stylesheet( const char* str, const char* baseurl, const char*
 	}
 }
 
+element::ptr document::get_element_by_point(pixel_t x, pixel_t y, pixel_t client_x, pixel_t client_y)
+{
+	if(!m_root_render) return nullptr;
+
+	if(m_hit_generation != m_layout_generation)
+	{
+		m_root_render->build_hit_index(m_layout_generation);
+		m_hit_generation = m_layout_generation;
+	}
+	return m_root_render->get_element_by_point(x, y, client_x, client_y);
+}
+
 bool document::on_mouse_over( pixel_t x, pixel_t y, pixel_t client_x, pixel_t client_y, position::vector& redraw_boxes )
 {
 	if(!m_root || !m_root_render)
@@ -833,7 +1899,7 @@ bool document::on_mouse_over( pixel_t x, pixel_t y, pixel_t client_x, pixel_t cl
 		return false;
 	}
 
-	element::ptr over_el = m_root_render->get_element_by_point(x, y, client_x, client_y);
+	element::ptr over_el = get_element_by_point(x, y, client_x, client_y);
 
 	bool state_was_changed = false;
 
@@ -866,7 +1932,7 @@ bool document::on_mouse_over( pixel_t x, pixel_t y, pixel_t client_x, pixel_t cl
 	if(state_was_changed)
 	{
 		m_container->on_mouse_event(m_over_element, mouse_event_enter);
-		return m_root->find_styles_changes(redraw_boxes);
+		return find_styles_changes(redraw_boxes);
 	}
 	return false;
 }
@@ -884,7 +1950,7 @@ bool document::on_mouse_leave( position::vector& redraw_boxes )
 		if(el->on_mouse_leave())
 		{
 			m_container->on_mouse_event(el, mouse_event_leave);
-			return m_root->find_styles_changes(redraw_boxes);
+			return find_styles_changes(redraw_boxes);
 		}
 	}
 	return false;
@@ -897,7 +1963,7 @@ bool document::on_lbutton_down( pixel_t x, pixel_t y, pixel_t client_x, pixel_t
 		return false;
 	}
 
-	element::ptr over_el = m_root_render->get_element_by_point(x, y, client_x, client_y);
+	element::ptr over_el = get_element_by_point(x, y, client_x, client_y);
     m_active_element = over_el;
 
 	bool state_was_changed = false;
@@ -938,7 +2004,7 @@ bool document::on_lbutton_down( pixel_t x, pixel_t y, pixel_t client_x, pixel_t
 	if(state_was_changed)
 	{
 		m_container->on_mouse_event(m_over_element, mouse_event_enter);
-		return m_root->find_styles_changes(redraw_boxes);
+		return find_styles_changes(redraw_boxes);
 	}
 
 	return false;
@@ -954,7 +2020,7 @@ bool document::on_lbutton_up( pixel_t /*x*/, pixel_t /*y*/, pixel_t /*client_x*/
 	{
 		if(m_over_element->on_lbutton_up(m_active_element == m_over_element))
 		{
-			return m_root->find_styles_changes(redraw_boxes);
+			return find_styles_changes(redraw_boxes);
 		}
 	}
 	return false;
@@ -978,15 +2044,149 @@ void document::add_fixed_box( const position& pos )
 bool document::media_changed()
 {
 	container()->get_media_features(m_media);
-	if (update_media_lists(m_media))
+
+	// A resize between two breakpoints of the media queries changes nothing
+	uint32_t changed = m_media_breakpoints.changed(m_media);
+	if (!changed) return false;
+
+	std::unordered_set<const media_query_list_list*> updated;
+	if (update_media_lists(m_media, changed, &updated))
 	{
-		m_root->refresh_styles();
-		m_root->compute_styles();
+		// computed lengths may depend on the viewport (vw, vh units)
+		m_style_cache.clear();
+		restyle_media_elements(updated);
+		collect_rule_tree();
 		return true;
 	}
 	return false;
 }
 
+// Restyles the elements matching the selectors of the lists, with their subtrees
+void document::restyle_media_elements(const std::unordered_set<const media_query_list_list*>& lists)
+{
+	if (!m_root) return;
+
+	std::vector<element*> stack = {m_root.get()};
+	while (!stack.empty())
+	{
+		element* el = stack.back();
+		stack.pop_back();
+
+		bool affected = false;
+		for (const auto& usel : el->m_used_styles)
+		{
+			if (usel->m_selector->m_media_query && lists.count(usel->m_selector->m_media_query.get()))
+			{
+				affected = true;
+				break;
+			}
+		}
+		if (affected)
+		{
+			size_t count = push_ancestors(*el);
+			el->refresh_styles();
+			pop_ancestors(count);
+			el->compute_styles();
+			continue;
+		}
+		for (const auto& child : el->m_children)
+		{
+			if (child->css().get_display() != display_inline_text)
+			{
+				stack.push_back(child.get());
+			}
+		}
+	}
+}
+
+void document::restyle_subtree(const element::ptr& el)
+{
+	// The selectors are matched again, attributes like class may have changed
+	std::vector<element*> stack = {el.get()};
+	while (!stack.empty())
+	{
+		element* item = stack.back();
+		stack.pop_back();
+		item->m_used_styles.clear();
+		for (const auto& child : item->m_children)
+		{
+			stack.push_back(child.get());
+		}
+	}
+
+	size_t count = push_ancestors(*el);
+	el->refresh_styles();
+	el->apply_stylesheet(m_master_css->styles());
+	el->parse_attributes();
+	el->apply_stylesheet(m_styles);
+	el->apply_stylesheet(m_user_css->styles());
+	pop_ancestors(count);
+	el->compute_styles();
+	if (m_rule_tree.needs_collect())
+	{
+		collect_rule_tree();
+	}
+}
+
+size_t document::push_ancestors(const element& el)
+{
+	std::vector<element::ptr> ancestors;
+	for (auto item = el.parent(); item; item = item->parent())
+	{
+		ancestors.push_back(item);
+	}
+	for (auto it = ancestors.rbegin(); it != ancestors.rend(); ++it)
+	{
+		auto tag = dynamic_cast<html_tag*>(it->get());
+		m_selector_filter.push_element((*it)->tag(), (*it)->id(), tag ? tag->classes() : vector<string_id>());
+	}
+	return ancestors.size();
+}
+
+void document::pop_ancestors(size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		m_selector_filter.pop_element();
+	}
+}
+
+bool document::find_styles_changes(position::vector& redraw_boxes)
+{
+	bool ret = m_root->find_styles_changes(redraw_boxes);
+	// Hover and active changes match new rule lists, drop the ones left behind
+	if (ret && m_rule_tree.needs_collect())
+	{
+		collect_rule_tree();
+	}
+	return ret;
+}
+
+void document::collect_rule_tree()
+{
+	// While loading, elements waiting to be attached still reference their rule nodes
+	if (!m_root || m_loading) return;
+
+	std::unordered_set<const rule_node*> live_nodes;
+	std::unordered_set<size_t> live_ids;
+	std::vector<element*> stack = {m_root.get()};
+	while (!stack.empty())
+	{
+		element* el = stack.back();
+		stack.pop_back();
+		if (auto tag = dynamic_cast<html_tag*>(el))
+		{
+			if (tag->m_rule_node) live_nodes.insert(tag->m_rule_node);
+			if (tag->m_style_id) live_ids.insert(tag->m_style_id);
+		}
+		for (const auto& child : el->m_children)
+		{
+			stack.push_back(child.get());
+		}
+	}
+	m_rule_tree.collect(live_nodes, live_ids);
+}
+
 bool document::lang_changed()
 {
 	if (!m_media_lists.empty())
@@ -1003,29 +2203,43 @@ bool document::lang_changed()
 		}
 		m_root->refresh_styles();
 		m_root->compute_styles();
+		collect_rule_tree();
 		return true;
 	}
 	return false;
 }
 
 // Apply media features (determine which selectors are active).
-bool document::update_media_lists(const media_features& features)
+bool document::update_media_lists(const media_features& features, uint32_t changed, std::unordered_set<const media_query_list_list*>* updated)
 {
 	bool update_styles = false;
 	for (auto& media_list : m_media_lists)
 	{
-		if (media_list->apply_media_features(features))
+		// Lists without dependencies are evaluated once, by the full evaluation
+		if (changed != media_dep_all && !(media_list->dependencies() & changed)) continue;
+
+		bool used = media_list->check(features);
+		if (used != is_media_list_used(media_list.get()))
 		{
+			if (used)
+				m_used_media_lists.insert(media_list.get());
+			else
+				m_used_media_lists.erase(media_list.get());
+			if (updated) updated->insert(media_list.get());
 			update_styles = true;
 		}
 	}
+	m_media_breakpoints.update(features);
 	return update_styles;
 }
 
 void document::add_media_list(media_query_list_list::ptr list)
 {
 	if (list && !contains(m_media_lists, list))
+	{
 		m_media_lists.push_back(list);
+		m_media_breakpoints.add(*list);
+	}
 }
 
 void document::add_keyframes(const keyframes_rule& rule)
@@ -1043,18 +2257,291 @@ const keyframes_rule* document::get_keyframes(const string& name) const
 
 bool document::advance_animations(double current_time_ms)
 {
-	bool any_active = m_animation_controller.advance(current_time_ms);
+	position::vector redraw_boxes;
+	bool relayout = false;
+	return advance_animations(current_time_ms, redraw_boxes, relayout);
+}
+
+// Transition and keyframe animation values are written into the computed styles of the elements.
+// Opacity, transform and colors are only painted, for them the areas to repaint are returned
+// and render() is not needed. Other transitioned properties set relayout, keyframe animations
+// apply only the painted properties.
+bool document::advance_animations(double current_time_ms, position::vector& redraw_boxes, bool& relayout)
+{
+	m_animation_time = current_time_ms;
+	relayout = false;
+	bool repaint_layers = false;
 
-	// If there are active animations, request a re-render
-	if (any_active && m_root && m_root_render)
+	auto add_paint_boxes = [&](const element* el)
 	{
-		// Recompute styles for elements with active animations
-		// (simplified - in production would only update affected elements)
-	}
+		for (const auto& weak_ri : el->m_renders)
+		{
+			if (auto ri = weak_ri.lock())
+			{
+				ri->get_paint_boxes(redraw_boxes);
+			}
+		}
+	};
+
+	// Writes a paint-only value, returns false for other properties
+	auto set_paint_value = [&](element* el, const keyframe_value& value)
+	{
+		css_properties& css = el->css_w();
+		switch (value.property)
+		{
+		case _opacity_:
+			if (css.get_opacity() == value.number) return true;
+			// Opacity below 1 creates a stacking context, see render_item::add_positioned
+			if ((value.number < 1.0f) != (css.get_opacity() < 1.0f))
+			{
+				relayout = true;
+			}
+			// The area before and after the change
+			add_paint_boxes(el);
+			css.set_opacity(value.number);
+			add_paint_boxes(el);
+			return true;
+		case _transform_:
+			add_paint_boxes(el);
+			css.set_transform_matrix(value.transform);
+			add_paint_boxes(el);
+			return true;
+		case _color_:
+			{
+				if (css.get_color() == value.color) return true;
+				// Text is painted with the color of its parent. Descendants without their own color
+				// inherit the new one, the ones that set it keep it even if it is the same.
+				std::vector<element*> stack = {el};
+				while (!stack.empty())
+				{
+					element* cur = stack.back();
+					stack.pop_back();
+					cur->css_w().set_color(value.color);
+					for (const auto& child : cur->m_children)
+					{
+						auto tag = dynamic_cast<html_tag*>(child.get());
+						if (!tag) continue;
+						const property_value& cascaded = tag->cascaded_style().get_property(_color_);
+						if (cascaded.is<invalid>() || cascaded.is<inherit>())
+						{
+							stack.push_back(tag);
+						}
+					}
+				}
+			}
+			break;
+		case _background_color_:
+			if (css.get_bg().m_color == value.color) return true;
+			css.set_bg_color(value.color);
+			break;
+		default:
+			return false;
+		}
+		add_paint_boxes(el);
+		// Composited ancestors have to paint the new color into their layers
+		repaint_layers = true;
+		return true;
+	};
+
+	auto apply = [&](element* el, const transition_state& state, float progress)
+	{
+		if (state.is_transform || state.is_color || state.property == _opacity_)
+		{
+			keyframe_value paint;
+			paint.property = state.is_transform ? _transform_ : state.property;
+			if (state.is_transform)
+			{
+				paint.transform = state.get_transform(progress);
+			} else if (state.is_color)
+			{
+				paint.color = interpolate::color(state.from_color, state.to_color, progress);
+			} else
+			{
+				paint.number = interpolate::number(state.from_value, state.to_value, progress);
+			}
+			set_paint_value(el, paint);
+			return;
+		}
+		css_properties& css = el->css_w();
+		css_length value(interpolate::number(state.from_value, state.to_value, progress), state.value_units);
+		switch (state.property)
+		{
+		case _width_:	css.set_width(value);	break;
+		case _height_:	css.set_height(value);	break;
+		case _left_:
+		case _top_:
+		case _right_:
+		case _bottom_:
+			{
+				css_offsets offsets = css.get_offsets();
+				css_length& len = state.property == _left_ ? offsets.left : state.property == _top_ ? offsets.top :
+					state.property == _right_ ? offsets.right : offsets.bottom;
+				len = value;
+				css.set_offsets(offsets);
+			}
+			break;
+		case _margin_left_:
+		case _margin_top_:
+		case _margin_right_:
+		case _margin_bottom_:
+		case _padding_left_:
+		case _padding_top_:
+		case _padding_right_:
+		case _padding_bottom_:
+			{
+				bool margin = state.property == _margin_left_ || state.property == _margin_top_ ||
+					state.property == _margin_right_ || state.property == _margin_bottom_;
+				css_margins box = margin ? css.get_margins() : css.get_padding();
+				switch (state.property)
+				{
+				case _margin_left_:	case _padding_left_:	box.left = value;	break;
+				case _margin_top_:	case _padding_top_:		box.top = value;	break;
+				case _margin_right_:	case _padding_right_:	box.right = value;	break;
+				default:											box.bottom = value;	break;
+				}
+				if (margin) css.set_margins(box); else css.set_padding(box);
+			}
+			break;
+		default:
+			// Not supported
+			return;
+		}
+		relayout = true;
+	};
 
+	auto apply_animation = [&](element* el, animation_state& anim, float progress)
+	{
+		if (!anim.resolved)
+		{
+			resolve_keyframes(el, anim);
+		}
+		if (progress < 0)
+		{
+			for (const auto& value : anim.base_values)
+			{
+				set_paint_value(el, value);
+			}
+			return;
+		}
+		// Interpolates between the keyframes around the progress, for every property
+		const auto& values = anim.values;
+		for (size_t first = 0; first < values.size(); )
+		{
+			size_t last = first;
+			while (last + 1 < values.size() && values[last + 1].property == values[first].property) last++;
+
+			size_t to = first;
+			while (to < last && values[to].offset < progress) to++;
+			size_t from = to > first && values[to].offset > progress ? to - 1 : to;
+			const keyframe_value& a = values[from];
+			const keyframe_value& b = values[to];
+			float t = b.offset > a.offset ? (progress - a.offset) / (b.offset - a.offset) : 1.0f;
+			t = std::min(std::max(t, 0.0f), 1.0f);
+
+			keyframe_value value = b;
+			value.number = interpolate::number(a.number, b.number, t);
+			value.color = interpolate::color(a.color, b.color, t);
+			value.transform = interpolate_transform(a.transform, b.transform, t);
+			set_paint_value(el, value);
+
+			first = last + 1;
+		}
+	};
+
+	bool any_active = m_animation_controller.advance(current_time_ms, apply, apply_animation);
+	if (repaint_layers)
+	{
+		invalidate_layers();
+	}
 	return any_active;
 }
 
+// Parses the painted properties of the keyframes. The computed values of the element are the base
+// values: keyframes without 0% or 100% animate from or to them, and they are restored when the
+// animation doesn't apply.
+void document::resolve_keyframes(element* el, animation_state& anim)
+{
+	anim.resolved = true;
+	const keyframes_rule* rule = get_keyframes(anim.name);
+	if (!rule) return;
+
+	const css_properties& css = el->css();
+	auto base_value = [&](string_id property)
+	{
+		keyframe_value value;
+		value.property = property;
+		value.number = css.get_opacity();
+		value.color = property == _color_ ? css.get_color() : css.get_bg().m_color;
+		value.transform = css.get_transform_matrix();
+		return value;
+	};
+
+	for (const auto& frame : rule->keyframes)
+	{
+		for (const auto& prop : frame.properties)
+		{
+			keyframe_value value;
+			value.property = _id(prop.first);
+			value.offset = frame.offset;
+			switch (value.property)
+			{
+			case _opacity_:
+				{
+					char* end = nullptr;
+					value.number = strtof(prop.second.c_str(), &end);
+					if (end == prop.second.c_str()) continue;
+					if (*end == '%') value.number /= 100;
+					value.number = std::min(std::max(value.number, 0.0f), 1.0f);
+				}
+				break;
+			case _color_:
+			case _background_color_:
+				{
+					auto tokens = normalize(prop.second, f_componentize | f_remove_whitespace);
+					if (tokens.size() != 1 || !parse_color(tokens[0], value.color, container())) continue;
+					if (value.color.is_current_color) value.color = css.get_color();
+				}
+				break;
+			case _transform_:
+				value.transform = CSSTransform::parse(prop.second);
+				break;
+			default:
+				// Not painted only
+				continue;
+			}
+			anim.values.push_back(value);
+		}
+	}
+	std::stable_sort(anim.values.begin(), anim.values.end(), [](const keyframe_value& a, const keyframe_value& b)
+		{
+			return a.property != b.property ? a.property < b.property : a.offset < b.offset;
+		});
+
+	// Implicit 0% and 100% keyframes
+	size_t count = anim.values.size();
+	for (size_t i = 0; i < count; i++)
+	{
+		string_id property = anim.values[i].property;
+		if (i == 0 || anim.values[i - 1].property != property)
+		{
+			anim.base_values.push_back(base_value(property));
+			if (anim.values[i].offset > 0)
+			{
+				anim.values.push_back(anim.base_values.back());
+			}
+		}
+		if ((i + 1 == count || anim.values[i + 1].property != property) && anim.values[i].offset < 1)
+		{
+			anim.values.push_back(base_value(property));
+			anim.values.back().offset = 1;
+		}
+	}
+	std::stable_sort(anim.values.begin(), anim.values.end(), [](const keyframe_value& a, const keyframe_value& b)
+		{
+			return a.property != b.property ? a.property < b.property : a.offset < b.offset;
+		});
+}
+
 void document::fix_tables_layout()
 {
 	for (const auto& el_ptr : m_tabular_elements)
@@ -1103,31 +2590,26 @@ void document::fix_table_children(const std::shared_ptr<render_item>& el_ptr, st
 
 	auto flush_elements = [&]()
 	{
-		element::ptr annon_tag = std::make_shared<html_tag>(el_ptr->src_el(), string("display:") + disp_str);
+		element::ptr annon_tag = std::make_shared<html_tag>(el_ptr->src_el()->shared_from_this(), string("display:") + disp_str);
 		std::shared_ptr<render_item> annon_ri;
 		if(annon_tag->css().get_display() == display_table_cell)
 		{
 			annon_tag->set_tagName("table_cell");
-			annon_ri = std::make_shared<render_item_block>(annon_tag);
+			annon_ri = make_anonymous_render_item<render_item_block>(annon_tag);
 		} else if(annon_tag->css().get_display() == display_table_row)
 		{
-			annon_ri = std::make_shared<render_item_table_row>(annon_tag);
+			annon_ri = make_anonymous_render_item<render_item_table_row>(annon_tag);
 		} else
 		{
-			annon_ri = std::make_shared<render_item_table_part>(annon_tag);
-		}
-		for(const auto& el : tmp)
-		{
-			annon_ri->add_child(el);
+			annon_ri = make_anonymous_render_item<render_item_table_part>(annon_tag);
 		}
 		// add annon item as tabular for future processing
 		add_tabular(annon_ri);
-		annon_ri->parent(el_ptr);
-		first_iter = el_ptr->children().insert(first_iter, annon_ri);
-		cur_iter = std::next(first_iter);
-		while (cur_iter != el_ptr->children().end() && (*cur_iter)->parent() != el_ptr)
+		el_ptr->children().insert(first_iter, annon_ri);
+		// The elements are moved from el_ptr, cur_iter is not one of them
+		for(const auto& el : tmp)
 		{
-			cur_iter = el_ptr->children().erase(cur_iter);
+			annon_ri->add_child(el);
 		}
 		first_iter = cur_iter;
 		tmp.clear();
@@ -1171,16 +2653,7 @@ void document::fix_table_parent(const std::shared_ptr<render_item>& el_ptr, styl
 
 	if (parent->src_el()->css().get_display() != disp)
 	{
-		auto this_element = std::find_if(parent->children().begin(), parent->children().end(),
-			[&](const std::shared_ptr<render_item>& el)
-			{
-				if (el == el_ptr)
-				{
-					return true;
-				}
-				return false;
-			}
-		);
+		auto this_element = parent->children().find(el_ptr.get());
 		if (this_element != parent->children().end())
 		{
 			style_display el_disp = el_ptr->src_el()->css().get_display();
@@ -1221,28 +2694,25 @@ void document::fix_table_parent(const std::shared_ptr<render_item>& el_ptr, styl
 			}
 
 			// extract elements with the same display and wrap them with anonymous object
-			element::ptr annon_tag = std::make_shared<html_tag>(parent->src_el(), string("display:") + disp_str);
+			element::ptr annon_tag = std::make_shared<html_tag>(parent->src_el()->shared_from_this(), string("display:") + disp_str);
 			std::shared_ptr<render_item> annon_ri;
 			if(annon_tag->css().get_display() == display_table || annon_tag->css().get_display() == display_inline_table)
 			{
-				annon_ri = std::make_shared<render_item_table>(annon_tag);
+				annon_ri = make_anonymous_render_item<render_item_table>(annon_tag);
 			} else if(annon_tag->css().get_display() == display_table_row)
 			{
-				annon_ri = std::make_shared<render_item_table_row>(annon_tag);
+				annon_ri = make_anonymous_render_item<render_item_table_row>(annon_tag);
 			} else
 			{
-				annon_ri = std::make_shared<render_item_table_part>(annon_tag);
+				annon_ri = make_anonymous_render_item<render_item_table_part>(annon_tag);
 			}
-			std::for_each(first, std::next(last, 1),
-				[&annon_ri](std::shared_ptr<render_item>& el)
-				{
-					annon_ri->add_child(el);
-				}
-			);
-			first = parent->children().erase(first, std::next(last));
 			parent->children().insert(first, annon_ri);
+			for (auto end = std::next(last); first != end;)
+			{
+				auto el = *first++;
+				annon_ri->add_child(el);
+			}
 			add_tabular(annon_ri);
-			annon_ri->parent(parent);
 		}
 	}
 }
@@ -1272,7 +2742,7 @@ void document::append_children_from_string(element& parent, const char* str)
 		parent.appendChild(child);
 
 		// apply master CSS
-		child->apply_stylesheet(m_master_css);
+		child->apply_stylesheet(m_master_css->styles());
 
 		// parse elements attributes
 		child->parse_attributes();
@@ -1281,7 +2751,7 @@ void document::append_children_from_string(element& parent, const char* str)
 		child->apply_stylesheet(m_styles);
 
 		// Apply user styles if any
-		child->apply_stylesheet(m_user_css);
+		child->apply_stylesheet(m_user_css->styles());
 
 		// Initialize m_css
 		child->compute_styles();
@@ -1296,6 +2766,24 @@ void document::append_children_from_string(element& parent, const char* str)
 	}
 }
 
+// Parses html in the context of the element, the elements are not styled
+elements_list document::parse_fragment(const string& html, const element& context)
+{
+	GumboOptions options = kGumboDefaultOptions;
+	options.fragment_context = gumbo_tag_enum(context.get_tagName());
+	GumboOutput* output = gumbo_parse_with_options(&options, html.data(), html.size());
+
+	// The fragment nodes are the children of the root
+	elements_list elements;
+	GumboVector& children = output->root->v.element.children;
+	for (size_t i = 0; i < children.length; i++)
+	{
+		create_node(children.data[i], elements, true);
+	}
+	gumbo_destroy_output(&options, output);
+	return elements;
+}
+
 void document::dump(dumper& cout)
 {
 	if(m_root_render)
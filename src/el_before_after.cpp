@@ -14,8 +14,9 @@ void litehtml::el_before_after_base::add_style(const style& style)
 {
 	html_tag::add_style(style);
 
-	auto children = m_children;
+	elements_list children(m_children.begin(), m_children.end());
 	m_children.clear();
+	get_document()->get_element_index().invalidate();
 
 	const auto& content_property = style.get_property(_content_);
 	if(content_property.is<string>() && !content_property.get<string>().empty())
@@ -74,7 +75,10 @@ void litehtml::el_before_after_base::add_style(const style& style)
 
 	if(m_children.empty())
 	{
-		m_children = children;
+		for(const auto& el : children)
+		{
+			m_children.push_back(el);
+		}
 	}
 }
 
@@ -3,6 +3,7 @@
 #include "render_item.h"
 #include "render_image.h"
 #include "document_container.h"
+#include "paint_profiler.h"
 
 namespace litehtml
 {
@@ -114,6 +115,7 @@ void el_button::draw(uint_ptr hdc, pixel_t x, pixel_t y, const position* clip, c
 			state.line_height = c.get_font_metrics().height;
 		}
 
+		PAINT_PROFILE_DRAW(draw_form_control, pos);
 		get_document()->container()->draw_form_control(hdc, form_control_button, pos, state);
 	}
 }
@@ -136,7 +138,7 @@ string el_button::dump_get_name()
 
 std::shared_ptr<render_item> el_button::create_render_item(const std::shared_ptr<render_item>& parent_ri)
 {
-	auto ret = std::make_shared<render_item_image>(shared_from_this());
+	auto ret = make_render_item<render_item_image>(this);
 	ret->parent(parent_ri);
 	return ret;
 }
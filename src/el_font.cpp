@@ -12,13 +12,13 @@ void litehtml::el_font::parse_attributes()
 	const char* str = get_attr("color");
 	if(str)
 	{
-		m_style.add_property(_color_, str, "", false, get_document()->container());
+		local_style().add_property(_color_, str, "", false, get_document()->container());
 	}
 
 	str = get_attr("face");
 	if(str)
 	{
-		m_style.add_property(_font_family_, str);
+		local_style().add_property(_font_family_, str);
 	}
 
 	str = get_attr("size");
@@ -29,25 +29,25 @@ void litehtml::el_font::parse_attributes()
 
 		if(sz <= 1)
 		{
-			m_style.add_property(_font_size_, "x-small");
+			local_style().add_property(_font_size_, "x-small");
 		} else if(sz >= 6)
 		{
-			m_style.add_property(_font_size_, "xx-large");
+			local_style().add_property(_font_size_, "xx-large");
 		} else
 		{
 			switch(sz)
 			{
 			case 2:
-				m_style.add_property(_font_size_, "small");
+				local_style().add_property(_font_size_, "small");
 				break;
 			case 3:
-				m_style.add_property(_font_size_, "medium");
+				local_style().add_property(_font_size_, "medium");
 				break;
 			case 4:
-				m_style.add_property(_font_size_, "large");
+				local_style().add_property(_font_size_, "large");
 				break;
 			case 5:
-				m_style.add_property(_font_size_, "x-large");
+				local_style().add_property(_font_size_, "x-large");
 				break;
 			}
 		}
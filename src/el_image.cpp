@@ -1,6 +1,7 @@
 #include "el_image.h"
 #include "render_image.h"
 #include "document_container.h"
+#include "paint_profiler.h"
 
 litehtml::el_image::el_image(const document::ptr& doc) : html_tag(doc)
 {
@@ -91,6 +92,7 @@ void litehtml::el_image::draw(uint_ptr hdc, pixel_t x, pixel_t y, const position
 			layer.border_box += ri->get_borders();
 			layer.repeat = background_repeat_no_repeat;
 			layer.border_radius = css().get_borders().radius.calc_percents(layer.border_box.width, layer.border_box.height);
+			PAINT_PROFILE_DRAW(draw_image, layer.border_box);
 			get_document()->container()->draw_image(hdc, layer, m_src, {});
 		}
 	}
@@ -100,15 +102,42 @@ void litehtml::el_image::compute_styles(bool recursive, bool use_cache)
 {
 	html_tag::compute_styles(recursive, use_cache);
 
-	if(!m_src.empty())
+	if(m_src.empty() || m_lazy == lazy_waiting)
 	{
-		if(!css().get_height().is_predefined() && !css().get_width().is_predefined())
-		{
-			get_document()->container()->load_image(m_src.c_str(), nullptr, true);
-		} else
-		{
-			get_document()->container()->load_image(m_src.c_str(), nullptr, false);
-		}
+		return;
+	}
+	if(m_lazy == lazy_none && is_lazy())
+	{
+		// The box keeps the size of the width/height attributes until the image is loaded
+		m_lazy = lazy_waiting;
+		get_document()->add_lazy_image(std::static_pointer_cast<el_image>(shared_from_this()));
+		return;
+	}
+	load_image();
+}
+
+void litehtml::el_image::load_lazy()
+{
+	if(m_lazy != lazy_waiting) return;
+
+	m_lazy = lazy_loaded;
+	get_document()->container()->on_image_near_viewport(shared_from_this(), m_src.c_str());
+	load_image();
+}
+
+bool litehtml::el_image::is_lazy() const
+{
+	return get_document()->lazy_images().is_lazy(get_attr("loading"));
+}
+
+void litehtml::el_image::load_image()
+{
+	if(!css().get_height().is_predefined() && !css().get_width().is_predefined())
+	{
+		get_document()->container()->load_image(m_src.c_str(), nullptr, true);
+	} else
+	{
+		get_document()->container()->load_image(m_src.c_str(), nullptr, false);
 	}
 }
 
@@ -119,7 +148,7 @@ litehtml::string litehtml::el_image::dump_get_name()
 
 std::shared_ptr<litehtml::render_item> litehtml::el_image::create_render_item(const std::shared_ptr<render_item>& parent_ri)
 {
-	auto ret = std::make_shared<render_item_image>(shared_from_this());
+	auto ret = make_render_item<render_item_image>(this);
 	ret->parent(parent_ri);
 	return ret;
 }
\ No newline at end of file
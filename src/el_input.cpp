@@ -3,6 +3,7 @@
 #include "render_item.h"
 #include "render_image.h"  // For render_item_image (used for replaced elements)
 #include "document_container.h"
+#include "paint_profiler.h"
 
 namespace litehtml
 {
@@ -86,7 +87,7 @@ void el_input::parse_attributes()
 			// Approximate width based on character count
 			// This is a rough estimate - real browsers use font metrics
 			string width_str = std::to_string(size * 8) + "px";
-			m_style.add_property(_width_, width_str);
+			local_style().add_property(_width_, width_str);
 		}
 	}
 
@@ -221,6 +222,7 @@ void el_input::draw(uint_ptr hdc, pixel_t x, pixel_t y, const position* clip, co
 			state.track_color = state.border_color;  // Use border color for track
 		}
 
+		PAINT_PROFILE_DRAW(draw_form_control, pos);
 		get_document()->container()->draw_form_control(hdc, m_type, pos, state);
 	}
 }
@@ -254,7 +256,7 @@ string el_input::dump_get_name()
 std::shared_ptr<render_item> el_input::create_render_item(const std::shared_ptr<render_item>& parent_ri)
 {
 	// Use render_item_image for proper replaced element sizing
-	auto ret = std::make_shared<render_item_image>(shared_from_this());
+	auto ret = make_render_item<render_item_image>(this);
 	ret->parent(parent_ri);
 	return ret;
 }
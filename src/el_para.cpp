@@ -10,7 +10,7 @@ void litehtml::el_para::parse_attributes()
 	const char* str = get_attr("align");
 	if(str)
 	{
-		m_style.add_property(_text_align_, str);
+		local_style().add_property(_text_align_, str);
 	}
 
 	html_tag::parse_attributes();
@@ -3,6 +3,7 @@
 #include "render_item.h"
 #include "render_image.h"
 #include "document_container.h"
+#include "paint_profiler.h"
 
 namespace litehtml
 {
@@ -143,6 +144,7 @@ void el_select::draw(uint_ptr hdc, pixel_t x, pixel_t y, const position* clip, c
 		state.arrow_color = state.text_color;
 		state.arrow_size = c.get_font_size() / 2;  // Arrow size based on font
 
+		PAINT_PROFILE_DRAW(draw_form_control, pos);
 		get_document()->container()->draw_form_control(hdc, form_control_select, pos, state);
 	}
 }
@@ -183,7 +185,7 @@ string el_select::dump_get_name()
 
 std::shared_ptr<render_item> el_select::create_render_item(const std::shared_ptr<render_item>& parent_ri)
 {
-	auto ret = std::make_shared<render_item_image>(shared_from_this());
+	auto ret = make_render_item<render_item_image>(this);
 	ret->parent(parent_ri);
 	return ret;
 }
@@ -3,6 +3,7 @@
 #include "document_container.h"
 #include <functional>
 #include <sstream>
+#include "paint_profiler.h"
 
 // Static members
 std::unordered_map<litehtml::string, litehtml::el_svg*> litehtml::el_svg::s_registry;
@@ -90,6 +91,7 @@ void litehtml::el_svg::draw(uint_ptr hdc, pixel_t x, pixel_t y, const position *
 			layer.border_box += ri->get_borders();
 			layer.repeat = background_repeat_no_repeat;
 			layer.border_radius = css().get_borders().radius.calc_percents(layer.border_box.width, layer.border_box.height);
+			PAINT_PROFILE_DRAW(draw_image, layer.border_box);
 			get_document()->container()->draw_image(hdc, layer, m_svg_id, {});
 		}
 	}
@@ -121,7 +123,7 @@ litehtml::string litehtml::el_svg::dump_get_name()
 
 std::shared_ptr<litehtml::render_item> litehtml::el_svg::create_render_item(const std::shared_ptr<render_item>& parent_ri)
 {
-	auto ret = std::make_shared<render_item_image>(shared_from_this());
+	auto ret = make_render_item<render_item_image>(this);
 	ret->parent(parent_ri);
 	return ret;
 }
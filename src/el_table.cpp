@@ -39,7 +39,7 @@ namespace litehtml
 
 		// https://html.spec.whatwg.org/multipage/rendering.html#tables-2:attr-background
 		str = get_attr("bgcolor");
-		if(str) { m_style.add_property(_background_color_, str, "", false, get_document()->container()); }
+		if(str) { local_style().add_property(_background_color_, str, "", false, get_document()->container()); }
 
 		html_tag::parse_attributes();
 	}
@@ -27,25 +27,25 @@ void el_td::parse_attributes()
 		string url = "url('";
 		url += str;
 		url += "')";
-		m_style.add_property(_background_image_, url);
+		local_style().add_property(_background_image_, url);
 	}
 
 	str = get_attr("bgcolor");
 	if (str)
 	{
-		m_style.add_property(_background_color_, str, "", false, get_document()->container());
+		local_style().add_property(_background_color_, str, "", false, get_document()->container());
 	}
 
 	str = get_attr("align");
 	if(str)
 	{
-		m_style.add_property(_text_align_, str);
+		local_style().add_property(_text_align_, str);
 	}
 
 	str = get_attr("valign");
 	if(str)
 	{
-		m_style.add_property(_vertical_align_, str);
+		local_style().add_property(_vertical_align_, str);
 	}
 
 	html_tag::parse_attributes();
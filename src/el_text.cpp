@@ -2,6 +2,7 @@
 #include "el_text.h"
 #include "render_item.h"
 #include "document_container.h"
+#include "paint_profiler.h"
 
 litehtml::el_text::el_text(const char* text, const document::ptr& doc) : element(doc)
 {
@@ -166,12 +167,14 @@ void litehtml::el_text::draw(uint_ptr hdc, pixel_t x, pixel_t y, const position
 				if (!shadows.empty() || letter_spacing != 0 || word_spacing != 0)
 				{
 					// Use the extended draw method with shadows and spacing
+					PAINT_PROFILE_DRAW(draw_text, pos);
 					doc->container()->draw_text_with_shadows(hdc, text, font, color, pos,
 					                                         shadows, letter_spacing, word_spacing);
 				}
 				else
 				{
 					// Use simple draw_text
+					PAINT_PROFILE_DRAW(draw_text, pos);
 					doc->container()->draw_text(hdc, text, font, color, pos);
 				}
 			}
@@ -3,6 +3,7 @@
 #include "render_item.h"
 #include "render_image.h"
 #include "document_container.h"
+#include "paint_profiler.h"
 
 namespace litehtml
 {
@@ -135,6 +136,7 @@ void el_textarea::draw(uint_ptr hdc, pixel_t x, pixel_t y, const position* clip,
 		state.placeholder_color = state.text_color;
 		state.placeholder_color.alpha = 128;  // 50% opacity
 
+		PAINT_PROFILE_DRAW(draw_form_control, pos);
 		get_document()->container()->draw_form_control(hdc, form_control_textarea, pos, state);
 	}
 }
@@ -152,7 +154,7 @@ string el_textarea::dump_get_name()
 
 std::shared_ptr<render_item> el_textarea::create_render_item(const std::shared_ptr<render_item>& parent_ri)
 {
-	auto ret = std::make_shared<render_item_image>(shared_from_this());
+	auto ret = make_render_item<render_item_image>(this);
 	ret->parent(parent_ri);
 	return ret;
 }
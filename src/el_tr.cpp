@@ -16,17 +16,17 @@ void litehtml::el_tr::parse_attributes()
 	str = get_attr("align");
 	if(str)
 	{
-		m_style.add_property(_text_align_, str);
+		local_style().add_property(_text_align_, str);
 	}
 	str = get_attr("valign");
 	if(str)
 	{
-		m_style.add_property(_vertical_align_, str);
+		local_style().add_property(_vertical_align_, str);
 	}
 	str = get_attr("bgcolor");
 	if (str)
 	{
-		m_style.add_property(_background_color_, str, "", false, get_document()->container());
+		local_style().add_property(_background_color_, str, "", false, get_document()->container());
 	}
 	html_tag::parse_attributes();
 }
@@ -14,10 +14,24 @@ namespace litehtml
 #define LITEHTML_EMPTY_FUNC			{}
 #define LITEHTML_RETURN_FUNC(ret)	{return ret;}
 
-element::element(const document::ptr& doc) : m_doc(doc)
+element::element(const document::ptr& doc) : m_doc(doc), m_children(this)
 {
 }
 
+element::element(const element& src) :
+	std::enable_shared_from_this<element>(),
+	m_doc(src.m_doc),
+	m_children(this),
+	m_css(src.m_css),
+	m_counter_values(src.m_counter_values)
+{
+	m_used_styles.reserve(src.m_used_styles.size());
+	for (const auto& usel : src.m_used_styles)
+	{
+		m_used_styles.push_back(std::make_unique<used_selector>(usel->m_selector, usel->m_used));
+	}
+}
+
 position element::get_placement() const
 {
 	position pos;
@@ -180,29 +194,29 @@ std::shared_ptr<render_item> element::create_render_item(const std::shared_ptr<r
 	   css().get_display() == display_table_header_group ||
 	   css().get_display() == display_table_row_group)
 	{
-		ret = std::make_shared<render_item_table_part>(shared_from_this());
+		ret = make_render_item<render_item_table_part>(this);
 	} else if(css().get_display() == display_table_row)
 	{
-		ret = std::make_shared<render_item_table_row>(shared_from_this());
+		ret = make_render_item<render_item_table_row>(this);
 	} else if(css().get_display() == display_block ||
 				css().get_display() == display_table_cell ||
 				css().get_display() == display_table_caption ||
 				css().get_display() == display_list_item ||
 				css().get_display() == display_inline_block)
 	{
-		ret = std::make_shared<render_item_block>(shared_from_this());
+		ret = make_render_item<render_item_block>(this);
 	} else if(css().get_display() == display_table || css().get_display() == display_inline_table)
 	{
-		ret = std::make_shared<render_item_table>(shared_from_this());
+		ret = make_render_item<render_item_table>(this);
 	} else if(css().get_display() == display_inline || css().get_display() == display_inline_text)
 	{
-		ret = std::make_shared<render_item_inline>(shared_from_this());
+		ret = make_render_item<render_item_inline>(this);
 	} else if(css().get_display() == display_flex || css().get_display() == display_inline_flex)
 	{
-		ret = std::make_shared<render_item_flex>(shared_from_this());
+		ret = make_render_item<render_item_flex>(this);
 	} else if(css().get_display() == display_grid || css().get_display() == display_inline_grid)
 	{
-		ret = std::make_shared<render_item_grid>(shared_from_this());
+		ret = make_render_item<render_item_grid>(this);
 	}
 	if(ret)
 	{
@@ -235,9 +249,10 @@ std::shared_ptr<render_item> element::create_render_item(const std::shared_ptr<r
 
 bool element::requires_styles_update()
 {
+	auto doc = get_document();
 	for (const auto& used_style : m_used_styles)
 	{
-		if(used_style->m_selector->is_media_valid())
+		if(used_style->m_selector->is_media_valid(doc.get()))
 		{
 			int res = select(*(used_style->m_selector), true);
 			if( (res == select_no_match && used_style->m_used) || (res == select_match && !used_style->m_used) )
@@ -251,6 +266,8 @@ bool element::requires_styles_update()
 
 void element::add_render(const std::shared_ptr<render_item>& ri)
 {
+	// Drop the render items of the previous render trees (see document::rebuild_render_tree)
+	m_renders.remove_if([](const std::weak_ptr<render_item>& item) { return item.expired(); });
 	m_renders.push_back(ri);
 }
 
@@ -272,6 +289,9 @@ bool element::find_styles_changes( position::vector& redraw_boxes)
 					auto ri = weak_ri.lock();
 					if(ri)
 					{
+						// Hover and active restyles don't call render(), so composited layers
+						// holding the old pixels must be repainted
+						ri->invalidate_layers();
 						position::vector boxes;
 						ri->get_rendering_boxes(boxes);
 						for (auto &box: boxes)
@@ -287,7 +307,10 @@ bool element::find_styles_changes( position::vector& redraw_boxes)
 			fetch_boxes(el);
 		}
 
+		auto doc = get_document();
+		size_t count = doc->push_ancestors(*this);
 		refresh_styles();
+		doc->pop_ancestors(count);
 		compute_styles();
 		ret = true;
 	}
@@ -314,6 +337,7 @@ element::ptr element::_add_before_after(int type, const style& /*style*/)
 		m_children.insert(m_children.end(), el);
 	}
 	el->parent(shared_from_this());
+	get_document()->get_element_index().invalidate();
 	return el;
 }
 
@@ -348,7 +372,7 @@ bool element::is_block_formatting_context() const
 
 litehtml::string litehtml::element::get_counter_value(const string& counter_name)
 {
-	std::map<string_id, int>::iterator i;
+	flat_map<string_id, int>::iterator i;
 	if (find_counter(_id(counter_name), i))
 	{
 		return std::to_string(i->second);
@@ -389,7 +413,7 @@ string litehtml::element::get_counters_value(const string_vector& parameters)
 }
 
 
-bool litehtml::element::find_counter(const string_id& counter_name_id, std::map<string_id, int>::iterator& map_iterator) {
+bool litehtml::element::find_counter(const string_id& counter_name_id, flat_map<string_id, int>::iterator& map_iterator) {
 	element::ptr current = shared_from_this();
 
 	while (current != nullptr)
@@ -447,7 +471,7 @@ void litehtml::element::parse_counter_tokens(const string_vector& tokens, const
 
 void litehtml::element::increment_counter(const string_id& counter_name_id, const int increment)
 {
-	std::map<string_id, int>::iterator i;
+	flat_map<string_id, int>::iterator i;
 	if (find_counter(counter_name_id, i)) {
 		i->second = i->second + increment;
 	}
@@ -465,7 +489,7 @@ void litehtml::element::reset_counter(const string_id& counter_name_id, const in
 const background* element::get_background(bool /*own_only*/)						LITEHTML_RETURN_FUNC(nullptr)
 void element::add_style( const style& /*style*/)									LITEHTML_EMPTY_FUNC
 void element::select_all(const css_selector& /*selector*/, elements_list& /*res*/)	LITEHTML_EMPTY_FUNC
-elements_list element::select_all(const css_selector& /*selector*/)					LITEHTML_RETURN_FUNC(elements_list())
+elements_list element::select_all(const css_selector& /*selector*/)				LITEHTML_RETURN_FUNC(elements_list())
 elements_list element::select_all(const string& /*selector*/)						LITEHTML_RETURN_FUNC(elements_list())
 element::ptr element::select_one( const css_selector& /*selector*/ )				LITEHTML_RETURN_FUNC(nullptr)
 element::ptr element::select_one( const string& /*selector*/ )						LITEHTML_RETURN_FUNC(nullptr)
@@ -561,40 +585,12 @@ element::ptr element::lastChild() const
 
 element::ptr element::previousSibling() const
 {
-	auto par = parent();
-	if (!par) {
-		return nullptr;
-	}
-
-	const auto& siblings = par->children();
-	element::ptr prev = nullptr;
-	for (const auto& sibling : siblings) {
-		if (sibling.get() == this) {
-			return prev;
-		}
-		prev = sibling;
-	}
-	return nullptr;
+	return m_prev_sibling ? m_prev_sibling->shared_from_this() : nullptr;
 }
 
 element::ptr element::nextSibling() const
 {
-	auto par = parent();
-	if (!par) {
-		return nullptr;
-	}
-
-	const auto& siblings = par->children();
-	bool found = false;
-	for (const auto& sibling : siblings) {
-		if (found) {
-			return sibling;
-		}
-		if (sibling.get() == this) {
-			found = true;
-		}
-	}
-	return nullptr;
+	return m_next_sibling;
 }
 
 element::ptr element::cloneNode(bool /*deep*/) const
@@ -603,6 +599,11 @@ element::ptr element::cloneNode(bool /*deep*/) const
 	return nullptr;
 }
 
+element::ptr element::copy() const
+{
+	return nullptr;
+}
+
 bool element::containsNode(const element::ptr& other) const
 {
 	if (!other) {
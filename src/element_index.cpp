@@ -0,0 +1,240 @@
+#include "html.h"
+#include "element_index.h"
+#include "html_tag.h"
+#include <algorithm>
+
+namespace litehtml
+{
+
+css_selector::ptr element_index::get_selector(const string& text, document_mode mode)
+{
+	if (mode != m_selectors_mode)
+	{
+		m_selectors.clear();
+		m_selectors_mode = mode;
+	}
+
+	auto it = m_selectors.find(text);
+	if (it != m_selectors.end())
+	{
+		return it->second;
+	}
+
+	if (m_selectors.size() >= MaxSelectors)
+	{
+		m_selectors.clear();
+	}
+
+	auto sel = std::make_shared<css_selector>();
+	if (!sel->parse(text, mode))
+	{
+		sel = nullptr;
+	}
+	m_selectors.emplace(text, sel);
+	return sel;
+}
+
+bool element_index::select(element* root, const element* scope, const css_selector& selector, elements_list& res, bool first_only)
+{
+	if (!root || !scope) return false;
+
+	update(root);
+
+	size_t begin = 0;
+	if (scope != root)
+	{
+		auto it = m_positions.find(scope);
+		if (it == m_positions.end()) return false;
+		begin = it->second;
+	}
+	size_t end = m_subtree_end[begin];
+
+	// Start from the smallest list of elements having the id, a class or the tag of the
+	// rightmost compound selector, the whole selector is verified for every candidate.
+	const std::vector<size_t>* candidates = nullptr;
+	auto narrow = [&candidates](const index_map& index, string_id key)
+	{
+		static const std::vector<size_t> empty;
+		auto it = index.find(key);
+		const std::vector<size_t>* list = it != index.end() ? &it->second : &empty;
+		if (!candidates || list->size() < candidates->size())
+		{
+			candidates = list;
+		}
+	};
+	for (const auto& attr : selector.m_right.m_attrs)
+	{
+		if (attr.type == select_id)
+		{
+			narrow(m_ids, attr.name);
+		} else if (attr.type == select_class)
+		{
+			narrow(m_classes, attr.name);
+		}
+	}
+	if (selector.m_right.m_tag != star_id)
+	{
+		narrow(m_tags, selector.m_right.m_tag);
+	}
+
+	if (!candidates)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			if (m_elements[i]->select(selector))
+			{
+				res.push_back(m_elements[i]->shared_from_this());
+				if (first_only) break;
+			}
+		}
+		return true;
+	}
+
+	for (auto it = std::lower_bound(candidates->begin(), candidates->end(), begin); it != candidates->end() && *it < end; ++it)
+	{
+		element* el = m_elements[*it];
+		if (el->select(selector))
+		{
+			res.push_back(el->shared_from_this());
+			if (first_only) break;
+		}
+	}
+	return true;
+}
+
+// Keeps the positions sorted and unique
+static void insert_position(std::vector<size_t>& list, size_t pos)
+{
+	auto it = std::lower_bound(list.begin(), list.end(), pos);
+	if (it == list.end() || *it != pos)
+	{
+		list.insert(it, pos);
+	}
+}
+
+static void erase_position(std::unordered_map<string_id, std::vector<size_t>>& index, string_id key, size_t pos)
+{
+	auto list = index.find(key);
+	if (list == index.end()) return;
+	auto it = std::lower_bound(list->second.begin(), list->second.end(), pos);
+	if (it != list->second.end() && *it == pos)
+	{
+		list->second.erase(it);
+		if (list->second.empty()) index.erase(list);
+	}
+}
+
+void element_index::changed(const html_tag* el, string_id old_tag, string_id old_id, const vector<string_id>& old_classes)
+{
+	if (!m_valid) return;
+	auto it = m_positions.find(el);
+	if (it == m_positions.end()) return;
+
+	size_t pos = it->second;
+	erase_position(m_tags, old_tag, pos);
+	if (old_id != empty_id)
+	{
+		erase_position(m_ids, old_id, pos);
+	}
+	for (string_id cls : old_classes)
+	{
+		erase_position(m_classes, cls, pos);
+	}
+	insert_keys(el, pos);
+}
+
+void element_index::appended(const element* parent, element* child)
+{
+	if (!m_valid) return;
+	auto it = m_positions.find(parent);
+	if (it == m_positions.end()) return;	// not in the indexed tree
+
+	// Only the end of the document can grow in place, other positions would shift
+	if (m_subtree_end[it->second] != m_elements.size() || m_positions.count(child))
+	{
+		invalidate();
+		return;
+	}
+	add_subtree(child);
+	// The subtrees of parent and its ancestors end at the end of the document too
+	for (const element* el = parent; el; el = el->parent().get())
+	{
+		m_subtree_end[m_positions[el]] = m_elements.size();
+		if (el == m_root) break;
+	}
+}
+
+void element_index::update(element* root)
+{
+	if (m_valid && m_root == root) return;
+
+	m_elements.clear();
+	m_subtree_end.clear();
+	m_positions.clear();
+	m_ids.clear();
+	m_classes.clear();
+	m_tags.clear();
+	m_root = root;
+	m_valid = true;
+
+	add_subtree(root);
+}
+
+void element_index::add_subtree(element* root)
+{
+	// Iterative pre-order walk to handle deeply nested documents
+	struct frame
+	{
+		size_t pos;
+		child_list::const_iterator child;
+		child_list::const_iterator end;
+	};
+	std::vector<frame> stack;
+
+	stack.push_back({m_elements.size(), root->children().begin(), root->children().end()});
+	add(root);
+	while (!stack.empty())
+	{
+		frame& top = stack.back();
+		if (top.child == top.end)
+		{
+			m_subtree_end[top.pos] = m_elements.size();
+			stack.pop_back();
+			continue;
+		}
+		element* el = (top.child++)->get();
+		size_t pos = m_elements.size();
+		add(el);
+		stack.push_back({pos, el->children().begin(), el->children().end()});
+	}
+}
+
+void element_index::add(element* el)
+{
+	size_t pos = m_elements.size();
+	m_elements.push_back(el);
+	m_subtree_end.push_back(pos + 1);
+	m_positions[el] = pos;
+
+	// Only tags can match a selector
+	if (auto tag = dynamic_cast<const html_tag*>(el))
+	{
+		insert_keys(tag, pos);
+	}
+}
+
+void element_index::insert_keys(const html_tag* el, size_t pos)
+{
+	insert_position(m_tags[el->m_tag], pos);
+	if (el->m_id != empty_id)
+	{
+		insert_position(m_ids[el->m_id], pos);
+	}
+	// duplicate class names add the element once
+	for (string_id cls : el->m_classes)
+	{
+		insert_position(m_classes[cls], pos);
+	}
+}
+
+} // namespace litehtml
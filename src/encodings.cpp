@@ -3,6 +3,10 @@
 #include "utf8_strings.h"
 #include "encodings.h"
 #include <cassert>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define out
 #define inout
@@ -53,11 +57,19 @@ struct decoder
 		result_codepoint
 	};
 
+	virtual ~decoder() = default;
+
 	result process_a_queue(string& input,                   string& output, error_mode mode);
 	result process_an_item(string& input, int& input_index, string& output, error_mode mode);
 
 	// NOTE: input can be modified by GB18030, ISO-2022-JP and UTF-16 decoders (search for "input.insert")
 	virtual result handler(inout string& input, inout int& index, out int ch[2]) = 0;
+
+	// Decodes as much input as possible starting at index in bulk, without going through handler.
+	// Stops before anything handler has to process (errors, end of input, decoder state).
+	// Called only if m_has_runs is set.
+	virtual void decode_run(const string& /*input*/, inout int& /*index*/, string& /*output*/) {}
+	bool m_has_runs = false;
 };
 
 // https://encoding.spec.whatwg.org/#concept-encoding-run
@@ -66,6 +78,7 @@ decoder::result decoder::process_a_queue(string& input, string& output, error_mo
 	int index = 0;
 	while (true)
 	{
+		if (m_has_runs) decode_run(input, index, output);
 		// NOTE: we read byte from input in decoder handlers, not here (standard prescribes to do it here).
 		auto result = process_an_item(input, index, output, mode);
 		if (result != result_continue) return result;
@@ -132,35 +145,105 @@ decoder::result decoder::process_an_item(string& input, int& index, string& outp
 // https://encoding.spec.whatwg.org/#bom-sniff
 encoding bom_sniff(const string& str)
 {
-	if (str.substr(0, 3) == "\xEF\xBB\xBF") return encoding::utf_8;
-	if (str.substr(0, 2) == "\xFE\xFF") return encoding::utf_16be;
-	if (str.substr(0, 2) == "\xFF\xFE") return encoding::utf_16le;
+	if (str.compare(0, 3, "\xEF\xBB\xBF") == 0) return encoding::utf_8;
+	if (str.compare(0, 2, "\xFE\xFF") == 0) return encoding::utf_16be;
+	if (str.compare(0, 2, "\xFF\xFE") == 0) return encoding::utf_16le;
 	return encoding::null;
 }
 
+// Length of the ASCII prefix of str
+static size_t ascii_length(const char* str, size_t len)
+{
+	size_t i = 0;
+#ifdef __SSE2__
+	for (; i + 16 <= len; i += 16)
+	{
+		int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(str + i)));
+		if (mask) return i + __builtin_ctz(mask);
+	}
+#else
+	for (; i + 8 <= len; i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, str + i, 8);
+		if (word & 0x8080808080808080ull) break;
+	}
+#endif
+	while (i < len && (byte)str[i] < 0x80) i++;
+	return i;
+}
+
+// https://encoding.spec.whatwg.org/#utf-8-decoder
+// Sequences accepted here are exactly those utf_8_decoder decodes without error, so a valid
+// prefix of the input is its own decoding.
+size_t valid_utf8_length(const char* str, size_t len)
+{
+	size_t i = 0;
+	while (true)
+	{
+		i += ascii_length(str + i, len - i);
+		if (i == len) return i;
+
+		// multi-byte sequence
+		const byte* s = (const byte*)str + i;
+		size_t left = len - i;
+		byte b = s[0];
+		if (b >= 0xC2 && b <= 0xDF)
+		{
+			if (left < 2 || (s[1] & 0xC0) != 0x80) return i;
+			i += 2;
+		}
+		else if (b >= 0xE0 && b <= 0xEF)
+		{
+			byte lower = b == 0xE0 ? 0xA0 : 0x80;
+			byte upper = b == 0xED ? 0x9F : 0xBF;
+			if (left < 3 || s[1] < lower || s[1] > upper || (s[2] & 0xC0) != 0x80) return i;
+			i += 3;
+		}
+		else if (b >= 0xF0 && b <= 0xF4)
+		{
+			byte lower = b == 0xF0 ? 0x90 : 0x80;
+			byte upper = b == 0xF4 ? 0x8F : 0xBF;
+			if (left < 4 || s[1] < lower || s[1] > upper || (s[2] & 0xC0) != 0x80 || (s[3] & 0xC0) != 0x80) return i;
+			i += 4;
+		}
+		else
+			return i;
+	}
+}
+
 decoder::ptr get_decoder(encoding _encoding);
 
 // https://encoding.spec.whatwg.org/#decode
-// input is copied because it can be modified by GB18030, ISO-2022-JP and UTF-16 decoders
-void decode(string input, encoding _encoding, string& output)
+void decode(const string& input, encoding _encoding, string& output)
 {
 	// 1.
 	encoding bom_encoding = bom_sniff(input);
 
 	// 2.
+	int start = 0;
 	if (bom_encoding != encoding::null)
 	{
 		_encoding = bom_encoding;
-		int len = (_encoding == encoding::utf_8 ? 3 : 2);
-		input.erase(0, len); // remove BOM
+		start = (_encoding == encoding::utf_8 ? 3 : 2); // skip BOM
+	}
+
+	// Valid UTF-8 is copied as is
+	if (_encoding == encoding::utf_8 && valid_utf8_length(input.data() + start, input.size() - start) == input.size() - start)
+	{
+		output.append(input, start, string::npos);
+		return;
 	}
 
 	// 3.
 	auto decoder = get_decoder(_encoding);
-	decoder->process_a_queue(input, output, error_mode::replacement);
+	output.reserve(output.size() + input.size() - start);
+	// The queue is a copy because it can be modified by GB18030, ISO-2022-JP and UTF-16 decoders
+	string queue(input, start);
+	decoder->process_a_queue(queue, output, error_mode::replacement);
 }
 
-string decode(string input, encoding encoding)
+string decode(const string& input, encoding encoding)
 {
 	string output;
 	decode(input, encoding, output);
@@ -178,7 +261,10 @@ struct utf_8_decoder final : decoder
 	int m_lower_boundary = 0x80;
 	int m_upper_boundary = 0xBF;
 
+	utf_8_decoder() { m_has_runs = true; }
+
 	result handler(string& input, int& index, int ch[2]) override;
+	void   decode_run(const string& input, int& index, string& output) override;
 };
 
 // https://encoding.spec.whatwg.org/#utf-8-decoder
@@ -275,6 +361,16 @@ decoder::result utf_8_decoder::handler(inout string& input, inout int& index, ou
 	return result_codepoint;
 }
 
+// Valid input is appended as is, see valid_utf8_length
+void utf_8_decoder::decode_run(const string& input, int& index, string& output)
+{
+	if (m_bytes_needed != 0) return;
+
+	size_t len = valid_utf8_length(input.data() + index, input.size() - index);
+	output.append(input, index, len);
+	index += (int)len;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 struct single_byte_decoder final : decoder
@@ -284,9 +380,22 @@ struct single_byte_decoder final : decoder
 	single_byte_decoder(encoding _encoding)
 	{
 		m_index = m_indexes[(int)_encoding - (int)encoding::ibm866];
+		for (int i = 0; i < 128; i++)
+		{
+			string str;
+			if (m_index[i] != null) append_char(str, m_index[i]);
+			m_utf8[i].len = (byte)str.size();
+			memcpy(m_utf8[i].bytes, str.data(), str.size());
+		}
+		m_has_runs = true;
 	}
 
 	result handler(string& input, int& index, int ch[2]) override;
+	void   decode_run(const string& input, int& index, string& output) override;
+
+	// UTF-8 encodings of the code points of m_index, length 0 for null code points
+	struct utf8_char { byte len; char bytes[3]; };
+	utf8_char m_utf8[128];
 
 	static int* m_indexes[(int)encoding::x_mac_cyrillic - (int)encoding::ibm866 + 1];
 
@@ -409,6 +518,32 @@ decoder::result single_byte_decoder::handler(string& input, int& index, int ch[2
 	return result_codepoint;
 }
 
+// Table driven version of handler, stops at bytes without a code point
+void single_byte_decoder::decode_run(const string& input, int& index, string& output)
+{
+	const char* str = input.data();
+	size_t len = input.size();
+	size_t i = index;
+	while (i < len)
+	{
+		size_t ascii = ascii_length(str + i, len - i);
+		output.append(str + i, ascii);
+		i += ascii;
+
+		for (; i < len && (byte)str[i] >= 0x80; i++)
+		{
+			const utf8_char& ch = m_utf8[(byte)str[i] - 0x80];
+			if (!ch.len)
+			{
+				index = (int)i;
+				return;
+			}
+			output.append(ch.bytes, ch.len);
+		}
+	}
+	index = (int)i;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 struct gb18030_decoder final : decoder
@@ -1987,14 +2122,14 @@ encoding prescan_for_encoding(const string& str)
 
 // https://html.spec.whatwg.org/multipage/parsing.html#encoding-sniffing-algorithm
 // see also doc/document_createFromString.txt
-void encoding_sniffing_algorithm(estring& str)
+void encoding_sniffing_algorithm(const string& str, encoding& _encoding, confidence& _confidence)
 {
 	// 1. If the result of BOM sniffing is an encoding, return that encoding with confidence certain.
 	encoding encoding = bom_sniff(str);
 	if (encoding != encoding::null)
 	{
-		str.encoding = encoding;
-		str.confidence = confidence::certain;
+		_encoding = encoding;
+		_confidence = confidence::certain;
 		return;
 	}
 
@@ -2004,7 +2139,7 @@ void encoding_sniffing_algorithm(estring& str)
 
 	// 4. HTTP encoding -> return { encoding, confidence: certain}
 
-	if (str.encoding != encoding::null && str.confidence == confidence::certain)
+	if (_encoding != encoding::null && _confidence == confidence::certain)
 		return;
 
 		//    all below return confidence: tentative
@@ -2013,8 +2148,8 @@ void encoding_sniffing_algorithm(estring& str)
 	encoding = prescan_for_encoding(str);
 	if (encoding != encoding::null)
 	{
-		str.encoding = encoding;
-		str.confidence = confidence::tentative;
+		_encoding = encoding;
+		_confidence = confidence::tentative;
 		return;
 	}
 
@@ -2028,12 +2163,17 @@ void encoding_sniffing_algorithm(estring& str)
 	//    may be UTF-8 or depends on locale or smth else
 
 	// if str has no encoding, use the default one
-	if (str.encoding == encoding::null)
+	if (_encoding == encoding::null)
 	{
-		str.encoding = encoding::utf_8;
-		str.confidence = confidence::tentative; // tentative means it will be overridden by <meta> encoding if present
+		_encoding = encoding::utf_8;
+		_confidence = confidence::tentative; // tentative means it will be overridden by <meta> encoding if present
 	}
-	// otherwise use str.encoding (tentative)
+	// otherwise use _encoding (tentative)
+}
+
+void encoding_sniffing_algorithm(estring& str)
+{
+	encoding_sniffing_algorithm(str, str.encoding, str.confidence);
 }
 
 } // namespace litehtml
@@ -0,0 +1,69 @@
+#include "html.h"
+#include "font_cache.h"
+#include "document_container.h"
+
+namespace litehtml
+{
+
+font_cache::~font_cache()
+{
+	for (const auto& font : m_fonts)
+	{
+		m_container->delete_font(font.second.item.font);
+	}
+}
+
+uint_ptr font_cache::acquire(const font_description& descr, const document* doc, font_metrics* fm)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto it = m_fonts.find(descr);
+	if (it == m_fonts.end())
+	{
+		entry fe = {{0, {}}, 0};
+		fe.item.font = m_container->create_font(descr, doc, &fe.item.metrics);
+		it = m_fonts.emplace(descr, fe).first;
+	}
+	it->second.refs++;
+	if (fm)
+	{
+		*fm = it->second.item.metrics;
+	}
+	return it->second.item.font;
+}
+
+void font_cache::release(const font_description& descr)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto it = m_fonts.find(descr);
+	if (it != m_fonts.end() && it->second.refs > 0)
+	{
+		it->second.refs--;
+	}
+}
+
+void font_cache::release_unused()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (auto it = m_fonts.begin(); it != m_fonts.end(); )
+	{
+		if (it->second.refs == 0)
+		{
+			m_container->delete_font(it->second.item.font);
+			it = m_fonts.erase(it);
+		} else
+		{
+			++it;
+		}
+	}
+}
+
+size_t font_cache::size()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_fonts.size();
+}
+
+} // namespace litehtml
@@ -382,10 +382,11 @@ litehtml::pixel_t litehtml::formatting_context::find_next_line_top(pixel_t top,
 
 void litehtml::formatting_context::update_floats(pixel_t dy, const std::shared_ptr<render_item> &parent)
 {
+	element::ptr parent_el = parent->src_el()->shared_from_this();
 	bool reset_cache = false;
 	for(auto fb = m_floats_left.rbegin(); fb != m_floats_left.rend(); fb++)
 	{
-		if(fb->el->src_el()->is_ancestor(parent->src_el()))
+		if(fb->el->src_el()->is_ancestor(parent_el))
 		{
 			reset_cache	= true;
 			fb->pos.y	+= dy;
@@ -398,7 +399,7 @@ void litehtml::formatting_context::update_floats(pixel_t dy, const std::shared_p
 	reset_cache = false;
 	for(auto fb = m_floats_right.rbegin(); fb != m_floats_right.rend(); fb++)
 	{
-		if(fb->el->src_el()->is_ancestor(parent->src_el()))
+		if(fb->el->src_el()->is_ancestor(parent_el))
 		{
 			reset_cache	= true;
 			fb->pos.y	+= dy;
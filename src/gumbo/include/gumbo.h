@@ -667,6 +667,13 @@ GumboOutput* gumbo_parse_with_options(
 /** Release the memory used for the parse tree & parse errors. */
 void gumbo_destroy_output(const GumboOptions* options, GumboOutput* output);
 
+/**
+ * Release the memory used for a subtree of the parse tree. The node must be
+ * detached from its parent (or the parent's children vector emptied) before
+ * the output is destroyed.
+ */
+void gumbo_destroy_node(const GumboOptions* options, GumboNode* node);
+
 #ifdef __cplusplus
 }
 #endif
@@ -10,6 +10,7 @@
 #include "num_cvt.h"
 #include "line_box.h"
 #include "render_item.h"
+#include "paint_profiler.h"
 #include "internal.h"
 #include "document_container.h"
 #include "css_transform.h"
@@ -27,9 +28,7 @@ litehtml::html_tag::html_tag(const element::ptr& parent, const string& style) :
 	m_tag(empty_id),
 	m_id(empty_id)
 {
-	litehtml::style st;
-	st.add(style);
-	add_style(st);
+	local_style().add(style);
 	this->parent(parent);
 	compute_styles();
 }
@@ -38,8 +37,16 @@ bool litehtml::html_tag::appendChild(const element::ptr &el)
 {
 	if(el)
 	{
-		el->parent(shared_from_this());
+		// An element in another list is moved, its old position is gone from the index too
+		bool moved = el->m_siblings != nullptr;
 		m_children.push_back(el);
+		if(moved)
+		{
+			get_document()->get_element_index().invalidate();
+		} else
+		{
+			get_document()->get_element_index().appended(this, el.get());
+		}
 		return true;
 	}
 	return false;
@@ -47,10 +54,12 @@ bool litehtml::html_tag::appendChild(const element::ptr &el)
 
 bool litehtml::html_tag::removeChild(const element::ptr &el)
 {
-	if(el && el->parent() == shared_from_this())
+	auto pos = m_children.find(el.get());
+	if(pos != m_children.end())
 	{
-		el->parent(nullptr);
-		m_children.erase(std::remove(m_children.begin(), m_children.end(), el), m_children.end());
+		get_document()->retain_removed(el);
+		m_children.erase(pos);
+		get_document()->get_element_index().invalidate();
 		return true;
 	}
 	return false;
@@ -61,9 +70,11 @@ void litehtml::html_tag::clearRecursive()
 	for(auto& el : m_children)
 	{
 		el->clearRecursive();
+		get_document()->retain_removed(el);
 		el->parent(nullptr);
 	}
 	m_children.clear();
+	get_document()->get_element_index().invalidate();
 }
 
 string_id html_tag::id() const
@@ -83,7 +94,9 @@ const char* html_tag::get_tagName() const
 
 void html_tag::set_tagName( const char* tag )
 {
+	string_id old_tag = m_tag;
 	m_tag = _id(lowcase(tag));
+	get_document()->get_element_index().changed(this, old_tag, m_id, m_classes);
 }
 
 void html_tag::set_attr( const char* _name, const char* _val )
@@ -91,31 +104,47 @@ void html_tag::set_attr( const char* _name, const char* _val )
 	if (_name && _val)
 	{
 		// attribute names in attribute selector are matched ASCII case-insensitively regardless of document mode
-		string name = lowcase(_name);
+		string_id name = _id(lowcase(_name));
 		// m_attrs has all attribute values, including class and id, in their original case
 		// because in attribute selector values are matched case-sensitively even in quirks mode
 		m_attrs[name] = _val;
+		// Presentational attributes add local declarations, so the style identity must change
+		m_local_style_key = 0;
 
-		if (name == "class")
+		if (name == _class_)
 		{
 			string val = _val;
 			// class names in class selector (.xxx) are matched ASCII case-insensitively in quirks mode
 			if (get_document()->mode() == quirks_mode) lcase(val);
-			m_str_classes = split_string(val, whitespace, "", "");
-			m_classes.clear();
-			for (auto cls : m_str_classes) m_classes.push_back(_id(cls));
+			vector<string_id> old_classes;
+			old_classes.swap(m_classes);
+			for (const auto& cls : split_string(val, whitespace, "", "")) m_classes.push_back(_id(cls));
+			get_document()->get_element_index().changed(this, m_tag, m_id, old_classes);
 		}
-		else if (name == "id")
+		else if (name == _id_)
 		{
 			string val = _val;
 			// ids in id selector (#xxx) are matched ASCII case-insensitively in quirks mode
 			if (get_document()->mode() == quirks_mode) lcase(val);
+			string_id old_id = m_id;
 			m_id = _id(val);
+			get_document()->get_element_index().changed(this, m_tag, old_id, m_classes);
 		}
 	}
 }
 
 const char* html_tag::get_attr( const char* name, const char* def ) const
+{
+	// A name without an id can't be an attribute
+	string_id id;
+	if(!name || !_find_id(name, id))
+	{
+		return def;
+	}
+	return get_attr(id, def);
+}
+
+const char* html_tag::get_attr( string_id name, const char* def ) const
 {
 	auto attr = m_attrs.find(name);
 	if(attr != m_attrs.end())
@@ -127,16 +156,24 @@ const char* html_tag::get_attr( const char* name, const char* def ) const
 
 litehtml::elements_list litehtml::html_tag::select_all(const string& selector )
 {
-	css_selector sel;
-	sel.parse(selector, get_document()->mode());
-
-	return select_all(sel);
+	auto doc = get_document();
+	auto sel = doc->get_element_index().get_selector(selector, doc->mode());
+	if(!sel)
+	{
+		return {};
+	}
+	return select_all(*sel);
 }
 
 litehtml::elements_list litehtml::html_tag::select_all(const css_selector& selector )
 {
 	litehtml::elements_list res;
-	select_all(selector, res);
+	auto doc = get_document();
+	if(!doc->get_element_index().select(doc->root().get(), this, selector, res, false))
+	{
+		// not in the document tree
+		select_all(selector, res);
+	}
 	return res;
 }
 
@@ -156,28 +193,25 @@ void litehtml::html_tag::select_all(const css_selector& selector, elements_list&
 
 litehtml::element::ptr litehtml::html_tag::select_one( const string& selector )
 {
-	css_selector sel;
-	sel.parse(selector, get_document()->mode());
-
-	return select_one(sel);
+	auto doc = get_document();
+	auto sel = doc->get_element_index().get_selector(selector, doc->mode());
+	if(!sel)
+	{
+		return nullptr;
+	}
+	return select_one(*sel);
 }
 
 litehtml::element::ptr litehtml::html_tag::select_one( const css_selector& selector )
 {
-	if(select(selector))
-	{
-		return shared_from_this();
-	}
-
-	for(auto& el : m_children)
+	elements_list res;
+	auto doc = get_document();
+	if(!doc->get_element_index().select(doc->root().get(), this, selector, res, true))
 	{
-		element::ptr res = el->select_one(selector);
-		if(res)
-		{
-			return res;
-		}
+		// not in the document tree
+		select_all(selector, res);
 	}
-	return nullptr;
+	return res.empty() ? nullptr : res.front();
 }
 
 void litehtml::html_tag::apply_stylesheet( const litehtml::css& stylesheet )
@@ -209,7 +243,7 @@ void litehtml::html_tag::apply_stylesheet( const litehtml::css& stylesheet )
 		{
 			used_selector::ptr us = std::make_unique<used_selector>(sel, false);
 
-			if(sel->is_media_valid())
+			if(sel->is_media_valid(doc.get()))
 			{
 				auto apply_before_after = [&]()
 					{
@@ -307,9 +341,13 @@ void litehtml::html_tag::draw(uint_ptr hdc, pixel_t x, pixel_t y, const position
 	pos.x	+= x;
 	pos.y	+= y;
 
+	// Composited elements are painted untransformed and unfiltered into their layer,
+	// transform and filter are applied by render_item::draw_composited
+	bool composited = ri->is_composited();
+
 	// Set current transform on the container before drawing
 	// Pass the raw transform matrix - the renderer will apply it around each primitive's center
-	if (m_css.has_transform()) {
+	if (m_css.has_transform() && !composited) {
 		get_document()->container()->set_current_transform(m_css.get_transform_matrix());
 	} else {
 		get_document()->container()->set_current_transform(TransformMatrix::identity());
@@ -317,7 +355,7 @@ void litehtml::html_tag::draw(uint_ptr hdc, pixel_t x, pixel_t y, const position
 
 	// Begin CSS filter if present
 	const string& filter = m_css.get_filter();
-	bool has_filter = !filter.empty() && filter != "none";
+	bool has_filter = !composited && !filter.empty() && filter != "none";
 	if (has_filter) {
 		get_document()->container()->begin_filter(filter);
 	}
@@ -357,7 +395,7 @@ void litehtml::html_tag::draw(uint_ptr hdc, pixel_t x, pixel_t y, const position
 
 bool html_tag::get_custom_property(string_id name, css_token_vector& result) const
 {
-	const property_value& value = m_style.get_property(name);
+	const property_value& value = cascaded_style().get_property(name);
 
 	if (value.is<css_token_vector>())
 	{
@@ -373,28 +411,46 @@ bool html_tag::get_custom_property(string_id name, css_token_vector& result) con
 
 void litehtml::html_tag::compute_styles(bool recursive, bool use_cache)
 {
-	const char* style_attr = get_attr("style");
+	const char* style_attr = get_attr(_style_);
 	document::ptr doc = get_document();
 
 	if (style_attr)
 	{
-		m_style.add(style_attr, "", doc->container());
+		local_style().add(style_attr, "", doc->container());
 	}
 
-	m_style.subst_vars(this);
-
-	// Try to use cached style for similar elements (style sharing)
-	// Use parent element pointer as hash - siblings share same parent so can share styles
-	element::ptr el_parent = parent();
-	size_t parent_style_hash = el_parent ? std::hash<element*>{}(el_parent.get()) : 0;
+	bool has_vars = m_own_style ? m_style.has_vars() : m_rule_node && m_rule_node->has_vars();
+	if (has_vars)
+	{
+		// var() substitution depends on the ancestors, so it is done on an own copy.
+		// The result is still determined by the style identity below.
+		own_style().subst_vars(this);
+	}
 
-	// Compute style hash for cache lookup
-	size_t style_hash = m_style.hash();
+	// Style identity: the same tag, matched rules and parent style give the same computed style.
+	// Elements with local declarations and children of elements without identity are unique.
+	bool shareable = !m_local_style;
+	size_t parent_style_id = 0;
+	if (element::ptr el_parent = parent())
+	{
+		auto parent_tag = dynamic_cast<html_tag*>(el_parent.get());
+		parent_style_id = parent_tag ? parent_tag->m_style_id : 0;
+		shareable = shareable && parent_style_id != 0;
+	}
+	rule_tree& rules = doc->get_rule_tree();
+	if (shareable)
+	{
+		m_style_id = rules.style_id(m_tag, is_replaced(), m_rule_node, parent_style_id);
+	} else
+	{
+		if (!m_local_style_key) m_local_style_key = rules.new_local_key();
+		m_style_id = rules.local_style_id(m_local_style_key, m_tag, is_replaced(), m_rule_node, parent_style_id, style_attr ? style_attr : "");
+	}
 
 	bool cache_hit = false;
-	if (use_cache)
+	if (use_cache && shareable)
 	{
-		const css_properties* cached = doc->get_style_cache().find(m_tag, m_classes, style_hash, parent_style_hash);
+		const css_properties* cached = doc->get_style_cache().find(m_style_id);
 		if (cached)
 		{
 			// Found cached style - copy it instead of recomputing
@@ -407,9 +463,9 @@ void litehtml::html_tag::compute_styles(bool recursive, bool use_cache)
 	{
 		// Compute style (and cache it if using cache)
 		m_css.compute(this, doc);
-		if (use_cache)
+		if (use_cache && shareable)
 		{
-			doc->get_style_cache().store(m_tag, m_classes, style_hash, parent_style_hash, m_css);
+			doc->get_style_cache().store(m_style_id, m_css);
 		}
 	}
 
@@ -439,9 +495,13 @@ int	html_tag::select(const css_selector::vector& selector_list, bool apply_pseud
 
 int litehtml::html_tag::select(const string& selector)
 {
-	css_selector sel;
-	sel.parse(selector, get_document()->mode());
-	return select(sel, true);
+	auto doc = get_document();
+	auto sel = doc->get_element_index().get_selector(selector, doc->mode());
+	if(!sel)
+	{
+		return select_no_match;
+	}
+	return select(*sel, true);
 }
 
 int litehtml::html_tag::select(const css_selector& selector, bool apply_pseudo)
@@ -762,7 +822,7 @@ int html_tag::select_pseudoclass(const css_attribute_selector& sel)
 // https://www.w3.org/TR/selectors-4/#attribute-selectors
 int html_tag::select_attribute(const css_attribute_selector& sel)
 {
-	const char* sz_attr_value = get_attr(_s(sel.name).c_str());
+	const char* sz_attr_value = get_attr(sel.name);
 
 	if (!sz_attr_value) return select_no_match;
 
@@ -823,9 +883,10 @@ int html_tag::select_attribute(const css_attribute_selector& sel)
 
 element::ptr html_tag::find_ancestor(const css_selector& selector, bool apply_pseudo, bool* is_pseudo)
 {
-	// Fast-reject using bloom filter: check if required identifiers exist in ancestor chain
+	// Fast-reject using bloom filter: check if required identifiers exist in ancestor chain.
+	// The filter holds the ancestors only while styles are applied, it is empty for select_all/select_one.
 	auto doc = get_document();
-	if (doc)
+	if (doc && doc->get_selector_filter().depth() > 0)
 	{
 		const auto& filter = doc->get_selector_filter();
 		const auto& right = selector.m_right;
@@ -1022,6 +1083,7 @@ void litehtml::html_tag::draw_background(uint_ptr hdc, pixel_t x, pixel_t y, con
 			const auto& shadows = m_css.get_box_shadows();
 			if(!shadows.empty())
 			{
+				PAINT_PROFILE_DRAW(draw_box_shadow, border_box);
 				get_document()->container()->draw_box_shadow(hdc, shadows, border_box);
 			}
 
@@ -1045,7 +1107,7 @@ void litehtml::html_tag::draw_background(uint_ptr hdc, pixel_t x, pixel_t y, con
 					layer.clip_box.round();
 					layer.origin_box.round();
 
-					bg->draw_layer(hdc, i, layer, get_document()->container());
+					bg->draw_layer(hdc, i, layer, get_document()->container(), &ri->get_background_cache());
 				}
 			}
 
@@ -1054,6 +1116,7 @@ void litehtml::html_tag::draw_background(uint_ptr hdc, pixel_t x, pixel_t y, con
 			{
 				border_box.round();
 				bdr.radius = m_css.get_borders().radius.calc_percents(border_box.width, border_box.height);
+				PAINT_PROFILE_DRAW_BORDERS(border_box, bdr);
 				get_document()->container()->draw_borders(hdc, bdr, border_box, is_root());
 			}
 		}
@@ -1124,7 +1187,7 @@ void litehtml::html_tag::draw_background(uint_ptr hdc, pixel_t x, pixel_t y, con
 						layer.clip_box.round();
 						layer.origin_box.round();
 
-						bg->draw_layer(hdc, i, layer, get_document()->container());
+						bg->draw_layer(hdc, i, layer, get_document()->container(), &ri->get_background_cache());
 					}
 				}
 				if(bdr.is_visible())
@@ -1132,6 +1195,7 @@ void litehtml::html_tag::draw_background(uint_ptr hdc, pixel_t x, pixel_t y, con
 					borders b = bdr;
 					b.radius = bdr.radius.calc_percents(box->width, box->height);
 					box->round();
+					PAINT_PROFILE_DRAW_BORDERS(*box, b);
 					get_document()->container()->draw_borders(hdc, b, *box, false);
 				}
 			}
@@ -1161,9 +1225,17 @@ bool litehtml::html_tag::set_pseudo_class( string_id cls, bool add )
 	return ret;
 }
 
+litehtml::string_vector litehtml::html_tag::str_classes() const
+{
+	string_vector ret;
+	for (string_id cls : m_classes) ret.push_back(_s(cls));
+	return ret;
+}
+
 bool litehtml::html_tag::set_class( const char* pclass, bool add )
 {
 	string_vector classes;
+	string_vector str_classes = this->str_classes();
 	bool changed = false;
 
 	split_string( pclass, classes, " " );
@@ -1172,9 +1244,9 @@ bool litehtml::html_tag::set_class( const char* pclass, bool add )
 	{
 		for( auto & _class : classes )
 		{
-			if(std::find(m_str_classes.begin(), m_str_classes.end(), _class) == m_str_classes.end())
+			if(std::find(str_classes.begin(), str_classes.end(), _class) == str_classes.end())
 			{
-				m_str_classes.push_back( std::move( _class ) );
+				str_classes.push_back( std::move( _class ) );
 				changed = true;
 			}
 		}
@@ -1182,11 +1254,11 @@ bool litehtml::html_tag::set_class( const char* pclass, bool add )
 	{
 		for( const auto & _class : classes )
 		{
-			auto end = std::remove(m_str_classes.begin(), m_str_classes.end(), _class);
+			auto end = std::remove(str_classes.begin(), str_classes.end(), _class);
 
-			if(end != m_str_classes.end())
+			if(end != str_classes.end())
 			{
-				m_str_classes.erase(end, m_str_classes.end());
+				str_classes.erase(end, str_classes.end());
 				changed = true;
 			}
 		}
@@ -1195,7 +1267,7 @@ bool litehtml::html_tag::set_class( const char* pclass, bool add )
 	if( changed )
 	{
 		string class_string;
-		join_string(class_string, m_str_classes, " ");
+		join_string(class_string, str_classes, " ");
 		set_attr("class", class_string.c_str());
 
 		return true;
@@ -1221,7 +1293,7 @@ element::ptr litehtml::html_tag::cloneNode(bool deep) const
 
 	// Copy all attributes
 	for (const auto& attr : m_attrs) {
-		clone->set_attr(attr.first.c_str(), attr.second.c_str());
+		clone->set_attr(_s(attr.first).c_str(), attr.second.c_str());
 	}
 
 	// Deep clone: also clone children
@@ -1325,6 +1397,7 @@ void litehtml::html_tag::draw_list_marker( uint_ptr hdc, const position& pos, co
 		auto marker_text = get_list_marker_text(lm.index);
 		if (marker_text.empty())
 		{
+			PAINT_PROFILE_DRAW(draw_list_marker, lm.pos);
 			get_document()->container()->draw_list_marker(hdc, lm);
 		}
 		else
@@ -1337,12 +1410,14 @@ void litehtml::html_tag::draw_list_marker( uint_ptr hdc, const position& pos, co
 				text_pos.move_to(text_pos.right() - tw, text_pos.y);
 				text_pos.width = tw;
 				text_pos.round();
+				PAINT_PROFILE_DRAW(draw_text, text_pos);
 				get_document()->container()->draw_text(hdc, marker_text.c_str(), lm.font, lm.color, text_pos);
 			}
 		}
 	}
 	else
 	{
+		PAINT_PROFILE_DRAW(draw_list_marker, lm.pos);
 		get_document()->container()->draw_list_marker(hdc, lm);
 	}
 }
@@ -1584,7 +1659,8 @@ litehtml::element::ptr litehtml::html_tag::get_element_after(const style& style,
 
 void litehtml::html_tag::handle_counter_properties()
 {
-	const auto& reset_property = m_style.get_property(_counter_reset_);
+	const style& cascaded = cascaded_style();
+	const auto& reset_property = cascaded.get_property(_counter_reset_);
 	if (reset_property.is<string_vector>()) {
 		auto reset_function = [&](const string_id&name_id, const int value) {
 			reset_counter(name_id, value);
@@ -1593,7 +1669,7 @@ void litehtml::html_tag::handle_counter_properties()
 		return;
 	}
 
-	const auto& inc_property = m_style.get_property(_counter_increment_);
+	const auto& inc_property = cascaded.get_property(_counter_increment_);
 	if (inc_property.is<string_vector>()) {
 		auto inc_function = [&](const string_id&name_id, const int value) {
 			increment_counter(name_id, value);
@@ -1606,12 +1682,49 @@ void litehtml::html_tag::handle_counter_properties()
 
 void litehtml::html_tag::add_style(const style& style)
 {
-	m_style.combine(style);
+	// The matched declaration block is only appended to the rule path, the cascaded
+	// style is shared by all elements on the same rule node
+	document::ptr doc = get_document();
+	if (doc)
+	{
+		m_rule_node = doc->get_rule_tree().child(m_rule_node, style);
+	}
+	if (m_own_style || !doc)
+	{
+		own_style().combine(style);
+	}
 	handle_counter_properties();
 }
 
+style& litehtml::html_tag::own_style()
+{
+	if (!m_own_style)
+	{
+		if (m_rule_node)
+		{
+			m_style = m_rule_node->cascaded();
+		}
+		m_own_style = true;
+	}
+	return m_style;
+}
+
+style& litehtml::html_tag::local_style()
+{
+	m_local_style = true;
+	return own_style();
+}
+
 void litehtml::html_tag::refresh_styles()
 {
+	// Descendant selectors of the children are matched with the bloom filter, see apply_stylesheet.
+	// The caller pushes the ancestors, see document::push_ancestors
+	auto doc = get_document();
+	if (doc)
+	{
+		doc->get_selector_filter().push_element(m_tag, m_id, m_classes);
+	}
+
 	for (auto& el : m_children)
 	{
 		if(el->css().get_display() != display_inline_text)
@@ -1621,12 +1734,15 @@ void litehtml::html_tag::refresh_styles()
 	}
 
 	m_style.clear();
+	m_rule_node = nullptr;
+	m_own_style = false;
+	m_local_style = false;
 
 	for (auto& usel : m_used_styles)
 	{
 		usel->m_used = false;
 
-		if(usel->m_selector->is_media_valid())
+		if(usel->m_selector->is_media_valid(doc.get()))
 		{
 			int apply = select(*usel->m_selector, false);
 
@@ -1679,6 +1795,11 @@ void litehtml::html_tag::refresh_styles()
 			}
 		}
 	}
+
+	if (doc)
+	{
+		doc->get_selector_filter().pop_element();
+	}
 }
 
 const litehtml::background* litehtml::html_tag::get_background(bool own_only)
@@ -1742,7 +1863,7 @@ void html_tag::map_to_pixel_length_property(string_id prop_name, string attr_val
 	if (html_parse_non_negative_integer(attr_value, n))
 	{
 		css_token tok(DIMENSION, (float)n, css_number_integer, "px");
-		m_style.add_property(prop_name, {tok});
+		local_style().add_property(prop_name, {tok});
 	}
 }
 
@@ -1752,7 +1873,7 @@ void html_tag::map_to_pixel_length_property_with_default_value(string_id prop_na
 	int n = default_value;
 	html_parse_non_negative_integer(attr_value, n);
 	css_token tok(DIMENSION, (float)n, css_number_integer, "px");
-	m_style.add_property(prop_name, {tok});
+	local_style().add_property(prop_name, {tok});
 }
 
 // https://html.spec.whatwg.org/multipage/rendering.html#maps-to-the-dimension-property
@@ -1769,7 +1890,7 @@ void html_tag::map_to_dimension_property(string_id prop_name, string attr_value)
 	else
 		tok = {PERCENTAGE, x, css_number_number};
 
-	m_style.add_property(prop_name, {tok});
+	local_style().add_property(prop_name, {tok});
 }
 
 // https://html.spec.whatwg.org/multipage/rendering.html#maps-to-the-dimension-property-(ignoring-zero)
@@ -1786,7 +1907,7 @@ void html_tag::map_to_dimension_property_ignoring_zero(string_id prop_name, stri
 	else
 		tok = {PERCENTAGE, x, css_number_number};
 
-	m_style.add_property(prop_name, {tok});
+	local_style().add_property(prop_name, {tok});
 }
 
 } // namespace litehtml
@@ -13,10 +13,13 @@ bool litehtml::elements_iterator::go_inside(const std::shared_ptr<render_item>&
     return 	/*!el->children().empty() &&*/ m_go_inside && m_go_inside->select(el);
 }
 
-void litehtml::elements_iterator::process(const std::shared_ptr<render_item>& container, const std::function<void (std::shared_ptr<render_item>&, iterator_item_type)>& func)
+void litehtml::elements_iterator::process(const std::shared_ptr<render_item>& container, const std::function<void (const std::shared_ptr<render_item>&, iterator_item_type)>& func)
 {
-    for(auto& el : container->children())
+    // func can replace the item in the children, the next one is taken first
+    auto& children = container->children();
+    for(auto iter = children.begin(); iter != children.end();)
     {
+        auto el = *iter++;
         if(go_inside(el))
         {
             if(m_return_parent)
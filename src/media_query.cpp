@@ -78,6 +78,35 @@ bool media_feature::check(const media_features& feat) const
 	}
 }
 
+uint32_t media_feature::get_dependencies(std::vector<float> breakpoints[media_range_count]) const
+{
+	auto range = [&](media_range r)
+	{
+		breakpoints[r].push_back(value);
+		if (op2) breakpoints[r].push_back(value2);
+		return 1u << r;
+	};
+	switch (_id(name))
+	{
+	case _width_:				return range(media_range_width);
+	case _height_:				return range(media_range_height);
+	case _device_width_:		return range(media_range_device_width);
+	case _device_height_:		return range(media_range_device_height);
+	case _aspect_ratio_:		return range(media_range_aspect_ratio);
+	case _device_aspect_ratio_:	return range(media_range_device_aspect_ratio);
+	case _resolution_:			return range(media_range_resolution);
+	case _orientation_:
+		// portrait is height >= width, i.e. aspect ratio <= 1
+		breakpoints[media_range_aspect_ratio].push_back(1);
+		return 1u << media_range_aspect_ratio;
+	case _color_:				return media_dep_color;
+	case _color_index_:			return media_dep_color_index;
+	case _monochrome_:			return media_dep_monochrome;
+	case _prefers_color_scheme_:return media_dep_color_scheme;
+	default:					return 0;
+	}
+}
+
 trilean media_condition::check(const media_features& features) const
 {
 	if (op == _not_)
@@ -168,24 +197,123 @@ bool media_query_list::check(const media_features& features) const
 
 // nested @media rules: https://drafts.csswg.org/css-conditional-3/#processing
 // all of them must be true for style rules to apply
-bool media_query_list_list::apply_media_features(const media_features& features)
+bool media_query_list_list::check(const media_features& features) const
 {
-	bool apply = true;
-
 	for (const auto& mq_list: m_media_query_lists)
 	{
 		if (!mq_list.check(features))
 		{
-			apply = false;
-			break;
+			return false;
 		}
 	}
+	return true;
+}
 
-	bool ret = (apply != m_is_used);
-	m_is_used = apply;
-	return ret;
+
+void media_query_list_list::add_dependencies(const media_query_list& mq_list)
+{
+	// Iterative walk of the nested conditions
+	std::vector<const media_condition*> conditions;
+	for (const auto& query : mq_list.m_queries)
+	{
+		if (query.m_media_type != media_type_all) m_dependencies |= media_dep_type;
+		for (const auto& condition : query.m_conditions) conditions.push_back(&condition);
+	}
+	while (!conditions.empty())
+	{
+		const media_condition* condition = conditions.back();
+		conditions.pop_back();
+		for (const auto& item : condition->m_conditions)
+		{
+			if (item.is<media_condition>()) conditions.push_back(&item.get<media_condition>());
+			else if (item.is<media_feature>()) m_dependencies |= item.get<media_feature>().get_dependencies(m_breakpoints);
+		}
+	}
+	for (auto& values : m_breakpoints)
+	{
+		std::sort(values.begin(), values.end());
+		values.erase(std::unique(values.begin(), values.end()), values.end());
+	}
 }
 
+static float range_value(const media_features& features, media_range range)
+{
+	switch (range)
+	{
+	case media_range_width:				return features.width;
+	case media_range_height:			return features.height;
+	case media_range_device_width:		return features.device_width;
+	case media_range_device_height:		return features.device_height;
+	// Degenerate ratios are never inside an interval, see media_breakpoints::update
+	case media_range_aspect_ratio:			return features.height != 0 ? float(features.width) / features.height : NAN;
+	case media_range_device_aspect_ratio:	return features.device_height != 0 ? float(features.device_width) / features.device_height : NAN;
+	case media_range_resolution:		return features.resolution;
+	default:							return NAN;
+	}
+}
+
+void media_breakpoints::clear()
+{
+	*this = media_breakpoints();
+}
+
+void media_breakpoints::add(const media_query_list_list& list)
+{
+	m_dependencies |= list.dependencies();
+	for (int i = 0; i < media_range_count; i++)
+	{
+		const auto& values = list.breakpoints((media_range) i);
+		auto& all = m_values[i];
+		all.insert(all.end(), values.begin(), values.end());
+		std::sort(all.begin(), all.end());
+		all.erase(std::unique(all.begin(), all.end()), all.end());
+	}
+	m_valid = false;
+}
+
+void media_breakpoints::update(const media_features& features)
+{
+	// eval_op treats close values as equal, so the intervals keep away from the breakpoints
+	const float epsilon = 0.001f;
+
+	m_features = features;
+	for (int i = 0; i < media_range_count; i++)
+	{
+		const auto& values = m_values[i];
+		float x = range_value(features, (media_range) i);
+		auto above = std::lower_bound(values.begin(), values.end(), x);
+		float low = above == values.begin() ? -INFINITY : *(above - 1) + epsilon;
+		float high = above == values.end() ? INFINITY : *above - epsilon;
+		if (std::isnan(x) || x <= low || x >= high)
+		{
+			// On a breakpoint any change is evaluated
+			low = high = x;
+		}
+		m_low[i] = low;
+		m_high[i] = high;
+	}
+	m_valid = true;
+}
+
+uint32_t media_breakpoints::changed(const media_features& features) const
+{
+	if (!m_valid) return media_dep_all;
+
+	uint32_t ret = 0;
+	for (int i = 0; i < media_range_count; i++)
+	{
+		if (!(m_dependencies & (1u << i))) continue;
+		float x = range_value(features, (media_range) i);
+		// false for NaN
+		if (!(x > m_low[i] && x < m_high[i])) ret |= 1u << i;
+	}
+	if (features.type != m_features.type)								ret |= media_dep_type;
+	if (features.color != m_features.color)								ret |= media_dep_color;
+	if (features.color_index != m_features.color_index)					ret |= media_dep_color_index;
+	if (features.monochrome != m_features.monochrome)					ret |= media_dep_monochrome;
+	if (features.prefers_color_scheme != m_features.prefers_color_scheme)	ret |= media_dep_color_scheme;
+	return ret & m_dependencies;
+}
 
 bool parse_media_query(const css_token_vector& tokens, media_query& mquery, document::ptr doc);
 
@@ -0,0 +1,33 @@
+#include "html.h"
+#include "node_arena.h"
+
+namespace litehtml
+{
+
+void* node_arena::allocate(size_t size, size_t align)
+{
+	size_t pad = (align - reinterpret_cast<uintptr_t>(m_pos) % align) % align;
+	if (!m_pos || pad + size > m_left)
+	{
+		// Large blocks get their own chunk, the current one stays in use
+		if (size > ChunkSize / 4)
+		{
+			m_chunks.emplace_back(new char[size]);
+			m_reserved += size;
+			m_used += size;
+			return m_chunks.back().get();
+		}
+		m_chunks.emplace_back(new char[ChunkSize]);
+		m_reserved += ChunkSize;
+		m_pos = m_chunks.back().get();
+		m_left = ChunkSize;
+		pad = (align - reinterpret_cast<uintptr_t>(m_pos) % align) % align;
+	}
+	void* ret = m_pos + pad;
+	m_pos += pad + size;
+	m_left -= pad + size;
+	m_used += pad + size;
+	return ret;
+}
+
+} // namespace litehtml
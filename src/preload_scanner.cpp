@@ -0,0 +1,294 @@
+#include "html.h"
+#include "preload_scanner.h"
+#include "document.h"
+#include "document_container.h"
+#include <cstring>
+
+namespace litehtml
+{
+
+// Case insensitive comparison of str[pos...] with an ASCII lowercase prefix
+static bool starts_with_nocase(const string& str, size_t pos, const char* prefix)
+{
+	for (; *prefix; prefix++, pos++)
+	{
+		if (pos >= str.size() || t_tolower(str[pos]) != *prefix) return false;
+	}
+	return true;
+}
+
+// Elements whose content is not parsed as tags
+static bool is_raw_text_tag(const string& tag)
+{
+	static const char* tags[] = {"script", "style", "textarea", "title", "xmp", "iframe", "noembed", "noframes"};
+	for (const char* name : tags)
+	{
+		if (tag == name) return true;
+	}
+	return false;
+}
+
+void preload_scanner::scan_html(const string& html, const std::shared_ptr<document>& doc)
+{
+	size_t pos = m_pos;
+	if (!m_raw_tag.empty() && !skip_raw_text(html, pos, doc)) return;
+	while (true)
+	{
+		pos = html.find('<', pos);
+		if (pos == string::npos)
+		{
+			m_pos = html.size();
+			return;
+		}
+		size_t start = pos;
+
+		if (html.compare(pos, 4, "<!--") == 0)
+		{
+			size_t end = html.find("-->", pos + 4);
+			if (end == string::npos) break;
+			pos = end + 3;
+			continue;
+		}
+		if (pos + 1 < html.size() && (html[pos + 1] == '!' || html[pos + 1] == '?' || html[pos + 1] == '/'))
+		{
+			size_t end = html.find('>', pos + 1);
+			if (end == string::npos) break;
+			pos = end + 1;
+			continue;
+		}
+		if (pos + 1 >= html.size())
+		{
+			break;
+		}
+		if (!t_isalpha(html[pos + 1]))
+		{
+			pos++;
+			continue;
+		}
+
+		// Tag name
+		pos++;
+		string tag;
+		while (pos < html.size() && !is_whitespace(html[pos]) && html[pos] != '>' && html[pos] != '/')
+		{
+			tag += (char) t_tolower(html[pos++]);
+		}
+
+		// Attributes, only the ones of the interesting tags are kept
+		bool keep = tag == "link" || tag == "img" || tag == "base";
+		string rel, href, src, loading;
+		bool has_loading = false;
+		bool complete = false;
+		while (pos < html.size())
+		{
+			char ch = html[pos];
+			if (ch == '>')
+			{
+				complete = true;
+				pos++;
+				break;
+			}
+			if (is_whitespace(ch) || ch == '/')
+			{
+				pos++;
+				continue;
+			}
+			string name;
+			while (pos < html.size() && !is_whitespace(html[pos]) && html[pos] != '>' && html[pos] != '=' && html[pos] != '/')
+			{
+				name += (char) t_tolower(html[pos++]);
+			}
+			while (pos < html.size() && is_whitespace(html[pos])) pos++;
+			string value;
+			if (pos < html.size() && html[pos] == '=')
+			{
+				pos++;
+				while (pos < html.size() && is_whitespace(html[pos])) pos++;
+				if (pos < html.size() && (html[pos] == '"' || html[pos] == '\''))
+				{
+					size_t end = html.find(html[pos], pos + 1);
+					if (end == string::npos)
+					{
+						pos = html.size();
+						break;
+					}
+					value = html.substr(pos + 1, end - pos - 1);
+					pos = end + 1;
+				} else
+				{
+					size_t end = pos;
+					while (end < html.size() && !is_whitespace(html[end]) && html[end] != '>') end++;
+					value = html.substr(pos, end - pos);
+					pos = end;
+				}
+			}
+			if (keep)
+			{
+				// Only &amp; is expected in URLs
+				for (size_t amp = value.find("&amp;"); amp != string::npos; amp = value.find("&amp;", amp + 1))
+				{
+					value.erase(amp + 1, 4);
+				}
+				// The first of repeated attributes is used
+				if (name == "rel" && rel.empty()) rel = value;
+				else if (name == "href" && href.empty()) href = value;
+				else if (name == "src" && src.empty()) src = value;
+				else if (name == "loading" && !has_loading)
+				{
+					loading = value;
+					has_loading = true;
+				}
+			}
+		}
+		// Wait for the rest of the tag
+		if (!complete)
+		{
+			pos = start;
+			break;
+		}
+
+		if (tag == "base")
+		{
+			if (m_base.empty()) m_base = href;
+		} else if (tag == "link")
+		{
+			// Same condition as el_link::parse_attributes
+			if (rel == "stylesheet" && !href.empty())
+			{
+				request(href, m_base, resource_stylesheet, doc);
+			}
+		} else if (tag == "img")
+		{
+			// Lazy images are loaded when they come near the viewport
+			if (!src.empty() && !doc->lazy_images().is_lazy(has_loading ? loading.c_str() : nullptr))
+			{
+				request(src, m_base, resource_image, doc);
+			}
+		} else if (is_raw_text_tag(tag))
+		{
+			m_raw_tag = tag;
+			m_raw_start = pos;
+			if (!skip_raw_text(html, pos, doc)) return;
+		}
+	}
+	m_pos = pos;
+}
+
+// Finds the end tag of m_raw_tag from pos and moves pos to it. Without the end tag the next scan
+// resumes the search where this one stopped, the content is not searched again.
+bool preload_scanner::skip_raw_text(const string& html, size_t& pos, const std::shared_ptr<document>& doc)
+{
+	size_t end = pos;
+	while ((end = html.find("</", end)) != string::npos && !starts_with_nocase(html, end + 2, m_raw_tag.c_str()))
+	{
+		end += 2;
+	}
+	if (end == string::npos)
+	{
+		// The end tag can be split between the appends
+		size_t tail = m_raw_tag.size() + 1;
+		m_pos = std::max(m_raw_start, html.size() > tail ? html.size() - tail : 0);
+		return false;
+	}
+	if (m_raw_tag == "style")
+	{
+		scan_css(html.substr(m_raw_start, end - m_raw_start), m_base, doc);
+	}
+	m_raw_tag.clear();
+	pos = end;
+	return true;
+}
+
+void preload_scanner::scan_css(const string& text, const string& baseurl, const std::shared_ptr<document>& doc)
+{
+	// @import rules must come first, only @charset can precede them
+	size_t pos = 0;
+	auto skip_space = [&text, &pos]()
+	{
+		while (pos < text.size())
+		{
+			if (is_whitespace(text[pos]))
+			{
+				pos++;
+			} else if (text.compare(pos, 2, "/*") == 0)
+			{
+				size_t end = text.find("*/", pos + 2);
+				pos = end == string::npos ? text.size() : end + 2;
+			} else
+			{
+				break;
+			}
+		}
+	};
+	auto skip_rule = [&text, &pos]()
+	{
+		char quote = 0;
+		for (; pos < text.size(); pos++)
+		{
+			char ch = text[pos];
+			if (quote)
+			{
+				if (ch == quote) quote = 0;
+			} else if (ch == '"' || ch == '\'')
+			{
+				quote = ch;
+			} else if (ch == ';')
+			{
+				pos++;
+				return;
+			}
+		}
+	};
+
+	while (true)
+	{
+		skip_space();
+		if (starts_with_nocase(text, pos, "@charset"))
+		{
+			skip_rule();
+			continue;
+		}
+		if (!starts_with_nocase(text, pos, "@import")) break;
+		pos += 7;
+		skip_space();
+
+		string url;
+		bool is_url = starts_with_nocase(text, pos, "url(");
+		if (is_url)
+		{
+			pos += 4;
+			skip_space();
+		}
+		if (pos < text.size() && (text[pos] == '"' || text[pos] == '\''))
+		{
+			size_t end = text.find(text[pos], pos + 1);
+			if (end == string::npos) break;
+			url = text.substr(pos + 1, end - pos - 1);
+			pos = end + 1;
+		} else if (is_url)
+		{
+			size_t end = text.find(')', pos);
+			if (end == string::npos) break;
+			url = trim(text.substr(pos, end - pos));
+			pos = end + 1;
+		}
+		if (!url.empty())
+		{
+			request(url, baseurl, resource_stylesheet, doc);
+		}
+		skip_rule();
+	}
+}
+
+void preload_scanner::request(const string& url, const string& baseurl, resource_type type, const std::shared_ptr<document>& doc)
+{
+	document_container* container = doc->container();
+	if (!container) return;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_requested.insert(baseurl + '\n' + url).second) return;
+	}
+	container->preload(doc, url, baseurl, type);
+}
+
+} // namespace litehtml
@@ -64,7 +64,7 @@ std::shared_ptr<litehtml::render_item> litehtml::render_item_block::init()
             int val = atoi(p->get_attr("start", "1"));
 			for(const auto &child : p->children())
             {
-                if (child == src_el())
+                if (child.get() == src_el())
                 {
                     src_el()->set_attr("list_index", std::to_string(val).c_str());
                     break;
@@ -78,7 +78,7 @@ std::shared_ptr<litehtml::render_item> litehtml::render_item_block::init()
     auto iter = m_children.begin();
     while (iter != m_children.end())
     {
-        const auto& el = *iter;
+        auto el = *iter;
         if(el->src_el()->css().get_display() == display_inline && !el->children().empty())
         {
             auto split_el = el->split_inlines();
@@ -88,10 +88,6 @@ std::shared_ptr<litehtml::render_item> litehtml::render_item_block::init()
                 iter = m_children.insert(iter, std::get<2>(split_el));
                 iter = m_children.insert(iter, std::get<1>(split_el));
                 iter = m_children.insert(iter, std::get<0>(split_el));
-
-                std::get<0>(split_el)->parent(shared_from_this());
-                std::get<1>(split_el)->parent(shared_from_this());
-                std::get<2>(split_el)->parent(shared_from_this());
                 continue;
             }
         }
@@ -117,15 +113,15 @@ std::shared_ptr<litehtml::render_item> litehtml::render_item_block::init()
     }
     if(has_block_level)
     {
-        ret = std::make_shared<render_item_block_context>(src_el());
+        ret = make_render_item<render_item_block_context>(src_el());
         ret->parent(parent());
 
-        auto doc = src_el()->get_document();
-        decltype(m_children) new_children;
+        // The children are moved to ret, the inlines between block boxes into anonymous blocks
         decltype(m_children) inlines;
         bool not_ws_added = false;
-        for (const auto& el : m_children)
+        while (!m_children.empty())
         {
+            auto el = m_children.front();
             if(el->src_el()->is_inline())
             {
                 inlines.push_back(el);
@@ -135,46 +131,32 @@ std::shared_ptr<litehtml::render_item> litehtml::render_item_block::init()
             {
                 if(not_ws_added)
                 {
-                    auto anon_el = std::make_shared<html_tag>(src_el());
-                    auto anon_ri = std::make_shared<render_item_block>(anon_el);
-                    for(const auto& inl : inlines)
-                    {
-                        anon_ri->add_child(inl);
-                    }
+                    auto anon_el = std::make_shared<html_tag>(src_el()->shared_from_this());
+                    auto anon_ri = make_anonymous_render_item<render_item_block>(anon_el);
+                    anon_ri->children().splice(anon_ri->children().end(), inlines);
 
                     not_ws_added = false;
-                    new_children.push_back(anon_ri);
-                    anon_ri->parent(ret);
+                    ret->add_child(anon_ri);
                 }
-                new_children.push_back(el);
-                el->parent(ret);
+                ret->add_child(el);
                 inlines.clear();
             }
         }
         if(!inlines.empty() && not_ws_added)
         {
-            auto anon_el = std::make_shared<html_tag>(src_el());
-            auto anon_ri = std::make_shared<render_item_block>(anon_el);
-            for(const auto& inl : inlines)
-            {
-                anon_ri->add_child(inl);
-            }
+            auto anon_el = std::make_shared<html_tag>(src_el()->shared_from_this());
+            auto anon_ri = make_anonymous_render_item<render_item_block>(anon_el);
+            anon_ri->children().splice(anon_ri->children().end(), inlines);
 
-            new_children.push_back(anon_ri);
-            anon_ri->parent(ret);
+            ret->add_child(anon_ri);
         }
-        ret->children() = new_children;
     }
 
     if(!ret)
     {
-        ret = std::make_shared<render_item_inline_context>(src_el());
+        ret = make_render_item<render_item_inline_context>(src_el());
         ret->parent(parent());
-        ret->children() = children();
-        for (const auto &el: ret->children())
-        {
-            el->parent(ret);
-        }
+        ret->children().splice(ret->children().end(), m_children);
     }
 
     ret->src_el()->add_render(ret);
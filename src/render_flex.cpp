@@ -331,7 +331,7 @@ std::list<litehtml::flex_line> litehtml::render_item_flex::get_lines(const liteh
 
 std::shared_ptr<litehtml::render_item> litehtml::render_item_flex::init()
 {
-    auto doc = src_el()->get_document();
+    // The children are moved to new_children, the inlines are wrapped with anonymous blocks
     decltype(m_children) new_children;
     decltype(m_children) inlines;
 
@@ -350,33 +350,26 @@ std::shared_ptr<litehtml::render_item> litehtml::render_item_flex::init()
                 inlines.erase((not_space.base()), inlines.end());
             }
 
-            auto anon_el = std::make_shared<html_tag>(src_el());
-            auto anon_ri = std::make_shared<render_item_block>(anon_el);
-            for(const auto& inl : inlines)
-            {
-                anon_ri->add_child(inl);
-            }
-            anon_ri->parent(shared_from_this());
+            auto anon_el = std::make_shared<html_tag>(src_el()->shared_from_this());
+            auto anon_ri = make_anonymous_render_item<render_item_block>(anon_el);
+            anon_ri->children().splice(anon_ri->children().end(), inlines);
 
             // Don't call init() recursively - init_tree() handles that
             new_children.push_back(anon_ri);
-            inlines.clear();
         }
         };
 
-    for (const auto& el : m_children)
+    while (!m_children.empty())
     {
+        auto el = m_children.front();
         if(el->src_el()->css().get_display() == display_inline_text)
         {
-            if(!inlines.empty())
+            if(!inlines.empty() || !el->src_el()->is_white_space())
             {
                 inlines.push_back(el);
             } else
             {
-                if (!el->src_el()->is_white_space())
-                {
-                    inlines.push_back(el);
-                }
+                m_children.erase(m_children.begin());
             }
         } else
         {
@@ -384,23 +377,21 @@ std::shared_ptr<litehtml::render_item> litehtml::render_item_flex::init()
             if(el->src_el()->is_block_box())
             {
                 // Add block boxes as is
-                el->parent(shared_from_this());
                 // Don't call init() recursively - init_tree() handles that
                 new_children.push_back(el);
             } else
             {
                 // Wrap inlines with anonymous block box
-                auto anon_el = std::make_shared<html_tag>(el->src_el());
-                auto anon_ri = std::make_shared<render_item_block>(anon_el);
+                auto anon_el = std::make_shared<html_tag>(el->src_el()->shared_from_this());
+                auto anon_ri = make_anonymous_render_item<render_item_block>(anon_el);
                 // Don't call init() recursively - init_tree() handles that
                 anon_ri->add_child(el);
-                anon_ri->parent(shared_from_this());
                 new_children.push_back(anon_ri);
             }
         }
     }
     convert_inlines();
-    children() = new_children;
+    children().splice(children().end(), new_children);
 
     return shared_from_this();
 }
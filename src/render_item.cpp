@@ -1,11 +1,20 @@
 #include "render_item.h"
 #include "document.h"
 #include <typeinfo>
+#include <cmath>
 #include "document_container.h"
 #include "types.h"
+#include "paint_profiler.h"
 
-litehtml::render_item::render_item(std::shared_ptr<element>  _src_el) :
-        m_element(std::move(_src_el)),
+litehtml::node_arena* litehtml::render_arena(const element* el)
+{
+    document::ptr doc = el->get_document();
+    return doc ? doc->render_arena() : nullptr;
+}
+
+litehtml::render_item::render_item(element* _src_el) :
+        m_element(_src_el),
+        m_children(this),
         m_skip(false),
         m_needs_layout(false),
         m_damage(damage_flags::reflow_all),
@@ -30,6 +39,11 @@ litehtml::render_item::render_item(std::shared_ptr<element>  _src_el) :
     m_borders.bottom	= doc->to_pixels(src_el()->css().get_borders().bottom.width, fm, 0);
 }
 
+litehtml::render_item::~render_item()
+{
+    release_layer();
+}
+
 litehtml::pixel_t litehtml::render_item::render(pixel_t x, pixel_t y, const containing_block_context& containing_block_size, formatting_context* fmt_ctx, bool second_pass)
 {
 	pixel_t ret;
@@ -152,33 +166,30 @@ std::tuple<
             std::shared_ptr<litehtml::render_item>,
             std::shared_ptr<litehtml::render_item>
     > ret;
-    for(const auto& child: m_children)
-    {
-        if(child->src_el()->is_block_box() && child->src_el()->css().get_float() == float_none)
+    // The children before child are moved to the first clone, the ones after it to the last one
+    auto split_children = [&](const std::shared_ptr<render_item>& child)
         {
             std::get<0>(ret) = clone();
-            std::get<1>(ret) = child;
             std::get<2>(ret) = clone();
+            std::get<0>(ret)->m_anonymous_el = m_anonymous_el;
+            std::get<2>(ret)->m_anonymous_el = m_anonymous_el;
 
-            std::get<1>(ret)->parent(std::get<0>(ret));
-            std::get<2>(ret)->parent(std::get<0>(ret));
-
-            bool found = false;
-            for(const auto& ch: m_children)
+            auto& first = std::get<0>(ret)->children();
+            auto& last = std::get<2>(ret)->children();
+            while (m_children.front() != child)
             {
-                if(ch == child)
-                {
-                    found = true;
-                    continue;
-                }
-                if(!found)
-                {
-                    std::get<0>(ret)->add_child(ch);
-                } else
-                {
-                    std::get<2>(ret)->add_child(ch);
-                }
+                first.push_back(m_children.front());
             }
+            m_children.erase(m_children.begin());
+            last.splice(last.end(), m_children);
+        };
+    for(auto iter = m_children.begin(); iter != m_children.end(); ++iter)
+    {
+        auto child = *iter;
+        if(child->src_el()->is_block_box() && child->src_el()->css().get_float() == float_none)
+        {
+            split_children(child);
+            std::get<1>(ret) = child;
             break;
         }
         if(!child->children().empty())
@@ -186,28 +197,8 @@ std::tuple<
             auto child_split = child->split_inlines();
             if(std::get<0>(child_split))
             {
-                std::get<0>(ret) = clone();
+                split_children(child);
                 std::get<1>(ret) = std::get<1>(child_split);
-                std::get<2>(ret) = clone();
-
-                std::get<2>(ret)->parent(std::get<0>(ret));
-
-                bool found = false;
-                for(const auto& ch: m_children)
-                {
-                    if(ch == child)
-                    {
-                        found = true;
-                        continue;
-                    }
-                    if(!found)
-                    {
-                        std::get<0>(ret)->add_child(ch);
-                    } else
-                    {
-                        std::get<2>(ret)->add_child(ch);
-                    }
-                }
                 std::get<0>(ret)->add_child(std::get<0>(child_split));
                 std::get<2>(ret)->add_child(std::get<2>(child_split));
                 break;
@@ -669,7 +660,7 @@ void litehtml::render_item::render_positioned(render_type rt)
 
     if(!m_positioned.empty())
     {
-        std::stable_sort(m_positioned.begin(), m_positioned.end(), [](const std::shared_ptr<render_item>& Left, const std::shared_ptr<render_item>& Right)
+        std::stable_sort(m_positioned.begin(), m_positioned.end(), [](const render_item* Left, const render_item* Right)
             {
                 return (Left->src_el()->css().get_z_index() < Right->src_el()->css().get_z_index());
             });
@@ -699,7 +690,7 @@ void litehtml::render_item::add_positioned(const std::shared_ptr<litehtml::rende
 
     if (creates_stacking_context)
     {
-        m_positioned.push_back(el);
+        m_positioned.push_back(el.get());
     } else
     {
         auto el_parent = parent();
@@ -814,6 +805,8 @@ void litehtml::render_item::draw_stacking_context( uint_ptr hdc, pixel_t x, pixe
     // and should not draw children
     if(src_el()->is_replaced()) return;
 
+    PAINT_PROFILE_CONTEXT(this, src_el()->get_tagName());
+
     std::map<int, bool> z_indexes;
     if(with_positioned)
     {
@@ -899,8 +892,11 @@ void litehtml::render_item::draw_children(uint_ptr hdc, pixel_t x, pixel_t y, co
                         if (el->src_el()->css().get_position() == element_position_fixed)
 						{
 							// Fixed elements position is always relative to the (0,0)
-                            el->src_el()->draw(hdc, 0, 0, clip, el);
-                            el->draw_stacking_context(hdc, 0, 0, clip, true, depth + 1);
+                            if (!el->draw_composited(hdc, 0, 0, true, depth + 1))
+                            {
+                                el->src_el()->draw(hdc, 0, 0, clip, el);
+                                el->draw_stacking_context(hdc, 0, 0, clip, true, depth + 1);
+                            }
                         }
                         else if (el->src_el()->css().get_position() == element_position_sticky)
                         {
@@ -927,10 +923,13 @@ void litehtml::render_item::draw_children(uint_ptr hdc, pixel_t x, pixel_t y, co
                             }
                             // TODO: Handle bottom, left, right sticky offsets
 
-                            el->src_el()->draw(hdc, draw_x, draw_y, clip, el);
-                            el->draw_stacking_context(hdc, draw_x, draw_y, clip, true, depth + 1);
+                            if (!el->draw_composited(hdc, draw_x, draw_y, true, depth + 1))
+                            {
+                                el->src_el()->draw(hdc, draw_x, draw_y, clip, el);
+                                el->draw_stacking_context(hdc, draw_x, draw_y, clip, true, depth + 1);
+                            }
                         }
-                        else
+                        else if (!el->draw_composited(hdc, pos.x, pos.y, true, depth + 1))
                         {
                             el->src_el()->draw(hdc, pos.x, pos.y, clip, el);
                             el->draw_stacking_context(hdc, pos.x, pos.y, clip, true, depth + 1);
@@ -941,25 +940,41 @@ void litehtml::render_item::draw_children(uint_ptr hdc, pixel_t x, pixel_t y, co
                 case draw_block:
                     if (!el->src_el()->is_inline() && el->src_el()->css().get_float() == float_none && !el->src_el()->is_positioned())
                     {
-                        el->src_el()->draw(hdc, pos.x, pos.y, clip, el);
+                        // A composited block paints its whole in-flow subtree into the layer
+                        if (el->draw_composited(hdc, pos.x, pos.y, false, depth + 1))
+                        {
+                            process = false;
+                        } else
+                        {
+                            el->src_el()->draw(hdc, pos.x, pos.y, clip, el);
+                        }
                     }
                     break;
                 case draw_floats:
                     if (el->src_el()->css().get_float() != float_none && !el->src_el()->is_positioned())
                     {
-                        el->src_el()->draw(hdc, pos.x, pos.y, clip, el);
-                        el->draw_stacking_context(hdc, pos.x, pos.y, clip, false, depth + 1);
+                        if (!el->draw_composited(hdc, pos.x, pos.y, false, depth + 1))
+                        {
+                            el->src_el()->draw(hdc, pos.x, pos.y, clip, el);
+                            el->draw_stacking_context(hdc, pos.x, pos.y, clip, false, depth + 1);
+                        }
                         process = false;
                     }
                     break;
                 case draw_inlines:
                     if (el->src_el()->is_inline() && el->src_el()->css().get_float() == float_none && !el->src_el()->is_positioned())
                     {
-                        el->src_el()->draw(hdc, pos.x, pos.y, clip, el);
                         if (el->src_el()->css().get_display() == display_inline_block || el->src_el()->css().get_display() == display_inline_flex)
                         {
-                            el->draw_stacking_context(hdc, pos.x, pos.y, clip, false, depth + 1);
+                            if (!el->draw_composited(hdc, pos.x, pos.y, false, depth + 1))
+                            {
+                                el->src_el()->draw(hdc, pos.x, pos.y, clip, el);
+                                el->draw_stacking_context(hdc, pos.x, pos.y, clip, false, depth + 1);
+                            }
                             process = false;
+                        } else
+                        {
+                            el->src_el()->draw(hdc, pos.x, pos.y, clip, el);
                         }
                     }
                     break;
@@ -978,9 +993,11 @@ void litehtml::render_item::draw_children(uint_ptr hdc, pixel_t x, pixel_t y, co
                 }
                 else
                 {
+                    // Composited blocks were painted into their layer by the draw_block pass
                     if (el->src_el()->css().get_float() == float_none &&
                         el->src_el()->css().get_display() != display_inline_block &&
-                        !el->src_el()->is_positioned())
+                        !el->src_el()->is_positioned() &&
+                        !el->is_composited())
                     {
                         el->draw_children(hdc, pos.x, pos.y, clip, flag, zindex, depth + 1);
                     }
@@ -995,6 +1012,109 @@ void litehtml::render_item::draw_children(uint_ptr hdc, pixel_t x, pixel_t y, co
     }
 }
 
+void litehtml::render_item::invalidate_layers()
+{
+    invalidate_subtree_layers();
+    for(auto par = parent(); par; par = par->parent())
+    {
+        par->m_layer.stale = true;
+    }
+}
+
+void litehtml::render_item::invalidate_subtree_layers()
+{
+    m_layer.stale = true;
+    for(const auto& el : m_children)
+    {
+        el->invalidate_subtree_layers();
+    }
+}
+
+void litehtml::render_item::release_layer()
+{
+    if(m_layer.handle)
+    {
+        m_layer.container->delete_layer(m_layer.handle);
+        m_layer.handle = 0;
+    }
+}
+
+bool litehtml::render_item::draw_composited(uint_ptr hdc, pixel_t x, pixel_t y, bool with_positioned, int depth)
+{
+    const css_properties& css = src_el()->css();
+    if(is_root() || !css.needs_compositing_layer())
+    {
+        release_layer();
+        return false;
+    }
+
+    document::ptr doc = src_el()->get_document();
+    document_container* container = doc->container();
+
+    position border_box = m_pos;
+    border_box += m_padding;
+    border_box += m_borders;
+
+    // The layer covers the border box and the visible overflow of the subtree
+    position bounds = border_box;
+    get_redraw_box(bounds);
+    pixel_t left = std::floor(bounds.left());
+    pixel_t top = std::floor(bounds.top());
+    bounds = position(left, top, std::ceil(bounds.right()) - left, std::ceil(bounds.bottom()) - top);
+    if(bounds.width <= 0 || bounds.height <= 0)
+    {
+        release_layer();
+        return false;
+    }
+
+    string filter = css.get_filter();
+    if(filter == "none") filter.clear();
+
+    if(!m_layer.handle || m_layer.stale || m_layer.generation != doc->paint_generation() || m_layer.filter != filter || !(m_layer.bounds == bounds))
+    {
+        release_layer();
+        uint_ptr layer = container->create_layer(hdc, (int) bounds.width, (int) bounds.height);
+        if(!layer)
+        {
+            return false;
+        }
+        m_layer.container = container;
+        m_layer.handle = layer;
+        m_layer.bounds = bounds;
+        m_layer.filter = filter;
+        m_layer.generation = doc->paint_generation();
+        m_layer.stale = false;
+
+        PAINT_PROFILE_LAYER();
+
+        // The filter is rasterized with the content, transform and opacity are applied on composite
+        if(!filter.empty()) container->begin_filter(filter);
+        src_el()->draw(layer, -bounds.x, -bounds.y, nullptr, shared_from_this());
+        draw_stacking_context(layer, -bounds.x, -bounds.y, nullptr, with_positioned, depth + 1);
+        if(!filter.empty()) container->end_filter();
+        container->finish_layer(layer);
+    }
+
+    // Running transitions change opacity and transform without repainting the layer
+    float opacity = css.get_opacity();
+    const TransformMatrix& transform = css.get_transform_matrix();
+
+    // Transform around transform-origin, then move the layer to its place
+    float origin_x = (float) (x + border_box.x + css.get_transform_origin_x().calc_percent(border_box.width));
+    float origin_y = (float) (y + border_box.y + css.get_transform_origin_y().calc_percent(border_box.height));
+    TransformMatrix matrix = TransformMatrix::translate(origin_x, origin_y)
+        .multiply(transform)
+        .multiply(TransformMatrix::translate((float) (x + bounds.x) - origin_x, (float) (y + bounds.y) - origin_y));
+
+#ifdef LITEHTML_PROFILE_PAINT
+    float layer_x = 0, layer_y = 0, layer_width = (float) bounds.width, layer_height = (float) bounds.height;
+    matrix.applyToRect(layer_x, layer_y, layer_width, layer_height);
+    PAINT_PROFILE_DRAW(composite_layer, position(layer_x, layer_y, layer_width, layer_height));
+#endif
+    container->composite_layer(hdc, m_layer.handle, matrix, std::max(0.0f, std::min(1.0f, opacity)));
+    return true;
+}
+
 std::shared_ptr<litehtml::element>  litehtml::render_item::get_child_by_point(pixel_t x, pixel_t y, pixel_t client_x, pixel_t client_y, draw_flag flag, int zindex, int depth)
 {
     // Prevent stack overflow from deeply nested or cyclic DOM structures
@@ -1018,9 +1138,10 @@ std::shared_ptr<litehtml::element>  litehtml::render_item::get_child_by_point(pi
     el_pos.x	= x - el_pos.x;
     el_pos.y	= y - el_pos.y;
 
-    for(auto i = m_children.rbegin(); i != m_children.rend() && !ret; std::advance(i, 1))
+    auto hit_child = [&](render_item* item) -> element::ptr
     {
-        auto el = (*i);
+        element::ptr ret;
+        render_item* el = item;
 
         if(el->is_visible() && el->src_el()->css().get_display() != display_inline_text)
         {
@@ -1032,16 +1153,16 @@ std::shared_ptr<litehtml::element>  litehtml::render_item::get_child_by_point(pi
                         if(el->src_el()->css().get_position() == element_position_fixed)
                         {
                             ret = el->get_element_by_point(client_x, client_y, client_x, client_y, depth + 1);
-                            if(!ret && (*i)->is_point_inside(client_x, client_y))
+                            if(!ret && item->is_point_inside(client_x, client_y))
                             {
-                                ret = (*i)->src_el();
+                                ret = item->src_el()->shared_from_this();
                             }
                         } else
                         {
                             ret = el->get_element_by_point(el_pos.x, el_pos.y, client_x, client_y, depth + 1);
-                            if(!ret && (*i)->is_point_inside(el_pos.x, el_pos.y))
+                            if(!ret && item->is_point_inside(el_pos.x, el_pos.y))
                             {
-                                ret = (*i)->src_el();
+                                ret = item->src_el()->shared_from_this();
                             }
                         }
                         el = nullptr;
@@ -1056,7 +1177,7 @@ std::shared_ptr<litehtml::element>  litehtml::render_item::get_child_by_point(pi
                             ret = el->get_element_by_point(el_pos.x, el_pos.y, client_x, client_y, depth + 1);
                             if(!ret)
                             {
-                                ret = el->src_el();
+                                ret = el->src_el()->shared_from_this();
                             }
                             el = nullptr;  // Prevent code below from overwriting ret
                         }
@@ -1067,9 +1188,9 @@ std::shared_ptr<litehtml::element>  litehtml::render_item::get_child_by_point(pi
                     {
                         ret = el->get_element_by_point(el_pos.x, el_pos.y, client_x, client_y, depth + 1);
 
-                        if(!ret && (*i)->is_point_inside(el_pos.x, el_pos.y))
+                        if(!ret && item->is_point_inside(el_pos.x, el_pos.y))
                         {
-                            ret = (*i)->src_el();
+                            ret = item->src_el()->shared_from_this();
                         }
                         el = nullptr;
                     }
@@ -1084,9 +1205,9 @@ std::shared_ptr<litehtml::element>  litehtml::render_item::get_child_by_point(pi
                             ret = el->get_element_by_point(el_pos.x, el_pos.y, client_x, client_y, depth + 1);
                             el = nullptr;
                         }
-                        if(!ret && (*i)->is_point_inside(el_pos.x, el_pos.y))
+                        if(!ret && item->is_point_inside(el_pos.x, el_pos.y))
                         {
-                            ret = (*i)->src_el();
+                            ret = item->src_el()->shared_from_this();
                         }
                     }
                     break;
@@ -1117,6 +1238,30 @@ std::shared_ptr<litehtml::element>  litehtml::render_item::get_child_by_point(pi
                 }
             }
         }
+        return ret;
+    };
+
+    // The hit testing index skips children that have nothing at the point
+    uint32_t hit_generation = src_el()->get_document()->hit_generation();
+    if(m_hit_bands && m_hit_generation == hit_generation)
+    {
+        const auto& band = m_hit_bands->find(el_pos.y);
+        for(auto i = band.rbegin(); i != band.rend() && !ret; std::advance(i, 1))
+        {
+            if((*i)->may_hit(el_pos.x, el_pos.y, hit_generation))
+            {
+                ret = hit_child(*i);
+            }
+        }
+        return ret;
+    }
+
+    for(auto i = m_children.rbegin(); i != m_children.rend() && !ret; std::advance(i, 1))
+    {
+        if((*i)->may_hit(el_pos.x, el_pos.y, hit_generation))
+        {
+            ret = hit_child(i->get());
+        }
     }
 
     return ret;
@@ -1132,6 +1277,7 @@ std::shared_ptr<litehtml::element> litehtml::render_item::get_element_by_point(p
     }
 
     if(!is_visible()) return nullptr;
+    if(!may_hit(x, y, src_el()->get_document()->hit_generation())) return nullptr;
 
     element::ptr ret;
 
@@ -1183,13 +1329,13 @@ std::shared_ptr<litehtml::element> litehtml::render_item::get_element_by_point(p
     {
         if(is_point_inside(client_x, client_y))
         {
-            ret = src_el();
+            ret = src_el()->shared_from_this();
         }
     } else
     {
         if(is_point_inside(x, y))
         {
-            ret = src_el();
+            ret = src_el()->shared_from_this();
         }
     }
 
@@ -1225,6 +1371,111 @@ bool litehtml::render_item::is_point_inside( pixel_t x, pixel_t y )
     return false;
 }
 
+void litehtml::render_item::get_hit_children(std::vector<render_item*>& children, std::vector<render_item*>& /*bounds_only*/, bool& clipped)
+{
+	for(const auto& el : m_children)
+	{
+		children.push_back(el.get());
+	}
+	clipped = src_el()->css().get_overflow() > overflow_visible;
+}
+
+void litehtml::render_item::update_hit_bounds(uint32_t generation)
+{
+	std::vector<render_item*> children;
+	std::vector<render_item*> bounds_only;
+	bool clipped = false;
+	get_hit_children(children, bounds_only, clipped);
+
+	hit_bounds bounds;
+	bounds.unbounded = src_el()->css().get_position() == element_position_fixed;
+
+	// The own area, see is_point_inside
+	if(src_el()->css().get_display() != display_inline && src_el()->css().get_display() != display_table_row)
+	{
+		position pos = m_pos;
+		pos += m_padding;
+		pos += m_borders;
+		bounds.add(pos);
+	} else
+	{
+		position::vector boxes;
+		get_inline_boxes(boxes);
+		for(const auto& box : boxes)
+		{
+			bounds.add(box);
+		}
+	}
+
+	hit_bounds children_bounds;
+	for(auto list : {&children, &bounds_only})
+	{
+		for(auto el : *list)
+		{
+			if(el->m_hit_generation == generation)
+			{
+				children_bounds.add(el->m_hit_bounds, m_pos.x, m_pos.y);
+			} else
+			{
+				children_bounds.unbounded = true;
+			}
+		}
+	}
+	if(clipped)
+	{
+		children_bounds.clip(m_pos);
+	}
+	bounds.add(children_bounds, 0, 0);
+
+	m_hit_bounds = bounds;
+	m_hit_generation = generation;
+
+	m_hit_bands = nullptr;
+	if(children.size() >= hit_bands::MinChildren)
+	{
+		std::vector<std::pair<render_item*, const hit_bounds*>> items;
+		items.reserve(children.size());
+		for(auto el : children)
+		{
+			items.emplace_back(el, &el->m_hit_bounds);
+		}
+		auto bands = std::make_unique<hit_bands>();
+		if(bands->build(items))
+		{
+			m_hit_bands = std::move(bands);
+		}
+	}
+}
+
+void litehtml::render_item::build_hit_index(uint32_t generation)
+{
+	// Iterative post-order walk to handle deeply nested documents
+	std::vector<std::pair<render_item*, bool>> stack;
+	std::vector<render_item*> children;
+	std::vector<render_item*> bounds_only;
+	stack.emplace_back(this, false);
+	while(!stack.empty())
+	{
+		auto item = stack.back();
+		stack.pop_back();
+		if(item.first->m_hit_generation == generation) continue;
+
+		if(item.second)
+		{
+			item.first->update_hit_bounds(generation);
+			continue;
+		}
+
+		stack.emplace_back(item.first, true);
+		children.clear();
+		bounds_only.clear();
+		bool clipped = false;
+		item.first->get_hit_children(children, bounds_only, clipped);
+		for(auto el : children) stack.emplace_back(el, false);
+		for(auto el : bounds_only) stack.emplace_back(el, false);
+	}
+}
+
 void litehtml::render_item::get_rendering_boxes( position::vector& redraw_boxes)
 {
     if(src_el()->css().get_display() == display_inline || src_el()->css().get_display() == display_table_row)
@@ -1237,7 +1488,48 @@ void litehtml::render_item::get_rendering_boxes( position::vector& redraw_boxes)
         pos += m_borders;
         redraw_boxes.push_back(pos);
     }
+    to_document_coords(redraw_boxes);
+}
 
+void litehtml::render_item::get_paint_boxes( position::vector& redraw_boxes)
+{
+    if(src_el()->css().get_display() == display_inline || src_el()->css().get_display() == display_table_row)
+    {
+        get_rendering_boxes(redraw_boxes);
+        return;
+    }
+
+    position border_box = m_pos;
+    border_box += m_padding;
+    border_box += m_borders;
+
+    // Same area as the compositing layer, see draw_composited
+    position bounds = border_box;
+    get_redraw_box(bounds);
+
+    const css_properties& css = src_el()->css();
+    if(css.has_transform())
+    {
+        float origin_x = (float) (border_box.x + css.get_transform_origin_x().calc_percent(border_box.width));
+        float origin_y = (float) (border_box.y + css.get_transform_origin_y().calc_percent(border_box.height));
+        TransformMatrix matrix = TransformMatrix::translate(origin_x, origin_y)
+            .multiply(css.get_transform_matrix())
+            .multiply(TransformMatrix::translate(-origin_x, -origin_y));
+        float x = (float) bounds.x, y = (float) bounds.y, width = (float) bounds.width, height = (float) bounds.height;
+        matrix.applyToRect(x, y, width, height);
+        pixel_t left = std::floor(x);
+        pixel_t top = std::floor(y);
+        bounds = position(left, top, std::ceil(x + width) - left, std::ceil(y + height) - top);
+    }
+
+    position::vector boxes = {bounds};
+    to_document_coords(boxes);
+    redraw_boxes.push_back(boxes.front());
+}
+
+// Moves boxes from the coordinates of the parent to the document coordinates
+void litehtml::render_item::to_document_coords( position::vector& redraw_boxes)
+{
     if(src_el()->css().get_position() != element_position_fixed)
     {
 		auto cur_el = parent();
@@ -1329,44 +1621,53 @@ std::shared_ptr<litehtml::render_item> litehtml::render_item::init_tree(std::sha
 {
     if (!root) return nullptr;
 
-    // Work item: pointer to where result should be stored, and the item to init
-    struct work_item {
-        std::shared_ptr<render_item>* result_ptr;
-        std::shared_ptr<render_item> item;
-    };
-
-    std::vector<work_item> stack;
-    std::shared_ptr<render_item> result = root;
+    std::vector<std::shared_ptr<render_item>> stack;
+    std::shared_ptr<render_item> result;
 
     // Start with root
-    stack.push_back({&result, root});
+    stack.push_back(std::move(root));
 
     while (!stack.empty())
     {
-        work_item work = std::move(stack.back());
+        auto item = std::move(stack.back());
         stack.pop_back();
 
+        // Subtrees initialized by the init() of an ancestor (table cells and captions) are skipped
+        if (item->m_initialized)
+        {
+            if (!result) result = item;
+            continue;
+        }
+
         // Initialize this item (may return a different item)
-        auto new_item = work.item->init();
+        auto new_item = item->init();
+        new_item->m_initialized = true;
 
-        // Update the result pointer with the new item
-        if (work.result_ptr)
+        // The new item replaces the old one in the children of its parent
+        if (new_item != item)
         {
-            *work.result_ptr = new_item;
+            if (!new_item->m_anonymous_el)
+            {
+                new_item->m_anonymous_el = item->m_anonymous_el;
+            }
+            if (item->m_siblings)
+            {
+                auto& siblings = *item->m_siblings;
+                auto pos = siblings.find(item.get());
+                siblings.insert(pos, new_item);
+                siblings.erase(pos);
+            }
         }
-
-        // Push children onto stack (process in reverse order to maintain order)
-        auto& child_list = new_item->children();
-        std::vector<std::list<std::shared_ptr<render_item>>::iterator> child_iters;
-        for (auto it = child_list.begin(); it != child_list.end(); ++it)
+        if (!result)
         {
-            child_iters.push_back(it);
+            result = new_item;
         }
 
-        // Push in reverse so first child is processed first (LIFO stack)
-        for (auto rit = child_iters.rbegin(); rit != child_iters.rend(); ++rit)
+        // Push children onto stack in reverse so first child is processed first (LIFO stack)
+        auto& children = new_item->children();
+        for (auto it = children.rbegin(); it != children.rend(); ++it)
         {
-            stack.push_back({&(**rit), **rit});
+            stack.push_back(*it);
         }
     }
 
@@ -1511,17 +1812,17 @@ litehtml::containing_block_context litehtml::render_item::calculate_containing_b
 	return ret;
 }
 
-std::tuple<litehtml::pixel_t, litehtml::pixel_t> litehtml::render_item::element_static_offset(const std::shared_ptr<litehtml::render_item>& el)
+std::tuple<litehtml::pixel_t, litehtml::pixel_t> litehtml::render_item::element_static_offset(const render_item* el)
 {
 	pixel_t offset_x = 0;
 	pixel_t offset_y = 0;
-	auto cur_el = el->parent();
-	auto this_el = el->css().get_position() != element_position_fixed ? shared_from_this() : src_el()->get_document()->root_render();
+	render_item* cur_el = el->m_parent;
+	render_item* this_el = el->css().get_position() != element_position_fixed ? this : src_el()->get_document()->root_render().get();
 	while(cur_el && cur_el != this_el)
 	{
 		offset_x += cur_el->m_pos.x;
 		offset_y += cur_el->m_pos.y;
-		cur_el = cur_el->parent();
+		cur_el = cur_el->m_parent;
 	}
 
 	if(el->css().get_position() == element_position_fixed || (is_root() && !src_el()->is_positioned()))
@@ -5,8 +5,8 @@
 #include "layout_profiler.h"
 
 
-litehtml::render_item_table::render_item_table(std::shared_ptr<element> _src_el) :
-        render_item(std::move(_src_el)),
+litehtml::render_item_table::render_item_table(element* _src_el) :
+        render_item(_src_el),
         m_border_spacing_x(0),
         m_border_spacing_y(0)
 {
@@ -437,30 +437,29 @@ std::shared_ptr<litehtml::render_item> litehtml::render_item_table::init()
 
     elements_iterator row_iter(false, &table_selector, &row_selector);
 
-    row_iter.process(shared_from_this(), [&](std::shared_ptr<render_item>& el, iterator_item_type /*item_type*/)
+    row_iter.process(shared_from_this(), [&](const std::shared_ptr<render_item>& el, iterator_item_type /*item_type*/)
         {
             m_grid->begin_row(el);
 
 
             elements_iterator cell_iter(true, &table_selector, &cell_selector);
-            cell_iter.process(el, [&](std::shared_ptr<render_item>& el, iterator_item_type item_type)
+            cell_iter.process(el, [&](const std::shared_ptr<render_item>& el, iterator_item_type item_type)
                 {
 					if(item_type != iterator_item_type_end_parent)
 					{
 						// Use init_tree instead of init to ensure cell children are also initialized
-						el = init_tree(el);
-						m_grid->add_cell(el);
+						m_grid->add_cell(init_tree(el));
 					}
                 });
         });
 
-    for (auto& el : m_children)
+    for (auto iter = m_children.begin(); iter != m_children.end();)
     {
+        auto el = *iter++;
         if (el->src_el()->css().get_display() == display_table_caption)
         {
             // Use init_tree instead of init to ensure caption children are also initialized
-            el = init_tree(el);
-            m_grid->captions().push_back(el);
+            m_grid->captions().push_back(init_tree(el));
         }
     }
 
@@ -523,6 +522,29 @@ void litehtml::render_item_table::draw_children(uint_ptr hdc, pixel_t x, pixel_t
     }
 }
 
+void litehtml::render_item_table::get_hit_children(std::vector<render_item*>& children, std::vector<render_item*>& bounds_only, bool& clipped)
+{
+    // get_child_by_point checks the cells from the last one, then the captions
+    clipped = false;
+    if (!m_grid) return;
+
+    for (int row = 0; row < m_grid->rows_count(); row++)
+    {
+        for (int col = 0; col < m_grid->cols_count(); col++)
+        {
+            table_cell* cell = m_grid->cell(col, row);
+            if (cell && cell->el)
+            {
+                children.push_back(cell->el.get());
+            }
+        }
+    }
+    for (const auto& caption : m_grid->captions())
+    {
+        bounds_only.push_back(caption.get());
+    }
+}
+
 std::shared_ptr<litehtml::element> litehtml::render_item_table::get_child_by_point(pixel_t x, pixel_t y, pixel_t client_x, pixel_t client_y, draw_flag /*flag*/, int /*zindex*/, int depth)
 {
     // Prevent stack overflow
@@ -537,22 +559,44 @@ std::shared_ptr<litehtml::element> litehtml::render_item_table::get_child_by_poi
     el_pos.x = x - el_pos.x;
     el_pos.y = y - el_pos.y;
 
-    // Search through table cells (stored in m_grid, not m_children)
-    for (int row = m_grid->rows_count() - 1; row >= 0 && !ret; row--)
+    auto hit_cell = [&](render_item* cell) -> element::ptr
     {
-        for (int col = m_grid->cols_count() - 1; col >= 0 && !ret; col--)
+        element::ptr ret;
+        if (cell->is_visible() && cell->is_point_inside(el_pos.x, el_pos.y))
         {
-            table_cell* cell = m_grid->cell(col, row);
-            if (cell && cell->el && cell->el->is_visible())
+            // Recurse into cell to find inline children (like links)
+            ret = cell->get_element_by_point(el_pos.x, el_pos.y, client_x, client_y, depth + 1);
+            if (!ret)
+            {
+                ret = cell->src_el()->shared_from_this();
+            }
+        }
+        return ret;
+    };
+
+    // The hit testing index has the cells in the order of get_hit_children
+    uint32_t hit_generation = src_el()->get_document()->hit_generation();
+    if (m_hit_bands && m_hit_generation == hit_generation)
+    {
+        const auto& band = m_hit_bands->find(el_pos.y);
+        for (auto it = band.rbegin(); it != band.rend() && !ret; ++it)
+        {
+            if ((*it)->may_hit(el_pos.x, el_pos.y, hit_generation))
             {
-                if (cell->el->is_point_inside(el_pos.x, el_pos.y))
+                ret = hit_cell(*it);
+            }
+        }
+    } else
+    {
+        // Search through table cells (stored in m_grid, not m_children)
+        for (int row = m_grid->rows_count() - 1; row >= 0 && !ret; row--)
+        {
+            for (int col = m_grid->cols_count() - 1; col >= 0 && !ret; col--)
+            {
+                table_cell* cell = m_grid->cell(col, row);
+                if (cell && cell->el && cell->el->may_hit(el_pos.x, el_pos.y, hit_generation))
                 {
-                    // Recurse into cell to find inline children (like links)
-                    ret = cell->el->get_element_by_point(el_pos.x, el_pos.y, client_x, client_y, depth + 1);
-                    if (!ret)
-                    {
-                        ret = cell->el->src_el();
-                    }
+                    ret = hit_cell(cell->el.get());
                 }
             }
         }
@@ -569,7 +613,7 @@ std::shared_ptr<litehtml::element> litehtml::render_item_table::get_child_by_poi
                 ret = caption->get_element_by_point(el_pos.x, el_pos.y, client_x, client_y, depth + 1);
                 if (!ret)
                 {
-                    ret = caption->src_el();
+                    ret = caption->src_el()->shared_from_this();
                 }
             }
         }
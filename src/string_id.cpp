@@ -45,6 +45,15 @@ string_id _id(const string& str)
 	return map[str] = (string_id)(array.size() - 1);
 }
 
+bool _find_id(const string& str, string_id& id)
+{
+	lock_guard;
+	auto it = map.find(str);
+	if (it == map.end()) return false;
+	id = it->second;
+	return true;
+}
+
 const string& _s(string_id id)
 {
 	lock_guard;
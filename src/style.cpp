@@ -566,6 +566,12 @@ void style::add_property(string_id name, const css_token_vector& value, const st
 		add_parsed_property(name, property_value(get_repr(value, 0, -1, true), important));
 		break;
 
+	case _will_change_: // https://developer.mozilla.org/en-US/docs/Web/CSS/will-change
+		// Store as raw string - "auto" or list of property names
+		str = get_repr(value, 0, -1, true);
+		add_parsed_property(name, property_value(str, important));
+		break;
+
 	//  =============================  CSS TRANSITIONS  =============================
 
 	case _transition_property_:
@@ -1947,45 +1953,45 @@ void style::parse_align_self(string_id name, const css_token_vector& tokens, boo
 void style::add_parsed_property( string_id name, const property_value& propval )
 {
 	auto prop = m_properties.find(name);
-	if (prop != m_properties.end())
+	if (prop)
 	{
-		if (!prop->second.m_important || (propval.m_important && prop->second.m_important))
+		if (!prop->m_important || (propval.m_important && prop->m_important))
 		{
-			prop->second = propval;
+			*prop = propval;
 		}
 	}
 	else
 	{
-		m_properties[name] = propval;
+		m_properties.set(name, propval);
 	}
 }
 
 void style::remove_property( string_id name, bool important )
 {
 	auto prop = m_properties.find(name);
-	if(prop != m_properties.end())
+	if(prop)
 	{
-		if( !prop->second.m_important || (important && prop->second.m_important) )
+		if( !prop->m_important || (important && prop->m_important) )
 		{
-			m_properties.erase(prop);
+			m_properties.erase(name);
 		}
 	}
 }
 
 void style::combine(const style& src)
 {
-	for (const auto& property : src.m_properties)
-	{
-		add_parsed_property(property.first, property.second);
-	}
+	// same rule as add_parsed_property: !important values are only replaced by !important ones
+	m_properties.merge(src.m_properties, [](const property_value& cur, const property_value& val)
+		{
+			return !cur.m_important || val.m_important;
+		});
 }
 
 const property_value& style::get_property(string_id name) const
 {
-	auto it = m_properties.find(name);
-	if (it != m_properties.end())
+	if (auto prop = m_properties.find(name))
 	{
-		return it->second;
+		return *prop;
 	}
 	static property_value dummy;
 	return dummy;
@@ -2055,17 +2061,27 @@ void subst_vars_(string_id name, css_token_vector& tokens, const html_tag* el)
 
 void style::subst_vars(const html_tag* el)
 {
-	for (auto& prop : m_properties)
+	// Names are collected first: re-adding a shorthand inserts its longhands into m_properties
+	std::vector<string_id> names;
+	for (const auto& prop : m_properties)
 	{
 		if (prop.second.m_has_var)
-		{
-			auto& value = prop.second.get<css_token_vector>();
-			subst_vars_(prop.first, value, el);
-			// re-adding the same property
-			// if it is a custom property it will be re-added as a css_token_vector
-			// if it is a standard css property it will be parsed and properly added as typed property
-			add_property(prop.first, value, "", prop.second.m_important, el->get_document()->container());
-		}
+			names.push_back(prop.first);
+	}
+
+	for (auto name : names)
+	{
+		// A shorthand substituted before may have replaced the property with a typed value
+		property_value* prop = m_properties.find(name);
+		if (!prop || !prop->m_has_var || !prop->is<css_token_vector>())
+			continue;
+		auto& value = prop->get<css_token_vector>();
+		subst_vars_(name, value, el);
+		// re-adding the same property
+		// if it is a custom property it will be re-added as a css_token_vector
+		// if it is a standard css property it will be parsed and properly added as typed property
+		css_token_vector tokens = value;
+		add_property(name, tokens, "", prop->m_important, el->get_document()->container());
 	}
 }
 
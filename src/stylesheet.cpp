@@ -77,6 +77,21 @@ void css::parse_css_stylesheet(const Input& input, string baseurl, document::ptr
 	}
 }
 
+compiled_css::ptr compiled_css::create(const string& text, document_container* container, const string& baseurl, document_mode mode)
+{
+	auto ret = make_shared<compiled_css>();
+	if (text.empty()) return ret;
+
+	// The parser registers media lists and keyframes in a document, a scratch one collects them
+	auto doc = make_shared<document>(container);
+	doc->m_mode = mode;
+	ret->m_css.parse_css_stylesheet(text, baseurl, doc);
+	ret->m_css.sort_selectors();
+	ret->m_media_lists = std::move(doc->m_media_lists);
+	ret->m_keyframes = std::move(doc->m_keyframes);
+	return ret;
+}
+
 // https://drafts.csswg.org/css-cascade-5/#at-import
 // `layer` and `supports` are not supported
 // @import [ <url> | <string> ] <media-query-list>?
@@ -184,7 +199,11 @@ void css::index_selector(const css_selector::ptr& selector)
 
 void css::build_index()
 {
-	if (m_index_built) return;
+	// Built from scratch, selectors may have been added since the last call
+	m_tag_index.clear();
+	m_class_index.clear();
+	m_id_index.clear();
+	m_universal_selectors.clear();
 
 	// Reserve approximate sizes to avoid reallocations
 	m_tag_index.reserve(m_selectors.size() / 4);
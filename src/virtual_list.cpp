@@ -0,0 +1,214 @@
+#include "html.h"
+#include "virtual_list.h"
+#include "document.h"
+#include "element.h"
+#include <cmath>
+#include <limits>
+
+namespace litehtml
+{
+
+virtual_list::virtual_list(document* doc, const std::shared_ptr<element>& list, const std::shared_ptr<virtual_list_source>& source) :
+	m_doc(doc), m_list(list), m_source(source)
+{
+}
+
+bool virtual_list::init()
+{
+	m_template = m_source->row_template();
+	auto row = create_element(m_template);
+	if (!row) return false;
+
+	// Spacers are rows of the same tag, table rows stay in the table grid and get a cell
+	string spacer = string("<") + row->get_tagName() + ">";
+	auto list = m_list.lock();
+	style_display display = list->css().get_display();
+	if (display == display_table || display == display_table_row_group || display == display_table_header_group || display == display_table_footer_group)
+	{
+		spacer += "<td style=\"padding:0;border:0\"></td>";
+	}
+	spacer += string("</") + row->get_tagName() + ">";
+	m_top_spacer = create_element(spacer);
+	m_bottom_spacer = create_element(spacer);
+	if (!m_top_spacer || !m_bottom_spacer) return false;
+
+	m_free.push_back(row);
+	m_count = m_source->row_count();
+	set_window(0, std::min(m_count, InitialRows));
+	return true;
+}
+
+bool virtual_list::update(const position& viewport)
+{
+	if (m_list.expired()) return false;
+
+	size_t count = m_source->row_count();
+	bool count_changed = count != m_count;
+	m_count = count;
+
+	if (m_row_height <= 0)
+	{
+		// Nothing measured yet, the first rows are laid out
+		if (!count_changed) return false;
+		set_window(0, std::min(m_count, InitialRows));
+		return true;
+	}
+
+	// Row positions are estimated from the top of the list with the average row height
+	pixel_t origin = row_box(m_top_spacer).y;
+	auto row_at = [this, origin](pixel_t y) -> size_t
+	{
+		if (y <= origin) return 0;
+		return (size_t) std::min((double) m_count, std::floor((double) (y - origin) / m_row_height));
+	};
+	size_t visible_first = row_at(viewport.y);
+	size_t visible_last = std::min(m_count, row_at(viewport.bottom()) + 1);
+
+	// The window is moved when the visible rows are not in it, with a viewport height of rows around them
+	if (!count_changed && visible_first >= m_first && visible_last <= m_first + m_rows.size())
+	{
+		if (m_spacers_height == m_row_height) return false;
+		set_spacers();
+		return true;
+	}
+	set_window(row_at(viewport.y - viewport.height), std::min(m_count, row_at(viewport.bottom() + viewport.height) + 1));
+	return true;
+}
+
+void virtual_list::measure()
+{
+	if (!m_measure || m_rows.empty()) return;
+
+	// The rows are between the spacers
+	position top = row_box(m_top_spacer);
+	pixel_t height = row_box(m_bottom_spacer).y - top.bottom();
+	if (height <= 0) return;
+	m_measure = false;
+
+	// Far from the top of the document the positions are rounded, such windows are only used for the
+	// first measurement so the rounding doesn't move the end of a long list
+	if (m_measured_rows)
+	{
+		double ulp = std::nextafter(top.bottom(), std::numeric_limits<pixel_t>::infinity()) - top.bottom();
+		if (2 * ulp * m_count / m_rows.size() > 1) return;
+	}
+
+	m_measured_height += height;
+	m_measured_rows += m_rows.size();
+	m_row_height = (pixel_t) (m_measured_height / m_measured_rows);
+}
+
+void virtual_list::set_window(size_t first, size_t last)
+{
+	auto list = m_list.lock();
+	if (!list) return;
+	if (last < first) last = first;
+
+	// Rows staying in the window keep their elements
+	std::vector<std::shared_ptr<element>> rows(last - first);
+	for (size_t i = 0; i < m_rows.size(); i++)
+	{
+		size_t index = m_first + i;
+		if (index >= first && index < last)
+		{
+			rows[index - first] = std::move(m_rows[i]);
+		} else
+		{
+			m_free.push_back(std::move(m_rows[i]));
+		}
+	}
+
+	elements_list children(list->children().begin(), list->children().end());
+	for (const auto& child : children)
+	{
+		list->removeChild(child);
+	}
+
+	list->appendChild(m_top_spacer);
+	for (size_t i = 0; i < rows.size(); i++)
+	{
+		if (rows[i])
+		{
+			list->appendChild(rows[i]);
+			continue;
+		}
+		if (!m_free.empty())
+		{
+			rows[i] = std::move(m_free.back());
+			m_free.pop_back();
+		} else
+		{
+			rows[i] = create_element(m_template);
+		}
+		list->appendChild(rows[i]);
+		m_source->fill_row(first + i, rows[i]);
+		m_doc->restyle_subtree(rows[i]);
+	}
+	list->appendChild(m_bottom_spacer);
+
+	// Enough free rows are kept to move the window by its size
+	if (m_free.size() > rows.size())
+	{
+		m_free.resize(rows.size());
+	}
+	m_rows = std::move(rows);
+	m_first = first;
+	m_measure = true;
+	set_spacers();
+}
+
+void virtual_list::set_spacers()
+{
+	size_t after = m_count - m_first - m_rows.size();
+	auto set_height = [this](const std::shared_ptr<element>& spacer, pixel_t height)
+	{
+		spacer->set_attr("style", ("height:" + std::to_string(height) + "px;margin:0;padding:0;border:0").c_str());
+		m_doc->restyle_subtree(spacer);
+	};
+	set_height(m_top_spacer, m_first * m_row_height);
+	set_height(m_bottom_spacer, after * m_row_height);
+	m_spacers_height = m_row_height;
+}
+
+position virtual_list::row_box(const std::shared_ptr<element>& row)
+{
+	// Table rows are not placed, only their cells
+	position box = row->get_border_box();
+	if (box.height == 0 && !row->children().empty())
+	{
+		bool is_first = true;
+		for (const auto& child : row->children())
+		{
+			if (child->is_text()) continue;
+			position cell = child->get_border_box();
+			if (is_first)
+			{
+				box = cell;
+				is_first = false;
+			} else
+			{
+				pixel_t bottom = std::max(box.bottom(), cell.bottom());
+				box.y = std::min(box.y, cell.y);
+				box.height = bottom - box.y;
+			}
+		}
+	}
+	return box;
+}
+
+std::shared_ptr<element> virtual_list::create_element(const string& html) const
+{
+	auto list = m_list.lock();
+	if (!list) return nullptr;
+
+	for (const auto& el : m_doc->parse_fragment(html, *list))
+	{
+		if (!el->is_text() && !el->is_comment())
+		{
+			return el;
+		}
+	}
+	return nullptr;
+}
+
+} // namespace litehtml
@@ -11,14 +11,10 @@ void litebrowser::text_file::on_page_downloaded(u_int32_t http_status,
 												u_int32_t err_code,
 												const std::string &/*err_text*/)
 {
-	if(err_code == 0 && (http_status == 200 || http_status == 0))
-	{
-		data_ready = true;
-	} else
-	{
-		data_ready = false;
-	}
-	wait_mutex.unlock();
+	std::unique_lock<std::mutex> lock(wait_mutex);
+	data_ready = err_code == 0 && (http_status == 200 || http_status == 0);
+	finished = true;
+	wait_cond.notify_all();
 }
 
 void litebrowser::web_page::open(const std::string &url, const std::string &fragment)
@@ -81,13 +77,8 @@ void litebrowser::web_page::import_css(litehtml::string& text, const litehtml::s
 	std::string css_url;
 	make_url(url.c_str(), baseurl.c_str(), css_url);
 
-	auto data = std::make_shared<text_file>();
-	auto cb_on_data = [data](void* in_data, size_t len, size_t /*downloaded*/, size_t /*total*/) { data->on_data(in_data, len, 0, 0); };
-	auto cb_on_finish = [data](u_int32_t http_status, u_int32_t err_code, const std::string &err_text, const std::string& /*url*/)
-	{
-		data->on_page_downloaded(http_status, err_code, err_text);
-	};
-	http_request(css_url, cb_on_data, cb_on_finish);
+	// The style sheet is usually preloaded, wait for the download started before
+	auto data = request_css(css_url, nullptr);
 	data->wait();
 	text = data->str();
 	if(!text.empty())
@@ -96,6 +87,50 @@ void litebrowser::web_page::import_css(litehtml::string& text, const litehtml::s
 	}
 }
 
+void litebrowser::web_page::preload(const std::shared_ptr<litehtml::document>& doc, const litehtml::string& url,
+									const litehtml::string& baseurl, litehtml::resource_type type)
+{
+	if(type == litehtml::resource_image)
+	{
+		// The image size can be unknown, render the page when it is ready
+		load_image(url.c_str(), baseurl.c_str(), false);
+	} else
+	{
+		std::string css_url;
+		make_url(url.c_str(), baseurl.c_str(), css_url);
+		request_css(css_url, doc);
+	}
+}
+
+std::shared_ptr<litebrowser::text_file> litebrowser::web_page::request_css(const std::string& css_url, const std::shared_ptr<litehtml::document>& doc)
+{
+	std::lock_guard<std::mutex> css_lock(m_css_mutex);
+	auto it = m_css_files.find(css_url);
+	if(it != m_css_files.end())
+	{
+		return it->second;
+	}
+
+	auto data = std::make_shared<text_file>();
+	m_css_files[css_url] = data;
+	auto cb_on_data = [data](void* in_data, size_t len, size_t /*downloaded*/, size_t /*total*/) { data->on_data(in_data, len, 0, 0); };
+	auto cb_on_finish = [data, doc, css_url](u_int32_t http_status, u_int32_t err_code, const std::string &err_text, const std::string& /*url*/)
+	{
+		data->on_page_downloaded(http_status, err_code, err_text);
+		// Preload the @import rules of the style sheet before the document parses it
+		if(doc)
+		{
+			std::string text = data->str();
+			if(!text.empty())
+			{
+				doc->stylesheet_preloaded(css_url, text);
+			}
+		}
+	};
+	http_request(css_url, cb_on_data, cb_on_finish);
+	return data;
+}
+
 void litebrowser::web_page::set_caption(const char* caption)
 {
 	m_notify->on_set_caption(caption);
@@ -117,6 +152,17 @@ cairo_surface_t* litebrowser::web_page::get_image(const std::string& url)
 	return m_images.get_image(url);
 }
 
+bool litebrowser::web_page::get_image_size_hint(const std::string& url, litehtml::size& sz)
+{
+	// The size is 0 until the header is read, images are never decoded for the layout
+	int width = 0;
+	int height = 0;
+	m_images.get_size(url, width, height);
+	sz.width = width;
+	sz.height = height;
+	return true;
+}
+
 void litebrowser::web_page::show_fragment(const litehtml::string& fragment)
 {
 	std::lock_guard<std::recursive_mutex> html_lock(m_html_mutex);
@@ -239,20 +285,29 @@ void litebrowser::web_page::on_image_downloaded(std::shared_ptr<image_file> data
 	data->close();
 	if(!data->path().empty() && !err_code && (http_status == 200 || http_status == 0))
 	{
-		auto ptr = m_html_host->load_image(data->path());
-		if(ptr)
+		// The decoder reads the size now and decodes the pixels when the image is painted.
+		// It keeps the file to decode the image again after eviction.
+		m_images.add_file(data->url(), data->path(), true, !data->redraw_only());
+	} else
+	{
+		unlink(data->path().c_str());
+	}
+}
+
+void litebrowser::web_page::on_image_ready(bool relayout)
+{
+	if(relayout)
+	{
+		m_notify->render();
+	} else
+	{
+		// The page isn't rendered again, so repaint the layers showing the old pixels
 		{
-			m_images.add_image(data->url(), ptr);
-			if(data->redraw_only())
-			{
-				m_notify->redraw();
-			} else
-			{
-				m_notify->render();
-			}
+			std::lock_guard<std::recursive_mutex> html_lock(m_html_mutex);
+			if(m_html) m_html->invalidate_layers();
 		}
+		m_notify->redraw();
 	}
-	unlink(data->path().c_str());
 }
 
 void litebrowser::web_page::load_image(const char *src, const char *baseurl, bool redraw_on_ready)
@@ -3,10 +3,11 @@
 
 #include <unistd.h>
 #include <sstream>
+#include <map>
 #include "container_cairo_pango.h"
 #include "html_host.h"
 #include "http_requests_pool.h"
-#include "cairo_images_cache.h"
+#include "cairo_image_decoder.h"
 #include "litehtml/types.h"
 
 namespace litebrowser
@@ -14,22 +15,22 @@ namespace litebrowser
 	class text_file
 	{
 		std::mutex wait_mutex;
+		std::condition_variable wait_cond;
 		std::stringstream stream;
 		bool data_ready = false;
+		bool finished = false;
 	public:
-		text_file()
-		{
-			wait_mutex.lock();
-		}
-
 		void set_ready() { data_ready = true; }
 
 		std::string str() const { return data_ready ? stream.str() : ""; }
+		// Can be called many times, a preloaded style sheet is waited for by every import_css
 		void wait()
 		{
-			wait_mutex.lock();
+			std::unique_lock<std::mutex> lock(wait_mutex);
+			wait_cond.wait(lock, [this] { return finished; });
 		}
 		void on_data(void* data, size_t len, size_t downloaded, size_t total);
+		std::shared_ptr<text_file> request_css(const std::string& css_url, const std::shared_ptr<litehtml::document>& doc);
 		void on_page_downloaded(u_int32_t http_status, u_int32_t err_code, const std::string& err_text);
 	};
 
@@ -70,8 +71,10 @@ namespace litebrowser
 		litehtml::string				m_clicked_url;
 		std::string                 	m_fragment;
 		html_host_interface*			m_html_host;
-		cairo_images_cache				m_images;
+		cairo_image_decoder				m_images;
 		litebrowser::http_requests_pool	m_requests_pool;
+		std::map<std::string, std::shared_ptr<text_file>>	m_css_files;	// style sheets by url, fetched by preload or import_css
+		std::mutex						m_css_mutex;
 		std::string 					m_html_source;
 
 		std::shared_ptr<browser_notify_interface> m_notify;
@@ -79,9 +82,17 @@ namespace litebrowser
 	public:
 		explicit web_page(html_host_interface* html_host, std::shared_ptr<browser_notify_interface> notify, int pool_size) :
 				m_html_host(html_host),
+				m_images((int) std::max(2u, std::thread::hardware_concurrency() / 2),
+						 [this](const std::string& path) { return m_html_host->load_image(path); },
+						 [this](const std::string& /*url*/, bool relayout) { on_image_ready(relayout); }),
 				m_requests_pool(pool_size, [this] { on_pool_update_state(); }),
 				m_notify(std::move(notify))
 		{}
+		~web_page() override
+		{
+			// The decoder callbacks use m_notify
+			m_images.stop();
+		}
 
 		[[nodiscard]]
 		uint64_t id() const { return (uint64_t)this; }
@@ -95,9 +106,12 @@ namespace litebrowser
 		void on_anchor_click(const char* url, const litehtml::element::ptr& el) override;
 		void set_cursor(const char* cursor) override;
 		void import_css(litehtml::string& text, const litehtml::string& url, litehtml::string& baseurl) override;
+		void preload(const std::shared_ptr<litehtml::document>& doc, const litehtml::string& url,
+					 const litehtml::string& baseurl, litehtml::resource_type type) override;
 		void set_caption(const char* caption) override;
 		void set_base_url(const char* base_url) override;
 		cairo_surface_t* get_image(const std::string& url) override;
+		bool get_image_size_hint(const std::string& url, litehtml::size& sz) override;
 		void make_url( const char* url, const char* basepath, litehtml::string& out ) override;
 		void load_image(const char* src, const char* baseurl, bool redraw_on_ready) override;
 		void on_mouse_event(const litehtml::element::ptr& el, litehtml::mouse_event event) override;
@@ -125,6 +139,7 @@ namespace litebrowser
 		void draw(litehtml::uint_ptr hdc, int x, int y, const litehtml::position* clip)
 		{
 			std::lock_guard<std::recursive_mutex> html_lock(m_html_mutex);
+			m_images.begin_frame();
 			if(m_html) m_html->draw(hdc, x, y, clip);
 		}
 
@@ -180,8 +195,10 @@ namespace litebrowser
 		void http_request(const std::string& url,
 						  const std::function<void(void* data, size_t len, size_t downloaded, size_t total)>& cb_on_data,
 						  const std::function<void(u_int32_t http_status, u_int32_t err_code, const std::string& err_text, const std::string& url)>& cb_on_finish);
+		std::shared_ptr<text_file> request_css(const std::string& css_url, const std::shared_ptr<litehtml::document>& doc);
 		void on_page_downloaded(std::shared_ptr<text_file> data, u_int32_t http_status, u_int32_t err_code, const std::string& err_text, const std::string& url);
 		void on_image_downloaded(std::shared_ptr<image_file> data, u_int32_t http_status, u_int32_t err_code, const std::string& err_text, const std::string& url);
+		void on_image_ready(bool relayout);
 		void on_pool_update_state();
 	};
 }
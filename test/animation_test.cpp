@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include "test_utils.h"
+
+using namespace litehtml;
+
+namespace
+{
+	transition_state color_transition(web_color from, web_color to)
+	{
+		transition_state state;
+		state.duration = 100;
+		state.is_color = true;
+		state.from_color = from;
+		state.to_color = to;
+		return state;
+	}
+
+	animation_state keyframes_animation(const string& name, animation_fill_mode fill_mode)
+	{
+		animation_state anim;
+		anim.name = name;
+		anim.duration = 1000;
+		anim.easing = easing_function::parse("linear");
+		anim.fill_mode = fill_mode;
+		return anim;
+	}
+}
+
+TEST(AnimationTest, ColorTransitionSkipsDescendantsWithOwnColor)
+{
+	test_doc_container container;
+	auto doc = document::createFromString(
+		"<div id='a' style='color: black'>"
+		"<span id='inherited'>text</span><b id='own' style='color: black'>text</b>"
+		"<i id='keyword' style='color: inherit'>text <u id='nested'>text</u></i></div>", &container);
+	doc->render(800);
+	auto el = doc->root()->select_one("#a");
+	doc->get_animation_controller().start_transition(el.get(), _color_, color_transition(web_color::black, web_color(200, 0, 0)));
+
+	position::vector redraw_boxes;
+	bool relayout = true;
+	EXPECT_TRUE(doc->advance_animations(50, redraw_boxes, relayout));
+	EXPECT_FALSE(relayout);
+	EXPECT_FALSE(redraw_boxes.empty());
+
+	web_color half(100, 0, 0);
+	EXPECT_EQ(el->css().get_color(), half);
+	for (const char* id : { "#inherited", "#keyword", "#nested" })
+	{
+		EXPECT_EQ(doc->root()->select_one(id)->css().get_color(), half) << id;
+	}
+	EXPECT_EQ(doc->root()->select_one("#own")->css().get_color(), web_color::black);
+
+	EXPECT_FALSE(doc->advance_animations(100, redraw_boxes, relayout));
+	EXPECT_EQ(doc->root()->select_one("#nested")->css().get_color(), web_color(200, 0, 0));
+	EXPECT_EQ(doc->root()->select_one("#own")->css().get_color(), web_color::black);
+}
+
+TEST(AnimationTest, KeyframesApplyPaintedProperties)
+{
+	test_doc_container container;
+	auto doc = document::createFromString(
+		"<style>@keyframes fade {"
+		" from { opacity: 0 }"
+		" 50% { background-color: #c80000; width: 10px }"
+		" to { opacity: 1; transform: translateX(100px) } }</style>"
+		"<div id='a' style='background-color: #0000c8'>text</div>", &container);
+	doc->render(800);
+	auto el = doc->root()->select_one("#a");
+	doc->get_animation_controller().start_animation(el.get(), keyframes_animation("fade", animation_fill_none));
+
+	position::vector redraw_boxes;
+	bool relayout = false;
+	EXPECT_TRUE(doc->advance_animations(250, redraw_boxes, relayout));
+	EXPECT_TRUE(relayout);	// opacity below 1 creates a stacking context
+	EXPECT_FLOAT_EQ(el->css().get_opacity(), 0.25f);
+	// The implicit 0% and 100% background colors are the computed one
+	EXPECT_EQ(el->css().get_bg().m_color, web_color(100, 0, 100));
+	EXPECT_FLOAT_EQ(el->css().get_transform_matrix().e, 25);
+
+	redraw_boxes.clear();
+	EXPECT_TRUE(doc->advance_animations(750, redraw_boxes, relayout));
+	EXPECT_FALSE(relayout);
+	EXPECT_FALSE(redraw_boxes.empty());
+	EXPECT_FLOAT_EQ(el->css().get_opacity(), 0.75f);
+	EXPECT_EQ(el->css().get_bg().m_color, web_color(100, 0, 100));
+	EXPECT_FLOAT_EQ(el->css().get_transform_matrix().e, 75);
+	// Only painted properties are animated
+	EXPECT_TRUE(el->css().get_width().is_predefined());
+
+	// Without fill the computed values are restored
+	EXPECT_FALSE(doc->advance_animations(1000, redraw_boxes, relayout));
+	EXPECT_FLOAT_EQ(el->css().get_opacity(), 1);
+	EXPECT_EQ(el->css().get_bg().m_color, web_color(0, 0, 200));
+	EXPECT_TRUE(el->css().get_transform_matrix().isIdentity());
+}
+
+TEST(AnimationTest, KeyframesFillForwards)
+{
+	test_doc_container container;
+	auto doc = document::createFromString(
+		"<style>@keyframes tint { to { color: rgb(0, 0, 200) } }</style>"
+		"<div id='a'>text <span id='child'>text</span></div>", &container);
+	doc->render(800);
+	auto el = doc->root()->select_one("#a");
+	doc->get_animation_controller().start_animation(el.get(), keyframes_animation("tint", animation_fill_forwards));
+
+	position::vector redraw_boxes;
+	bool relayout = false;
+	EXPECT_TRUE(doc->advance_animations(500, redraw_boxes, relayout));
+	EXPECT_EQ(doc->root()->select_one("#child")->css().get_color(), web_color(0, 0, 100));
+	EXPECT_FALSE(doc->advance_animations(2000, redraw_boxes, relayout));
+	EXPECT_EQ(el->css().get_color(), web_color(0, 0, 200));
+	EXPECT_EQ(doc->root()->select_one("#child")->css().get_color(), web_color(0, 0, 200));
+}
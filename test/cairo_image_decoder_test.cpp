@@ -0,0 +1,208 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include "cairo_image_decoder.h"
+
+namespace
+{
+	std::vector<unsigned char> png_header(int width, int height)
+	{
+		std::vector<unsigned char> data = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n', 0, 0, 0, 13, 'I', 'H', 'D', 'R' };
+		for (int value : { width, height })
+		{
+			for (int shift = 24; shift >= 0; shift -= 8)
+				data.push_back((unsigned char) (value >> shift));
+		}
+		return data;
+	}
+
+	// PNG headers written to files, decoded into surfaces of the header size
+	class decoder_test : public ::testing::Test
+	{
+	protected:
+		std::vector<std::string> files;
+
+		void TearDown() override
+		{
+			for (const auto& path : files)
+				std::remove(path.c_str());
+			EXPECT_EQ(cairo_stub_live_surfaces(), 0);
+		}
+
+		std::string write_png(const std::string& name, int width, int height)
+		{
+			std::string path = ::testing::TempDir() + "litehtml_decoder_" + name + ".png";
+			auto data = png_header(width, height);
+			std::ofstream(path, std::ios::binary).write((const char*) data.data(), (std::streamsize) data.size());
+			files.push_back(path);
+			return path;
+		}
+
+		static cairo_surface_t* decode(const std::string& path)
+		{
+			std::ifstream file(path, std::ios::binary);
+			std::vector<unsigned char> data(64);
+			file.read((char*) data.data(), (std::streamsize) data.size());
+			int width, height;
+			if (!cairo_image_decoder::read_size(data.data(), (size_t) file.gcount(), width, height))
+				return nullptr;
+			return cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+		}
+
+		template<class Pred>
+		static bool wait_for(Pred pred)
+		{
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+			while (!pred())
+			{
+				if (std::chrono::steady_clock::now() > deadline) return false;
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			return true;
+		}
+
+		// Paints the images in a new frame, returns how many were decoded
+		static int paint_frame(cairo_image_decoder& decoder, const std::vector<std::string>& urls)
+		{
+			decoder.begin_frame();
+			int painted = 0;
+			for (const auto& url : urls)
+			{
+				if (cairo_surface_t* surface = decoder.get_image(url))
+				{
+					painted++;
+					cairo_surface_destroy(surface);
+				}
+			}
+			return painted;
+		}
+	};
+}
+
+TEST(CairoImageDecoderTest, ReadSize)
+{
+	int width = 0, height = 0;
+	auto png = png_header(640, 480);
+	ASSERT_TRUE(cairo_image_decoder::read_size(png.data(), png.size(), width, height));
+	EXPECT_EQ(width, 640);
+	EXPECT_EQ(height, 480);
+	EXPECT_FALSE(cairo_image_decoder::read_size(png.data(), png.size() - 1, width, height));
+
+	const unsigned char gif[] = { 'G', 'I', 'F', '8', '9', 'a', 0x2c, 0x01, 0x10, 0x00 };
+	ASSERT_TRUE(cairo_image_decoder::read_size(gif, sizeof(gif), width, height));
+	EXPECT_EQ(width, 300);
+	EXPECT_EQ(height, 16);
+
+	// Bottom-up BMP has a negative height
+	unsigned char bmp[26] = { 'B', 'M' };
+	bmp[18] = 0x20;
+	bmp[22] = 0xf0; bmp[23] = 0xff; bmp[24] = 0xff; bmp[25] = 0xff;
+	ASSERT_TRUE(cairo_image_decoder::read_size(bmp, sizeof(bmp), width, height));
+	EXPECT_EQ(width, 32);
+	EXPECT_EQ(height, 16);
+
+	unsigned char webp[30] = { 'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'E', 'B', 'P', 'V', 'P', '8', 'X' };
+	webp[24] = 99;		// width - 1, 24 bits
+	webp[27] = 0x2b; webp[28] = 0x01;
+	ASSERT_TRUE(cairo_image_decoder::read_size(webp, sizeof(webp), width, height));
+	EXPECT_EQ(width, 100);
+	EXPECT_EQ(height, 300);
+
+	unsigned char vp8l[30] = { 'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'E', 'B', 'P', 'V', 'P', '8', 'L' };
+	// 14 bits width - 1 = 199, 14 bits height - 1 = 49
+	vp8l[21] = 199;
+	vp8l[22] = (unsigned char) ((49 & 0x03) << 6);
+	vp8l[23] = (unsigned char) (49 >> 2);
+	ASSERT_TRUE(cairo_image_decoder::read_size(vp8l, sizeof(vp8l), width, height));
+	EXPECT_EQ(width, 200);
+	EXPECT_EQ(height, 50);
+
+	// JPEG: APP0 segment, then the baseline frame header
+	const unsigned char jpeg[] = { 0xff, 0xd8, 0xff, 0xe0, 0x00, 0x06, 'J', 'F', 'I', 'F',
+								   0xff, 0xc0, 0x00, 0x11, 0x08, 0x01, 0x2c, 0x02, 0x58, 0x03, 0, 0, 0, 0 };
+	ASSERT_TRUE(cairo_image_decoder::read_size(jpeg, sizeof(jpeg), width, height));
+	EXPECT_EQ(width, 600);
+	EXPECT_EQ(height, 300);
+	EXPECT_FALSE(cairo_image_decoder::read_size(jpeg, 12, width, height));
+
+	const unsigned char text[] = "<svg width='10'";
+	EXPECT_FALSE(cairo_image_decoder::read_size(text, sizeof(text), width, height));
+}
+
+// An image larger than the whole budget is decoded once and stays while it is painted
+TEST_F(decoder_test, OversizedImageIsKept)
+{
+	cairo_image_decoder decoder(2, decode, nullptr);
+	decoder.set_max_bytes(1000);
+	decoder.add_file("big", write_png("big", 100, 100), false, false);
+
+	EXPECT_EQ(paint_frame(decoder, {"big"}), 0);
+	ASSERT_TRUE(wait_for([&] { return decoder.get_stats().decodes == 1; }));
+	for (int frame = 0; frame < 5; frame++)
+	{
+		EXPECT_EQ(paint_frame(decoder, {"big"}), 1);
+	}
+	EXPECT_EQ(decoder.get_stats().decodes, 1u);
+	EXPECT_EQ(decoder.get_stats().bytes, 100u * 100 * 4);
+}
+
+// Visible images that don't fit the budget together don't evict each other
+TEST_F(decoder_test, VisibleSetLargerThanBudget)
+{
+	cairo_image_decoder decoder(2, decode, nullptr);
+	decoder.set_max_bytes(25000);	// two of the images
+	std::vector<std::string> urls = { "a", "b", "c", "d" };
+	for (const auto& url : urls)
+		decoder.add_file(url, write_png(url, 50, 50), false, false);
+
+	EXPECT_EQ(paint_frame(decoder, urls), 0);
+	ASSERT_TRUE(wait_for([&] { return decoder.get_stats().decodes == 4; }));
+	for (int frame = 0; frame < 5; frame++)
+	{
+		EXPECT_EQ(paint_frame(decoder, urls), 4);
+	}
+	EXPECT_EQ(decoder.get_stats().decodes, 4u);
+	EXPECT_EQ(decoder.get_stats().evictions, 0u);
+
+	// Images scrolled away are evicted down to the budget
+	EXPECT_EQ(paint_frame(decoder, {"a", "b"}), 2);
+	decoder.set_max_bytes(25000);
+	EXPECT_EQ(decoder.get_stats().entries, 2u);
+	EXPECT_EQ(decoder.get_stats().evictions, 2u);
+	EXPECT_EQ(paint_frame(decoder, {"a", "b"}), 2);
+}
+
+// Without frames the least recently used image is evicted, never the one just decoded
+TEST_F(decoder_test, EvictsLeastRecentlyUsed)
+{
+	cairo_image_decoder decoder(1, decode, nullptr);
+	decoder.set_max_bytes(20000);	// two of the images
+	for (const char* url : { "a", "b", "c" })
+		decoder.add_file(url, write_png(url, 50, 50), false, false);
+
+	auto decode_now = [&](const std::string& url, size_t decodes)
+	{
+		EXPECT_EQ(decoder.get_image(url), nullptr);
+		return wait_for([&] { return decoder.get_stats().decodes == decodes; });
+	};
+	ASSERT_TRUE(decode_now("a", 1));
+	ASSERT_TRUE(decode_now("b", 2));
+
+	// a is used again, so b is the least recently used one
+	cairo_surface_t* a = decoder.get_image("a");
+	ASSERT_NE(a, nullptr);
+	cairo_surface_destroy(a);
+
+	ASSERT_TRUE(decode_now("c", 3));
+	EXPECT_EQ(decoder.get_stats().evictions, 1u);
+	for (const char* url : { "a", "c" })
+	{
+		cairo_surface_t* surface = decoder.get_image(url);
+		EXPECT_NE(surface, nullptr) << url;
+		cairo_surface_destroy(surface);
+	}
+	EXPECT_EQ(decoder.get_image("b"), nullptr);
+	decoder.stop();
+}
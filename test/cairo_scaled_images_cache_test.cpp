@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+#include "cairo_scaled_images_cache.h"
+
+// Variants keep their originals alive, the originals count toward the budget once
+TEST(CairoScaledImagesCacheTest, CountsReferencedOriginals)
+{
+	{
+		cairo_scaled_images_cache cache;
+		cairo_surface_t* source = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 100, 100);
+
+		cairo_surface_destroy(cache.get_scaled("a", source, 50, 50));
+		cairo_surface_destroy(cache.get_scaled("a", source, 20, 20));
+		auto stats = cache.get_stats();
+		EXPECT_EQ(stats.entries, 2u);
+		EXPECT_EQ(stats.source_bytes, 100u * 100 * 4);
+		EXPECT_EQ(stats.bytes, 100u * 100 * 4 + 50 * 50 * 4 + 20 * 20 * 4);
+
+		// The host drops the original, the cache still holds it
+		cairo_surface_destroy(source);
+		EXPECT_EQ(cairo_stub_live_surfaces(), 3);
+
+		cache.remove("a");
+		stats = cache.get_stats();
+		EXPECT_EQ(stats.entries, 0u);
+		EXPECT_EQ(stats.bytes, 0u);
+		EXPECT_EQ(stats.source_bytes, 0u);
+		EXPECT_EQ(cairo_stub_live_surfaces(), 0);
+	}
+	EXPECT_EQ(cairo_stub_live_surfaces(), 0);
+}
+
+// Reloaded originals are released by evicting their variants
+TEST(CairoScaledImagesCacheTest, EvictionReleasesOriginals)
+{
+	cairo_scaled_images_cache cache;
+	// One original of 40000 bytes and its thumbnail fit, two don't
+	cache.set_max_bytes(50000);
+
+	cairo_surface_t* first = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 100, 100);
+	cairo_surface_destroy(cache.get_scaled("a", first, 10, 10));
+	cairo_surface_destroy(first);
+
+	cairo_surface_t* second = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 100, 100);
+	cairo_surface_destroy(cache.get_scaled("b", second, 10, 10));
+	auto stats = cache.get_stats();
+	EXPECT_EQ(stats.entries, 1u);
+	EXPECT_EQ(stats.evictions, 1u);
+	EXPECT_EQ(stats.bytes, 100u * 100 * 4 + 10 * 10 * 4);
+	// The first original is gone with its variant
+	EXPECT_EQ(cairo_stub_live_surfaces(), 2);
+
+	// An original larger than the budget is scaled but not cached
+	cairo_surface_t* large = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 200, 200);
+	cairo_surface_t* scaled = cache.get_scaled("c", large, 10, 10);
+	ASSERT_NE(scaled, nullptr);
+	EXPECT_EQ(cache.get_stats().entries, 1u);
+	cairo_surface_destroy(scaled);
+	cairo_surface_destroy(large);
+	cairo_surface_destroy(second);
+	cache.clear();
+	EXPECT_EQ(cairo_stub_live_surfaces(), 0);
+}
@@ -0,0 +1,95 @@
+#ifndef LITEHTML_TEST_CAIRO_STUB_H
+#define LITEHTML_TEST_CAIRO_STUB_H
+
+// The part of the cairo API used by the header only classes of the cairo container, so their
+// tests build without cairo. Surfaces are reference counted and own no pixels, drawing does nothing.
+
+#include <atomic>
+
+typedef enum _cairo_format
+{
+	CAIRO_FORMAT_ARGB32 = 0,
+} cairo_format_t;
+
+typedef enum _cairo_content
+{
+	CAIRO_CONTENT_COLOR_ALPHA = 0x3000,
+} cairo_content_t;
+
+typedef enum _cairo_filter
+{
+	CAIRO_FILTER_FAST,
+	CAIRO_FILTER_GOOD,
+	CAIRO_FILTER_BEST,
+	CAIRO_FILTER_NEAREST,
+	CAIRO_FILTER_BILINEAR,
+} cairo_filter_t;
+
+typedef enum _cairo_extend
+{
+	CAIRO_EXTEND_NONE,
+	CAIRO_EXTEND_REPEAT,
+	CAIRO_EXTEND_REFLECT,
+	CAIRO_EXTEND_PAD,
+} cairo_extend_t;
+
+typedef struct _cairo_surface
+{
+	std::atomic<int>	refs;
+	int					width;
+	int					height;
+} cairo_surface_t;
+
+inline std::atomic<int>& cairo_stub_live_surfaces()
+{
+	static std::atomic<int> count(0);
+	return count;
+}
+
+inline cairo_surface_t* cairo_image_surface_create(cairo_format_t /*format*/, int width, int height)
+{
+	cairo_stub_live_surfaces()++;
+	return new cairo_surface_t{{1}, width, height};
+}
+
+inline cairo_surface_t* cairo_surface_reference(cairo_surface_t* surface)
+{
+	if(surface) surface->refs++;
+	return surface;
+}
+
+inline void cairo_surface_destroy(cairo_surface_t* surface)
+{
+	if(surface && --surface->refs == 0)
+	{
+		cairo_stub_live_surfaces()--;
+		delete surface;
+	}
+}
+
+inline cairo_surface_t* cairo_surface_create_similar(cairo_surface_t* /*other*/, cairo_content_t /*content*/, int width, int height)
+{
+	return cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+}
+
+inline cairo_content_t cairo_surface_get_content(cairo_surface_t* /*surface*/) { return CAIRO_CONTENT_COLOR_ALPHA; }
+
+typedef struct _cairo_pattern { int unused; } cairo_pattern_t;
+typedef struct _cairo { int unused; } cairo_t;
+
+inline cairo_pattern_t* cairo_pattern_create_for_surface(cairo_surface_t* /*surface*/) { return new cairo_pattern_t(); }
+inline void cairo_pattern_set_filter(cairo_pattern_t* /*pattern*/, cairo_filter_t /*filter*/) {}
+inline void cairo_pattern_set_extend(cairo_pattern_t* /*pattern*/, cairo_extend_t /*extend*/) {}
+inline void cairo_pattern_destroy(cairo_pattern_t* pattern) { delete pattern; }
+inline cairo_t* cairo_create(cairo_surface_t* /*target*/) { return new cairo_t(); }
+inline void cairo_scale(cairo_t* /*cr*/, double /*sx*/, double /*sy*/) {}
+inline void cairo_set_source(cairo_t* /*cr*/, cairo_pattern_t* /*source*/) {}
+inline void cairo_rectangle(cairo_t* /*cr*/, double /*x*/, double /*y*/, double /*width*/, double /*height*/) {}
+inline void cairo_fill(cairo_t* /*cr*/) {}
+inline void cairo_destroy(cairo_t* cr) { delete cr; }
+
+inline int cairo_image_surface_get_width(cairo_surface_t* surface) { return surface->width; }
+inline int cairo_image_surface_get_height(cairo_surface_t* surface) { return surface->height; }
+inline int cairo_image_surface_get_stride(cairo_surface_t* surface) { return surface->width * 4; }
+
+#endif // LITEHTML_TEST_CAIRO_STUB_H
@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include "test_utils.h"
+
+using namespace litehtml;
+
+namespace
+{
+	// Ids of the selected elements, in the returned order
+	string select_ids(const element::ptr& scope, const string& selector)
+	{
+		string ids;
+		for (const auto& el : scope->select_all(selector))
+		{
+			ids += string(el->get_attr("id", "?")) + " ";
+		}
+		return ids;
+	}
+}
+
+TEST(ElementIndexTest, SelectAllInDocumentOrder)
+{
+	test_doc_container container;
+	auto doc = document::createFromString(
+		"<div id='a' class='x'><p id='b' class='y x'></p><p id='c'></p></div><div id='d'><p id='e' class='x'></p></div>", &container);
+
+	elements_list list = doc->root()->select_all(".x");
+	EXPECT_EQ(list.size(), 3u);
+	EXPECT_EQ(select_ids(doc->root(), ".x"), "a b e ");
+	EXPECT_EQ(select_ids(doc->root(), "div p"), "b c e ");
+	EXPECT_EQ(select_ids(doc->root()->select_one("#d"), "p.x"), "e ");
+	EXPECT_EQ(doc->root()->select_one("p:not(.x)"), doc->root()->select_one("#c"));
+	EXPECT_TRUE(select_ids(doc->root(), "p[").empty());
+}
+
+TEST(ElementIndexTest, AttributeChangesUpdateIndex)
+{
+	test_doc_container container;
+	auto doc = document::createFromString("<div id='a' class='x'></div><div id='b'></div><span id='c'></span>", &container);
+	EXPECT_EQ(select_ids(doc->root(), ".x"), "a ");
+
+	element::ptr b = doc->root()->select_one("#b");
+	b->set_attr("class", "y x");
+	EXPECT_EQ(select_ids(doc->root(), ".x"), "a b ");
+	EXPECT_EQ(select_ids(doc->root(), ".y"), "b ");
+
+	doc->root()->select_one("#a")->set_attr("class", "y");
+	EXPECT_EQ(select_ids(doc->root(), ".x"), "b ");
+	EXPECT_EQ(select_ids(doc->root(), ".y"), "a b ");
+
+	b->set_attr("id", "z");
+	EXPECT_EQ(doc->root()->select_one("#b"), nullptr);
+	EXPECT_EQ(doc->root()->select_one("#z"), b);
+
+	doc->root()->select_one("#c")->set_tagName("div");
+	EXPECT_EQ(select_ids(doc->root(), "div"), "a z c ");
+	EXPECT_TRUE(select_ids(doc->root(), "span").empty());
+}
+
+TEST(ElementIndexTest, TreeChangesUpdateIndex)
+{
+	test_doc_container container;
+	auto doc = document::createFromString("<div id='a'><p id='b' class='x'></p></div><div id='c'></div>", &container);
+	EXPECT_EQ(select_ids(doc->root(), ".x"), "b ");
+
+	auto new_element = [&](const char* id) { return doc->create_element("p", {{"id", id}, {"class", "x"}}); };
+
+	// Appended at the end of the document
+	element::ptr c = doc->root()->select_one("#c");
+	c->appendChild(new_element("d"));
+	EXPECT_EQ(select_ids(doc->root(), ".x"), "b d ");
+	EXPECT_EQ(select_ids(c, ".x"), "d ");
+	EXPECT_EQ(select_ids(doc->root()->select_one("#a"), ".x"), "b ");
+
+	// Appended in the middle
+	element::ptr a = doc->root()->select_one("#a");
+	a->appendChild(new_element("e"));
+	EXPECT_EQ(select_ids(doc->root(), ".x"), "b e d ");
+	EXPECT_EQ(select_ids(a, "p"), "b e ");
+
+	a->removeChild(a->select_one("#b"));
+	EXPECT_EQ(select_ids(doc->root(), ".x"), "e d ");
+}
+
+// Progressive loading replaces the provisional elements of the previous update, selectors run
+// between the chunks must not see the removed ones
+TEST(ElementIndexTest, SelectBetweenLoadingChunks)
+{
+	test_doc_container container;
+	auto doc = document::begin(&container);
+
+	string spans;
+	for (int i = 0; i < 3000; i++) spans += "<span class='s'>x</span>";
+	string html = "<html><body><div>" + spans + "<p id='prov'>partial";
+	doc->append_bytes(html.data(), html.size());
+	element::ptr prov = doc->root()->select_one("#prov");
+
+	string bolds;
+	for (int i = 0; i < 3000; i++) bolds += "<b>y</b>";
+	html = " rest</p>" + bolds;
+	doc->append_bytes(html.data(), html.size());
+
+	element::ptr p = doc->root()->select_one("#prov");
+	ASSERT_TRUE(p);
+	EXPECT_EQ(doc->root()->select_all("#prov").size(), 1u);
+	EXPECT_EQ(doc->root()->select_all("p").size(), 1u);
+	EXPECT_EQ(doc->root()->select_all(".s").size(), 3000u);
+	string text;
+	p->get_text(text);
+	EXPECT_EQ(text, "partial rest");
+
+	html = "</div><p id='end'>end</p></body></html>";
+	doc->append_bytes(html.data(), html.size());
+	EXPECT_EQ(doc->root()->select_all("b").size(), 3000u);
+	doc->finish();
+	EXPECT_EQ(doc->root()->select_all("p").size(), 2u);
+	EXPECT_EQ(select_ids(doc->root(), "p"), "prov end ");
+	EXPECT_EQ(doc->root()->select_all("div b").size(), 3000u);
+}
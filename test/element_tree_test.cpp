@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include "test_utils.h"
+
+using namespace litehtml;
+
+namespace
+{
+	string child_ids(const element::ptr& el)
+	{
+		string ids;
+		for (const auto& child : el->children())
+		{
+			ids += child->get_attr("id", "?");
+		}
+		return ids;
+	}
+}
+
+TEST(ElementTreeTest, SiblingLinks)
+{
+	test_doc_container container;
+	auto doc = document::createFromString("<div id='p'><i id='a'></i><i id='b'></i><i id='c'></i></div><div id='q'></div>", &container);
+	auto p = doc->root()->select_one("#p");
+	auto q = doc->root()->select_one("#q");
+	auto b = doc->root()->select_one("#b");
+	ASSERT_EQ(child_ids(p), "abc");
+	EXPECT_EQ(p->children().size(), 3u);
+	EXPECT_EQ(b->previousSibling(), p->firstChild());
+	EXPECT_EQ(b->nextSibling(), p->lastChild());
+	EXPECT_EQ(b->parent(), p);
+
+	string reversed;
+	for (auto it = p->children().rbegin(); it != p->children().rend(); ++it)
+	{
+		reversed += (*it)->get_attr("id");
+	}
+	EXPECT_EQ(reversed, "cba");
+
+	// appendChild moves the element to the new parent
+	q->appendChild(b);
+	EXPECT_EQ(child_ids(p), "ac");
+	EXPECT_EQ(child_ids(q), "b");
+	EXPECT_EQ(b->parent(), q);
+	EXPECT_EQ(p->firstChild()->nextSibling(), p->lastChild());
+	EXPECT_EQ(doc->root()->select_all("#q > i").size(), 1u);
+
+	// A removed element keeps working without its parent and siblings
+	ASSERT_TRUE(q->removeChild(b));
+	EXPECT_FALSE(q->removeChild(b));
+	EXPECT_TRUE(q->children().empty());
+	EXPECT_EQ(b->parent(), nullptr);
+	EXPECT_EQ(b->nextSibling(), nullptr);
+	EXPECT_EQ(b->previousSibling(), nullptr);
+
+	// Children outlive their parent if they are referenced
+	auto a = p->firstChild();
+	doc.reset();
+	p.reset();
+	q.reset();
+	EXPECT_EQ(a->parent(), nullptr);
+	EXPECT_EQ(a->nextSibling(), nullptr);
+}
+
+TEST(ElementTreeTest, LongSiblingListIsDestroyedIteratively)
+{
+	test_doc_container container;
+	string html = "<div>";
+	for (int i = 0; i < 100000; i++) html += "<b></b>";
+	auto doc = document::createFromString(html + "</div>", &container);
+	auto div = doc->root()->select_one("div");
+	EXPECT_EQ(div->children().size(), 100000u);
+	doc.reset();
+	div.reset();	// the last reference to the list
+}
+
+TEST(ElementTreeTest, Attributes)
+{
+	test_doc_container container;
+	auto doc = document::createFromString("<p ID='first' Class='a b' data-Value='x'>text</p>", &container);
+	auto p = doc->root()->select_one("p");
+	EXPECT_STREQ(p->get_attr("id"), "first");
+	EXPECT_STREQ(p->get_attr("data-value"), "x");
+	EXPECT_EQ(p->get_attr("litehtml-unknown-attribute"), nullptr);
+	EXPECT_STREQ(p->get_attr("litehtml-unknown-attribute", "def"), "def");
+	EXPECT_EQ(doc->root()->select_one("[data-value=x].b#first"), p);
+
+	p->set_attr("Class", "c");
+	EXPECT_STREQ(p->get_attr("class"), "c");
+	EXPECT_EQ(doc->root()->select_one(".c"), p);
+	EXPECT_EQ(doc->root()->select_one(".a"), nullptr);
+}
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include "test_utils.h"
+
+using namespace litehtml;
+
+namespace
+{
+	// Records the geometry of the drawn linear gradients
+	class gradient_container : public test_doc_container
+	{
+	public:
+		std::vector<pointF> starts;
+		std::vector<position> origins;
+		std::vector<uint32_t> lut;
+
+		void draw_linear_gradient(uint_ptr /*hdc*/, const background_layer& layer, const background_layer::linear_gradient& gradient) override
+		{
+			starts.push_back(gradient.start);
+			origins.push_back(layer.origin_box);
+			lut = gradient.get_color_lut(256);
+		}
+	};
+
+	uint32_t rgba(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+	{
+		const uint8_t bytes[4] = { r, g, b, a };
+		uint32_t pixel;
+		memcpy(&pixel, bytes, sizeof(pixel));
+		return pixel;
+	}
+}
+
+TEST(GradientTest, ColorLutIsPremultipliedRgba)
+{
+	gradient_container container;
+	auto doc = document::createFromString(
+		"<div style='width: 100px; height: 10px; background: linear-gradient(to right, rgba(255, 0, 0, 0.5), blue)'></div>", &container);
+	doc->render(800);
+	doc->draw(0, 0, 0, nullptr);
+
+	ASSERT_EQ(container.lut.size(), 256u);
+	EXPECT_EQ(container.lut.front(), rgba(128, 0, 0, 128));
+	EXPECT_EQ(container.lut.back(), rgba(0, 0, 255, 255));
+
+	// Halfway in premultiplied space
+	const auto* mid = (const uint8_t*) &container.lut[128];
+	EXPECT_NEAR(mid[0], 64, 1);
+	EXPECT_EQ(mid[1], 0);
+	EXPECT_NEAR(mid[2], 128, 1);
+	EXPECT_NEAR(mid[3], 192, 1);
+	for (uint32_t pixel : container.lut)
+	{
+		const auto* c = (const uint8_t*) &pixel;
+		EXPECT_LE(std::max({c[0], c[1], c[2]}), c[3]);
+	}
+}
+
+TEST(GradientTest, CachedLayerMovesWithoutDrift)
+{
+	gradient_container container;
+	auto doc = document::createFromString(
+		"<div style='margin: 3px; width: 100px; height: 10px; background: linear-gradient(33deg, red, blue)'></div>", &container);
+	doc->render(800);
+
+	doc->draw(0, 0, 0, nullptr);
+	ASSERT_EQ(container.starts.size(), 1u);
+	float start_x = container.starts[0].x - container.origins[0].x;
+	float start_y = container.starts[0].y - container.origins[0].y;
+
+	// Drawn at many positions through the same cached layer
+	for (int i = 1; i <= 1000; i++)
+	{
+		doc->draw(0, (i % 2 ? 20000.0f : 0.0f) + i * 0.37f, (i % 3 ? -7000.0f : 0.0f) - i * 1.13f, nullptr);
+	}
+	doc->draw(0, 0, 0, nullptr);
+	ASSERT_EQ(container.starts.size(), 1002u);
+	EXPECT_EQ(container.starts.back().x, container.starts.front().x);
+	EXPECT_EQ(container.starts.back().y, container.starts.front().y);
+	for (size_t i = 0; i < container.starts.size(); i++)
+	{
+		EXPECT_NEAR(container.starts[i].x - container.origins[i].x, start_x, 1e-3);
+		EXPECT_NEAR(container.starts[i].y - container.origins[i].y, start_y, 1e-3);
+	}
+}
@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+#include "test_utils.h"
+#include <litehtml/render_item.h>
+
+using namespace litehtml;
+
+namespace
+{
+	struct hit_point
+	{
+		pixel_t x, y, client_x, client_y;
+	};
+
+	// Points on a grid covering the document, the second half with the document scrolled down
+	std::vector<hit_point> grid_points(const document::ptr& doc, pixel_t step)
+	{
+		std::vector<hit_point> points;
+		pixel_t scroll = 150;
+		for (int scrolled = 0; scrolled < 2; scrolled++)
+		{
+			for (pixel_t y = -5; y < doc->height() + 10; y += step)
+			{
+				for (pixel_t x = -5; x < doc->width() + 10; x += step)
+				{
+					points.push_back({x, y, x, scrolled ? y - scroll : y});
+				}
+			}
+		}
+		return points;
+	}
+
+	// Finds the element at every point without the hit testing index, then with it
+	void expect_same_hits(const document::ptr& doc, pixel_t step = 3)
+	{
+		auto points = grid_points(doc, step);
+		ASSERT_EQ(doc->hit_generation(), 0u);
+
+		// render_item::get_element_by_point checks every child until the document builds the index
+		std::vector<element::ptr> expected;
+		for (const auto& pt : points)
+		{
+			expected.push_back(doc->root_render()->get_element_by_point(pt.x, pt.y, pt.client_x, pt.client_y));
+		}
+
+		size_t hits = 0;
+		for (size_t i = 0; i < points.size(); i++)
+		{
+			const auto& pt = points[i];
+			auto el = doc->get_element_by_point(pt.x, pt.y, pt.client_x, pt.client_y);
+			ASSERT_NE(doc->hit_generation(), 0u);
+			EXPECT_EQ(el, expected[i]) << "at " << pt.x << "," << pt.y << " client " << pt.client_x << "," << pt.client_y;
+			if (el) hits++;
+		}
+		EXPECT_GT(hits, 0u);
+	}
+
+	document::ptr render_doc(test_doc_container& container, const string& html)
+	{
+		auto doc = document::createFromString(html, &container);
+		doc->render(800);
+		return doc;
+	}
+
+	// Enough children for the index to group them in bands
+	string many_children(const string& tag, const string& style, int count)
+	{
+		string html;
+		for (int i = 0; i < count; i++)
+		{
+			html += "<" + tag + " id='c" + std::to_string(i) + "' style='" + style + "'>item " + std::to_string(i) + "</" + tag + ">";
+		}
+		return html;
+	}
+}
+
+TEST(HitIndexTest, ZIndex)
+{
+	test_doc_container container;
+	auto doc = render_doc(container,
+		"<div style='position:relative'>" + many_children("div", "height:10px", 40) +
+		"<div id='top' style='position:absolute; left:20px; top:30px; width:100px; height:100px; z-index:5'>top</div>"
+		"<div id='bottom' style='position:absolute; left:60px; top:60px; width:100px; height:100px; z-index:1'>bottom</div>"
+		"<div id='behind' style='position:absolute; left:0; top:200px; width:300px; height:50px; z-index:-1'>behind</div>"
+		"<div style='position:relative; z-index:2'><div style='position:absolute; left:400px; top:-20px; width:50px; height:500px'>tall</div></div>"
+		"</div>");
+	expect_same_hits(doc);
+	EXPECT_EQ(doc->get_element_by_point(70, 70, 70, 70), doc->root()->select_one("#top"));
+	EXPECT_EQ(doc->get_element_by_point(150, 150, 150, 150), doc->root()->select_one("#bottom"));
+}
+
+TEST(HitIndexTest, FixedElements)
+{
+	test_doc_container container;
+	auto doc = render_doc(container,
+		"<div>" + many_children("p", "margin:0; height:20px", 50) +
+		"<div id='fixed' style='position:fixed; left:100px; top:10px; width:200px; height:40px'>fixed"
+		"<span style='position:absolute; left:250px; top:100px'>outside</span></div>"
+		"</div>"
+		"<div style='position:fixed; right:0; bottom:0; width:50px; height:50px; z-index:3'>corner</div>");
+	expect_same_hits(doc);
+	// Fixed elements are hit in client coordinates
+	auto fixed = doc->root()->select_one("#fixed");
+	auto el = doc->get_element_by_point(150, 320, 150, 20);
+	ASSERT_TRUE(el);
+	EXPECT_TRUE(el == fixed || el->parent() == fixed);
+	el = doc->get_element_by_point(150, 20, 150, 320);
+	ASSERT_TRUE(el);
+	EXPECT_NE(el->parent(), fixed);
+}
+
+TEST(HitIndexTest, OverflowClipping)
+{
+	test_doc_container container;
+	auto doc = render_doc(container,
+		"<div id='clip' style='overflow:hidden; width:200px; height:100px'>" +
+		many_children("div", "width:400px; height:20px", 30) +
+		"<div style='position:relative; left:300px; width:50px; height:50px'>clipped</div></div>"
+		"<div style='overflow:auto; width:300px; height:80px'>" + many_children("span", "display:inline-block; width:90px", 40) + "</div>"
+		"<div style='overflow:hidden; position:relative; width:100px; height:100px'>"
+		"<div style='position:absolute; left:150px; top:0; width:50px; height:50px'>abs</div></div>");
+	expect_same_hits(doc);
+	// The children overflowing the clip are not hit
+	EXPECT_EQ(doc->get_element_by_point(300, 50, 300, 50), doc->root()->select_one("body"));
+}
+
+TEST(HitIndexTest, Tables)
+{
+	test_doc_container container;
+	string rows;
+	for (int i = 0; i < 30; i++)
+	{
+		rows += "<tr><td>a" + std::to_string(i) + "</td><td rowspan='2'>b</td><td><div style='position:relative; left:40px'>c</div></td></tr>";
+	}
+	auto doc = render_doc(container,
+		"<table border='1' cellspacing='2'><caption>caption</caption><thead><tr><th colspan='3'>head</th></tr></thead>"
+		"<tbody>" + rows + "</tbody></table>"
+		"<div style='display:table'><div style='display:table-row'>" + many_children("div", "display:table-cell; width:20px", 20) + "</div></div>");
+	expect_same_hits(doc);
+}
@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+#include "test_utils.h"
+
+using namespace litehtml;
+
+namespace
+{
+	// Counts layer repaints
+	class layer_container : public test_doc_container
+	{
+	public:
+		int			layers_created = 0;
+		uint_ptr	next_handle = 100;
+
+		uint_ptr create_layer(uint_ptr /*hdc*/, int /*width*/, int /*height*/) override
+		{
+			layers_created++;
+			return next_handle++;
+		}
+	};
+}
+
+TEST(LayerTest, HoverRepaintsCompositedLayer)
+{
+	layer_container container;
+	auto doc = document::createFromString(
+		"<style>#a:hover { color: red }</style>"
+		"<div style='opacity: 0.5'><span id='a'>hover me</span></div>", &container);
+	doc->render(800);
+
+	doc->draw(0, 0, 0, nullptr);
+	ASSERT_EQ(container.layers_created, 1);
+
+	// Drawing again reuses the layer
+	doc->draw(0, 0, 0, nullptr);
+	EXPECT_EQ(container.layers_created, 1);
+
+	// Hover restyles the span inside the layer without render()
+	position::vector redraw_boxes;
+	ASSERT_TRUE(doc->on_mouse_over(20, 20, 20, 20, redraw_boxes));
+	doc->draw(0, 0, 0, nullptr);
+	EXPECT_EQ(container.layers_created, 2);
+
+	doc->draw(0, 0, 0, nullptr);
+	EXPECT_EQ(container.layers_created, 2);
+}
@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+#include "pixel_kernels.h"
+
+using namespace pixel_kernels;
+
+namespace
+{
+	// Random premultiplied pixels: no channel above alpha, with opaque and transparent ones mixed in
+	std::vector<uint32_t> random_premultiplied(std::mt19937& rng, size_t n)
+	{
+		std::vector<uint32_t> ret(n);
+		for (auto& px : ret)
+		{
+			uint32_t a = rng() % 4 == 0 ? (rng() % 2) * 255 : rng() % 256;
+			px = a << 24;
+			for (int shift = 0; shift < 24; shift += 8)
+				px |= (a ? rng() % (a + 1) : 0) << shift;
+		}
+		return ret;
+	}
+}
+
+TEST(PixelKernelsTest, FillSpanMatchesScalar)
+{
+	std::mt19937 rng(1);
+	const auto& scalar = get_scalar_pixel_kernels();
+	for (const kernels* k : available_pixel_kernels())
+	{
+		// Unaligned starts and lengths around the vector widths
+		for (size_t offset = 0; offset < 8; offset++)
+		{
+			for (size_t n = 0; n < 67; n++)
+			{
+				std::vector<uint32_t> expected(offset + n + 8);
+				for (auto& px : expected) px = rng();
+				std::vector<uint32_t> actual = expected;
+				uint32_t color = rng();
+
+				scalar.fill_span(expected.data() + offset, color, n);
+				k->fill_span(actual.data() + offset, color, n);
+				ASSERT_EQ(expected, actual) << k->name << " offset=" << offset << " n=" << n;
+			}
+		}
+	}
+}
+
+TEST(PixelKernelsTest, BlendSrcOverMatchesScalar)
+{
+	std::mt19937 rng(2);
+	const auto& scalar = get_scalar_pixel_kernels();
+	for (const kernels* k : available_pixel_kernels())
+	{
+		for (size_t offset = 0; offset < 8; offset++)
+		{
+			for (size_t n = 0; n < 67; n++)
+			{
+				std::vector<uint32_t> src = random_premultiplied(rng, offset + n);
+				std::vector<uint32_t> expected = random_premultiplied(rng, offset + n + 8);
+				std::vector<uint32_t> actual = expected;
+
+				scalar.blend_src_over(expected.data() + offset, src.data() + offset, n);
+				k->blend_src_over(actual.data() + offset, src.data() + offset, n);
+				ASSERT_EQ(expected, actual) << k->name << " offset=" << offset << " n=" << n;
+			}
+		}
+	}
+
+	// Opaque source replaces, transparent source keeps the destination
+	uint32_t dst[2] = { 0x80402010, 0xFF00FF00 };
+	const uint32_t src[2] = { 0xFF102030, 0x00000000 };
+	scalar.blend_src_over(dst, src, 2);
+	EXPECT_EQ(dst[0], 0xFF102030u);
+	EXPECT_EQ(dst[1], 0xFF00FF00u);
+}
+
+TEST(PixelKernelsTest, GradientSpanMatchesScalar)
+{
+	std::mt19937 rng(3);
+	const auto& scalar = get_scalar_pixel_kernels();
+	std::vector<uint32_t> lut(256);
+	for (auto& px : lut) px = rng();
+
+	for (const kernels* k : available_pixel_kernels())
+	{
+		for (size_t n = 0; n < 67; n++)
+		{
+			// Positions starting before the LUT and running past its end, both directions
+			int32_t pos = (int32_t) (rng() % (400 << 16)) - (100 << 16);
+			int32_t step = (int32_t) (rng() % (16 << 16)) - (8 << 16);
+			std::vector<uint32_t> expected(n + 8, 0);
+			std::vector<uint32_t> actual = expected;
+
+			scalar.gradient_span(expected.data() + 1, lut.data(), (int) lut.size(), pos, step, n);
+			k->gradient_span(actual.data() + 1, lut.data(), (int) lut.size(), pos, step, n);
+			ASSERT_EQ(expected, actual) << k->name << " n=" << n << " pos=" << pos << " step=" << step;
+		}
+	}
+}
+
+TEST(PixelKernelsTest, BoxBlurMatchesScalar)
+{
+	std::mt19937 rng(4);
+	const auto& scalar = get_scalar_pixel_kernels();
+	for (const kernels* k : available_pixel_kernels())
+	{
+		// Sizes around the 8 and 16 lane widths, radius up to the clamp
+		for (int width : { 1, 7, 8, 17, 40 })
+		{
+			for (int height : { 1, 9, 16, 33 })
+			{
+				for (int radius : { 1, 3, 20, 127, 200 })
+				{
+					int stride = width + 5;
+					std::vector<uint8_t> expected((size_t) stride * height);
+					for (auto& v : expected) v = (uint8_t) (rng() % 3 == 0 ? 255 : rng());
+					std::vector<uint8_t> actual = expected;
+
+					scalar.box_blur_h(expected.data(), width, height, stride, radius);
+					k->box_blur_h(actual.data(), width, height, stride, radius);
+					ASSERT_EQ(expected, actual) << k->name << " h " << width << "x" << height << " r=" << radius;
+
+					scalar.box_blur_v(expected.data(), width, height, stride, radius);
+					k->box_blur_v(actual.data(), width, height, stride, radius);
+					ASSERT_EQ(expected, actual) << k->name << " v " << width << "x" << height << " r=" << radius;
+				}
+			}
+		}
+	}
+
+	// Padding between rows is not touched, a flat mask stays flat inside
+	std::vector<uint8_t> mask(20 * 20, 200);
+	scalar.box_blur_h(mask.data(), 10, 20, 20, 2);
+	EXPECT_EQ(mask[5], 200);
+	EXPECT_EQ(mask[15], 200);
+	EXPECT_LT(mask[0], 200);
+}
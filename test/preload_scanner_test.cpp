@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include <map>
+#include "test_utils.h"
+
+using namespace litehtml;
+
+namespace
+{
+	// Records the preloads, style sheets are served from files and passed back to the document
+	class preload_container : public test_doc_container
+	{
+	public:
+		std::map<string, string>	files;		// url -> style sheet
+		std::vector<string>			requests;	// "baseurl|url" in request order
+
+		void preload(const std::shared_ptr<document>& doc, const string& url, const string& baseurl, resource_type type) override
+		{
+			requests.push_back(baseurl + "|" + url);
+			auto file = files.find(url);
+			if (type == resource_stylesheet && file != files.end())
+			{
+				doc->stylesheet_preloaded(url, file->second);
+			}
+		}
+	};
+
+	std::vector<string> preload_requests(const string& html, size_t chunk_size)
+	{
+		preload_container container;
+		auto doc = document::begin(&container);
+		for (size_t pos = 0; pos < html.size(); pos += chunk_size)
+		{
+			string chunk = html.substr(pos, chunk_size);
+			doc->append_bytes(chunk.data(), chunk.size());
+		}
+		doc->finish();
+		return container.requests;
+	}
+}
+
+TEST(PreloadScannerTest, FindsResources)
+{
+	string html =
+		"<html><head><base href='http://example.com/'>"
+		"<link rel=stylesheet href='main.css?a=1&amp;b=2'><link rel=icon href='icon.png'>"
+		"<!-- <img src='comment.png'> -->"
+		"<script>var s = '<img src=\"script.png\">';</script>"
+		"<style>@charset 'utf-8'; /* first */ @import url(\"theme.css\") screen; @import 'print.css';"
+		" body { background: url(bg.png) } @import 'late.css';</style>"
+		"<textarea><img src='text.png'></textarea></head>"
+		"<body><IMG SRC=photo.jpg><img src='lazy.jpg' loading='lazy'><img src='photo.jpg'></body></html>";
+	std::vector<string> expected = {
+		"http://example.com/|main.css?a=1&b=2",
+		"http://example.com/|theme.css",
+		"http://example.com/|print.css",
+		"http://example.com/|photo.jpg",
+	};
+	// Every split of the input finds the same resources
+	for (size_t chunk_size : { html.size(), (size_t) 1, (size_t) 7, (size_t) 64 })
+	{
+		EXPECT_EQ(preload_requests(html, chunk_size), expected) << chunk_size;
+	}
+}
+
+TEST(PreloadScannerTest, LongScriptAcrossAppends)
+{
+	string script = "<script>";
+	while (script.size() < 200000)
+	{
+		script += "if (a < b) document.write('<p>' + a + '</p>');\n";
+	}
+	string html = "<html><body>" + script + "</SCRIPT><img src='after.png'></body></html>";
+	EXPECT_EQ(preload_requests(html, 13), std::vector<string>{"|after.png"});
+}
+
+TEST(PreloadScannerTest, ChainsImports)
+{
+	preload_container container;
+	container.files["a.css"] = "@import 'b.css'; p { color: red }";
+	container.files["b.css"] = "/* comment */ @import url(c.css);\n@import \"a.css\";";
+	container.files["c.css"] = "body { margin: 0 }";
+
+	auto doc = document::createFromString("<link rel='stylesheet' href='a.css'><p>text</p>", &container);
+	// Each style sheet is requested once with the url of the importing one as the base
+	std::vector<string> expected = { "|a.css", "a.css|b.css", "b.css|c.css", "b.css|a.css" };
+	EXPECT_EQ(container.requests, expected);
+}
+
+TEST(PreloadScannerTest, StylesheetPreloaded)
+{
+	preload_container container;
+	auto doc = document::begin(&container);
+	doc->stylesheet_preloaded("http://example.com/css/site.css", "@import 'fonts.css'; @import url(  'grid.css' ) ; a { color: blue }");
+	// Repeated notifications don't repeat the requests
+	doc->stylesheet_preloaded("http://example.com/css/site.css", "@import 'fonts.css';");
+	std::vector<string> expected = { "http://example.com/css/site.css|fonts.css", "http://example.com/css/site.css|grid.css" };
+	EXPECT_EQ(container.requests, expected);
+}
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "test_utils.h"
+
+using namespace litehtml;
+
+namespace
+{
+	// About 40 KB of mixed content
+	string test_page()
+	{
+		string html =
+			"<!DOCTYPE html><html><head><meta charset='utf-8'><title>Test</title>"
+			"<style>body { font-size: 14px } .note { color: #333; margin: 4px } li:last-child { font-weight: bold }"
+			" td + td { padding-left: 8px } h2 ~ p { line-height: 1.4 }</style></head><body>";
+		for (int i = 0; html.size() < 40000; i++)
+		{
+			string n = std::to_string(i);
+			html += "<h2 id='h" + n + "'>Section " + n + " &amp; more</h2>";
+			html += "<p class='note'>Paragraph <b>" + n + "</b> with <a href='#h" + n + "'>a link</a>, <i>italic</i> text"
+					" and an entity &copy; that should <span style='color: red'>wrap</span> across lines.</p>";
+			html += "<!-- comment " + n + " -->";
+			html += "<ul><li>one</li><li>two <em>" + n + "</em></li><li>three</li></ul>";
+			if (i % 3 == 0)
+			{
+				html += "<table><tr><td>a" + n + "</td><td>b</td></tr><tr><td colspan=2>c</td></tr></table>";
+			}
+			if (i % 5 == 0)
+			{
+				html += "<div style='float: left; width: 50px; height: 20px'></div><div><div><p>nested " + n + "</p></div></div>";
+			}
+			html += "<pre>  pre\n  text " + n + "</pre>";
+		}
+		html += "<p>end</p></body></html>";
+		return html;
+	}
+}
+
+// Progressive loading with random chunk sizes and render() calls in between must build the same
+// document as createFromString
+TEST(ProgressiveLoadingTest, MatchesCreateFromString)
+{
+	test_doc_container container;
+	string html = test_page();
+
+	auto expected_doc = document::createFromString(html, &container);
+	expected_doc->render(800);
+	string expected = dump_document(expected_doc);
+	ASSERT_FALSE(expected.empty());
+
+	for (unsigned seed : {1u, 2u})
+	{
+		std::mt19937 rng(seed);
+		for (int run = 0; run < 4; run++)
+		{
+			auto doc = document::begin(&container);
+			size_t pos = 0;
+			while (pos < html.size())
+			{
+				size_t size = std::min(html.size() - pos, (size_t) (1 + rng() % 3000));
+				bool updated = doc->append_bytes(html.data() + pos, size);
+				pos += size;
+				if (updated && rng() % 2)
+				{
+					doc->render(800);
+				}
+			}
+			doc->finish();
+			doc->render(800);
+			EXPECT_EQ(dump_document(doc), expected) << "seed " << seed << " run " << run;
+		}
+	}
+}
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include "test_utils.h"
+#include <litehtml/render_item.h>
+
+using namespace litehtml;
+
+namespace
+{
+	// Every child links back to its parent and refers to a live element
+	void check_links(const std::shared_ptr<render_item>& root)
+	{
+		std::vector<std::shared_ptr<render_item>> stack = {root};
+		while (!stack.empty())
+		{
+			auto item = stack.back();
+			stack.pop_back();
+			ASSERT_NE(item->src_el(), nullptr);
+			for (const auto& child : item->children())
+			{
+				ASSERT_EQ(child->parent(), item);
+				stack.push_back(child);
+			}
+		}
+	}
+}
+
+TEST(RenderTreeTest, AnonymousBoxes)
+{
+	test_doc_container container;
+	auto doc = document::createFromString(
+		"<div>text <span>inline <div>block in inline</div> after</span> tail<p>para</p></div>"
+		"<div style='display:flex'> text <b>bold</b> <div>block</div> more <span>span</span></div>"
+		"<div style='display:table'><span>text</span><div style='display:table-cell'>c</div></div>"
+		"<table><tr><td id='a'>a</td><td id='b'>b</td></tr></table>", &container);
+	doc->render(800);
+	check_links(doc->root_render());
+
+	// The anonymous boxes own their elements, the tree is laid out again without them
+	doc->rebuild_render_tree();
+	doc->render(800);
+	check_links(doc->root_render());
+
+	auto a = doc->root()->select_one("#a")->firstChild();
+	auto b = doc->root()->select_one("#b")->firstChild();
+	EXPECT_GT(b->get_placement().x, a->get_placement().x);
+	EXPECT_EQ(b->get_placement().y, a->get_placement().y);
+}
+
+TEST(RenderTreeTest, RemovedElementIsKeptUntilRebuild)
+{
+	test_doc_container container;
+	auto doc = document::createFromString("<div id='a'>one</div><div id='b'>two</div>", &container);
+	doc->render(800);
+
+	auto a = doc->root()->select_one("#a");
+	std::weak_ptr<element> weak = a;
+	ASSERT_TRUE(a->parent()->removeChild(a));
+	a.reset();
+
+	// The render tree still refers to the element
+	EXPECT_FALSE(weak.expired());
+	doc->get_element_by_point(10, 20, 10, 20);
+	doc->render(800);
+
+	doc->rebuild_render_tree();
+	EXPECT_TRUE(weak.expired());
+	doc->render(800);
+	EXPECT_EQ(doc->get_element_by_point(10, 20, 10, 20), doc->root()->select_one("#b"));
+}
+
+TEST(RenderTreeTest, LongSiblingListIsDestroyedIteratively)
+{
+	test_doc_container container;
+	string html = "<div>";
+	for (int i = 0; i < 100000; i++) html += "<b></b>";
+	auto doc = document::createFromString(html + "</div>", &container);
+	auto div = doc->root()->select_one("div");
+	std::vector<std::shared_ptr<render_item>> stack = {doc->root_render()};
+	std::shared_ptr<render_item> item;
+	while (!item && !stack.empty())
+	{
+		auto cur = stack.back();
+		stack.pop_back();
+		if (cur->src_el() == div.get()) item = cur;
+		stack.insert(stack.end(), cur->children().begin(), cur->children().end());
+	}
+	ASSERT_TRUE(item);
+	EXPECT_EQ(item->children().size(), 100000u);
+	stack.clear();
+	item.reset();
+	doc.reset();
+}
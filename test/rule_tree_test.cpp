@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include "test_utils.h"
+
+using namespace litehtml;
+
+TEST(RuleTreeTest, DeclarationsAreKeyedByUid)
+{
+	rule_tree tree;
+	auto first = std::make_unique<style>();
+	first->add("color: red");
+	const rule_node* node = tree.child(nullptr, *first);
+	EXPECT_EQ(tree.child(nullptr, *first), node);
+
+	// A copy is another declaration block, even with the same content
+	style copy = *first;
+	EXPECT_NE(copy.uid(), first->uid());
+	EXPECT_NE(tree.child(nullptr, copy), node);
+}
+
+TEST(RuleTreeTest, HoverChurnDoesNotGrowTree)
+{
+	test_doc_container container;
+	auto doc = document::createFromString(
+		"<style>#a:hover { color: red } #a:hover span { color: blue }</style>"
+		"<div id='a' style='margin: 1px'><span style='padding: 1px'>hover me</span><p>text</p></div>", &container);
+	doc->render(800);
+
+	auto hover = [&](bool over)
+	{
+		position::vector redraw_boxes;
+		if (over)
+			doc->on_mouse_over(20, 20, 20, 20, redraw_boxes);
+		else
+			doc->on_mouse_leave(redraw_boxes);
+	};
+
+	element::ptr div = doc->root()->select_one("#a");
+	ASSERT_TRUE(div);
+	hover(true);
+	EXPECT_EQ(div->css().get_color(), web_color(255, 0, 0));
+	hover(false);
+	size_t size = doc->get_rule_tree().size();
+
+	for (int i = 0; i < 1000; i++)
+	{
+		hover(true);
+		hover(false);
+	}
+	EXPECT_LE(doc->get_rule_tree().size(), size * 2 + 256);
+	EXPECT_NE(div->css().get_color(), web_color(255, 0, 0));
+}
+
+TEST(RuleTreeTest, MediaChangedCollectsTree)
+{
+	test_doc_container container;
+	auto doc = document::createFromString(
+		"<style>@media (max-width: 500px) { div { color: red } }</style>"
+		"<div style='margin: 1px'>text</div>", &container);
+	doc->render(800);
+
+	element::ptr div = doc->root()->select_one("div");
+	for (int i = 0; i < 50; i++)
+	{
+		container.viewport.width = (i % 2) ? 800 : 400;
+		doc->media_changed();
+		EXPECT_EQ(div->css().get_color() == web_color(255, 0, 0), container.viewport.width == 400);
+	}
+	// The collected tree holds the rules of one state
+	rule_tree& tree = doc->get_rule_tree();
+	size_t size = tree.size();
+	container.viewport.width = 400;
+	doc->media_changed();
+	container.viewport.width = 800;
+	doc->media_changed();
+	EXPECT_EQ(tree.size(), size);
+}
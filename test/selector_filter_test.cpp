@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+#include "test_utils.h"
+
+using namespace litehtml;
+
+// Restyles fill the selector filter with the ancestors of the restyled element, so descendant
+// selectors match as they do on a fresh parse
+
+TEST(SelectorFilterTest, DescendantSelectorAfterMediaChanged)
+{
+	test_doc_container container;
+	auto doc = document::createFromString(
+		"<style>div .d { color: blue } @media (max-width: 500px) { .d { display: inline } }</style>"
+		"<div><section><p class='d'>text</p></section></div>", &container);
+	doc->render(800);
+
+	element::ptr p = doc->root()->select_one(".d");
+	ASSERT_TRUE(p);
+	EXPECT_EQ(p->css().get_color(), web_color(0, 0, 255));
+
+	container.viewport.width = 400;
+	doc->media_changed();
+	EXPECT_EQ(p->css().get_display(), display_inline);
+	EXPECT_EQ(p->css().get_color(), web_color(0, 0, 255));
+
+	container.viewport.width = 800;
+	doc->media_changed();
+	EXPECT_EQ(p->css().get_display(), display_block);
+	EXPECT_EQ(p->css().get_color(), web_color(0, 0, 255));
+	EXPECT_EQ(doc->get_selector_filter().depth(), 0u);
+}
+
+TEST(SelectorFilterTest, DescendantSelectorAfterHover)
+{
+	test_doc_container container;
+	auto doc = document::createFromString(
+		"<style>div .d { color: blue } div #a:hover { color: red }</style>"
+		"<div><span id='a' class='d'>hover me</span></div>", &container);
+	doc->render(800);
+
+	element::ptr a = doc->root()->select_one("#a");
+	ASSERT_TRUE(a);
+	EXPECT_EQ(a->css().get_color(), web_color(0, 0, 255));
+
+	position::vector redraw_boxes;
+	doc->on_mouse_over(20, 20, 20, 20, redraw_boxes);
+	EXPECT_EQ(a->css().get_color(), web_color(255, 0, 0));
+
+	doc->on_mouse_leave(redraw_boxes);
+	EXPECT_EQ(a->css().get_color(), web_color(0, 0, 255));
+	EXPECT_EQ(doc->get_selector_filter().depth(), 0u);
+}
@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+#include "test_utils.h"
+
+using namespace litehtml;
+
+static const char* snapshot_page =
+	"<style>.a { color: red; margin: 4px } p + p { padding-left: 3px } @media (max-width: 500px) { .a { color: blue } }</style>"
+	"<div class='a'><p>one <b>two</b></p><p>three</p><table><tr><td>x</td><td>y</td></tr></table></div>";
+
+TEST(SnapshotTest, CloneRendersLikeSource)
+{
+	test_doc_container container;
+	auto doc = document::createFromString(snapshot_page, &container);
+	doc->render(800);
+	string expected = dump_document(doc);
+
+	document_snapshot::ptr snap = doc->snapshot();
+	ASSERT_TRUE(snap);
+	auto clone = document::clone_from_snapshot(snap);
+	ASSERT_TRUE(clone);
+	clone->render(800);
+	EXPECT_EQ(dump_document(clone), expected);
+
+	// The clone keeps working after the source and the snapshot are gone
+	doc.reset();
+	snap.reset();
+	container.viewport.width = 400;
+	clone->media_changed();
+	clone->render(400);
+	EXPECT_EQ(clone->root()->select_one(".a")->css().get_color(), web_color(0, 0, 255));
+}
+
+TEST(SnapshotTest, ClonesAreIndependent)
+{
+	test_doc_container container;
+	auto doc = document::createFromString(snapshot_page, &container);
+	doc->render(800);
+	auto snap = doc->snapshot();
+	auto first = document::clone_from_snapshot(snap);
+	auto second = document::clone_from_snapshot(snap);
+	first->render(800);
+	second->render(800);
+
+	element::ptr el = first->root()->select_one(".a");
+	EXPECT_NE(el, second->root()->select_one(".a"));
+	EXPECT_EQ(el->get_document(), first);
+
+	// Changing one clone doesn't change the other
+	el->set_attr("class", "b");
+	first->root()->refresh_styles();
+	first->root()->compute_styles();
+	first->render(800);
+	EXPECT_EQ(el->css().get_color(), web_color(0, 0, 0));
+	EXPECT_EQ(second->root()->select_one(".a")->css().get_color(), web_color(255, 0, 0));
+}
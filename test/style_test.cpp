@@ -0,0 +1,21 @@
+#include <gtest/gtest.h>
+#include "test_utils.h"
+
+using namespace litehtml;
+
+// Substituting a shorthand re-adds its longhands as typed values,
+// a longhand collected before must not be substituted again
+TEST(StyleTest, SubstVarsShorthandOverridesLonghand)
+{
+	test_doc_container container;
+	auto doc = document::createFromString(
+		"<div style='--m:2px;--t:5px;margin: var(--m); margin-top: var(--t)'>text</div>", &container);
+	doc->render(800);
+
+	element::ptr div = doc->root()->select_one("div");
+	ASSERT_TRUE(div);
+	const css_margins& margins = div->css().get_margins();
+	EXPECT_EQ(margins.left.val(), 2);
+	EXPECT_EQ(margins.right.val(), 2);
+	EXPECT_EQ(margins.bottom.val(), 2);
+}
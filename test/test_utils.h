@@ -0,0 +1,95 @@
+#ifndef LITEHTML_TEST_UTILS_H
+#define LITEHTML_TEST_UTILS_H
+
+#include <litehtml.h>
+#include <cstring>
+
+// Headless container for the unit tests: fixed font metrics, nothing is drawn.
+// Tests override the calls they want to observe.
+class test_doc_container : public litehtml::document_container
+{
+public:
+	litehtml::position	viewport = litehtml::position(0, 0, 800, 600);
+
+	litehtml::uint_ptr create_font(const litehtml::font_description& descr, const litehtml::document* /*doc*/, litehtml::font_metrics* fm) override
+	{
+		if (fm)
+		{
+			fm->font_size = descr.size;
+			fm->ascent = descr.size * 0.8f;
+			fm->descent = descr.size * 0.2f;
+			fm->height = descr.size;
+			fm->x_height = descr.size * 0.5f;
+			fm->ch_width = descr.size * 0.5f;
+		}
+		return 1;
+	}
+	void delete_font(litehtml::uint_ptr /*hFont*/) override {}
+	litehtml::pixel_t text_width(const char* text, litehtml::uint_ptr /*hFont*/) override { return (litehtml::pixel_t) (strlen(text) * 8); }
+	void draw_text(litehtml::uint_ptr /*hdc*/, const char* /*text*/, litehtml::uint_ptr /*hFont*/, litehtml::web_color /*color*/, const litehtml::position& /*pos*/) override {}
+	litehtml::pixel_t pt_to_px(float pt) const override { return pt * 96 / 72; }
+	litehtml::pixel_t get_default_font_size() const override { return 16; }
+	const char* get_default_font_name() const override { return "serif"; }
+	void draw_list_marker(litehtml::uint_ptr /*hdc*/, const litehtml::list_marker& /*marker*/) override {}
+	void load_image(const char* /*src*/, const char* /*baseurl*/, bool /*redraw_on_ready*/) override {}
+	void get_image_size(const char* /*src*/, const char* /*baseurl*/, litehtml::size& sz) override { sz.width = sz.height = 0; }
+	void draw_image(litehtml::uint_ptr /*hdc*/, const litehtml::background_layer& /*layer*/, const std::string& /*url*/, const std::string& /*base_url*/) override {}
+	void draw_solid_fill(litehtml::uint_ptr /*hdc*/, const litehtml::background_layer& /*layer*/, const litehtml::web_color& /*color*/) override {}
+	void draw_linear_gradient(litehtml::uint_ptr /*hdc*/, const litehtml::background_layer& /*layer*/, const litehtml::background_layer::linear_gradient& /*gradient*/) override {}
+	void draw_radial_gradient(litehtml::uint_ptr /*hdc*/, const litehtml::background_layer& /*layer*/, const litehtml::background_layer::radial_gradient& /*gradient*/) override {}
+	void draw_conic_gradient(litehtml::uint_ptr /*hdc*/, const litehtml::background_layer& /*layer*/, const litehtml::background_layer::conic_gradient& /*gradient*/) override {}
+	void draw_borders(litehtml::uint_ptr /*hdc*/, const litehtml::borders& /*borders*/, const litehtml::position& /*draw_pos*/, bool /*root*/) override {}
+	void set_caption(const char* /*caption*/) override {}
+	void set_base_url(const char* /*base_url*/) override {}
+	void link(const std::shared_ptr<litehtml::document>& /*doc*/, const litehtml::element::ptr& /*el*/) override {}
+	void on_anchor_click(const char* /*url*/, const litehtml::element::ptr& /*el*/) override {}
+	void on_mouse_event(const litehtml::element::ptr& /*el*/, litehtml::mouse_event /*event*/) override {}
+	void set_cursor(const char* /*cursor*/) override {}
+	void transform_text(litehtml::string& /*text*/, litehtml::text_transform /*tt*/) override {}
+	void import_css(litehtml::string& /*text*/, const litehtml::string& /*url*/, litehtml::string& /*baseurl*/) override {}
+	void set_clip(const litehtml::position& /*pos*/, const litehtml::border_radiuses& /*bdr_radius*/) override {}
+	void del_clip() override {}
+	void get_viewport(litehtml::position& vp) const override { vp = viewport; }
+	litehtml::element::ptr create_element(const char* /*tag_name*/, const litehtml::string_map& /*attributes*/, const std::shared_ptr<litehtml::document>& /*doc*/) override { return nullptr; }
+	void get_media_features(litehtml::media_features& media) const override
+	{
+		litehtml::document_container::get_media_features(media);
+		media.width = viewport.width;
+		media.height = viewport.height;
+	}
+};
+
+// Render tree and element placements as text, used to compare two documents
+class string_dumper : public litehtml::dumper
+{
+public:
+	litehtml::string	out;
+	int					depth = 0;
+
+	void begin_node(const litehtml::string& descr) override { out += litehtml::string(depth * 2, ' ') + descr + "\n"; depth++; }
+	void end_node() override { depth--; }
+	void begin_attrs_group(const litehtml::string& descr) override { out += litehtml::string(depth * 2, ' ') + "[" + descr + "]\n"; }
+	void end_attrs_group() override {}
+	void add_attr(const litehtml::string& name, const litehtml::string& value) override { out += litehtml::string(depth * 2, ' ') + name + "=" + value + "\n"; }
+};
+
+inline void dump_placements(const litehtml::element::ptr& el, litehtml::string& out)
+{
+	litehtml::position pos = el->get_placement();
+	out += el->dump_get_name() + " " + std::to_string(pos.x) + "," + std::to_string(pos.y) + " " +
+		   std::to_string(pos.width) + "x" + std::to_string(pos.height) + "\n";
+	for (const auto& child : el->children())
+	{
+		dump_placements(child, out);
+	}
+}
+
+inline litehtml::string dump_document(const litehtml::document::ptr& doc)
+{
+	string_dumper d;
+	doc->dump(d);
+	dump_placements(doc->root(), d.out);
+	return d.out;
+}
+
+#endif // LITEHTML_TEST_UTILS_H
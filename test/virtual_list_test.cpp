@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+#include <set>
+#include "test_utils.h"
+
+using namespace litehtml;
+
+namespace
+{
+	// Rows of 20px, records the elements it fills
+	class row_source : public virtual_list_source
+	{
+	public:
+		size_t					count;
+		string					html;
+		std::set<element*>		elements;
+		size_t					filled = 0;
+
+		row_source(size_t count, const string& html) : count(count), html(html) {}
+
+		size_t row_count() const override { return count; }
+		string row_template() const override { return html; }
+		void fill_row(size_t index, const element::ptr& row) override
+		{
+			row->set_attr("data-row", std::to_string(index).c_str());
+			elements.insert(row.get());
+			filled++;
+		}
+	};
+
+	// Document with all the rows in the DOM
+	document::ptr full_document(test_doc_container& container, const string& html, const string& row, size_t count)
+	{
+		string rows;
+		for (size_t i = 0; i < count; i++) rows += row;
+		size_t pos = html.find("></");
+		auto doc = document::createFromString(html.substr(0, pos + 1) + rows + html.substr(pos + 1), &container);
+		doc->render(800);
+		return doc;
+	}
+
+	// Table rows are not placed, only their cells
+	pixel_t row_top(const element::ptr& row)
+	{
+		return row->get_placement().height > 0 ? row->get_placement().y : row->children().front()->get_placement().y;
+	}
+
+	// Checks that the rows in the DOM are consecutive and placed where the full list places them,
+	// returns the range of rows in the DOM
+	std::pair<size_t, size_t> check_rows(const element::ptr& list, const element::ptr& full_list)
+	{
+		std::vector<element::ptr> full_rows(full_list->children().begin(), full_list->children().end());
+		size_t first = 0, last = 0;
+		bool is_first = true;
+		for (const auto& row : list->children())
+		{
+			const char* index = row->get_attr("data-row");
+			if (!index) continue;	// spacer
+			size_t i = (size_t) std::stoul(index);
+			if (is_first)
+			{
+				first = i;
+				is_first = false;
+			} else
+			{
+				EXPECT_EQ(i, last);
+			}
+			last = i + 1;
+			EXPECT_FLOAT_EQ(row_top(row), row_top(full_rows[i])) << "row " << i;
+		}
+		return {first, last};
+	}
+}
+
+TEST(VirtualListTest, ScrollMovesAndRecyclesRows)
+{
+	test_doc_container container;
+	string html = "<style>body, ul { margin: 0; padding: 0 } li { display: block; height: 20px }</style>"
+				  "<ul id='list'></ul><p>after</p>";
+	auto full = full_document(container, html, "<li><span>row</span></li>", 10000);
+	auto doc = document::createFromString(html, &container);
+	auto source = std::make_shared<row_source>(10000, "<li><span>row</span></li>");
+	element::ptr list = doc->root()->select_one("#list");
+	ASSERT_TRUE(doc->set_virtual_list(list, source));
+	doc->render(800);
+
+	// The first rows are laid out and measured, then the spacers are sized
+	EXPECT_TRUE(doc->update_virtual_lists());
+	doc->render(800);
+	EXPECT_FALSE(doc->update_virtual_lists());
+	EXPECT_FLOAT_EQ(doc->height(), full->height());
+
+	auto rows = check_rows(list, full->root()->select_one("#list"));
+	EXPECT_EQ(rows.first, 0u);
+	EXPECT_LT(rows.second, 100u);
+
+	// The window follows the viewport and the document height doesn't change
+	for (int y : {5000, 100000, 100300, 199400, 40000, 0})
+	{
+		container.viewport.y = y;
+		if (doc->update_virtual_lists())
+		{
+			doc->render(800);
+		}
+		EXPECT_FLOAT_EQ(doc->height(), full->height());
+		rows = check_rows(list, full->root()->select_one("#list"));
+		EXPECT_LE(rows.first, (size_t) y / 20) << "viewport " << y;
+		EXPECT_GE(rows.second, std::min((size_t) 10000, (size_t) (y + 600) / 20)) << "viewport " << y;
+		EXPECT_LT(rows.second - rows.first, 200u);
+	}
+	EXPECT_FLOAT_EQ(doc->root()->select_one("p")->get_placement().y, full->root()->select_one("p")->get_placement().y);
+
+	// Elements are reused for the new rows
+	EXPECT_GT(source->filled, 2 * source->elements.size());
+	EXPECT_LT(source->elements.size(), 300u);
+}
+
+TEST(VirtualListTest, TableBodyRows)
+{
+	test_doc_container container;
+	string html = "<style>body { margin: 0 } table { border-spacing: 0 } td { padding: 0 }</style>"
+				  "<table><tbody id='list'></tbody></table>";
+	auto full = full_document(container, html, "<tr><td>a</td><td>b</td></tr>", 1000);
+	auto doc = document::createFromString(html, &container);
+	auto source = std::make_shared<row_source>(1000, "<tr><td>a</td><td>b</td></tr>");
+	element::ptr list = doc->root()->select_one("#list");
+	ASSERT_TRUE(doc->set_virtual_list(list, source));
+	doc->render(800);
+	if (doc->update_virtual_lists()) doc->render(800);
+	EXPECT_FLOAT_EQ(doc->height(), full->height());
+
+	container.viewport.y = full->height() / 2;
+	ASSERT_TRUE(doc->update_virtual_lists());
+	doc->render(800);
+
+	auto rows = check_rows(list, full->root()->select_one("#list"));
+	EXPECT_LE(rows.first, 500u);
+	EXPECT_GT(rows.second, 500u);
+	EXPECT_LT(rows.second - rows.first, 300u);
+	EXPECT_FLOAT_EQ(doc->height(), full->height());
+}
+
+TEST(VirtualListTest, RowCountChange)
+{
+	test_doc_container container;
+	auto doc = document::createFromString(
+		"<style>body, ul { margin: 0; padding: 0 } li { display: block; height: 20px }</style><ul id='list'></ul>", &container);
+	auto source = std::make_shared<row_source>(100, "<li></li>");
+	element::ptr list = doc->root()->select_one("#list");
+	ASSERT_TRUE(doc->set_virtual_list(list, source));
+	doc->render(800);
+	if (doc->update_virtual_lists()) doc->render(800);
+	EXPECT_FLOAT_EQ(doc->height(), 100 * 20);
+
+	source->count = 5000;
+	EXPECT_TRUE(doc->update_virtual_lists());
+	doc->render(800);
+	EXPECT_FLOAT_EQ(doc->height(), 5000 * 20);
+
+	source->count = 10;
+	EXPECT_TRUE(doc->update_virtual_lists());
+	doc->render(800);
+	EXPECT_FLOAT_EQ(doc->height(), 10 * 20);
+}